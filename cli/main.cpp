@@ -0,0 +1,395 @@
+#include "webgrep/crawler.h"
+#include "webgrep/results_sink.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+/** Headless crawler: greps the pages reachable from the URL and prints the matches
+ *  as "URL<TAB>matched text" lines (or JSON Lines, binary records), then the summary of the crawl.
+ *  Exit codes: 0 -- done, 1 -- bad arguments, 2 -- the crawl has not started
+ *  (bad expression, the first page is not downloaded), 3 -- stopped by the timeout or a signal.*/
+
+static const char* usageText =
+    "Usage: webgrep-cli [options] URL REGEX\n"
+    "  -n, --max-links N     crawl N pages at most (4096)\n"
+    "  -t, --threads N       working threads, 1..32 (4)\n"
+    "  -o, --output FILE     write the results to FILE, \"-\" is stdout (default)\n"
+    "  -f, --format F        results format: text (URL<TAB>match lines), jsonl or binary (text)\n"
+    "      --with-body       write the pages' content too (jsonl and binary)\n"
+    "  -s, --summary FILE    write the summary to FILE instead of stderr\n"
+    "  -p, --policy P        order of the pages: bfs, dfs or best (bfs)\n"
+    "  -T, --timeout SEC     stop the crawl after SEC seconds, 0 -- no limit (0)\n"
+    "      --max-page BYTES  skip the bigger pages, 0 -- no limit (8388608)\n"
+    "      --rate RPS        requests per second to one host, 0 -- no limit (10)\n"
+    "      --cache DIR       keep the pages in DIR for the conditional GET\n"
+    "      --no-robots       don't follow robots.txt\n"
+    "      --checkpoint FILE journal the crawl to FILE to resume it after a restart\n"
+    "      --resume          continue the crawl journaled to the checkpoint's FILE,\n"
+    "                        the results are appended to the output FILE\n"
+    "      --metrics FILE    write the crawl's metrics to FILE every second (Prometheus text)\n"
+    "  -h, --help            print this text\n";
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void OnSignal(int)
+{
+  interrupted = 1;
+}
+
+struct CliOptions
+{
+  CliOptions() : maxLinks(4096), threads(4), timeoutSec(0), maxPageBytes(8u << 20),
+    rate(10.0), obeyRobots(true), withBody(false), resume(false), format("text"),
+    policy(WebGrep::FrontierPolicy::BFS)
+  { }
+
+  std::string url, regex, output, summary, cacheDir, checkpoint, metrics;
+  unsigned long maxLinks, threads, timeoutSec, maxPageBytes;
+  double rate;
+  bool obeyRobots, withBody, resume;
+  std::string format;
+  WebGrep::FrontierPolicy policy;
+};
+
+/** Counts the pages for the summary and passes them to the sink of the chosen format,
+ *  the text format is written here.*/
+class CliSink : public WebGrep::ResultsSink
+{
+public:
+  CliSink(std::ostream* os, std::shared_ptr<WebGrep::ResultsSink> formatSink)
+    : ResultsSink(nullptr != formatSink && formatSink->withBody()), out(os), next(formatSink),
+      pages(0), failed(0), pagesMatched(0), matches(0), bytes(0)
+  { }
+
+  std::ostream* out;
+  std::shared_ptr<WebGrep::ResultsSink> next;//< NULL for the text format
+  size_t pages, failed, pagesMatched, matches;
+  unsigned long long bytes;
+  std::vector<unsigned> fetchMs;
+
+protected:
+  bool doWrite(const WebGrep::PageRecord& rec) override;
+  bool doFlush() override
+  {
+    if (nullptr != next)
+      return next->flush();
+    out->flush();
+    return !out->fail();
+  }
+
+  std::string line;
+};
+
+//parse decimal (text) to (value), FALSE on garbage
+static bool ParseNumber(const char* text, unsigned long& value)
+{
+  if (nullptr == text || '\0' == *text || '-' == *text)
+    return false;
+  char* end = nullptr;
+  value = std::strtoul(text, &end, 10);
+  return '\0' == *end;
+}
+
+//TRUE for the options followed by a value
+static bool TakesValue(const std::string& arg)
+{
+  static const char* names[] = {
+    "-n", "--max-links", "-t", "--threads", "-o", "--output", "-s", "--summary",
+    "-f", "--format", "-p", "--policy", "-T", "--timeout", "--max-page", "--rate", "--cache",
+    "--checkpoint", "--metrics"
+  };
+  for(const char* name : names)
+    {
+      if (arg == name)
+        return true;
+    }
+  return false;
+}
+
+static bool ParseArgs(int argc, char** argv, CliOptions& opt)
+{
+  std::vector<std::string> positional;
+  for(int idx = 1; idx < argc; ++idx)
+    {
+      std::string arg = argv[idx];
+      //the options with a value:
+      const char* value = (idx + 1 < argc)? argv[idx + 1] : nullptr;
+      bool ok = true;
+      if ("-h" == arg || "--help" == arg)
+        {
+          std::cout << usageText;
+          std::exit(0);
+        }
+      else if ("--no-robots" == arg)
+        {
+          opt.obeyRobots = false;
+          continue;
+        }
+      else if ("--with-body" == arg)
+        {
+          opt.withBody = true;
+          continue;
+        }
+      else if ("--resume" == arg)
+        {
+          opt.resume = true;
+          continue;
+        }
+      else if (arg.size() < 2 || '-' != arg[0])
+        {
+          positional.push_back(arg);
+          continue;
+        }
+      else if (!TakesValue(arg))
+        {
+          std::cerr << "webgrep-cli: unknown option " << arg << "\n";
+          return false;
+        }
+      else if (nullptr == value)
+        {
+          std::cerr << "webgrep-cli: " << arg << " requires a value\n";
+          return false;
+        }
+      else if ("-n" == arg || "--max-links" == arg)
+        ok = ParseNumber(value, opt.maxLinks) && opt.maxLinks > 0;
+      else if ("-t" == arg || "--threads" == arg)
+        ok = ParseNumber(value, opt.threads) && opt.threads > 0 && opt.threads <= WebGrep::Crawler::maxThreads;
+      else if ("-T" == arg || "--timeout" == arg)
+        ok = ParseNumber(value, opt.timeoutSec);
+      else if ("--max-page" == arg)
+        ok = ParseNumber(value, opt.maxPageBytes);
+      else if ("--rate" == arg)
+        {
+          char* end = nullptr;
+          opt.rate = std::strtod(value, &end);
+          ok = '\0' == *end && opt.rate >= 0;
+        }
+      else if ("-o" == arg || "--output" == arg)
+        opt.output = value;
+      else if ("-s" == arg || "--summary" == arg)
+        opt.summary = value;
+      else if ("--cache" == arg)
+        opt.cacheDir = value;
+      else if ("--checkpoint" == arg)
+        opt.checkpoint = value;
+      else if ("--metrics" == arg)
+        opt.metrics = value;
+      else if ("-f" == arg || "--format" == arg)
+        {
+          opt.format = value;
+          ok = "text" == opt.format || "jsonl" == opt.format || "binary" == opt.format;
+        }
+      else if ("-p" == arg || "--policy" == arg)
+        {
+          std::string p = value;
+          if ("bfs" == p)
+            opt.policy = WebGrep::FrontierPolicy::BFS;
+          else if ("dfs" == p)
+            opt.policy = WebGrep::FrontierPolicy::DFS;
+          else if ("best" == p)
+            opt.policy = WebGrep::FrontierPolicy::BEST_FIRST;
+          else
+            ok = false;
+        }
+      if (!ok)
+        {
+          std::cerr << "webgrep-cli: bad value of " << arg << ": " << value << "\n";
+          return false;
+        }
+      ++idx;//the value is taken
+    }
+  if (2 != positional.size())
+    {
+      std::cerr << "webgrep-cli: expected URL and REGEX\n";
+      return false;
+    }
+  if (opt.resume && opt.checkpoint.empty())
+    {
+      std::cerr << "webgrep-cli: --resume requires --checkpoint FILE\n";
+      return false;
+    }
+  opt.url = positional[0];
+  opt.regex = positional[1];
+  return true;
+}
+
+//called in the crawler's threads on each page
+bool CliSink::doWrite(const WebGrep::PageRecord& rec)
+{
+  if (!rec.downloaded || (200 != rec.responseCode && 304 != rec.responseCode))
+    ++failed;
+  else
+    {
+      ++pages;
+      bytes += rec.pageBytes;
+      fetchMs.push_back(rec.fetchMs);
+      pagesMatched += rec.matches.empty()? 0 : 1;
+      matches += rec.matches.size();
+    }
+  if (nullptr != next)
+    return next->write(rec);
+  for(const std::string& match : rec.matches)
+    {
+      line = match;
+      std::replace_if(line.begin(), line.end(),
+                      [](char c) { return '\n' == c || '\r' == c || '\t' == c; }, ' ');
+      *out << rec.url << '\t' << line << '\n';
+    }
+  return !out->fail();
+}
+
+//nearest-rank percentile of the sorted (values)
+static unsigned Percentile(const std::vector<unsigned>& values, double p)
+{
+  if (values.empty())
+    return 0;
+  size_t rank = (size_t)(p * (double)values.size() + 0.5);
+  return values[std::min(values.size() - 1, rank > 0? rank - 1 : 0)];
+}
+
+//"p50/p99" of the stage's histogram, milliseconds
+static std::string StageQuantiles(const WebGrep::MetricsSnapshot& metrics, const char* stage)
+{
+  WebGrep::HistogramSnapshot h = metrics.histogram(std::string("webgrep_") + stage + "_seconds");
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "%s %.2f/%.2f", stage,
+                (double)h.quantileUs(0.5) / 1000.0, (double)h.quantileUs(0.99) / 1000.0);
+  return buf;
+}
+
+static void PrintSummary(std::ostream& os, CliSink& stats, const WebGrep::MetricsSnapshot& metrics,
+                         double elapsedSec, const char* status)
+{
+  std::vector<unsigned>& ms(stats.fetchMs);
+  std::sort(ms.begin(), ms.end());
+  double seconds = std::max(elapsedSec, 0.001);
+  char buf[256];
+  os << "status: " << status << "\n";
+  os << "pages: " << stats.pages << " downloaded, " << stats.failed << " failed\n";
+  os << "matches: " << stats.matches << " on " << stats.pagesMatched << " pages\n";
+  os << "bytes: " << stats.bytes << "\n";
+  std::snprintf(buf, sizeof(buf), "elapsed: %.3f s\n", elapsedSec);
+  os << buf;
+  std::snprintf(buf, sizeof(buf), "throughput: %.2f pages/s, %.1f KB/s\n",
+                (double)stats.pages / seconds, (double)stats.bytes / 1024.0 / seconds);
+  os << buf;
+  std::snprintf(buf, sizeof(buf), "latency ms: p50 %u, p90 %u, p99 %u, max %u\n",
+                Percentile(ms, 0.5), Percentile(ms, 0.9), Percentile(ms, 0.99),
+                ms.empty()? 0 : ms.back());
+  os << buf;
+  os << "stages ms p50/p99:";
+  const char* stages[] = { "connect", "ttfb", "download", "fetch", "parse", "grep", "queue_wait", "task" };
+  for(size_t idx = 0; idx < sizeof(stages) / sizeof(stages[0]); ++idx)
+    os << (0 == idx? " " : ", ") << StageQuantiles(metrics, stages[idx]);
+  os << "\n";
+  os.flush();
+}
+
+int main(int argc, char** argv)
+{
+  CliOptions opt;
+  if (!ParseArgs(argc, argv, opt))
+    {
+      std::cerr << usageText;
+      return 1;
+    }
+
+  std::ofstream outFile;
+  std::ostream* out = &std::cout;
+  bool appended = false;//< the resumed crawl's results go after the previous ones
+  if (!opt.output.empty() && "-" != opt.output)
+    {
+      outFile.open(opt.output, std::ios::out | std::ios::binary
+                   | (opt.resume? std::ios::app : std::ios::trunc));
+      if (!outFile)
+        {
+          std::cerr << "webgrep-cli: can't write " << opt.output << "\n";
+          return 1;
+        }
+      outFile.seekp(0, std::ios::end);
+      appended = outFile.tellp() > 0;
+      out = &outFile;
+    }
+  std::shared_ptr<WebGrep::ResultsSink> formatSink;
+  if ("jsonl" == opt.format)
+    formatSink = std::make_shared<WebGrep::JsonLinesSink>(out, opt.withBody);
+  else if ("binary" == opt.format)
+    formatSink = std::make_shared<WebGrep::BinaryRecordSink>(out, opt.withBody, !appended);
+  //the stopped crawler's threads may outlive main(), the sink is closed before that
+  std::shared_ptr<CliSink> stats = std::make_shared<CliSink>(out, formatSink);
+
+  WebGrep::Crawler crawler;
+  crawler.setMaxPageSize(opt.maxPageBytes);
+  crawler.setObeyRobots(opt.obeyRobots);
+  crawler.setHostLimits(opt.rate);
+  if (!opt.cacheDir.empty() && !crawler.setCacheDir(opt.cacheDir))
+    {
+      std::cerr << "webgrep-cli: can't use the cache directory " << opt.cacheDir << "\n";
+      return 1;
+    }
+  crawler.setResultsSink(stats);
+  crawler.setCheckpoint(opt.checkpoint);
+  if (!opt.metrics.empty() && !crawler.setMetricsFile(opt.metrics, 1000))
+    {
+      std::cerr << "webgrep-cli: can't write the metrics to " << opt.metrics << "\n";
+      return 1;
+    }
+
+  std::signal(SIGINT, &OnSignal);
+  std::signal(SIGTERM, &OnSignal);
+
+  auto started = std::chrono::steady_clock::now();
+  auto deadline = started + std::chrono::seconds(opt.timeoutSec);
+  std::shared_ptr<WebGrep::LinkedTask> root
+      = crawler.start(opt.url, opt.regex, (unsigned)opt.maxLinks, (unsigned)opt.threads, opt.policy,
+                      opt.resume);
+  if (nullptr == root)
+    {
+      std::cerr << "webgrep-cli: failed to start the crawl\n";
+      return 2;
+    }
+
+  bool finished = false;
+  while(!finished && !interrupted)
+    {
+      if (0 != opt.timeoutSec && std::chrono::steady_clock::now() >= deadline)
+        break;
+      finished = crawler.waitIdle(500);
+    }
+  crawler.stop();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  const char* status = finished? "done" : (interrupted? "interrupted" : "timeout");
+  int code = finished? 0 : 3;
+  //the stopped tasks may still report the pages
+  stats->close();
+  WebGrep::MetricsSnapshot metrics = crawler.stats();
+  //the last values are written when the writer is stopped
+  crawler.setMetricsFile(std::string());
+  //a resumed crawl may have nothing left to download
+  if (finished && 0 == stats->pages && !opt.resume)
+    {
+      status = "failed";
+      code = 2;
+    }
+  if (opt.summary.empty())
+    {
+      PrintSummary(std::cerr, *stats, metrics, elapsed, status);
+    }
+  else
+    {
+      std::ofstream summaryFile(opt.summary, std::ios::out | std::ios::trunc);
+      PrintSummary(summaryFile, *stats, metrics, elapsed, status);
+      if (!summaryFile)
+        std::cerr << "webgrep-cli: can't write " << opt.summary << "\n";
+    }
+  return code;
+}
@@ -0,0 +1,218 @@
+#include "webgrep/crawl_checkpoint.h"
+#include "webgrep/linked_task.h"
+#include <list>
+#include <string>
+#include <fstream>
+#include <cstdlib>
+#include <iostream>
+#include <functional>
+#include <unistd.h>
+#include "checkpoint_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = CrawlCheckpointTests::Test();
+  return (int)!result;
+}
+
+namespace CrawlCheckpointTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+//a fresh file in /tmp
+static std::string TempFile()
+{
+  char name[] = "/tmp/webgrep_checkpoint_XXXXXX";
+  int fd = ::mkstemp(name);
+  if (fd < 0)
+    return std::string();
+  ::close(fd);
+  return std::string(name);
+}
+
+static PageRecord MakeRecord(const std::string& url, long code, unsigned level)
+{
+  PageRecord rec;
+  rec.url = url;
+  rec.responseCode = code;
+  rec.downloaded = (200 == code);
+  rec.level = level;
+  rec.fetchMs = 7;
+  rec.pageBytes = 1000;
+  return rec;
+}
+
+//spawn the child level of (node) with the (urls)
+static void SpawnLinks(LinkedTask* node, const std::vector<std::string>& urls)
+{
+  LinkedTask* old = nullptr;
+  LinkedTask* head = node->spawnChildNode(old);
+  head->spawnNextNodes(urls.size() - 1);
+  size_t idx = 0;
+  ForEachOnBranch(head, [&](LinkedTask* item) { item->grepVars.targetUrl = urls[idx++]; });
+}
+
+static bool WriteLoad(const std::string& path)
+{
+  std::shared_ptr<LinkedTask> root = LinkedTask::createRootNode();
+  root->grepVars.targetUrl = "http://a.b/";
+  SpawnLinks(root.get(), {"http://a.b/1", "http://a.b/2\tx"});
+  {
+    CrawlCheckpoint cp(path, 60000);
+    if (!cp.begin("http://a.b/", "foo\\d"))
+      return false;
+    PageRecord rec = MakeRecord("http://a.b/", 200, 0);
+    rec.matches.push_back("foo1");
+    rec.matches.push_back("line\nbreak\\");
+    cp.writePage(rec, root.get());
+    LinkedTask* child = ItemLoadAcquire(root->child);
+    cp.writePage(MakeRecord("http://a.b/1", 404, 1), child);
+    cp.writePage(MakeRecord("http://a.b/1", -1, 1), child);
+    //the destructor flushes
+  }
+  CrawlCheckpoint::State state;
+  if (!CrawlCheckpoint::Load(path, state) || "http://a.b/" != state.rootUrl || "foo\\d" != state.grepRegex
+      || 2 != state.pages.size())
+    return false;
+  const CrawlCheckpoint::Page& first(state.pages["http://a.b/"]);
+  const CrawlCheckpoint::Page& second(state.pages["http://a.b/1"]);
+  return 200 == first.rec.responseCode && first.rec.downloaded && 0 == first.rec.level
+        && 7 == first.rec.fetchMs && 1000 == first.rec.pageBytes
+        && 2 == first.rec.matches.size() && "line\nbreak\\" == first.rec.matches[1]
+        && 2 == first.links.size() && "http://a.b/2\tx" == first.links[1]
+        && -1 == second.rec.responseCode && !second.rec.downloaded && 1 == second.rec.level
+        && second.links.empty();
+}
+
+bool test1()
+{
+  std::string path = TempFile();
+  bool ok = WriteLoad(path);
+  ::unlink(path.c_str());
+  return ok;
+}
+
+bool test2()
+{
+  CrawlCheckpoint::State state;
+  state.rootUrl = "http://a.b/";
+  CrawlCheckpoint::Page page;
+  page.rec = MakeRecord("http://a.b/", 200, 0);
+  page.rec.matches.push_back("foo");
+  page.links = {"http://a.b/1", "http://a.b/2", "http://a.b/3"};
+  state.pages[page.rec.url] = page;
+  page.rec = MakeRecord("http://a.b/1", 200, 1);
+  page.rec.matches = {"bar", "baz"};
+  page.links = {"http://a.b/2", "http://a.b/1/x"};//a link of another page is not repeated
+  state.pages[page.rec.url] = page;
+  page.rec = MakeRecord("http://a.b/3", 404, 1);
+  page.rec.matches.clear();
+  page.links.clear();
+  state.pages[page.rec.url] = page;
+  page.rec = MakeRecord("http://c.d/orphan", 200, 2);//it's parent was not finished
+  state.pages[page.rec.url] = page;
+
+  std::shared_ptr<LinkedTask> root = LinkedTask::createRootNode();
+  root->visitedSet = std::make_shared<VisitedSet>();
+  std::vector<LinkedTask*> pending;
+  if (4 != CrawlCheckpoint::Restore(state, root.get(), pending))
+    return false;
+  //pending: /2 of the first level, then /1/x
+  if (2 != pending.size() || "http://a.b/2" != pending[0]->grepVars.targetUrl
+      || "http://a.b/1/x" != pending[1]->grepVars.targetUrl || 2 != pending[1]->level)
+    return false;
+  LinkedTask* first = ItemLoadAcquire(root->child);
+  if (!root->grepVars.pageIsParsed || 1 != root->grepVars.matchTextVector.size()
+      || nullptr == first || "http://a.b/1" != first->grepVars.targetUrl || 1 != first->level
+      || 2 != first->grepVars.matchTextVector.size())
+    return false;
+  const GrepVars::CIteratorPair& match(first->grepVars.matchTextVector[1]);
+  if ("baz" != std::string(match.first, match.second))
+    return false;
+  LinkedTask* third = ItemLoadAcquire(ItemLoadAcquire(first->next)->next);
+  if (nullptr == third || 404 != third->grepVars.responseCode || third->grepVars.pageIsReady
+      || !third->grepVars.pageIsParsed)
+    return false;
+  return 5 == root->visitedSet->size() && root->visitedSet->contains("http://a.b/1/x")
+      && !root->visitedSet->contains("http://c.d/orphan");
+}
+
+static bool CutAndReopen(const std::string& path)
+{
+  std::shared_ptr<LinkedTask> root = LinkedTask::createRootNode();
+  {
+    CrawlCheckpoint cp(path, 0);
+    cp.begin("http://a.b/", "foo");
+    cp.writePage(MakeRecord("http://a.b/", 200, 0), root.get());
+  }
+  {//a broken line and the cut one
+    std::ofstream out(path, std::ios::app | std::ios::binary);
+    out << "P\thttp://a.b/broken\t200\n";
+    out << "P\thttp://a.b/cut\t200\t1\t1";
+  }
+  CrawlCheckpoint::State state;
+  if (!CrawlCheckpoint::Load(path, state) || 1 != state.pages.size())
+    return false;
+  {
+    CrawlCheckpoint cp(path, 0);
+    if (!cp.reopen())
+      return false;
+    cp.writePage(MakeRecord("http://a.b/2", 200, 1), root.get());
+  }
+  if (!CrawlCheckpoint::Load(path, state) || 2 != state.pages.size()
+      || 1 != state.pages.count("http://a.b/2") || 0 != state.pages.count("http://a.b/cut"))
+    return false;
+
+  //not a checkpoint
+  {
+    std::ofstream out(path, std::ios::trunc | std::ios::binary);
+    out << "webgrep-checkpoint\t2\thttp://a.b/\tfoo\n";
+  }
+  return !CrawlCheckpoint::Load(path, state) && !CrawlCheckpoint::Load(path + ".missing", state);
+}
+
+bool test3()
+{
+  std::string path = TempFile();
+  bool ok = CutAndReopen(path);
+  ::unlink(path.c_str());
+  return ok;
+}
+
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test checkpoint write and load: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test restore of the tree: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test cut line and reopen: ",
+                  []()->bool {return test3();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//CrawlCheckpointTests
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace CrawlCheckpointTests {
+
+  /** The pages written by writePage() are read back by Load(): the results, the links
+   *  of the child level, the escaped tabs and new lines; the latest record of a page wins.*/
+  bool test1();
+
+  /** Restore(): the tree is rebuilt from the first page by the links, the pages without
+   *  a record are pending, the orphan records and the repeated links are skipped.*/
+  bool test2();
+
+  /** A line cut by the killed process is skipped, reopen() appends after it.*/
+  bool test3();
+
+  //accumulative test:
+  bool Test();
+}
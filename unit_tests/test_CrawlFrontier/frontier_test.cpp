@@ -0,0 +1,543 @@
+#include "webgrep/crawl_frontier.h"
+#include "webgrep/linked_task.h"
+#include <list>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include <functional>
+#include "frontier_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = CrawlFrontierTests::Test();
+  return (int)!result;
+}
+
+namespace CrawlFrontierTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+typedef CrawlFrontier::Clock_t Clock_t;
+
+//levels 0..2, 3 nodes on each level, URLs of different depth
+static std::vector<LinkedTask*> MakeNodes(RootNodePtr& root)
+{
+  std::vector<LinkedTask*> nodes;
+  root->maxPossbleNodesQuantity.store(1000);
+  LinkedTask* head = root.get();
+  LinkedTask* expelled = nullptr;
+  for(unsigned level = 1; level <= 3; ++level)
+    {
+      head = head->spawnChildNode(expelled);
+      head->spawnNextNodes(2);
+      unsigned idx = 0;
+      for(LinkedTask* item = head; nullptr != item; item = ItemLoadAcquire(item->next), ++idx)
+        {
+          item->grepVars.targetUrl = "http://site.com/";
+          for(unsigned dir = 0; dir < (idx + 1) % 3; ++dir)
+            item->grepVars.targetUrl += "dir/";
+          item->grepVars.targetUrl += "page.html";
+          nodes.push_back(item);
+        }
+    }
+  return nodes;
+}
+
+static std::vector<LinkedTask*> Drain(CrawlFrontier& f)
+{
+  std::vector<LinkedTask*> order;
+  FrontierItem item;
+  Clock_t::time_point waitUntil;
+  while(f.pop(item, waitUntil))
+    order.push_back(item.node);
+  return order;
+}
+
+bool test1()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  std::vector<LinkedTask*> nodes = MakeNodes(root);
+
+  CrawlFrontier f(FrontierPolicy::BFS);
+  //pushed deepest first:
+  for(size_t idx = nodes.size(); idx > 0; --idx)
+    f.push(nodes[idx - 1], nullptr, nullptr);
+  std::vector<LinkedTask*> bfs = Drain(f);
+  for(size_t idx = 1; idx < bfs.size(); ++idx)
+    {
+      if (bfs[idx - 1]->level > bfs[idx]->level)
+        return false;
+    }
+
+  for(LinkedTask* node : nodes)
+    f.push(node, nullptr, nullptr);
+  f.setPolicy(FrontierPolicy::DFS);
+  std::vector<LinkedTask*> dfs = Drain(f);
+  //the deepest level first, the last pushed first
+  if (nodes.size() != dfs.size() || dfs.front() != nodes.back())
+    return false;
+  for(size_t idx = 1; idx < dfs.size(); ++idx)
+    {
+      if (dfs[idx - 1]->level < dfs[idx]->level)
+        return false;
+    }
+
+  f.setPolicy(FrontierPolicy::BEST_FIRST);
+  for(LinkedTask* node : nodes)
+    f.push(node, nullptr, nullptr);
+  std::vector<LinkedTask*> best = Drain(f);
+  for(size_t idx = 1; idx < best.size(); ++idx)
+    {
+      double a = CrawlFrontier::DefaultScore(best[idx - 1]->grepVars.targetUrl, best[idx - 1]->level);
+      double b = CrawlFrontier::DefaultScore(best[idx]->grepVars.targetUrl, best[idx]->level);
+      if (a < b)
+        return false;
+    }
+  return nodes.size() == bfs.size() && nodes.size() == best.size() && 0 == f.size();
+}
+
+bool test2()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  std::vector<LinkedTask*> nodes = MakeNodes(root);
+  nodes[0]->grepVars.targetUrl = "http://slow.org/a.html";
+  nodes[1]->grepVars.targetUrl = "http://slow.org/b.html";
+
+  CrawlFrontier f(FrontierPolicy::BFS);
+  for(LinkedTask* node : nodes)
+    f.push(node, nullptr, nullptr);
+  Clock_t::time_point until = Clock_t::now() + std::chrono::milliseconds(200);
+  f.delayHost("slow.org", until);
+
+  std::vector<LinkedTask*> first = Drain(f);
+  if (nodes.size() - 2 != first.size() || 2 != f.parkedCount())
+    return false;
+  FrontierItem item;
+  Clock_t::time_point waitUntil;
+  if (f.pop(item, waitUntil) || waitUntil != until)
+    return false;
+
+  std::this_thread::sleep_until(until);
+  std::vector<LinkedTask*> later = Drain(f);
+  return 2 == later.size() && nodes[0] == later[0] && nodes[1] == later[1] && 0 == f.size();
+}
+
+bool test3()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  root->maxPossbleNodesQuantity.store(100000);
+  LinkedTask* expelled = nullptr;
+  LinkedTask* child = root->spawnChildNode(expelled);
+  const size_t count = 20000;
+  child->spawnNextNodes(count - 1);
+  std::vector<LinkedTask*> nodes;
+  for(LinkedTask* item = child; nullptr != item; item = ItemLoadAcquire(item->next))
+    {
+      item->grepVars.targetUrl = "http://site.com/" + std::to_string(nodes.size());
+      nodes.push_back(item);
+    }
+
+  CrawlFrontier f(FrontierPolicy::BEST_FIRST);
+  std::vector<std::atomic_uint> taken(count);
+  std::atomic<size_t> pushed(0);
+  std::vector<std::thread> pool;
+  for(size_t t = 0; t < 4; ++t)
+    {
+      pool.emplace_back([&, t]()
+      {
+        for(size_t idx = t; idx < count; idx += 4)
+          {
+            f.push(nodes[idx], nullptr, nullptr);
+            pushed.fetch_add(1);
+          }
+      });
+      pool.emplace_back([&]()
+      {
+        FrontierItem item;
+        Clock_t::time_point waitUntil;
+        while(pushed.load() < count || 0 != f.size())
+          {
+            if (f.pop(item, waitUntil))
+              taken[std::stoul(item.node->grepVars.targetUrl.substr(16))].fetch_add(1);
+          }
+      });
+    }
+  for(std::thread& t : pool)
+    t.join();
+  for(std::atomic_uint& cnt : taken)
+    {
+      if (1 != cnt.load())
+        return false;
+    }
+  return true;
+}
+
+bool test4()
+{
+  Clock_t::time_point readyAt;
+  {//2 requests at once, then 1 per 50ms
+    HostScheduler s(20.0, 2, 0);
+    if (!s.tryAcquire("a.com", readyAt) || !s.tryAcquire("a.com", readyAt))
+      return false;
+    Clock_t::time_point now = Clock_t::now();
+    if (s.tryAcquire("a.com", readyAt) || readyAt <= now
+        || readyAt > now + std::chrono::milliseconds(60))
+      return false;
+    if (!s.tryAcquire("b.com", readyAt))//the other host has own bucket
+      return false;
+    std::this_thread::sleep_until(readyAt);
+    if (!s.tryAcquire("a.com", readyAt))
+      return false;
+  }
+  {//not more than 2 in flight, the slot is released once and reported without polling
+    std::shared_ptr<HostScheduler> s = std::make_shared<HostScheduler>(0.0, 1, 2);
+    std::vector<std::string> freed;
+    s->setSlotFreedFunc([&freed](const std::string& host) { freed.push_back(host); });
+    if (!s->tryAcquire("a.com", readyAt) || !s->tryAcquire("a.com", readyAt)
+        || s->tryAcquire("a.com", readyAt) || Clock_t::time_point::max() != readyAt)
+      return false;
+    {
+      HostSlot slot(s, "a.com");
+      slot.done(200);
+      slot.done(200);
+    }
+    if (1 != freed.size() || "a.com" != freed.front())
+      return false;
+    if (1 != s->inFlight("a.com") || !s->tryAcquire("a.com", readyAt))
+      return false;
+    {
+      HostSlot slot(s, "a.com");//not done: released by the destructor
+    }
+    if (1 != s->inFlight("a.com"))
+      return false;
+  }
+  {//503 without Retry-After: 1 second, then twice as long; 429 with Retry-After
+    HostScheduler s(0.0, 1, 0);
+    s.tryAcquire("a.com", readyAt);
+    Clock_t::time_point now = Clock_t::now();
+    s.release("a.com", 503);
+    if (s.tryAcquire("a.com", readyAt) || readyAt < now + std::chrono::milliseconds(900))
+      return false;
+    s.release("a.com", 503);
+    if (s.tryAcquire("a.com", readyAt) || readyAt < now + std::chrono::milliseconds(1900))
+      return false;
+    now = Clock_t::now();
+    s.release("b.com", 429, 30);
+    if (s.tryAcquire("b.com", readyAt) || readyAt < now + std::chrono::seconds(29))
+      return false;
+    if (!s.tryAcquire("c.com", readyAt))
+      return false;
+  }
+  return true;
+}
+
+bool test5()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  std::vector<LinkedTask*> nodes = MakeNodes(root);
+  nodes[0]->grepVars.targetUrl = "http://busy.org/a.html";
+  nodes[1]->grepVars.targetUrl = "http://busy.org/b.html";
+  nodes[2]->grepVars.targetUrl = "http://busy.org/c.html";
+
+  std::shared_ptr<HostScheduler> s = std::make_shared<HostScheduler>(0.0, 1, 1);
+  CrawlFrontier f(FrontierPolicy::BFS);
+  f.setHostScheduler(s);
+  for(LinkedTask* node : nodes)
+    f.push(node, nullptr, nullptr);
+
+  //one page of busy.org and one of site.com, the others wait for the slots
+  FrontierItem busy, other;
+  Clock_t::time_point waitUntil;
+  if (!f.pop(busy, waitUntil) || !f.pop(other, waitUntil) || f.pop(other, waitUntil))
+    return false;
+  if (nodes[0] != busy.node || !busy.hostAcquired || nodes.size() - 2 != f.parkedCount())
+    return false;
+  //nothing to wait by time: the hosts are unparked by the freed slots
+  if (Clock_t::time_point::max() != waitUntil)
+    return false;
+
+  s->release(busy.host, 200);
+  s->release(other.host, 200);
+  FrontierItem next;
+  if (!f.pop(next, waitUntil) || nodes[1] != next.node)
+    return false;
+
+  //the busy host backs off, site.com's pages are given meanwhile
+  s->release(next.host, 503);
+  std::vector<LinkedTask*> rest;
+  while(rest.size() < nodes.size() - 4)
+    {
+      if (f.pop(next, waitUntil))
+        {
+          rest.push_back(next.node);
+          s->release(next.host, 200);
+        }
+      else
+        std::this_thread::sleep_until(std::min(waitUntil, Clock_t::now() + std::chrono::milliseconds(50)));
+    }
+  for(LinkedTask* node : rest)
+    {
+      if (nodes[2] == node)
+        return false;
+    }
+  return 1 == f.size();
+}
+
+bool test6()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  root->maxPossbleNodesQuantity.store(100000);
+  LinkedTask* expelled = nullptr;
+  LinkedTask* child = root->spawnChildNode(expelled);
+  const size_t count = 20000;
+  child->spawnNextNodes(count - 1);
+  std::vector<LinkedTask*> nodes;
+  for(LinkedTask* item = child; nullptr != item; item = ItemLoadAcquire(item->next))
+    {
+      item->grepVars.targetUrl = "http://slow.org/" + std::to_string(nodes.size());
+      nodes.push_back(item);
+    }
+  nodes.back()->grepVars.targetUrl = "http://site.com/";
+
+  //200 requests per second, each pop() in between finds the host parked
+  std::shared_ptr<HostScheduler> s = std::make_shared<HostScheduler>(200.0, 1, 0);
+  CrawlFrontier f(FrontierPolicy::BFS);
+  f.setHostScheduler(s);
+  for(LinkedTask* node : nodes)
+    f.push(node, nullptr, nullptr);
+
+  std::vector<LinkedTask*> taken;
+  Clock_t::duration inPop(0);
+  FrontierItem item;
+  Clock_t::time_point waitUntil;
+  while(taken.size() < 100)
+    {
+      Clock_t::time_point started = Clock_t::now();
+      bool got = f.pop(item, waitUntil);
+      inPop += Clock_t::now() - started;
+      if (!got)
+        {
+          std::this_thread::sleep_until(waitUntil);
+          continue;
+        }
+      taken.push_back(item.node);
+      s->release(item.host, 200);
+    }
+  if (count - 100 != f.size() || inPop > std::chrono::milliseconds(100))
+    return false;
+  //the other host is not held by the parked one, the parked host keeps it's order
+  bool other = false;
+  for(size_t idx = 0, next = 0; idx < taken.size(); ++idx)
+    {
+      if (nodes.back() == taken[idx])
+        {
+          other = true;
+          continue;
+        }
+      if (nodes[next++] != taken[idx])
+        return false;
+    }
+  return other;
+}
+
+//the pumps of test7, test8: the frontier's timer only schedules them,
+//they're run by the test's thread as by a pool and chain the owed ones
+static CrawlFrontier* pumpFrontier = nullptr;
+static std::shared_ptr<HostScheduler> pumpScheduler;
+static std::atomic<unsigned> pumpsRun(0), pumpsTaken(0), pumpsScheduled(0);
+static std::atomic<bool> pumpOffPool(false);
+static std::thread::id poolThread;
+
+static void TestSchedule(const std::shared_ptr<const WorkerCtx>& ctx)
+{
+  (void)ctx;
+  ++pumpsScheduled;
+}
+
+static void TestPump()
+{
+  ++pumpsRun;
+  if (std::this_thread::get_id() != poolThread)
+    pumpOffPool.store(true);
+  FrontierItem item;
+  if (!pumpFrontier->popOrWait(item, &TestSchedule))
+    return;
+  ++pumpsTaken;
+  pumpScheduler->release(item.host, 200);
+  if (pumpFrontier->takeOwedPump())
+    TestSchedule(nullptr);
+}
+
+//run the scheduled pumps
+static void RunScheduled()
+{
+  for(unsigned cnt = pumpsScheduled.exchange(0); cnt > 0; --cnt)
+    TestPump();
+}
+
+static void ResetPumps(CrawlFrontier* f, std::shared_ptr<HostScheduler> s)
+{
+  pumpFrontier = f;
+  pumpScheduler = s;
+  pumpsRun.store(0);
+  pumpsTaken.store(0);
+  pumpsScheduled.store(0);
+  pumpOffPool.store(false);
+  poolThread = std::this_thread::get_id();
+}
+
+bool test7()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  std::vector<LinkedTask*> nodes = MakeNodes(root);
+
+  //20 requests per second: the items of the host get ready each 50 ms
+  std::unique_ptr<CrawlFrontier> f(new CrawlFrontier(FrontierPolicy::BFS));
+  ResetPumps(f.get(), std::make_shared<HostScheduler>(20.0, 1, 0));
+  f->setHostScheduler(pumpScheduler);
+  for(LinkedTask* node : nodes)
+    f->push(node, nullptr, nullptr);
+  //one pump per item, all of them at once: the first one takes an item, the rest return
+  for(size_t idx = 0; idx < nodes.size(); ++idx)
+    TestPump();
+  if (1 != pumpsTaken.load() || 0 != pumpsScheduled.load())
+    return false;
+
+  //the timer schedules a pump when the next item is ready, it doesn't run it
+  auto deadline = Clock_t::now() + std::chrono::seconds(3);
+  while(0 == pumpsScheduled.load() && Clock_t::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  if (1 != pumpsScheduled.load() || 1 != pumpsTaken.load())
+    return false;
+
+  while(pumpsTaken.load() < nodes.size() && Clock_t::now() < deadline)
+    {
+      RunScheduled();
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  bool ok = (nodes.size() == pumpsTaken.load()) && 0 == f->size() && !pumpOffPool.load()
+      //a pump per item and a few timer's pumps that came too early, no polling
+      && pumpsRun.load() < 4 * nodes.size();
+  f.reset();
+  pumpScheduler.reset();
+  return ok;
+}
+
+bool test8()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  std::vector<LinkedTask*> nodes = MakeNodes(root);
+  nodes.back()->grepVars.targetUrl = "http://other.com/";
+
+  std::unique_ptr<CrawlFrontier> f(new CrawlFrontier(FrontierPolicy::BFS));
+  ResetPumps(f.get(), std::make_shared<HostScheduler>(0.0, 1, 0));
+  //e.g. the robots.txt of the host is downloading: the other host goes on
+  f->holdHost("site.com");
+  for(LinkedTask* node : nodes)
+    f->push(node, nullptr, nullptr);
+  for(size_t idx = 0; idx < nodes.size(); ++idx)
+    TestPump();
+  if (1 != pumpsTaken.load() || nodes.size() - 1 != f->parkedCount())
+    return false;
+  //one pump is scheduled, not run by the caller, the owed ones are chained
+  unsigned runBefore = pumpsRun.load();
+  f->releaseHost("site.com");
+  if (runBefore != pumpsRun.load() || 1 != pumpsScheduled.load())
+    return false;
+  while(0 != pumpsScheduled.load())
+    RunScheduled();
+  bool ok = (nodes.size() == pumpsTaken.load()) && 0 == f->size()
+      && pumpsRun.load() < 2 * nodes.size();
+  f.reset();
+  pumpScheduler.reset();
+  return ok;
+}
+
+bool test9()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  std::vector<LinkedTask*> nodes = MakeNodes(root);
+  nodes[0]->grepVars.targetUrl = "http://busy.org/a.html";
+  nodes[1]->grepVars.targetUrl = "http://busy.org/b.html";
+
+  //one request in flight: the second page waits for the slot, not for a timer
+  std::unique_ptr<CrawlFrontier> f(new CrawlFrontier(FrontierPolicy::BFS));
+  ResetPumps(f.get(), std::make_shared<HostScheduler>(0.0, 1, 1));
+  f->setHostScheduler(pumpScheduler);
+  f->push(nodes[0], nullptr, nullptr);
+  f->push(nodes[1], nullptr, nullptr);
+  FrontierItem item;
+  if (!f->popOrWait(item, &TestSchedule) || f->popOrWait(item, &TestSchedule))
+    return false;
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  if (0 != pumpsScheduled.load() || 1 != f->parkedCount())
+    return false;
+  //the freed slot schedules the owed pump, it's not run by the caller
+  pumpScheduler->release(item.host, 200);
+  if (1 != pumpsScheduled.load() || 0 != pumpsRun.load())
+    return false;
+  RunScheduled();
+  bool ok = 1 == pumpsTaken.load() && 0 == f->size() && !pumpOffPool.load();
+  f.reset();
+  pumpScheduler.reset();
+  return ok;
+}
+
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test frontier order by BFS, DFS, BEST_FIRST: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test delayed host's items are parked: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test concurrent push and pop: ",
+                  []()->bool {return test3();}) );
+  testsList.push_back
+      ( NamedTask("test host scheduler's limits and backoff: ",
+                  []()->bool {return test4();}) );
+  testsList.push_back
+      ( NamedTask("test frontier with the host scheduler: ",
+                  []()->bool {return test5();}) );
+  testsList.push_back
+      ( NamedTask("test many items of a rate-limited host: ",
+                  []()->bool {return test6();}) );
+  testsList.push_back
+      ( NamedTask("test the frontier's timer schedules the parked items' pumps: ",
+                  []()->bool {return test7();}) );
+  testsList.push_back
+      ( NamedTask("test held host's items wait for releaseHost(): ",
+                  []()->bool {return test8();}) );
+  testsList.push_back
+      ( NamedTask("test in-flight limited host's items wait for the freed slot: ",
+                  []()->bool {return test9();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//CrawlFrontierTests
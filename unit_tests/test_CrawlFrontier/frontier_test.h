@@ -0,0 +1,25 @@
+#pragma once
+
+namespace CrawlFrontierTests {
+
+  /** Order of the items by BFS, DFS and BEST_FIRST policies, the policy changed with waiting items.*/
+  bool test1();
+
+  /** The items of a delayed host are parked until it's ready, the other hosts go first.*/
+  bool test2();
+
+  /** Push and pop from several threads: each item is taken once.*/
+  bool test3();
+
+  /** HostScheduler: the token bucket's rate, the in-flight limit, the backoff after 429/503.*/
+  bool test4();
+
+  /** The frontier with a HostScheduler: a busy host's items are parked, the other hosts go first.*/
+  bool test5();
+
+  /** Many items of a rate-limited host: the parked host costs pop() nothing, it's order is kept.*/
+  bool test6();
+
+  //accumulative test:
+  bool Test();
+}
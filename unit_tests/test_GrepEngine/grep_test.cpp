@@ -0,0 +1,194 @@
+#include "webgrep/grep_engine.h"
+#include <list>
+#include <string>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <functional>
+#include "grep_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = GrepEngineTests::Test();
+  return (int)!result;
+}
+
+namespace GrepEngineTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+bool test1()
+{
+  static const char* d_patterns[] = {
+    "abc", "a|ab", "ab|a", "a*", "a+b", "(ab)+c", "(?:a|b)*c", "[a-c]{2,3}",
+    "x[^y]*z|q", "\\d+", "\\w+\\s\\w+", "c.a", "(a|bc)*b?", "[^abc]", "a{2}",
+    "b(a|c){1,}", "[\\d.-]+", "a?b?c?", "(a*)*b", "[a\\]]|d"
+  };
+  std::mt19937 gen(77);
+  std::uniform_int_distribution<int> letter(0, 9);
+  static const char d_alphabet[] = "abcxyzq1 .";
+
+  bool ok = true;
+  for(const char* pattern : d_patterns)
+    {
+      std::shared_ptr<AutomatonGrep> automaton = AutomatonGrep::Compile(pattern);
+      if (nullptr == automaton)
+        {
+          std::cerr << __FUNCTION__ << " failed to compile: " << pattern << std::endl;
+          ok = false;
+          continue;
+        }
+      std::regex expr(pattern);
+      for(unsigned iter = 0; ok && iter < 300; ++iter)
+        {
+          std::string text;
+          for(size_t len = gen() % 40; len > 0; --len)
+            text += d_alphabet[letter(gen)];
+
+          std::vector<GrepMatch> groups;
+          bool found = automaton->search(text.data(), text.size(), groups);
+          std::smatch matched;
+          bool expected = std::regex_search(text, matched, expr);
+          ok = (found == expected);
+          if (ok && found)
+            {//same start, the end is the longest one
+              const GrepMatch& m(groups[0]);
+              ok = (1 == groups.size()) && (m.begin == (size_t)matched.position(0))
+                  && std::regex_match(text.begin() + m.begin, text.begin() + m.end, expr);
+              for(size_t end = m.end + 1; ok && end <= text.size(); ++end)
+                ok = !std::regex_match(text.begin() + m.begin, text.begin() + end, expr);
+            }
+          if (!ok)
+            std::cerr << __FUNCTION__ << " mismatch: /" << pattern << "/ on \"" << text << "\"\n";
+        }
+    }
+  return ok;
+}
+
+bool test2()
+{
+  static const char* d_fallback[] = { "^abc", "abc$", "\\bword", "(a)\\1", "a*?b", "(?=a)a" };
+  bool ok = true;
+  for(const char* pattern : d_fallback)
+    {
+      std::shared_ptr<const GrepEngine> engine = GrepEngine::Create(pattern);
+      ok = ok && (nullptr == AutomatonGrep::Compile(pattern))
+          && (std::string("std::regex") == engine->name());
+    }
+  ok = ok && (std::string("automaton") == GrepEngine::Create("a(b|c)+")->name());
+  ok = ok && (std::string("std::regex")
+              == GrepEngine::Create("a(b|c)+", GrepEngineKind::STD_REGEX)->name());
+
+  //std::regex reports the subgroups
+  std::vector<GrepMatch> groups;
+  std::string text("xx abc");
+  ok = ok && GrepEngine::Create("a(b)c", GrepEngineKind::STD_REGEX)
+      ->search(text.data(), text.size(), groups)
+      && 2 == groups.size() && 3 == groups[0].begin && 4 == groups[1].begin;
+
+  //invalid patterns are reported like before
+  bool thrown = false;
+  try {
+    GrepEngine::Create("(abc");
+  } catch(std::regex_error&)
+  {
+    thrown = true;
+  }
+  return ok && thrown;
+}
+
+bool test3()
+{
+  //the match is at the end of a 4MB page
+  std::string page(4 * 1024 * 1024, 'a');
+  for(size_t pos = 0; pos < page.size(); pos += 61)
+    page[pos] = 'b';
+  page += "needle 42</b>";
+
+  std::shared_ptr<const GrepEngine> engine = GrepEngine::Create("(a|b)*needle \\d+");
+  std::shared_ptr<const GrepEngine> literal = GrepEngine::Create("needle");
+  std::atomic_uint passed(0);
+  std::vector<std::thread> threads;
+  for(unsigned cnt = 0; cnt < 4; ++cnt)
+    {
+      threads.push_back(std::thread([&]()
+      {
+        std::vector<GrepMatch> groups;
+        bool ok = engine->search(page.data(), page.size(), groups)
+            && 0 == groups[0].begin && page.size() - 4 == groups[0].end;
+        ok = ok && literal->search(page.data(), page.size(), groups)
+            && page.size() - 13 == groups[0].begin;
+        passed += ok? 1 : 0;
+      }));
+    }
+  for(std::thread& th : threads)
+    th.join();
+  return 4 == passed.load();
+}
+
+bool test4()
+{
+  //480KB single line page, each tag is an occurrence of the literal "<script"
+  std::string page;
+  while(page.size() < 480 * 1024)
+    page += "<script x=1>";
+  std::shared_ptr<const GrepEngine> engine = GrepEngine::Create("<script.*foo");
+  std::shared_ptr<const GrepEngine> digit = GrepEngine::Create("<script x=\\d>7");
+  bool ok = (std::string("automaton") == engine->name());
+
+  auto started = std::chrono::steady_clock::now();
+  std::vector<GrepMatch> groups;
+  ok = ok && !engine->search(page.data(), page.size(), groups);
+  ok = ok && !digit->search(page.data(), page.size(), groups);
+  std::string tail = page + "foo <script x=2>7";
+  ok = ok && engine->search(tail.data(), tail.size(), groups)
+      && 0 == groups[0].begin && page.size() + 3 == groups[0].end;
+  ok = ok && digit->search(tail.data(), tail.size(), groups)
+      && page.size() + 4 == groups[0].begin && tail.size() == groups[0].end;
+  //a scan from each occurrence takes tens of seconds here
+  return ok && std::chrono::steady_clock::now() - started < std::chrono::seconds(2);
+}
+
+//=============================================================================
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test AutomatonGrep matches like std::regex: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test GrepEngine fallback and errors: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test AutomatonGrep on a big page in several threads: ",
+                  []()->bool {return test3();}) );
+  testsList.push_back
+      ( NamedTask("test AutomatonGrep on a line of many literal occurrences: ",
+                  []()->bool {return test4();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//GrepEngineTests
@@ -0,0 +1,22 @@
+#pragma once
+
+namespace GrepEngineTests {
+
+  /** Compare AutomatonGrep with std::regex on random texts: same match start,
+   *  the match is leftmost-longest.*/
+  bool test1();
+
+  /** Test the fallback to std::regex for unsupported syntax and the errors of invalid patterns.*/
+  bool test2();
+
+  /** Test a big page searched by several threads with one shared engine.*/
+  bool test3();
+
+  /** Test a long line with many occurrences of the pattern's leading literal:
+   *  the search time stays linear.*/
+  bool test4();
+
+  //accumulative test:
+  bool Test();
+}
+
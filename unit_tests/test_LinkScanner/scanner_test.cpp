@@ -0,0 +1,190 @@
+#include "webgrep/link_scanner.h"
+#include <list>
+#include <string>
+#include <random>
+#include <iostream>
+#include <functional>
+#include "scanner_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = LinkScannerTests::Test();
+  return (int)!result;
+}
+
+namespace LinkScannerTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+static const char* d_kernels[] = {"scalar", "sse2", "avx2"};
+
+//make a page of HTML-like pieces glued in random order
+static std::string RandomPage(std::mt19937& gen, size_t pieces)
+{
+  static const char* d_pieces[] = {
+    "<a href=\"/some/page.html\">", "href = \"x\"", "http://site.com/a/b.php?q=1 ",
+    "https://x.org/'", "<p>text text</p>", "hr", "ht", "h", "http", "href=",
+    "\"", "'", ">", "<", " ", "\n", "abcdefghijklmnopqrstuvwxyz", "http:", "https:/",
+    "<a href=\"http://site.com/c.htm\">link</a>"
+  };
+  const size_t count = sizeof(d_pieces)/sizeof(d_pieces[0]);
+  std::uniform_int_distribution<size_t> dist(0, count - 1);
+  std::string page;
+  for(size_t cnt = 0; cnt < pieces; ++cnt)
+    page += d_pieces[dist(gen)];
+  return page;
+}
+
+static bool SameSpans(const std::vector<LinkSpan>& a, const std::vector<LinkSpan>& b)
+{
+  if (a.size() != b.size())
+    return false;
+  for(size_t idx = 0; idx < a.size(); ++idx)
+    {
+      if (a[idx].begin != b[idx].begin || a[idx].end != b[idx].end
+          || a[idx].isHref != b[idx].isHref)
+        return false;
+    }
+  return true;
+}
+
+bool test1()
+{
+  std::mt19937 gen(1234);
+  bool ok = true;
+  for(unsigned iter = 0; ok && iter < 2000; ++iter)
+    {
+      std::string page = RandomPage(gen, 1 + iter % 200);
+      //cut the page at random length to test the tails of the blocks
+      page.resize(page.size() - (gen() % std::min<size_t>(page.size(), 40)));
+
+      std::vector<LinkSpan> expected;
+      SetLinkScannerKernel("scalar");
+      ScanLinks(page.data(), page.size(), expected);
+      for(const char* name : d_kernels)
+        {
+          if (!SetLinkScannerKernel(name))
+            continue;
+          std::vector<LinkSpan> spans;
+          ScanLinks(page.data(), page.size(), spans);
+          if (!SameSpans(expected, spans))
+            {
+              std::cerr << __FUNCTION__ << " kernel " << name << " mismatch at iteration "
+                        << iter << std::endl;
+              ok = false;
+            }
+          size_t len = page.size();
+          for(size_t pos = 0; ok && pos < len; pos += 7)
+            {
+              SetLinkScannerKernel("scalar");
+              size_t a = FindStopChar(page.data() + pos, page.data() + len);
+              SetLinkScannerKernel(name);
+              size_t b = FindStopChar(page.data() + pos, page.data() + len);
+              ok = (a == b);
+            }
+        }
+    }
+  SetLinkScannerKernel("avx2") || SetLinkScannerKernel("sse2");
+  return ok;
+}
+
+bool test2()
+{
+  //a link at 20KB offset was never found when the search was bound to the page's first 8KB
+  std::string page(20000, 'x');
+  page += "<a href=\"/far/away.html\">";
+  page += " http://site.com/tail";
+  page += "\">";
+  bool ok = true;
+  for(const char* name : d_kernels)
+    {
+      if (!SetLinkScannerKernel(name))
+        continue;
+      std::vector<LinkSpan> spans;
+      ScanLinks(page.data(), page.size(), spans);
+      ok = ok && (2 == spans.size())
+          && (page.substr(spans[0].begin, spans[0].end - spans[0].begin) == "/far/away.html")
+          && spans[0].isHref
+          && (page.substr(spans[1].begin, spans[1].end - spans[1].begin) == "http://site.com/tail")
+          && !spans[1].isHref;
+
+      //unclosed link at the end of the page is dropped
+      std::string tail = "abc href=\"/no/end";
+      spans.clear();
+      ScanLinks(tail.data(), tail.size(), spans);
+      ok = ok && spans.empty();
+    }
+  SetLinkScannerKernel("avx2") || SetLinkScannerKernel("sse2");
+  return ok;
+}
+
+bool test3()
+{
+  std::mt19937 gen(4321);
+  bool ok = true;
+  for(unsigned iter = 0; ok && iter < 1000; ++iter)
+    {
+      std::string page = RandomPage(gen, 1 + iter % 300);
+      std::vector<LinkSpan> expected;
+      ScanLinks(page.data(), page.size(), expected);
+
+      //the buffer grows like the download's buffer, chunks are 1..64 bytes
+      std::string buffer;
+      LinkTokenizer tokenizer;
+      std::vector<LinkSpan> spans;
+      for(size_t pos = 0; pos < page.size(); )
+        {
+          size_t chunk = std::min<size_t>(1 + gen() % 64, page.size() - pos);
+          buffer.append(page, pos, chunk);
+          pos += chunk;
+          tokenizer.feed(buffer.data(), buffer.size(), false, spans);
+        }
+      tokenizer.feed(buffer.data(), buffer.size(), true, spans);
+      if (!SameSpans(expected, spans))
+        {
+          std::cerr << __FUNCTION__ << " mismatch at iteration " << iter << std::endl;
+          ok = false;
+        }
+    }
+  return ok;
+}
+
+//=============================================================================
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test ScanLinks kernels give the same links: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test ScanLinks for links beyond 8KB and at the page's end: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test LinkTokenizer for the page split into chunks: ",
+                  []()->bool {return test3();}) );
+
+  bool ok = true;
+  std::cerr << "link scanner kernel: " << LinkScannerKernel() << std::endl;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//LinkScannerTests
@@ -0,0 +1,17 @@
+#pragma once
+
+namespace LinkScannerTests {
+
+  /** Compare the links found by every supported kernel (scalar, sse2, avx2) on random pages.*/
+  bool test1();
+
+  /** Test the links placed far from the page's beginning and at the page's end.*/
+  bool test2();
+
+  /** Test LinkTokenizer: the page fed by random chunks gives the same links as the whole page.*/
+  bool test3();
+
+  //accumulative test:
+  bool Test();
+}
+
@@ -0,0 +1,410 @@
+#include "webgrep/linked_task.h"
+#include "webgrep/node_arena.h"
+#include "webgrep/epoch_reclaimer.h"
+#include "webgrep/link_budget.h"
+#include <atomic>
+#include <list>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <functional>
+#include "tree_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = LinkedTaskTests::Test();
+  return (int)!result;
+}
+
+namespace LinkedTaskTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+bool test1()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  root->maxPossbleNodesQuantity.store(100000);
+  NodeArena* arena = root->arena.get();
+  if (nullptr == arena)
+    return false;
+
+  const size_t count = 5000;
+  LinkedTask* expelled = nullptr;
+  LinkedTask* child = root->spawnChildNode(expelled);
+  if (nullptr == child || nullptr != expelled)
+    return false;
+  if (count - 1 != child->spawnNextNodes(count - 1))
+    return false;
+  if (count != root->nodeAllocationsCount.load() || count != arena->aliveCount())
+    return false;
+  //the child nodes have no hooks of their own
+  if (child->makeNewNode || child->deleteNode || child->arena)
+    return false;
+
+  size_t slabs = arena->slabsCount();
+  //replace the subtree, delete the old one:
+  child = root->spawnChildNode(expelled);
+  DeleteList(expelled);
+  if (1 != root->nodeAllocationsCount.load() || 1 != arena->aliveCount())
+    return false;
+
+  //the freed slots are taken again, no new slabs
+  child->spawnNextNodes(count - 2);
+  return count - 1 == arena->aliveCount() && slabs == arena->slabsCount();
+}
+
+bool test2()
+{
+  //each node keeps a copy of the root's visitedSet pointer,
+  //it's use_count() tells how many nodes are alive
+  std::shared_ptr<VisitedSet> marker = std::make_shared<VisitedSet>();
+  RootNodePtr root = LinkedTask::createRootNode();
+  root->maxPossbleNodesQuantity.store(100000);
+  root->visitedSet = marker;
+
+  const size_t threads = 4, perThread = 3000;
+  root->spawnNextNodes(threads - 1);
+  std::vector<LinkedTask*> heads;
+  for(LinkedTask* item = root.get(); nullptr != item; item = ItemLoadAcquire(item->next))
+    heads.push_back(item);
+  if (threads != heads.size())
+    return false;
+
+  std::vector<std::thread> pool;
+  for(LinkedTask* head : heads)
+    {
+      pool.emplace_back([head, perThread]()
+      {
+        LinkedTask* expelled = nullptr;
+        LinkedTask* child = head->spawnChildNode(expelled);
+        if (nullptr != child)
+          child->spawnNextNodes(perThread - 1);
+      });
+    }
+  for(std::thread& t : pool)
+    t.join();
+
+  size_t expected = 1 + (threads - 1) + threads * perThread;
+  if (expected != (size_t)marker.use_count() - 1)
+    return false;
+  root.reset();
+  return 1 == marker.use_count();
+}
+
+bool test3()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  root->maxPossbleNodesQuantity.store(100000);
+  LinkedTask* expelled = nullptr;
+  LinkedTask* child = root->spawnChildNode(expelled);
+
+  const size_t threads = 4, perThread = 4000;
+  std::vector<std::thread> pool;
+  for(size_t t = 0; t < threads; ++t)
+    {
+      pool.emplace_back([child, perThread]()
+      {
+        for(size_t cnt = 0; cnt < perThread; ++cnt)
+          child->spawnNextNodes(1);
+      });
+    }
+  for(std::thread& t : pool)
+    t.join();
+
+  std::vector<unsigned> orders;
+  for(LinkedTask* item = ItemLoadAcquire(child->next); nullptr != item; item = ItemLoadAcquire(item->next))
+    orders.push_back(item->order);
+  if (threads * perThread != orders.size() || child->getLastOnLevel() == child)
+    return false;
+  std::sort(orders.begin(), orders.end());
+  for(size_t idx = 0; idx < orders.size(); ++idx)
+    {
+      if (idx != orders[idx])
+        return false;
+    }
+  return nullptr == ItemLoadAcquire(child->getLastOnLevel()->next);
+}
+
+bool test4()
+{
+  //  A -> B -> C
+  //  |    |
+  //  D    F -> G
+  //  |
+  //  E
+  RootNodePtr root = LinkedTask::createRootNode();
+  LinkedTask* A = root.get();
+  LinkedTask* expelled = nullptr;
+  A->spawnNextNodes(2);
+  LinkedTask* B = ItemLoadAcquire(A->next);
+  LinkedTask* D = A->spawnChildNode(expelled);
+  LinkedTask* E = D->spawnChildNode(expelled);
+  LinkedTask* F = B->spawnChildNode(expelled);
+  F->spawnNextNodes(1);
+  LinkedTask* C = ItemLoadAcquire(B->next);
+  LinkedTask* G = ItemLoadAcquire(F->next);
+
+  std::vector<LinkedTask*> pre, post, lvl;
+  for(LinkedTask* item : PreOrder(A))
+    pre.push_back(item);
+  for(LinkedTask* item : PostOrder(A))
+    post.push_back(item);
+  for(LinkedTask* item : LevelOrder(A))
+    lvl.push_back(item);
+
+  std::vector<LinkedTask*> expPre = {A, D, E, B, F, G, C};
+  std::vector<LinkedTask*> expPost = {C, G, F, B, E, D, A};
+  std::vector<LinkedTask*> expLvl = {A, B, C, D, F, G, E};
+
+  size_t cnt = 0;
+  TraverseTree(D, [&cnt](LinkedTask*) { ++cnt; });
+  return pre == expPre && post == expPost && lvl == expLvl && 2 == cnt
+      && PreOrder(nullptr).begin() == PreOrder(nullptr).end();
+}
+
+bool test5()
+{
+  const size_t count = 300000;
+  RootNodePtr root = LinkedTask::createRootNode();
+  root->maxPossbleNodesQuantity.store(4 * count);
+
+  //one long level:
+  LinkedTask* expelled = nullptr;
+  LinkedTask* child = root->spawnChildNode(expelled);
+  if (count - 1 != child->spawnNextNodes(count - 1))
+    return false;
+  //one deep branch:
+  LinkedTask* deep = ItemLoadAcquire(child->next);
+  for(size_t cnt = 0; nullptr != deep && cnt < count; ++cnt)
+    deep = deep->spawnChildNode(expelled);
+  //the root itself is not made by the arena
+  if (nullptr == deep || 2 * count != root->arena->aliveCount())
+    return false;
+
+  size_t visited = 0;
+  for(LinkedTask* item : LevelOrder(root.get()))
+    visited += (nullptr != item);
+  if (2 * count + 1 != visited)
+    return false;
+
+  //delete the subtree by the hooks, in a thread with a small default stack:
+  child = root->spawnChildNode(expelled);
+  std::thread t([expelled]() { DeleteList(expelled); });
+  t.join();
+  return 1 == root->arena->aliveCount() && 1 == root->nodeAllocationsCount.load();
+}
+
+bool test6()
+{
+  EpochReclaimer r;
+  int released = 0;
+  std::unique_ptr<EpochGuard> reader(new EpochGuard(r));
+  r.retire(nullptr, [&released]() { ++released; });
+  for(int cnt = 0; cnt < 4; ++cnt)
+    r.collect();
+  if (0 != released || 1 != r.pending())
+    return false;
+
+  //a reader that came later doesn't hold the item:
+  EpochGuard late(r);
+  reader.reset();
+  for(int cnt = 0; cnt < 4 && 0 == released; ++cnt)
+    r.collect();
+  if (1 != released || 0 != r.pending())
+    return false;
+
+  //drain() releases by the tag regardless of the readers:
+  int tag = 0;
+  r.retire(&tag, [&released]() { ++released; });
+  r.retire(nullptr, [&released]() { ++released; });
+  if (1 != r.drain(&tag) || 2 != released || 1 != r.pending())
+    return false;
+
+  //drain() waits for the deleters of the tag that collect() runs in another thread:
+  EpochReclaimer r2;
+  std::atomic<int> stage(0);
+  std::thread t([&r2, &tag, &stage]()
+  {
+    r2.retire(&tag, [&stage]()
+    {
+      stage.store(1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      stage.store(2);
+    });
+  });
+  while(0 == stage.load())
+    std::this_thread::yield();
+  r2.drain(&tag);
+  bool waited = (2 == stage.load());
+  t.join();
+  return waited;
+}
+
+bool test7()
+{
+  RootNodePtr root = LinkedTask::createRootNode();
+  root->maxPossbleNodesQuantity.store(1000000);
+  LinkedTask* expelled = nullptr;
+  LinkedTask* child = root->spawnChildNode(expelled);
+  child->spawnNextNodes(63);
+
+  std::atomic_bool stop(false);
+  std::atomic<size_t> visits(0);
+  std::vector<std::thread> readers;
+  for(unsigned t = 0; t < 3; ++t)
+    {
+      readers.emplace_back([&root, &stop, &visits]()
+      {
+        while(!stop.load())
+          {
+            EpochGuard guard;
+            size_t cnt = 0;
+            for(LinkedTask* item : PreOrder(ItemLoadAcquire(root->child)))
+              cnt += item->level;
+            visits.fetch_add(1 + cnt);
+          }
+      });
+    }
+
+  for(unsigned iter = 0; iter < 2000; ++iter)
+    {
+      LinkedTask* old = nullptr;
+      LinkedTask* fresh = root->spawnChildNode(old);
+      if (nullptr == fresh)
+        break;
+      fresh->spawnNextNodes(63);
+      RetireList(old);
+    }
+  stop.store(true);
+  for(std::thread& t : readers)
+    t.join();
+
+  EpochReclaimer::Global().collect();
+  EpochReclaimer::Global().collect();
+  //only the current level and nothing retired is left
+  size_t alive = root->arena->aliveCount();
+  root.reset();
+  return 64 == alive && 0 == EpochReclaimer::Global().pending() && visits.load() > 0;
+}
+
+bool test8()
+{
+  auto used = std::make_shared<std::atomic_uint>(0);
+  auto limit = std::make_shared<std::atomic_uint>(10007);
+  auto budget = std::make_shared<LinkBudget>(used, limit);
+
+  std::atomic_uint granted(0);
+  std::vector<std::thread> pool;
+  for(unsigned t = 0; t < 8; ++t)
+    {
+      pool.emplace_back([budget, &granted, t]()
+      {
+        for(unsigned cnt = 0; cnt < 4000; ++cnt)
+          {
+            unsigned want = 1 + (cnt + t) % 7;
+            unsigned got = budget->acquire(want);
+            //a failed node allocation gives the token back:
+            if (got > 0 && 0 == cnt % 5)
+              {
+                budget->giveBack(1);
+                --got;
+              }
+            granted.fetch_add(got);
+          }
+        LinkBudget::ReleaseThreadLease();
+      });
+    }
+  for(std::thread& t : pool)
+    t.join();
+  if (limit->load() != granted.load() || limit->load() != used->load() || !budget->exhausted())
+    return false;
+
+  //the limit is raised: the next tokens are granted, the lease is returned
+  limit->store(10017);
+  if (3 != budget->acquire(3))
+    return false;
+  LinkBudget::ReleaseThreadLease();
+  if (budget->exhausted() || 7 != budget->acquire(100) || 0 != budget->acquire(1))
+    return false;
+
+  //the tokens of the lease are published when it's released
+  auto used3 = std::make_shared<std::atomic_uint>(0);
+  auto budget3 = std::make_shared<LinkBudget>(used3, std::make_shared<std::atomic_uint>(1000));
+  if (1 != budget3->acquire(1) || 1 != used3->load() || 1 != budget3->acquire(1) || 1 != used3->load())
+    return false;
+  budget3->giveBack(1);
+  LinkBudget::ReleaseThreadLease();
+  if (1 != used3->load())
+    return false;
+
+  //the level of subtasks is cut by the budget:
+  RootNodePtr root = LinkedTask::createRootNode();
+  auto used2 = std::make_shared<std::atomic_uint>(0);
+  auto limit2 = std::make_shared<std::atomic_uint>(5);
+  root->linksCounterPtr = used2;
+  root->maxLinksCountPtr = limit2;
+  root->linksBudget = std::make_shared<LinkBudget>(used2, limit2);
+  std::string page = "0123456789";
+  for(size_t idx = 0; idx < page.size(); ++idx)
+    root->grepVars.matchURLVector.push_back(GrepVars::CIteratorPair(page.begin() + idx, page.begin() + idx + 1));
+  root->grepVars.pageIsParsed = true;
+  LinkedTask* expelled = nullptr;
+  LinkedTask* child = root->spawnChildNode(expelled);
+  size_t cnt = child->spawnGreppedSubtasks("localhost", root->grepVars);
+  return 5 == cnt && 5 == used2->load() && 0 == child->spawnGreppedSubtasks("localhost", root->grepVars);
+}
+
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test NodeArena accounting and reuse of freed nodes: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test concurrent spawn and bulk release of the tree: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test concurrent append to one level: ",
+                  []()->bool {return test3();}) );
+  testsList.push_back
+      ( NamedTask("test pre-order, post-order, level-order iterators: ",
+                  []()->bool {return test4();}) );
+  testsList.push_back
+      ( NamedTask("test DeleteList on a long level and a deep branch: ",
+                  []()->bool {return test5();}) );
+  testsList.push_back
+      ( NamedTask("test EpochReclaimer keeps retired items for the readers: ",
+                  []()->bool {return test6();}) );
+  testsList.push_back
+      ( NamedTask("test RetireList while the tree is being read: ",
+                  []()->bool {return test7();}) );
+  testsList.push_back
+      ( NamedTask("test LinkBudget grants exactly the limit: ",
+                  []()->bool {return test8();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//LinkedTaskTests
@@ -0,0 +1,34 @@
+#pragma once
+
+namespace LinkedTaskTests {
+
+  /** Test the root's NodeArena: node accounting, the memory of deleted subtrees is reused.*/
+  bool test1();
+
+  /** Spawn the subtrees from several threads, then release the whole tree by the root's deleter:
+   *  each node's destructor must run.*/
+  bool test2();
+
+  /** Append to one level from several threads by one node at a time:
+   *  no node is lost, the orders are unique.*/
+  bool test3();
+
+  /** Compare the orders of PreOrder(), PostOrder(), LevelOrder() on a small tree.*/
+  bool test4();
+
+  /** DeleteList() on a level of 300000 items and on a branch 300000 levels deep (no stack overflow).*/
+  bool test5();
+
+  /** EpochReclaimer: a retired item is released only after the readers pinned before are gone.*/
+  bool test6();
+
+  /** Replace a level with RetireList() while the reader threads traverse it under EpochGuard.*/
+  bool test7();
+
+  /** LinkBudget: the threads acquire the tokens concurrently, exactly (limit) tokens are granted,
+   *  the leased tokens are given back.*/
+  bool test8();
+
+  //accumulative test:
+  bool Test();
+}
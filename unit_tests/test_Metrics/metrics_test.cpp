@@ -0,0 +1,199 @@
+#include "webgrep/metrics.h"
+#include <list>
+#include <string>
+#include <vector>
+#include <thread>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <functional>
+#include <iterator>
+#include <cstdio>
+#include <unistd.h>
+#include "metrics_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = MetricsTests::Test();
+  return (int)!result;
+}
+
+namespace MetricsTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+//TRUE if (value) is within the limits of it's bucket
+static bool InBucket(uint64_t value)
+{
+  unsigned idx = LatencyHistogram::BucketIndex(value);
+  if (0 == idx)
+    return value <= LatencyHistogram::BucketLimit(0);
+  return value > LatencyHistogram::BucketLimit(idx - 1) && value <= LatencyHistogram::BucketLimit(idx);
+}
+
+bool test1()
+{
+  bool ok = true;
+  //the buckets follow each other without gaps
+  for(unsigned idx = 1; idx < LatencyHistogram::bucketsCount; ++idx)
+    ok = ok && LatencyHistogram::BucketLimit(idx) > LatencyHistogram::BucketLimit(idx - 1);
+  for(uint64_t value = 0; value < 70000; ++value)
+    ok = ok && InBucket(value);
+  for(uint64_t value = 70000; value < ((uint64_t)1 << 35); value = value * 3 / 2 + 7)
+    {
+      unsigned idx = LatencyHistogram::BucketIndex(value);
+      uint64_t width = LatencyHistogram::BucketLimit(idx) - LatencyHistogram::BucketLimit(idx - 1);
+      ok = ok && InBucket(value) && width * 8 <= value;
+    }
+  //the huge values go to the last bucket
+  ok = ok && LatencyHistogram::bucketsCount - 1 == LatencyHistogram::BucketIndex((uint64_t)1 << 40);
+
+  LatencyHistogram h;
+  ok = ok && 0 == h.snapshot().quantileUs(0.5);
+  for(uint64_t value = 1; value <= 1000; ++value)
+    h.record(value);
+  HistogramSnapshot snap = h.snapshot();
+  uint64_t p50 = snap.quantileUs(0.5), p99 = snap.quantileUs(0.99);
+  ok = ok && 1000 == snap.count && 500500 == snap.sumUs;
+  ok = ok && p50 >= 500 && p50 <= 500 * 9 / 8 && p99 >= 990 && p99 <= 990 * 9 / 8;
+  ok = ok && 1 == snap.quantileUs(0.0) && 8 == snap.countAtMost(8) && 512 == snap.countAtMost(512);
+  return ok;
+}
+//--------------------------------------------------------------
+bool test2()
+{
+  static const unsigned _N_threads = 8;
+  static const unsigned _N_items = 20000;
+  MetricCounter counter;
+  LatencyHistogram h;
+  std::vector<std::thread> threads(_N_threads);
+  for(std::thread& thr : threads)
+    {
+      thr = std::thread([&counter, &h]()
+      {
+        for(unsigned z = 0; z < _N_items; ++z)
+          {
+            counter.add(2);
+            h.record(z % 100);
+          }
+      });
+    }
+  for(std::thread& thr : threads)
+    thr.join();
+  HistogramSnapshot snap = h.snapshot();
+  uint64_t sum = (uint64_t)_N_threads * (_N_items / 100) * (99 * 100 / 2);
+  return 2ull * _N_threads * _N_items == counter.value()
+      && (uint64_t)_N_threads * _N_items == snap.count && sum == snap.sumUs;
+}
+//--------------------------------------------------------------
+//the value of the Prometheus text's line that starts with (key), -1 if there is no such line
+static double PromValue(const std::string& text, const std::string& key)
+{
+  std::istringstream is(text);
+  std::string line;
+  while(std::getline(is, line))
+    {
+      if (0 == line.compare(0, key.size() + 1, key + " "))
+        return std::stod(line.substr(key.size() + 1));
+    }
+  return -1;
+}
+
+bool test3()
+{
+  std::shared_ptr<MetricsRegistry> registry = std::make_shared<MetricsRegistry>();
+  std::shared_ptr<MetricCounter> pages = registry->counter("test_pages_total", "Pages.");
+  std::shared_ptr<LatencyHistogram> fetch = registry->histogram("test_fetch_seconds", "Fetch.");
+  bool ok = (pages == registry->counter("test_pages_total", "Again."));
+  pages->add(3);
+  fetch->record(100);
+  fetch->record(3000);
+  fetch->record(500000000);
+
+  std::ostringstream os;
+  registry->writePrometheus(os);
+  std::string text = os.str();
+  ok = ok && std::string::npos != text.find("# HELP test_pages_total Pages.\n# TYPE test_pages_total counter\n");
+  ok = ok && std::string::npos != text.find("# TYPE test_fetch_seconds histogram\n");
+  ok = ok && 3 == PromValue(text, "test_pages_total");
+  ok = ok && 0 == PromValue(text, "test_fetch_seconds_bucket{le=\"0.000064\"}");
+  ok = ok && 1 == PromValue(text, "test_fetch_seconds_bucket{le=\"0.000128\"}");
+  ok = ok && 2 == PromValue(text, "test_fetch_seconds_bucket{le=\"0.004096\"}");
+  ok = ok && 2 == PromValue(text, "test_fetch_seconds_bucket{le=\"134.217728\"}");
+  ok = ok && 3 == PromValue(text, "test_fetch_seconds_bucket{le=\"+Inf\"}");
+  ok = ok && 3 == PromValue(text, "test_fetch_seconds_count");
+  ok = ok && 500.0031 == PromValue(text, "test_fetch_seconds_sum");
+
+  //"le" includes the bound itself
+  std::shared_ptr<LatencyHistogram> edge = registry->histogram("test_edge_seconds", "Edge.");
+  edge->record(8);
+  edge->record(4096);
+  edge->record(4097);
+  std::ostringstream edgeOs;
+  registry->writePrometheus(edgeOs);
+  text = edgeOs.str();
+  ok = ok && 1 == PromValue(text, "test_edge_seconds_bucket{le=\"0.000008\"}");
+  ok = ok && 1 == PromValue(text, "test_edge_seconds_bucket{le=\"0.002048\"}");
+  ok = ok && 2 == PromValue(text, "test_edge_seconds_bucket{le=\"0.004096\"}");
+  ok = ok && 3 == PromValue(text, "test_edge_seconds_bucket{le=\"0.008192\"}");
+
+  MetricsSnapshot snap = registry->snapshot();
+  ok = ok && 3 == snap.counter("test_pages_total") && 0 == snap.counter("none")
+      && 3 == snap.histogram("test_fetch_seconds").count;
+
+  //the writer's file is replaced at once, it has the last values after the stop
+  char name[] = "/tmp/webgrep_metrics_XXXXXX";
+  int fd = ::mkstemp(name);
+  if (fd < 0)
+    return false;
+  ::close(fd);
+  {
+    MetricsFileWriter writer(registry, name, 3600 * 1000);
+    pages->add(1);
+  }
+  std::ifstream in(name);
+  std::string written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  ok = ok && 4 == PromValue(written, "test_pages_total");
+  std::ifstream tmp(std::string(name) + ".tmp");
+  ok = ok && !tmp;
+  std::remove(name);
+  return ok;
+}
+//--------------------------------------------------------------
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test latency histogram's buckets and quantiles: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test sharded metrics of many threads: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test Prometheus text and the file writer: ",
+                  []()->bool {return test3();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//MetricsTests
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace MetricsTests {
+
+  /** Buckets of LatencyHistogram: the values fall into the bucket whose limits hold them,
+   *  the bucket is 12.5% of the value at most, the quantiles of a known set of values.*/
+  bool test1();
+
+  /** The sharded counters and histograms updated by many threads sum up exactly.*/
+  bool test2();
+
+  /** Prometheus text of the registry: the counters, the cumulative buckets of the histograms
+   *  in seconds; the file written by MetricsFileWriter on stop.*/
+  bool test3();
+
+  //accumulative test:
+  bool Test();
+}
@@ -0,0 +1,179 @@
+#include "webgrep/page_cache.h"
+#include <list>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <functional>
+#include <unistd.h>
+#include "cache_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = PageCacheTests::Test();
+  return (int)!result;
+}
+
+namespace PageCacheTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+//a fresh directory in /tmp
+static std::string TempDir()
+{
+  char name[] = "/tmp/webgrep_cache_XXXXXX";
+  const char* dir = ::mkdtemp(name);
+  return (nullptr == dir)? std::string() : std::string(dir);
+}
+
+static void AddLine(HttpValidators& v, const char* line)
+{
+  v.parseHeaderLine(line, ::strlen(line));
+}
+
+bool test1()
+{
+  HttpValidators v;
+  AddLine(v, "HTTP/1.1 301 Moved Permanently\r\n");
+  AddLine(v, "ETag: \"old\"\r\n");
+  AddLine(v, "HTTP/1.1 200 OK\r\n");
+  AddLine(v, "Content-Type: text/html\r\n");
+  AddLine(v, "etag:   W/\"5f-1a2b\"  \r\n");
+  AddLine(v, "Last-Modified: Wed, 21 Oct 2015 07:28:00 GMT\r\n");
+  AddLine(v, "ETagX: no\r\n");
+  AddLine(v, "\r\n");
+  if ("W/\"5f-1a2b\"" != v.etag || "Wed, 21 Oct 2015 07:28:00 GMT" != v.lastModified)
+    return false;
+  std::vector<std::string> headers = v.conditionalHeaders();
+  if (2 != headers.size() || "If-None-Match: W/\"5f-1a2b\"" != headers[0]
+      || "If-Modified-Since: Wed, 21 Oct 2015 07:28:00 GMT" != headers[1])
+    return false;
+  AddLine(v, "HTTP/1.1 304 Not Modified\r\n");
+  return v.empty() && v.conditionalHeaders().empty();
+}
+
+bool test2()
+{
+  std::string dir = TempDir();
+  PageCache cache(dir + "/pages");
+  if (dir.empty() || !cache.valid())
+    return false;
+  HttpValidators v;
+  v.etag = "\"abc\"";
+  std::string body("<html>\n\0binary\r\n\n</html>", 25);
+
+  PageCache::Entry entry;
+  if (cache.lookup("http://site.com/a/", entry) || !cache.store("HTTP://Site.com:80/a/#top", v, body))
+    return false;
+  if (!cache.lookup("http://site.com/a", entry) || body != entry.body
+      || "\"abc\"" != entry.validators.etag || !entry.validators.lastModified.empty()
+      || "http://site.com/a" != entry.url)
+    return false;
+  if (!cache.lookup("http://site.com/a", entry, false) || !entry.body.empty() || "\"abc\"" != entry.validators.etag)
+    return false;
+  if (cache.lookup("http://site.com/b", entry))
+    return false;
+
+  //replaced by the newer page, no validators -- not stored
+  v.lastModified = "Wed, 21 Oct 2015 07:28:00 GMT";
+  if (!cache.store("http://site.com/a", v, "new") || !cache.lookup("http://site.com/a", entry)
+      || "new" != entry.body || v.lastModified != entry.validators.lastModified)
+    return false;
+  if (cache.store("http://site.com/c", HttpValidators(), "page") || cache.lookup("http://site.com/c", entry))
+    return false;
+
+  //the directory is kept, the files are found by another instance
+  PageCache other(dir + "/pages/");
+  if (!other.valid() || !other.lookup("http://site.com/a", entry) || "new" != entry.body)
+    return false;
+  if (!other.remove("http://site.com/a") || cache.lookup("http://site.com/a", entry))
+    return false;
+  ::rmdir((dir + "/pages").c_str());
+  ::rmdir(dir.c_str());
+  return !PageCache("").valid();
+}
+
+bool test3()
+{
+  std::string dir = TempDir();
+  PageCache cache(dir);
+  if (!cache.valid())
+    return false;
+  std::atomic_bool stop(false);
+  std::atomic_uint bad(0), found(0);
+  std::vector<std::thread> pool;
+  for(unsigned t = 0; t < 4; ++t)
+    {
+      pool.emplace_back([&, t]()
+      {
+        HttpValidators v;
+        for(unsigned idx = 0; idx < 200; ++idx)
+          {//the body is (size) repeated letters, the ETag tells the size
+            size_t size = 1000 + (idx * 37 + t * 1009) % 50000;
+            v.etag = std::to_string(size);
+            cache.store("http://site.com/page", v, std::string(size, (char)('a' + t)));
+          }
+      });
+      pool.emplace_back([&]()
+      {
+        PageCache::Entry entry;
+        while(!stop.load())
+          {
+            if (!cache.lookup("http://site.com/page", entry))
+              continue;
+            found.fetch_add(1);
+            if (std::to_string(entry.body.size()) != entry.validators.etag
+                || std::string::npos != entry.body.find_first_not_of(entry.body[0]))
+              bad.fetch_add(1);
+          }
+      });
+    }
+  for(size_t idx = 0; idx < pool.size(); idx += 2)
+    pool[idx].join();
+  stop.store(true);
+  for(size_t idx = 1; idx < pool.size(); idx += 2)
+    pool[idx].join();
+  cache.remove("http://site.com/page");
+  ::rmdir(dir.c_str());
+  return 0 == bad.load() && found.load() > 0;
+}
+
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test response validators: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test cached pages store and lookup: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test concurrent store and lookup: ",
+                  []()->bool {return test3();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//PageCacheTests
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace PageCacheTests {
+
+  /** HttpValidators: ETag and Last-Modified from the header lines, the status line clears them,
+   *  the headers of the conditional GET.*/
+  bool test1();
+
+  /** Store and lookup: the body with any bytes, the normalized URL's entry,
+   *  the pages without validators are not stored, remove().*/
+  bool test2();
+
+  /** Concurrent store() and lookup() of one page: the readers get a whole entry or nothing.*/
+  bool test3();
+
+  //accumulative test:
+  bool Test();
+}
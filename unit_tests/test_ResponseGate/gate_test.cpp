@@ -0,0 +1,151 @@
+#include "webgrep/response_gate.h"
+#include <list>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include <functional>
+#include "gate_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = ResponseGateTests::Test();
+  return (int)!result;
+}
+
+namespace ResponseGateTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+static bool Line(ResponseGate& gate, const char* line)
+{
+  return gate.onHeaderLine(line, ::strlen(line));
+}
+
+bool test1()
+{
+  ResponseGate gate(1000);
+  //the redirect's own type and size don't matter
+  if (!Line(gate, "HTTP/1.1 302 Found\r\n") || !Line(gate, "Content-Type: application/pdf\r\n")
+      || !Line(gate, "Content-Length: 5000\r\n") || !gate.onBody(5000))
+    return false;
+  if (!Line(gate, "HTTP/1.1 200 OK\r\n") || !Line(gate, "content-type: Text/HTML; charset=utf-8\r\n")
+      || !Line(gate, "Content-Length: 1000\r\n") || !Line(gate, "\r\n") || gate.rejected())
+    return false;
+
+  if (!Line(gate, "HTTP/2 200\r\n") || Line(gate, "Content-Length: 1001\r\n")
+      || nullptr == gate.reason() || 0 != ::strcmp("too big page", gate.reason()))
+    return false;
+  if (!Line(gate, "HTTP/1.1 200 OK\r\n") || Line(gate, "Content-Type: video/mp4\r\n")
+      || 0 != ::strcmp("not a text page", gate.reason()))
+    return false;
+  if (!Line(gate, "HTTP/1.1 304 Not Modified\r\n") || !Line(gate, "Content-Type: image/png\r\n"))
+    return false;
+
+  ResponseGate unlimited(0);
+  unlimited.onStatus(200);
+  unlimited.onContentLength(1ull << 40);
+  if (unlimited.rejected())
+    return false;
+  const char* types[] = { "text/html", " application/xhtml+xml", "text/plain;charset=koi8-r", "" };
+  for(const char* type : types)
+    {
+      if (!ResponseGate::IsPageType(type, ::strlen(type)))
+        return false;
+    }
+  const char* others[] = { "text/htmlx", "image/jpeg", "application/octet-stream", "text/css" };
+  for(const char* type : others)
+    {
+      if (ResponseGate::IsPageType(type, ::strlen(type)))
+        return false;
+    }
+  return true;
+}
+
+bool test2()
+{
+  ResponseGate gate(100);
+  gate.onStatus(301);
+  if (!gate.onBody(500))
+    return false;
+  gate.onStatus(200);
+  if (0 != gate.received() || !gate.onBody(60) || !gate.onBody(40) || gate.onBody(1))
+    return false;
+  if (101 != gate.received() || !gate.rejected())
+    return false;
+  gate.onStatus(200);
+  return !gate.rejected() && gate.onBody(100);
+}
+
+static bool Check(const char* url)
+{
+  return CheckExtension(url, (unsigned)::strlen(url));
+}
+
+bool test3()
+{
+  const char* pages[] = {
+    "http://site.com", "http://site.com/", "https://www.site.co.uk/dir/",
+    "http://site.com/a/page.html", "http://site.com/a.b/index.PHP?x=1.jpg",
+    "http://site.com/dir.v2/readme", "http://site.com/archive.tar.html#top",
+    "/relative/page.htm", "page.aspx", "http://site.com/file.unknown"
+  };
+  for(const char* url : pages)
+    {
+      if (!Check(url))
+        {
+          std::cerr << "rejected: " << url << "\n";
+          return false;
+        }
+    }
+  const char* media[] = {
+    "http://site.com/video.mp4", "http://site.com/a/b/photo.JPEG", "http://site.com/doc.pdf?download=1",
+    "/style.css", "http://site.com/app.min.js", "http://site.com/page.html.gz", "logo.png#x"
+  };
+  for(const char* url : media)
+    {
+      if (Check(url))
+        {
+          std::cerr << "accepted: " << url << "\n";
+          return false;
+        }
+    }
+  return true;
+}
+
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test response gate by the headers: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test response gate by the body's size: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test URL extension filter: ",
+                  []()->bool {return test3();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//ResponseGateTests
@@ -0,0 +1,17 @@
+#pragma once
+
+namespace ResponseGateTests {
+
+  /** The headers of the response: Content-Type and Content-Length of 2xx are checked,
+   *  the redirects and 304 are not.*/
+  bool test1();
+
+  /** The body's limit for the responses without Content-Length, a new response resets the count.*/
+  bool test2();
+
+  /** CheckExtension(): the last extension of the path, the host's dots, the query.*/
+  bool test3();
+
+  //accumulative test:
+  bool Test();
+}
@@ -0,0 +1,198 @@
+#include "webgrep/results_sink.h"
+#include <list>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <iostream>
+#include <functional>
+#include "sink_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = ResultsSinkTests::Test();
+  return (int)!result;
+}
+
+namespace ResultsSinkTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+static PageRecord MakeRecord(const std::string& url, long code, const char* body)
+{
+  PageRecord rec;
+  rec.url = url;
+  rec.responseCode = code;
+  rec.downloaded = true;
+  rec.level = 2;
+  rec.fetchMs = 15;
+  rec.body = body;
+  rec.bodyLen = std::string(body).size();
+  rec.pageBytes = rec.bodyLen;
+  return rec;
+}
+
+bool test1()
+{
+  std::string escaped;
+  //quote, backslash, newline, control char, valid 2-byte UTF-8, overlong '/', lone continuation byte
+  const char text[] = "a\"b\\c\nd\x01 \xC3\xA9 \xC0\xAF \x80";
+  JsonLinesSink::AppendJsonString(escaped, text, sizeof(text) - 1);
+  if ("\"a\\\"b\\\\c\\nd\\u0001 \xC3\xA9 \xEF\xBF\xBD\xEF\xBF\xBD \xEF\xBF\xBD\"" != escaped)
+    return false;
+  escaped.clear();
+  //a surrogate and a truncated 3-byte sequence
+  const char bad[] = "\xED\xA0\x80\xE2\x82";
+  JsonLinesSink::AppendJsonString(escaped, bad, sizeof(bad) - 1);
+  if (std::string::npos != escaped.find('\xED') || std::string::npos != escaped.find('\xE2'))
+    return false;
+
+  std::ostringstream os;
+  JsonLinesSink sink(&os, true);
+  PageRecord rec = MakeRecord("http://a.b/x?q=\"1\"", 200, "<p>foo</p>");
+  rec.matches.push_back("foo");
+  rec.matches.push_back("f\too");
+  if (!sink.write(rec))
+    return false;
+  rec.downloaded = false;
+  rec.responseCode = 404;
+  rec.matches.clear();
+  rec.body = nullptr;
+  if (!sink.write(rec))
+    return false;
+  return os.str() ==
+      "{\"url\":\"http://a.b/x?q=\\\"1\\\"\",\"status\":200,\"downloaded\":true,\"level\":2,\"fetch_ms\":15,"
+      "\"bytes\":10,\"matches\":[\"foo\",\"f\\too\"],\"body\":\"<p>foo</p>\"}\n"
+      "{\"url\":\"http://a.b/x?q=\\\"1\\\"\",\"status\":404,\"downloaded\":false,\"level\":2,\"fetch_ms\":15,"
+      "\"bytes\":10,\"matches\":[],\"body\":\"\"}\n";
+}
+
+bool test2()
+{
+  std::stringstream ss;
+  {
+    BinaryRecordSink sink(&ss, true);
+    PageRecord rec = MakeRecord("http://a.b/1", 200, "body");
+    rec.pageBytes = 5000000000ull;
+    rec.matches.push_back("one");
+    rec.matches.push_back("");
+    if (!sink.write(rec))
+      return false;
+    rec = MakeRecord("http://a.b/2", -1, "");
+    rec.downloaded = false;
+    if (!sink.write(rec))
+      return false;
+    sink.close();
+  }
+  BinaryRecordReader reader(ss);
+  PageRecord rec;
+  if (!reader.valid() || !reader.next(rec))
+    return false;
+  if ("http://a.b/1" != rec.url || 200 != rec.responseCode || !rec.downloaded || 2 != rec.level
+      || 15 != rec.fetchMs || 5000000000ull != rec.pageBytes || 2 != rec.matches.size()
+      || "one" != rec.matches[0] || !rec.matches[1].empty() || "body" != std::string(rec.body, rec.bodyLen))
+    return false;
+  if (!reader.next(rec) || "http://a.b/2" != rec.url || -1 != rec.responseCode || rec.downloaded
+      || !rec.matches.empty() || 0 != rec.bodyLen)
+    return false;
+  if (reader.next(rec))
+    return false;
+
+  //a broken size of 4 GiB: the short read fails, the record isn't allocated
+  std::string header = ss.str().substr(0, 8);
+  std::istringstream huge(header + std::string("\xF0\xFF\xFF\xFF", 4) + std::string(100, 'x'));
+  BinaryRecordReader broken(huge);
+  if (!broken.valid() || broken.next(rec))
+    return false;
+
+  //not a records' file
+  std::istringstream junk("WGRX\x01\0\0\0");
+  BinaryRecordReader bad(junk);
+  return !bad.valid() && !bad.next(rec);
+}
+
+bool test3()
+{
+  std::ostringstream os;
+  JsonLinesSink sink(&os);
+  std::atomic_uint written(0);
+  std::vector<std::thread> threads;
+  for(unsigned t = 0; t < 4; ++t)
+    {
+      threads.emplace_back([&sink, &written, t]()
+      {
+        PageRecord rec = MakeRecord("http://a.b/" + std::to_string(t), 200, "");
+        rec.matches.assign(8, std::string(64, (char)('a' + t)));
+        for(unsigned cnt = 0; cnt < 500; ++cnt)
+          written += sink.write(rec)? 1 : 0;
+      });
+    }
+  for(std::thread& th : threads)
+    th.join();
+  sink.close();
+  if (sink.write(MakeRecord("http://a.b/late", 200, "")) || !sink.closed())
+    return false;
+
+  std::istringstream is(os.str());
+  std::string line;
+  unsigned lines = 0;
+  while(std::getline(is, line))
+    {
+      char c = line[std::string("{\"url\":\"http://a.b/").size()];
+      //each line holds the matches of its own record only
+      if (line.find(std::string(64, (char)('a' + c - '0'))) == std::string::npos
+          || '}' != line.back())
+        return false;
+      ++lines;
+    }
+  if (2000 != written || 2000 != lines)
+    return false;
+
+  unsigned calls = 0;
+  CallbackSink cb([&calls](const PageRecord& rec) { calls += rec.matches.size(); });
+  PageRecord rec = MakeRecord("http://a.b/", 200, "");
+  rec.matches.push_back("x");
+  cb.write(rec);
+  cb.close();
+  cb.write(rec);
+  return 1 == calls;
+}
+
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test JSON Lines sink: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test binary records round trip: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test concurrent writes and close: ",
+                  []()->bool {return test3();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//ResultsSinkTests
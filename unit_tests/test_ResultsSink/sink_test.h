@@ -0,0 +1,17 @@
+#pragma once
+
+namespace ResultsSinkTests {
+
+  /** JsonLinesSink: the record's format, escaping of the quotes, control characters
+   *  and the invalid UTF-8 bytes.*/
+  bool test1();
+
+  /** BinaryRecordSink -> BinaryRecordReader round trip, the body is written when requested.*/
+  bool test2();
+
+  /** Concurrent writes are not mixed up, the records are dropped after close().*/
+  bool test3();
+
+  //accumulative test:
+  bool Test();
+}
@@ -0,0 +1,202 @@
+#include "webgrep/robots_rules.h"
+#include "webgrep/host_scheduler.h"
+#include <list>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include <functional>
+#include "robots_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = RobotsRulesTests::Test();
+  return (int)!result;
+}
+
+namespace RobotsRulesTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+static const char* robotsText =
+    "# comment line\n"
+    "User-agent: Googlebot\n"
+    "Disallow: /\n"
+    "\n"
+    "User-agent: *\n"
+    "Disallow: /private/\n"
+    "Allow: /private/open/\n"
+    "Disallow: /*.pdf$\n"
+    "Disallow: /search*q=\n"
+    "Crawl-delay: 3\n"
+    "\n"
+    "User-Agent: otherbot\n"
+    "user-agent: WebGrep/1.0   # ours\n"
+    "DISALLOW: /tmp\n"
+    "Allow: /tmp/x\n"
+    "Disallow: /tmp/x\n"
+    "Disallow:\n"
+    "Crawl-delay: 0.5\r\n";
+
+bool test1()
+{
+  std::shared_ptr<const RobotsRules> star = RobotsRules::Parse(robotsText, "somebot");
+  if (4 != star->rulesCount() || 3.0 != star->crawlDelay())
+    return false;
+  if (!star->allowed("/") || !star->allowed("/private") || star->allowed("/private/a.html")
+      || !star->allowed("/private/open/a.html") || star->allowed("http://site.com/private/b#x"))
+    return false;
+  if (star->allowed("/docs/a.pdf") || !star->allowed("/docs/a.pdf.html")
+      || star->allowed("/search?x=1&q=2") || !star->allowed("/search?x=1")
+      || !star->allowed("http://site.com") || !star->allowed("/robots.txt"))
+    return false;
+
+  std::shared_ptr<const RobotsRules> mine = RobotsRules::Parse(robotsText, "webgrep");
+  if (3 != mine->rulesCount() || 0.5 != mine->crawlDelay())
+    return false;
+  //the group of "*" is not used by our agent, "Allow: /tmp/x" wins the tie
+  if (!mine->allowed("/private/a.html") || mine->allowed("/tmp") || mine->allowed("/tmpfile")
+      || !mine->allowed("/tmp/x") || !mine->allowed("/tmp/xyz"))
+    return false;
+
+  std::shared_ptr<const RobotsRules> none = RobotsRules::Parse("User-agent: a\nDisallow: /\n");
+  std::shared_ptr<const RobotsRules> all = RobotsRules::Parse("User-agent: *\nDisallow: /\n");
+  return 0 == none->rulesCount() && none->allowed("/any") && none->crawlDelay() < 0.0
+      && !all->allowed("/") && !all->allowed("/any") && all->allowed("/robots.txt");
+}
+
+bool test2()
+{
+  std::shared_ptr<HostScheduler> scheduler = std::make_shared<HostScheduler>(100.0, 1, 0);
+  RobotsCache cache(scheduler);
+  std::atomic_uint fetches(0);
+  RobotsCache::FetchFunc_t fetch = [&](const std::string& url, std::string& content, long& code)
+  {
+    fetches.fetch_add(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    if ("http://slow.com/robots.txt" == url)
+      {
+        content = "User-agent: *\nCrawl-delay: 2\nDisallow: /cgi-bin/\n";
+        code = 200;
+        return true;
+      }
+    if ("http://missing.com:8080/robots.txt" == url)
+      {
+        content = "User-agent: *\nDisallow: /\n";//the page of the error
+        code = 404;
+        return true;
+      }
+    return false;
+  };
+
+  std::atomic_uint disallowed(0);
+  std::vector<std::thread> pool;
+  for(unsigned t = 0; t < 8; ++t)
+    {
+      pool.emplace_back([&]()
+      {
+        for(unsigned idx = 0; idx < 100; ++idx)
+          {
+            if (!cache.rules("http://slow.com/cgi-bin/x.cgi", fetch)->allowed("/cgi-bin/x.cgi"))
+              disallowed.fetch_add(1);
+            cache.rules("http://missing.com:8080/a/b.html", fetch);
+            cache.rules("https://down.org/", fetch);
+          }
+      });
+    }
+  for(std::thread& t : pool)
+    t.join();
+  if (3 != fetches.load() || 800 != disallowed.load() || 3 != cache.size())
+    return false;
+  if (!cache.allowed("http://missing.com:8080/any") || !cache.allowed("https://down.org/any"))
+    return false;
+
+  //Crawl-delay: 2 seconds between the requests
+  HostScheduler::Clock_t::time_point readyAt, now = HostScheduler::Clock_t::now();
+  if (!scheduler->tryAcquire("slow.com", readyAt) || scheduler->tryAcquire("slow.com", readyAt)
+      || readyAt < now + std::chrono::milliseconds(1900))
+    return false;
+  //the other hosts keep the common rate
+  now = HostScheduler::Clock_t::now();
+  return scheduler->tryAcquire("missing.com:8080", readyAt) && !scheduler->tryAcquire("missing.com:8080", readyAt)
+      && readyAt < now + std::chrono::milliseconds(100);
+}
+
+bool test3()
+{
+  if ("http://site.com:8080" != RobotsCache::OriginOf("HTTP://Site.com:8080/a/b.html")
+      || "https://site.com" != RobotsCache::OriginOf("https://site.com?q=1")
+      || "http://site.com" != RobotsCache::OriginOf("site.com/a"))
+    return false;
+
+  RobotsCache cache;
+  if (nullptr != cache.peek("http://site.com/") || !cache.allowed("http://site.com/admin/")
+      || 0 != cache.size())
+    return false;
+  cache.rules("http://site.com/", [](const std::string&, std::string& content, long& code)
+  {
+    content = "User-agent: *\nDisallow: /admin/\n";
+    code = 200;
+    return true;
+  });
+  if (nullptr == cache.peek("http://site.com/x") || cache.allowed("http://site.com/admin/")
+      || !cache.allowed("http://site.com/a") || !cache.allowed("https://site.com/admin/"))
+    return false;
+  cache.clear();
+  if (!cache.allowed("http://site.com/admin/") || 0 != cache.size())
+    return false;
+
+  //the fetch taken by claimFetch(): nobody waits, rules() waits for store()
+  if (!cache.claimFetch("http://site.com/a") || cache.claimFetch("http://site.com/b")
+      || nullptr != cache.peek("http://site.com/a"))
+    return false;
+  std::atomic_bool waited(false);
+  std::thread reader([&cache, &waited]()
+  {
+    std::shared_ptr<const RobotsRules> rules = cache.rules("http://site.com/c", nullptr);
+    waited.store(!rules->allowed("/webgrep/x"));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  cache.store("http://site.com/a", true, 200, "User-agent: webgrep\nDisallow: /webgrep/\n");
+  reader.join();
+  return waited.load() && !cache.claimFetch("http://site.com/a") && !cache.allowed("http://site.com/webgrep/");
+}
+
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test robots.txt parsing and rules: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test robots.txt fetched once per host: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test cached rules lookup and claimed fetch: ",
+                  []()->bool {return test3();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//RobotsRulesTests
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace RobotsRulesTests {
+
+  /** Parsing of robots.txt: the group of our user-agent or "*", the longest rule wins,
+   *  Allow wins the tie, '*' and '$' patterns, Crawl-delay.*/
+  bool test1();
+
+  /** RobotsCache downloads robots.txt once per host while many threads ask for it,
+   *  no robots.txt allows all, Crawl-delay goes to the HostScheduler.*/
+  bool test2();
+
+  /** peek() and allowed() don't download, the host's origin of the URLs.*/
+  bool test3();
+
+  //accumulative test:
+  bool Test();
+}
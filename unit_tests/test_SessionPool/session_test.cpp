@@ -0,0 +1,171 @@
+#include "webgrep/session_pool.h"
+#include <list>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <iostream>
+#include <functional>
+#include "session_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = SessionPoolTests::Test();
+  return (int)!result;
+}
+
+namespace SessionPoolTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+static const std::string hostA = "http://a.com:80";
+static const std::string hostB = "https://b.com:443";
+
+//acquire() and mark the context connected, like Client::connect() does
+static std::shared_ptr<ClientCtx> AcquireConnected(SessionPool& pool, const std::string& key)
+{
+  std::shared_ptr<ClientCtx> ctx = pool.acquire(key);
+  if (nullptr != ctx && ctx->host_and_port.empty())
+    ctx->host_and_port = key.substr(key.find("://") + 3);
+  return ctx;
+}
+
+bool test1()
+{
+  SessionPool pool(2, 8, 30);
+  std::shared_ptr<ClientCtx> a1 = AcquireConnected(pool, hostA);
+  std::shared_ptr<ClientCtx> a2 = AcquireConnected(pool, hostA);
+  bool ok = nullptr != a1 && nullptr != a2 && a1 != a2;
+
+  std::atomic<bool> done(false);
+  std::shared_ptr<ClientCtx> a3;
+  std::thread waiter([&pool, &a3, &done]()
+  {
+    a3 = pool.acquire(hostA);
+    done = true;
+  });
+  //the host's limit is reached, another host is not affected
+  std::shared_ptr<ClientCtx> b1 = AcquireConnected(pool, hostB);
+  ok = ok && nullptr != b1;
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  ok = ok && !done;
+
+  ClientCtx* released = a2.get();
+  pool.release(hostA, std::move(a2));
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while(!done && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  ok = ok && done;
+  waiter.join();
+  //the waiter got the released connection
+  ok = ok && nullptr == a2 && released == a3.get();
+
+  pool.release(hostA, std::move(a1));
+  pool.release(hostA, std::move(a3));
+  pool.release(hostB, std::move(b1));
+  ok = ok && 3 == pool.idleCount();
+  return ok;
+}
+//--------------------------------------------------------------
+bool test2()
+{
+  SessionPool pool(16, 2, 30);
+  std::vector<std::shared_ptr<ClientCtx>> taken;
+  for(unsigned z = 0; z < 4; ++z)
+    taken.push_back(AcquireConnected(pool, hostA));
+  std::shared_ptr<ClientCtx> b1 = AcquireConnected(pool, hostB);
+  ClientCtx* last = taken[1].get();
+  bool ok = true;
+  for(std::shared_ptr<ClientCtx>& ctx : taken)
+    ok = ok && nullptr != ctx;
+  if (!ok)
+    return false;
+
+  taken[0]->response = "left from the last request";
+  ClientCtx* first = taken[0].get();
+  pool.release(hostA, std::move(taken[0]));
+  pool.release(hostA, std::move(taken[1]));
+  //the host keeps 2 idle contexts, the others are closed
+  pool.release(hostA, std::move(taken[2]));
+  pool.release(hostA, std::move(taken[3]));
+  ok = ok && 2 == pool.idleCount();
+  pool.release(hostB, std::move(b1));
+  ok = ok && 3 == pool.idleCount();
+
+  std::shared_ptr<ClientCtx> ctx = pool.acquire(hostA);
+  ok = ok && last == ctx.get() && 2 == pool.idleCount();
+  std::shared_ptr<ClientCtx> ctx2 = pool.acquire(hostA);
+  ok = ok && first == ctx2.get() && ctx2->response.empty();
+  //a new one is made when there is no idle context of the host
+  std::shared_ptr<ClientCtx> ctx3 = pool.acquire(hostA);
+  ok = ok && nullptr != ctx3 && ctx3->host_and_port.empty() && 1 == pool.idleCount();
+
+  //the context that isn't connected is not kept
+  pool.release(hostA, std::move(ctx3));
+  ok = ok && 1 == pool.idleCount();
+  pool.release(hostA, std::move(ctx));
+  pool.release(hostA, std::move(ctx2));
+  ok = ok && 3 == pool.idleCount();
+  return ok;
+}
+//--------------------------------------------------------------
+bool test3()
+{
+  SessionPool pool(16, 8, 1);
+  std::shared_ptr<ClientCtx> a1 = AcquireConnected(pool, hostA);
+  std::shared_ptr<ClientCtx> a2 = AcquireConnected(pool, hostA);
+  std::shared_ptr<ClientCtx> b1 = AcquireConnected(pool, hostB);
+  std::weak_ptr<ClientCtx> weakA1(a1);
+  pool.release(hostA, std::move(a1));
+  pool.release(hostB, std::move(b1));
+  bool ok = 0 == pool.evictIdle() && 2 == pool.idleCount();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  ok = ok && 2 == pool.evictIdle() && 0 == pool.idleCount() && weakA1.expired();
+  pool.release(hostA, std::move(a2));
+  ok = ok && 0 == pool.evictIdle() && 1 == pool.idleCount();
+
+  //acquire() evicts too, once a second
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  std::shared_ptr<ClientCtx> b2 = pool.acquire(hostB);
+  ok = ok && nullptr != b2 && b2->host_and_port.empty() && 0 == pool.idleCount();
+  return ok;
+}
+//--------------------------------------------------------------
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test the per-host limit of the contexts in use: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test reuse and the limit of the idle contexts: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test eviction of the idle contexts: ",
+                  []()->bool {return test3();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//SessionPoolTests
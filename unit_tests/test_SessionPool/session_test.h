@@ -0,0 +1,18 @@
+#pragma once
+
+namespace SessionPoolTests {
+
+  /** The limit of the contexts of a host in use: acquire() above it waits
+   *  until a context of the host is released, the other hosts aren't blocked.*/
+  bool test1();
+
+  /** The released connected contexts are reused (the last released first), at most
+   *  maxIdlePerHost of a host are kept, the contexts that aren't connected are dropped.*/
+  bool test2();
+
+  /** The idle contexts older than idleSeconds are closed by evictIdle() and by acquire().*/
+  bool test3();
+
+  //accumulative test:
+  bool Test();
+}
@@ -22,7 +22,11 @@ public:
   explicit LList(std::atomic_uint& ref, uint32_t i = 0)
     : pref(&ref), idx(i)
   {
-    //set up a sinle task functor
+    arm();
+  }
+  //set up a sinle task functor, the pool moves it away on each submission
+  void arm()
+  {
     dfunc.functor = [this](){ ;
         pref->fetch_add(1);
         throw std::logic_error("just checking reaction for fake error...");
@@ -76,6 +80,7 @@ public:
     {//a functor that is iteration interface on LList class items
       if (nullptr != list_cur_ptr->next)
         {
+          list_cur_ptr->arm();
           *pptr = &(list_cur_ptr->dfunc);
           list_cur_ptr = list_cur_ptr->next;
           return true;
@@ -83,6 +88,7 @@ public:
       return false;
     };
     //submit array of tasks with custom iteration functor, no spray (all to same thread)
+    head->arm();
     pool.submit(&(head->dfunc), 0, ifunc, false);
   }
 
@@ -155,20 +161,26 @@ bool test2()
   g_cnt2.store(0);
   ThreadsPool pool2(5);
   std::array<WebGrep::CallableDoubleFunc, 128> funcArray;
-  for(WebGrep::CallableDoubleFunc& dfunc : funcArray)
-    {
-      dfunc.functor = [&g_cnt2]()
+  //the tasks are moved away on submission, fill the array before each one
+  auto armTasks = [&funcArray, &g_cnt2]()
+  {
+    for(WebGrep::CallableDoubleFunc& dfunc : funcArray)
       {
-        g_cnt2.fetch_add(1, std::memory_order_acquire);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        throw std::logic_error("fake error");
-      };
-      dfunc.cbOnException = [](const std::exception&){};
-    }
+        dfunc.functor = [&g_cnt2]()
+        {
+          g_cnt2.fetch_add(1, std::memory_order_acquire);
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          throw std::logic_error("fake error");
+        };
+        dfunc.cbOnException = [](const std::exception&){};
+      }
+  };
+  armTasks();
   pool2.submit(funcArray.data(), funcArray.size());
+  armTasks();
   for(WebGrep::CallableDoubleFunc& dfunc : funcArray)
     {
-      pool2.submit(dfunc);
+      pool2.submit(std::move(dfunc));
     }
   pool2.close();
   pool2.joinAll();
@@ -220,7 +232,7 @@ bool test3()
     std::lock_guard<std::mutex> lk(vectorLock); (void)lk;
     for(size_t c = 0; c < len; ++c)
       {
-        tasksLeft.push_back(abandonedTasksArray[c]);
+        tasksLeft.push_back(std::move(abandonedTasksArray[c]));
       }
   };
   pool.joinExportAll(taskSavior);
@@ -228,13 +240,259 @@ bool test3()
   //execute the abandoned tasks here:
   for(WebGrep::CallableDoubleFunc& lonelyTask : tasksLeft)
     {
-      lonelyTask.functor();
+      if (nullptr != lonelyTask.functor)
+        lonelyTask.functor();
     }
   //check the sum
   auto value = counter.load();
   return value == dispatchCnt.load();
 }
 //--------------------------------------------------------------
+/** Test work stealing: tasks queued behind a blocked task are taken by idle threads.*/
+bool test4()
+{
+  static const unsigned _N = 64;
+  std::atomic_uint counter;
+  counter.store(0);
+  volatile bool othersDone = false;
+
+  ThreadsPool pool(4, true);
+  std::array<WebGrep::CallableDoubleFunc, _N + 1> funcArray;
+  //the first task blocks it's thread until the rest is done (or timeout)
+  funcArray[0].functor = [&counter, &othersDone]()
+  {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(counter.load() < _N && std::chrono::steady_clock::now() < deadline)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    othersDone = (counter.load() == _N);
+  };
+  for(size_t c = 1; c < funcArray.size(); ++c)
+    {
+      funcArray[c].functor = [&counter](){ counter.fetch_add(1); };
+    }
+  //all tasks to one thread's queue, behind the blocking one
+  pool.submit(funcArray.data(), funcArray.size(), PtrForwardIterationDbl, false);
+  pool.joinAll();
+  return othersDone && _N == counter.load();
+}
+//--------------------------------------------------------------
+/** Test the lock-free queue backend with concurrent producers and ring overflow.*/
+bool test5()
+{
+  static const unsigned _N_producers = 4;
+  static const unsigned _N_tasks = 5000;//more than TPool_RingCapacity for each thread
+  bool ok = true;
+
+  for(bool stealing : {false, true})
+    {
+      std::atomic_uint counter;
+      counter.store(0);
+      ThreadsPool pool(3, stealing, TPoolQueue::LOCKFREE_RING);
+
+      std::vector<std::thread> producers(_N_producers);
+      for(std::thread& thr : producers)
+        {
+          thr = std::thread([&pool, &counter]()
+          {
+            for(unsigned z = 0; z < _N_tasks; ++z)
+              {
+                pool.submit([&counter](){ counter.fetch_add(1); });
+              }
+          });
+        }
+      for(std::thread& thr : producers)
+        { thr.join(); }
+
+      pool.joinAll();
+      ok = ok && (_N_producers * _N_tasks == counter.load());
+    }
+  return ok;
+}
+//--------------------------------------------------------------
+/** Test move-only tasks: inline storage of small functors and move-only captures.*/
+bool test6()
+{
+  std::atomic_uint counter;
+  counter.store(0);
+  bool ok = true;
+
+  std::array<char, 80> small; small.fill(1);
+  std::array<char, 256> big; big.fill(1);
+  WebGrep::CallableDoubleFunc smallTask, bigTask, uniqueTask;
+  smallTask.functor = [small, &counter](){ counter.fetch_add(small[0]); };
+  bigTask.functor = [big, &counter](){ counter.fetch_add(big[0]); };
+  std::unique_ptr<unsigned> one(new unsigned(1));
+  uniqueTask.functor = std::bind([&counter](std::unique_ptr<unsigned>& value)
+                                 { counter.fetch_add(*value); }, std::move(one));
+  ok = ok && smallTask.functor.isInline() && !bigTask.functor.isInline();
+
+  //moving the task moves the functor:
+  WebGrep::CallableDoubleFunc moved(std::move(smallTask));
+  ok = ok && (nullptr == smallTask.functor) && moved.functor.isInline();
+
+  ThreadsPool pool(2, true, TPoolQueue::LOCKFREE_RING);
+  pool.submit(std::move(moved));
+  pool.submit(std::move(bigTask));
+  pool.submit(std::move(uniqueTask));
+  pool.joinAll();
+  return ok && 3 == counter.load();
+}
+//--------------------------------------------------------------
+/** Test resize() of the running pool: retired threads hand their tasks over to the rest.*/
+bool test7()
+{
+  static const unsigned _N_tasks = 20000;
+  bool ok = true;
+
+  for(int mode = 0; mode < 3; ++mode)
+    {
+      std::atomic_uint counter;
+      counter.store(0);
+      ThreadsPool pool(2, 2 == mode,
+                       0 == mode? TPoolQueue::LOCKED_DEQUE : TPoolQueue::LOCKFREE_RING);
+      ok = ok && !pool.resize(0);
+
+      std::thread producer([&pool, &counter]()
+      {
+        for(unsigned z = 0; z < _N_tasks; ++z)
+          {
+            pool.submit([&counter, z]()
+            {
+              if (0 == z % 1000)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+              counter.fetch_add(1);
+            });
+          }
+      });
+      for(uint32_t n : {6, 1, 4, 2, 1})
+        {
+          ok = ok && pool.resize(n) && n == pool.threadsCount();
+          std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+      producer.join();
+      pool.joinAll();
+      ok = ok && (_N_tasks == counter.load()) && !pool.resize(2) && 0 == pool.threadsCount();
+    }
+  ThreadsPool detached(2);
+  detached.terminateDetach();
+  ok = ok && 0 == detached.threadsCount();
+  return ok;
+}
+//--------------------------------------------------------------
+//wait until the paused pool's threads are parked, FALSE on timeout
+static bool WaitParked(const ThreadsPool& pool)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while(pool.parkedCount() < pool.threadsCount())
+    {
+      if (std::chrono::steady_clock::now() >= deadline)
+        return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  return true;
+}
+
+/** Test pause() and resume(): the threads park, the queued tasks are kept.*/
+bool test8()
+{
+  static const unsigned _N_tasks = 5000;
+  bool ok = true;
+
+  for(int mode = 0; mode < 3; ++mode)
+    {
+      std::atomic_uint counter;
+      counter.store(0);
+      ThreadsPool pool(3, 2 == mode,
+                       0 == mode? TPoolQueue::LOCKED_DEQUE : TPoolQueue::LOCKFREE_RING);
+      for(unsigned z = 0; z < _N_tasks; ++z)
+        {
+          pool.submit([&counter](){
+              std::this_thread::sleep_for(std::chrono::microseconds(20));
+              counter.fetch_add(1);
+            });
+        }
+      pool.pause();
+      ok = ok && pool.paused() && WaitParked(pool);
+      //nothing is executed while it's paused, the submission goes on
+      unsigned done = counter.load();
+      for(unsigned z = 0; z < _N_tasks; ++z)
+        {
+          pool.submit([&counter](){ counter.fetch_add(1); });
+        }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      ok = ok && done == counter.load() && !pool.idle();
+
+      //the threads are changed at the gate
+      ok = ok && pool.resize(5) && pool.resize(2) && WaitParked(pool);
+      ok = ok && done == counter.load();
+
+      pool.resume();
+      ok = ok && !pool.paused();
+      //joining the paused pool lets the threads finish the tasks
+      pool.pause();
+      pool.joinAll();
+      ok = ok && (2 * _N_tasks == counter.load());
+    }
+  return ok;
+}
+//--------------------------------------------------------------
+//wait until the pool is idle, FALSE on timeout
+static bool WaitIdle(const ThreadsPool& pool)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while(!pool.idle())
+    {
+      if (std::chrono::steady_clock::now() >= deadline)
+        return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  return true;
+}
+
+/** Test pause() and resume() under load: no task taken before the pause is left behind.*/
+bool test9()
+{
+  static const unsigned _N_tasks = 2000;
+  static const unsigned _N_rounds = 20;
+  bool ok = true;
+
+  for(int mode = 0; mode < 3; ++mode)
+    {
+      ThreadsPool pool(4, 2 == mode,
+                       0 == mode? TPoolQueue::LOCKED_DEQUE : TPoolQueue::LOCKFREE_RING);
+      for(unsigned round = 0; round < _N_rounds && ok; ++round)
+        {
+          std::atomic_uint counter;
+          counter.store(0);
+          std::atomic_bool submitted(false);
+          std::thread producer([&pool, &counter, &submitted]()
+          {
+            for(unsigned z = 0; z < _N_tasks; ++z)
+              pool.submit([&counter](){ counter.fetch_add(1); });
+            submitted.store(true);
+          });
+          //the gate is toggled while the threads are taking the tasks, the last ones as well
+          auto until = std::chrono::steady_clock::time_point::max();
+          while(_N_tasks != counter.load() && std::chrono::steady_clock::now() < until)
+            {
+              if (submitted.load() && until == std::chrono::steady_clock::time_point::max())
+                until = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+              pool.pause();
+              std::this_thread::yield();
+              pool.resume();
+            }
+          producer.join();
+          pool.resume();
+          //idle() is not TRUE while a task is kept by a thread
+          ok = ok && WaitIdle(pool) && _N_tasks == counter.load();
+        }
+      pool.joinAll();
+    }
+  return ok;
+}
+//--------------------------------------------------------------
 bool Test()
 {
   typedef std::pair<std::string, std::function<bool()>> NamedTask;
@@ -248,6 +506,24 @@ bool Test()
   testsList.push_back
       ( NamedTask("test ThreadsPool.joinExportAll for abandoned tasks export: ",
                   []()->bool {return test3();}) );
+  testsList.push_back
+      ( NamedTask("test ThreadsPool work stealing of queued tasks: ",
+                  []()->bool {return test4();}) );
+  testsList.push_back
+      ( NamedTask("test ThreadsPool lock-free queue backend: ",
+                  []()->bool {return test5();}) );
+  testsList.push_back
+      ( NamedTask("test ThreadsPool move-only tasks: ",
+                  []()->bool {return test6();}) );
+  testsList.push_back
+      ( NamedTask("test ThreadsPool resize of the running pool: ",
+                  []()->bool {return test7();}) );
+  testsList.push_back
+      ( NamedTask("test ThreadsPool pause and resume: ",
+                  []()->bool {return test8();}) );
+  testsList.push_back
+      ( NamedTask("test ThreadsPool pause and resume under load: ",
+                  []()->bool {return test9();}) );
 
   bool ok = true;
 
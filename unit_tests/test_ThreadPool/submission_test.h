@@ -11,6 +11,24 @@ namespace ThreadPoolTests {
   /** Test joibExportAll() that lets you to get abandoned tasks.*/
   bool test3();
 
+  /** Test work stealing: tasks queued behind a blocked task are taken by idle threads.*/
+  bool test4();
+
+  /** Test the lock-free queue backend with concurrent producers and ring overflow.*/
+  bool test5();
+
+  /** Test move-only tasks: inline storage of small functors and move-only captures.*/
+  bool test6();
+
+  /** Test resize() of the running pool: retired threads hand their tasks over to the rest.*/
+  bool test7();
+
+  /** Test pause() and resume(): the threads park, the queued tasks are kept.*/
+  bool test8();
+
+  /** Test pause() and resume() under load: no task taken before the pause is left behind.*/
+  bool test9();
+
   //accumulative test:
   bool Test();
 }
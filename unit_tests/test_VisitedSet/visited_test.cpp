@@ -0,0 +1,140 @@
+#include "webgrep/visited_set.h"
+#include <list>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <iostream>
+#include <functional>
+#include "visited_test.h"
+
+int main(int argc, char** argv)
+{
+  (void)argc; (void)argv;
+  bool result = VisitedSetTests::Test();
+  return (int)!result;
+}
+
+namespace VisitedSetTests {
+//=============================================================================
+
+using namespace WebGrep;
+
+static std::string Norm(const std::string& url)
+{
+  return VisitedSet::NormalizeURL(url.data(), url.size());
+}
+
+bool test1()
+{
+  bool ok = true;
+  ok = ok && "http://site.com/a" == Norm("http://site.com:80/a");
+  ok = ok && "https://site.com/a" == Norm("https://site.com:443/a");
+  ok = ok && "site.com?q=1" == Norm("site.com:80?q=1");
+  //not the default port of the scheme
+  ok = ok && "http://site.com:443/a" == Norm("http://site.com:443/a");
+  ok = ok && "https://site.com:80/a" == Norm("https://site.com:80/a");
+  ok = ok && "http://site.com:8080/a" == Norm("http://site.com:8080/a");
+  //":80" of the path isn't a port
+  ok = ok && "http://site.com/a:80" == Norm("http://site.com/a:80");
+
+  ok = ok && "http://site.com/a" == Norm("http://site.com/a#top");
+  ok = ok && "http://site.com/a?q=1" == Norm("http://site.com/a?q=1#top");
+  ok = ok && "http://site.com" == Norm("http://site.com#top");
+  ok = ok && "http://site.com/a" == Norm("HTTP://Site.com:80/a/#top");
+  return ok;
+}
+//--------------------------------------------------------------
+bool test2()
+{
+  bool ok = true;
+  ok = ok && "https://site.com/Path/File.HTML?Q=A" == Norm("HTTPS://SITE.Com/Path/File.HTML?Q=A");
+  ok = ok && "site.com/a" == Norm("Site.COM/a");
+  ok = ok && "http://site.com/a" == Norm("http://site.com/a/");
+  ok = ok && "http://site.com/a" == Norm("http://site.com/a//");
+  ok = ok && "http://site.com" == Norm("http://site.com/");
+  ok = ok && "" == Norm("");
+
+  VisitedSet visited;
+  ok = ok && visited.insert("http://site.com/a");
+  ok = ok && !visited.insert("HTTP://SITE.COM:80/a/#b");
+  ok = ok && !visited.insert("http://site.com/a/");
+  ok = ok && visited.insert("http://site.com/A");
+  ok = ok && visited.insert("https://site.com/a");
+  ok = ok && visited.contains("Http://Site.com/a#x") && !visited.contains("http://site.com/b");
+  ok = ok && 3 == visited.size();
+  visited.clear();
+  ok = ok && 0 == visited.size() && !visited.contains("http://site.com/a");
+  return ok;
+}
+//--------------------------------------------------------------
+bool test3()
+{
+  static const unsigned _N_threads = 8;
+  static const unsigned _N_urls = 5000;
+  VisitedSet visited;
+  std::atomic<unsigned> inserted(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads(_N_threads);
+  for(unsigned t = 0; t < _N_threads; ++t)
+    {
+      threads[t] = std::thread([t, &visited, &inserted, &go]()
+      {
+        while(!go)
+          std::this_thread::yield();
+        for(unsigned z = 0; z < _N_urls; ++z)
+          {//the same URLs spelled differently by the threads
+            std::string url = (0 == t % 2)? "http://site.com/" : "HTTP://SITE.COM:80/";
+            url += std::to_string(z);
+            url += (0 == t % 3)? "/#f" : "";
+            if (visited.insert(url))
+              inserted.fetch_add(1);
+          }
+      });
+    }
+  go = true;
+  for(std::thread& thr : threads)
+    thr.join();
+  bool ok = _N_urls == inserted.load() && _N_urls == visited.size();
+
+  visited.erase("http://site.com/7/");
+  ok = ok && !visited.contains("http://site.com/7") && _N_urls - 1 == visited.size();
+  ok = ok && visited.insert("http://site.com/7") && !visited.insert("http://site.com/7");
+  return ok;
+}
+//--------------------------------------------------------------
+bool Test()
+{
+  typedef std::pair<std::string, std::function<bool()>> NamedTask;
+  std::list<NamedTask> testsList;
+  testsList.push_back
+      ( NamedTask("test URL normalization: default ports and fragments: ",
+                  []()->bool {return test1();}) );
+  testsList.push_back
+      ( NamedTask("test URL normalization: case and trailing slash: ",
+                  []()->bool {return test2();}) );
+  testsList.push_back
+      ( NamedTask("test concurrent insert of the same URLs: ",
+                  []()->bool {return test3();}) );
+
+  bool ok = true;
+
+  try {
+    for(NamedTask& t : testsList)
+      {
+        bool res = t.second();
+        std::string msg = res? "PASSED." : "FAILED.";
+        std::cerr << t.first << msg << std::endl;
+        ok = ok && res;
+      }
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " test failed: " << ex.what() << std::endl;
+    return false;
+  }
+  return ok;
+}
+//=============================================================================
+
+}//VisitedSetTests
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace VisitedSetTests {
+
+  /** NormalizeURL(): the default ports (:80 of http, :443 of https) are dropped,
+   *  the other ports are kept; the "#fragment" is cut.*/
+  bool test1();
+
+  /** NormalizeURL(): the scheme and the host are lowercased, the path and the query are not;
+   *  the trailing "/" is dropped. insert() and contains() treat the variants as one URL.*/
+  bool test2();
+
+  /** Many threads insert the same URLs at once: exactly one insert() of each URL
+   *  returns TRUE; erase() makes the URL new again.*/
+  bool test3();
+
+  //accumulative test:
+  bool Test();
+}
@@ -7,9 +7,50 @@
 #include <iostream>
 #include <exception>
 #include "linked_task.h"
+#include "session_pool.h"
+#include "user_agent.h"
 
 namespace WebGrep {
 
+//"scheme://host:port" key of a session, (colpos) is the position of "://"
+static std::string MakeSessionKey(const std::string& httpURL, size_t colpos)
+{
+  std::string key = httpURL.substr(0, colpos);
+  for(char& c : key)
+    c = std::tolower(c);
+  key += "://";
+  key += ExtractHostPortHttp(httpURL);
+  return key;
+}
+
+void Client::setSessionPool(const std::shared_ptr<SessionPool>& pool)
+{
+  release();
+  d_pool = pool;
+}
+
+void Client::release()
+{
+  if (nullptr != d_pool && nullptr != ctx)
+    {
+      d_pool->release(d_poolKey, std::move(ctx));
+    }
+  ctx.reset();
+  d_poolKey.clear();
+}
+
+bool Client::bindContext(const std::string& key)
+{
+  if (nullptr != ctx && key == d_poolKey)
+    return true;
+  release();
+  ctx = (nullptr != d_pool)? d_pool->acquire(key) : std::make_shared<ClientCtx>();
+  if (nullptr == ctx)
+    return false;
+  d_poolKey = key;
+  return true;
+}
+
 //-----------------------------------------------------------------
 const char* Client::scheme() const
 {
@@ -53,7 +94,12 @@ std::string Client::connect(const std::string& httpURL)
   if (colpos < 4 || colpos > 5)
     return std::string();
 
-  ctx = std::make_shared<ClientCtx>();
+  if (!bindContext(MakeSessionKey(httpURL, colpos)))
+    return std::string();
+  if (nullptr != ctx->sess)
+    {//the session is reused with it's keep-alive connection
+      return ctx->host_and_port;
+    }
   ctx->scheme.fill(0x00);
   ::memcpy(ctx->scheme.data(), httpURL.data(), colpos);
 
@@ -81,7 +127,7 @@ std::string Client::connect(const std::string& httpURL)
       ctx->host_and_port.append(temp.data());
     }
   ctx->sess = ne;
-  ne_set_useragent(ctx->sess, "libneon");
+  ne_set_useragent(ctx->sess, UserAgentHeader);
   if (ctx->isHttps())
     {
       ne_ssl_trust_default_ca(ne);
@@ -124,9 +170,11 @@ std::string Client::connect(const std::string& httpURL)
   if (colpos < 4 || colpos > 5)
     return std::string();
 
-  if(nullptr == ctx)
-    {
-      ctx = std::make_shared<ClientCtx>();
+  if (!bindContext(MakeSessionKey(httpURL, colpos)))
+    return std::string();
+  if (!ctx->host_and_port.empty())
+    {//the context is reused, so is it's CURL* handle with the connection
+      return ctx->host_and_port;
     }
   ctx->scheme.fill(0x00);
   ::memcpy(ctx->scheme.data(), httpURL.data(), colpos);
@@ -190,12 +238,16 @@ WebGrep::IssuedRequest Client::issueRequest(const char* method, const char* path
   out.ctx = this->ctx;
   out.responseStringPtr = &(ctx->response);
 
-  ctx->curl = curl_easy_init();
+  //the handle keeps the connections alive, so it's reset instead of a new one
+  if (nullptr == ctx->curl)
+    ctx->curl = curl_easy_init();
+  else
+    curl_easy_reset(ctx->curl);
   if(nullptr == ctx->curl)
     { return out; }
 
   ctx->response.clear();
-  curl_easy_setopt(ctx->curl,CURLOPT_USERAGENT, "cURL-7");
+  curl_easy_setopt(ctx->curl,CURLOPT_USERAGENT, UserAgentHeader);
 
   curl_easy_setopt(ctx->curl,CURLOPT_URL, url.data());
   curl_easy_setopt(ctx->curl, CURLOPT_FOLLOWLOCATION, 1L);
@@ -220,7 +272,12 @@ std::string Client::connect(const std::string& httpURL)
   if (colpos < 4 || colpos > 5)
     return std::string();
 
-  ctx = std::make_shared<ClientCtx>();
+  if (!bindContext(MakeSessionKey(httpURL, colpos)))
+    return std::string();
+  if (!ctx->host_and_port.empty())
+    {//connected to the host already
+      return ctx->host_and_port;
+    }
   ctx->scheme.fill(0x00);
   ::memcpy(ctx->scheme.data(), httpURL.data(), colpos);
 
@@ -259,7 +316,7 @@ WebGrep::IssuedRequest Client::issueRequest(const char* method, const char* path
   url += ctx->host_and_port.data();
   url += path;
   out.req.setUrl(url);
-  out.req.setRawHeader("User-Agent", "Qt5GET 1.0");
+  out.req.setRawHeader("User-Agent", UserAgentHeader);
   out.ctx = ctx;
   return out;
 }
@@ -12,6 +12,8 @@
 /** Modified version from https://github.com/eidheim/Simple-Web-Server */
 namespace WebGrep {
 
+class SessionPool;
+
 //-----------------------------------------------------------------------------
 /** Contains connection context and it's dependant request tasks,
  * the destructor will clean up it all.
@@ -20,10 +22,19 @@ class Client
 {
 public:
   Client();
-  virtual ~Client() { }
+  virtual ~Client() { release(); }
+
+  /** Take the connections from (pool) and give them back there,
+   *  so they're kept alive between the requests. The pool is copied with the Client.*/
+  void setSessionPool(const std::shared_ptr<SessionPool>& pool);
+
+  /** Give the connection back to the session pool or close it if there is no pool.
+   *  The IssuedRequest objects of the connection must be destroyed before that.*/
+  void release();
 
   /** Connect to a host, use issueRequest() when connected.
-   * Thread-safe: shared_ptr<ClientCtx> is constructed on each connect.
+   * Thread-safe: the context is taken from the session pool or constructed,
+   * it's kept if the host is the same as before.
    * @return extracted host and port string like "site.com:443"
    * or empty string on fail.*/
   std::string connect(const std::string& httpURL);
@@ -49,13 +60,21 @@ public:
   }
 
   Client& operator = (const Client& rhs)
-  {//make sure to do not have ties with rhs
-    (void)rhs;
-    ctx.reset();
+  {//make sure to do not have ties with rhs, except the pool
+    if (this != &rhs)
+      {
+        release();
+        d_pool = rhs.d_pool;
+      }
     return *this;
   }
 protected:
+  //take a context for (key) from the pool or construct it, @return FALSE on fail
+  bool bindContext(const std::string& key);
+
   std::shared_ptr<ClientCtx> ctx;//not null when connected
+  std::shared_ptr<SessionPool> d_pool;
+  std::string d_poolKey;//"scheme://host:port" of the ctx
 };
 
 
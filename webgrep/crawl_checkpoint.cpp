@@ -0,0 +1,326 @@
+#include "crawl_checkpoint.h"
+#include "linked_task.h"
+#include <deque>
+#include <unordered_set>
+#include <iostream>
+#include <cstdlib>
+
+namespace WebGrep {
+
+static const char checkpointMagic[] = "webgrep-checkpoint";
+static const char checkpointVersion[] = "1";
+
+//the fields are separated by tabs, the records by new lines
+static void AppendField(std::string& out, const char* text, size_t len)
+{
+  out.push_back('\t');
+  for(size_t pos = 0; pos < len; ++pos)
+    {
+      switch(text[pos])
+        {
+        case '\\': out += "\\\\"; break;
+        case '\t': out += "\\t"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        default: out.push_back(text[pos]);
+        }
+    }
+}
+
+static void AppendField(std::string& out, const std::string& text)
+{
+  AppendField(out, text.data(), text.size());
+}
+
+static void AppendNumber(std::string& out, unsigned long long value, bool negative = false)
+{
+  out.push_back('\t');
+  if (negative)
+    out.push_back('-');
+  out += std::to_string(value);
+}
+
+//split the record's line by tabs and unescape the fields
+static void SplitFields(const std::string& line, std::vector<std::string>& fields)
+{
+  fields.assign(1, std::string());
+  for(size_t pos = 0; pos < line.size(); ++pos)
+    {
+      char c = line[pos];
+      if ('\t' == c)
+        {
+          fields.emplace_back();
+          continue;
+        }
+      if ('\\' == c && pos + 1 < line.size())
+        {
+          c = line[++pos];
+          c = ('t' == c)? '\t' : ('n' == c)? '\n' : ('r' == c)? '\r' : c;
+        }
+      fields.back().push_back(c);
+    }
+}
+
+//decimal field, FALSE if it's not a number
+static bool ParseField(const std::string& field, long long& value)
+{
+  if (field.empty())
+    return false;
+  char* end = nullptr;
+  value = ::strtoll(field.c_str(), &end, 10);
+  return '\0' == *end;
+}
+
+//"P url status downloaded level fetchMs bytes N match1..N M link1..M"
+static bool ParsePage(const std::vector<std::string>& fields, CrawlCheckpoint::Page& page)
+{
+  static const size_t fixedFields = 8;
+  long long num[6], links = 0;
+  if (fields.size() < fixedFields + 1 || "P" != fields[0])
+    return false;
+  for(size_t idx = 0; idx < 6; ++idx)
+    {
+      if (!ParseField(fields[2 + idx], num[idx]))
+        return false;
+    }
+  long long matches = num[5];
+  if (matches < 0 || (size_t)matches >= fields.size() - fixedFields
+      || !ParseField(fields[fixedFields + matches], links)
+      || links < 0 || (size_t)links != fields.size() - fixedFields - matches - 1)
+    return false;
+  PageRecord& rec(page.rec);
+  rec.url = fields[1];
+  rec.responseCode = (long)num[0];
+  rec.downloaded = 0 != num[1];
+  rec.level = (unsigned)num[2];
+  rec.fetchMs = (unsigned)num[3];
+  rec.pageBytes = (uint64_t)num[4];
+  rec.matches.assign(fields.begin() + fixedFields, fields.begin() + fixedFields + matches);
+  page.links.assign(fields.begin() + fixedFields + matches + 1, fields.end());
+  return true;
+}
+//---------------------------------------------------------------
+CrawlCheckpoint::CrawlCheckpoint(const std::string& path, unsigned flushMs)
+  : d_path(path), d_flushPeriod(flushMs)
+{
+  d_lastFlush = std::chrono::steady_clock::now();
+}
+
+CrawlCheckpoint::~CrawlCheckpoint()
+{
+  try {
+    flush();
+  } catch(...)
+  { }
+}
+
+void CrawlCheckpoint::setResultsSink(std::shared_ptr<ResultsSink> sink)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  d_sink = sink;
+}
+
+bool CrawlCheckpoint::begin(const std::string& rootUrl, const std::string& grepRegex)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  d_file.close();
+  d_file.clear();
+  d_file.open(d_path, std::ios::out | std::ios::trunc | std::ios::binary);
+  d_buffer = checkpointMagic;
+  AppendField(d_buffer, checkpointVersion, sizeof(checkpointVersion) - 1);
+  AppendField(d_buffer, rootUrl);
+  AppendField(d_buffer, grepRegex);
+  d_buffer.push_back('\n');
+  return writeBuffer();
+}
+
+bool CrawlCheckpoint::reopen()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  d_file.close();
+  d_file.clear();
+  d_buffer.clear();
+  {//the line cut by the killed process is ended: it's skipped then
+    std::ifstream in(d_path, std::ios::binary);
+    char last = '\n';
+    if (in.seekg(-1, std::ios::end))
+      in.get(last);
+    if ('\n' != last)
+      d_buffer.push_back('\n');
+  }
+  d_file.open(d_path, std::ios::out | std::ios::app | std::ios::binary);
+  return writeBuffer();
+}
+
+bool CrawlCheckpoint::writePage(const PageRecord& rec, LinkedTask* task)
+{
+  std::string line("P");
+  AppendField(line, rec.url);
+  AppendNumber(line, (unsigned long long)std::abs(rec.responseCode), rec.responseCode < 0);
+  AppendNumber(line, rec.downloaded? 1 : 0);
+  AppendNumber(line, rec.level);
+  AppendNumber(line, rec.fetchMs);
+  AppendNumber(line, rec.pageBytes);
+  AppendNumber(line, rec.matches.size());
+  for(const std::string& match : rec.matches)
+    AppendField(line, match);
+
+  //the child level is spawned from this page only
+  std::string links;
+  size_t linksCount = 0;
+  for(LinkedTask* item = ItemLoadAcquire(task->child); nullptr != item; item = ItemLoadAcquire(item->next))
+    {
+      if (item->grepVars.targetUrl.empty())
+        continue;
+      AppendField(links, item->grepVars.targetUrl);
+      ++linksCount;
+    }
+  AppendNumber(line, linksCount);
+  line += links;
+  line.push_back('\n');
+
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  if (nullptr != d_sink && d_sink->closed())
+    return false;//the results are dropped: the page is downloaded again on resume
+  d_buffer += line;
+  if (std::chrono::steady_clock::now() - d_lastFlush < d_flushPeriod)
+    return true;
+  return writeBuffer();
+}
+
+bool CrawlCheckpoint::flush()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  return writeBuffer();
+}
+
+bool CrawlCheckpoint::writeBuffer()
+{
+  d_lastFlush = std::chrono::steady_clock::now();
+  if (!d_file.is_open())
+    return false;
+  if (!d_buffer.empty())
+    {
+      if (nullptr != d_sink)
+        d_sink->flush();
+      d_file.write(d_buffer.data(), d_buffer.size());
+      d_file.flush();
+      d_buffer.clear();
+    }
+  if (!d_file)
+    {
+      std::cerr << __FUNCTION__ << " can't write " << d_path << "\n";
+      return false;
+    }
+  return true;
+}
+//---------------------------------------------------------------
+bool CrawlCheckpoint::Load(const std::string& path, State& state)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  std::string line;
+  std::vector<std::string> fields;
+  if (!std::getline(in, line))
+    return false;
+  SplitFields(line, fields);
+  if (4 != fields.size() || checkpointMagic != fields[0] || checkpointVersion != fields[1])
+    return false;
+  state.rootUrl = fields[2];
+  state.grepRegex = fields[3];
+  state.pages.clear();
+
+  Page page;
+  while(std::getline(in, line))
+    {
+      if (in.eof())
+        break;//the last line is cut
+      SplitFields(line, fields);
+      if (!ParsePage(fields, page))
+        continue;
+      std::string url = page.rec.url;
+      state.pages[url] = std::move(page);
+    }
+  return true;
+}
+
+//the finished page's results, the matched text is kept in the page's content
+static void ApplyPage(LinkedTask* node, const PageRecord& rec)
+{
+  GrepVars& g(node->grepVars);
+  g.responseCode = rec.responseCode;
+  g.fetchMs = rec.fetchMs;
+  g.pageContent.clear();
+  std::vector<std::pair<size_t, size_t>> spans;
+  for(const std::string& match : rec.matches)
+    {
+      spans.push_back(std::make_pair(g.pageContent.size(), match.size()));
+      g.pageContent += match;
+      g.pageContent.push_back('\n');
+    }
+  g.matchURLVector.clear();
+  g.matchTextVector.clear();
+  for(const std::pair<size_t, size_t>& span : spans)
+    {
+      auto begin = g.pageContent.cbegin() + span.first;
+      g.matchTextVector.push_back(GrepVars::CIteratorPair(begin, begin + span.second));
+    }
+  g.pageIsReady = rec.downloaded;
+  g.pageIsParsed = true;
+}
+
+size_t CrawlCheckpoint::Restore(const State& state, LinkedTask* root, std::vector<LinkedTask*>& pending)
+{
+  pending.clear();
+  if (nullptr == root)
+    return 0;
+  root->grepVars.targetUrl = state.rootUrl;
+  std::unordered_set<std::string> seen;
+  seen.insert(state.rootUrl);
+  if (nullptr != root->visitedSet)
+    root->visitedSet->insert(state.rootUrl);
+
+  size_t restored = 0;
+  std::deque<LinkedTask*> levels;
+  levels.push_back(root);
+  for(; !levels.empty(); levels.pop_front())
+    {
+      LinkedTask* node = levels.front();
+      auto found = state.pages.find(node->grepVars.targetUrl);
+      if (state.pages.end() == found)
+        {//spawned, not downloaded yet
+          if (root != node)
+            pending.push_back(node);
+          continue;
+        }
+      ApplyPage(node, found->second.rec);
+
+      LinkedTask* head = nullptr;
+      for(const std::string& link : found->second.links)
+        {
+          if (!seen.insert(link).second)
+            continue;
+          if (nullptr != root->visitedSet)
+            root->visitedSet->insert(link);
+          LinkedTask* item = nullptr;
+          if (nullptr == head)
+            {
+              LinkedTask* old = nullptr;
+              head = item = node->spawnChildNode(old); RetireList(old);
+            }
+          else if (1 == head->spawnNextNodes(1))
+            {
+              item = head->getLastOnLevel();
+            }
+          if (nullptr == item)
+            break;//maximum nodes count reached
+          item->grepVars.targetUrl = link;
+          levels.push_back(item);
+          ++restored;
+        }
+    }
+  return restored;
+}
+
+}//WebGrep
@@ -0,0 +1,93 @@
+#ifndef CRAWL_CHECKPOINT_H
+#define CRAWL_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+#include "noncopyable.hpp"
+#include "results_sink.h"
+
+namespace WebGrep {
+
+class LinkedTask;
+
+/** Append-only journal of a crawl to resume it after the process is restarted.
+ *  The file starts with the crawl's first URL and the text expression,
+ *  then each finished page adds a line: it's results (PageRecord) and the links spawned from it.
+ *  The tree is rebuilt from the first page by these links: the pages that have a record
+ *  are finished, the others are waiting to be downloaded (the frontier), all of them are visited
+ *  and counted by the links' limit.
+ *
+ *  The lines are buffered and written at most (flushMs) apart, flush() writes them at once.
+ *  A line cut by the killed process is skipped by Load(), the pages that were downloading
+ *  are downloaded again. Thread-safe, I/O errors are reported by FALSE.
+*/
+class CrawlCheckpoint : public WebGrep::noncopyable
+{
+public:
+  /** A finished page as it's read from the file.*/
+  struct Page
+  {
+    PageRecord rec;
+    std::vector<std::string> links;
+  };
+
+  /** The file's contents, the latest record of a page is kept.*/
+  struct State
+  {
+    std::string rootUrl, grepRegex;
+    std::unordered_map<std::string, Page> pages;
+  };
+
+  explicit CrawlCheckpoint(const std::string& path, unsigned flushMs = 1000);
+  ~CrawlCheckpoint();
+
+  const std::string& path() const { return d_path; }
+
+  /** Flush (sink) before the records are written: a resumed crawl doesn't lose
+   *  the results of the pages it won't download again. The pages are not recorded
+   *  after the sink is closed. NULL by default.*/
+  void setResultsSink(std::shared_ptr<ResultsSink> sink);
+
+  /** Truncate the file and write the header of a new crawl.*/
+  bool begin(const std::string& rootUrl, const std::string& grepRegex);
+
+  /** Open the file of the crawl being resumed, the records are appended.*/
+  bool reopen();
+
+  /** Record the finished page (task) and the URLs of it's child level.*/
+  bool writePage(const PageRecord& rec, LinkedTask* task);
+
+  /** Write the buffered records to the file.*/
+  bool flush();
+
+  /** Read the crawl's records from (path).
+   *  @return FALSE if the file is missing or it's not a checkpoint.*/
+  static bool Load(const std::string& path, State& state);
+
+  /** Rebuild the tree of (root) from (state): the finished pages get their results
+   *  (pageContent holds the matched text only, matchTextVector points there),
+   *  their links become the child levels. The URLs are inserted to root->visitedSet.
+   *  @param pending: the spawned nodes that are not finished, in the order of the tree levels.
+   *  @return count of the links restored, (root) is not counted.*/
+  static size_t Restore(const State& state, LinkedTask* root, std::vector<LinkedTask*>& pending);
+
+protected:
+  bool writeBuffer();//< called with (mu) locked
+
+  std::mutex mu;
+  std::string d_path;
+  std::ofstream d_file;
+  std::string d_buffer;
+  std::shared_ptr<ResultsSink> d_sink;
+  std::chrono::milliseconds d_flushPeriod;
+  std::chrono::steady_clock::time_point d_lastFlush;
+};
+
+}//WebGrep
+
+#endif // CRAWL_CHECKPOINT_H
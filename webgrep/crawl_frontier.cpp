@@ -0,0 +1,412 @@
+#include "crawl_frontier.h"
+#include "linked_task.h"
+#include <algorithm>
+
+namespace WebGrep {
+
+bool CrawlFrontier::Before::operator()(const FrontierItem& a, const FrontierItem& b) const
+{
+  if (FrontierPolicy::DFS == policy)
+    {
+      if (a.level != b.level)
+        return a.level < b.level;
+      return a.seq < b.seq;
+    }
+  if (FrontierPolicy::BEST_FIRST == policy && a.score != b.score)
+    {
+      return a.score < b.score;
+    }
+  //BFS, the equal scores of BEST_FIRST
+  if (a.level != b.level)
+    return a.level > b.level;
+  return a.seq > b.seq;
+}
+
+CrawlFrontier::CrawlFrontier(FrontierPolicy policy)
+  : seqCounter(0), itemsCount(0), slotLink(std::make_shared<SlotLink>()),
+    pumpFunc(nullptr), timer(std::make_shared<PumpTimer>())
+{
+  slotLink->owner = this;
+  before.policy = policy;
+  scorer = &CrawlFrontier::DefaultScore;
+  owedPumps.store(0);
+}
+
+CrawlFrontier::~CrawlFrontier()
+{
+  {
+    std::lock_guard<std::recursive_mutex> lk(slotLink->mu); (void)lk;
+    slotLink->owner = nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lk(timer->mu); (void)lk;
+    timer->stopping = true;
+    timer->cond.notify_all();
+  }
+  if (!timer->thread.joinable())
+    return;
+  if (std::this_thread::get_id() == timer->thread.get_id())
+    timer->thread.detach();//< released by the fired pump's context
+  else
+    timer->thread.join();
+}
+
+void CrawlFrontier::setPolicy(FrontierPolicy policy)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  if (policy == before.policy)
+    return;
+  before.policy = policy;
+  ready.clear();
+  for(auto& entry : hosts)
+    {
+      HostQueue& hq(entry.second);
+      std::make_heap(hq.items.begin(), hq.items.end(), before);
+      if (!hq.parked)
+        pushReady(hq.items.front());
+    }
+}
+
+FrontierPolicy CrawlFrontier::policy()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  return before.policy;
+}
+
+void CrawlFrontier::setScorer(ScoreFunc_t func)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  scorer = (nullptr == func)? ScoreFunc_t(&CrawlFrontier::DefaultScore) : func;
+}
+
+double CrawlFrontier::DefaultScore(const std::string& url, unsigned level)
+{
+  size_t pathPos = FindURLAddressBegin(url.data(), url.size());
+  pathPos = (pathPos >= url.size())? 0 : pathPos;
+  pathPos = url.find('/', pathPos);
+  double score = 0.0;
+  if (std::string::npos != pathPos)
+    {//each directory of the path
+      score -= (double)std::count(url.begin() + pathPos + 1, url.end(), '/');
+    }
+  if (std::string::npos != url.find('?'))
+    score -= 2.0;
+  score -= (double)url.size() / 64.0;
+  score -= 0.5 * (double)level;
+  return score;
+}
+
+void CrawlFrontier::push(LinkedTask* node, bool (*method)(LinkedTask*, WorkerCtx&),
+                         const std::shared_ptr<const WorkerCtx>& ctx)
+{
+  FrontierItem item;
+  item.node = node;
+  item.method = method;
+  item.ctx = ctx;
+  item.level = node->level;
+  item.host = ExtractHostPortHttp(node->grepVars.targetUrl);
+
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  item.score = scorer(node->grepVars.targetUrl, item.level);
+  item.seq = seqCounter++;
+  uint64_t seq = item.seq;
+  HostQueue& hq(hosts[item.host]);
+  hq.items.push_back(std::move(item));
+  std::push_heap(hq.items.begin(), hq.items.end(), before);
+  ++itemsCount;
+  if (!hq.parked && seq == hq.items.front().seq)
+    pushReady(hq.items.front());//< the host's best item has changed
+}
+
+void CrawlFrontier::pushReady(const FrontierItem& top)
+{
+  FrontierItem key;
+  key.host = top.host;
+  key.level = top.level;
+  key.score = top.score;
+  key.seq = top.seq;
+  ready.push_back(std::move(key));
+  std::push_heap(ready.begin(), ready.end(), before);
+}
+
+void CrawlFrontier::park(HostQueue& hq, const std::string& host, Clock_t::time_point until)
+{
+  hq.parked = true;
+  FrontierItem key;
+  key.host = host;
+  key.readyAt = until;
+  parked.push_back(std::move(key));
+  std::push_heap(parked.begin(), parked.end(), ReadyLater());
+}
+
+void CrawlFrontier::unparkReady(Clock_t::time_point now)
+{
+  while(!parked.empty() && parked.front().readyAt <= now)
+    {
+      std::pop_heap(parked.begin(), parked.end(), ReadyLater());
+      auto found = hosts.find(parked.back().host);
+      parked.pop_back();
+      if (hosts.end() == found || !found->second.parked)
+        continue;
+      found->second.parked = false;
+      pushReady(found->second.items.front());
+    }
+}
+
+bool CrawlFrontier::pop(FrontierItem& item, Clock_t::time_point& waitUntil)
+{
+  Clock_t::time_point now = Clock_t::now();
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  return popLocked(item, now, waitUntil);
+}
+
+bool CrawlFrontier::popOrWait(FrontierItem& item, PumpFunc_t pump)
+{
+  Clock_t::time_point now = Clock_t::now();
+  Clock_t::time_point waitUntil;
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  pumpFunc = pump;
+  if (popLocked(item, now, waitUntil))
+    return true;
+  if (0 == itemsCount)
+    return false;
+  //the parked items get this pump back from the timer
+  owedPumps.fetch_add(1);
+  if (Clock_t::time_point::max() != waitUntil)
+    armTimer(waitUntil);
+  return false;
+}
+
+bool CrawlFrontier::takeOwedPump()
+{
+  size_t owed = owedPumps.load();
+  while(0 != owed)
+    {
+      if (owedPumps.compare_exchange_weak(owed, owed - 1))
+        return true;
+    }
+  return false;
+}
+
+void CrawlFrontier::armTimer(Clock_t::time_point when)
+{
+  std::lock_guard<std::mutex> lk(timer->mu); (void)lk;
+  if (timer->stopping || when >= timer->deadline)
+    return;
+  timer->deadline = when;
+  if (!timer->thread.joinable())
+    timer->thread = std::thread(&CrawlFrontier::TimerLoop, timer, this);
+  else
+    timer->cond.notify_all();
+}
+
+void CrawlFrontier::TimerLoop(std::shared_ptr<PumpTimer> timer, CrawlFrontier* owner)
+{
+  std::unique_lock<std::mutex> lk(timer->mu);
+  while(!timer->stopping)
+    {
+      if (Clock_t::time_point::max() == timer->deadline)
+        {
+          timer->cond.wait(lk);
+          continue;
+        }
+      if (Clock_t::now() < timer->deadline)
+        {
+          timer->cond.wait_until(lk, timer->deadline);
+          continue;
+        }
+      timer->deadline = Clock_t::time_point::max();
+      lk.unlock();
+      //the destructor waits for it or, if it's called from here, sets (stopping)
+      owner->wakeOwed();
+      lk.lock();
+    }
+}
+
+void CrawlFrontier::wakeOwed()
+{
+  //declared first to be released last: it may hold the last reference to the frontier
+  std::shared_ptr<const WorkerCtx> ctx;
+  PumpFunc_t pump = nullptr;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    if (nullptr == pumpFunc || hosts.empty() || !takeOwedPump())
+      return;
+    auto found = parked.empty()? hosts.end() : hosts.find(parked.front().host);
+    if (hosts.end() == found)
+      found = hosts.begin();
+    ctx = found->second.items.front().ctx;
+    pump = pumpFunc;
+  }
+  pump(ctx);
+}
+
+bool CrawlFrontier::popLocked(FrontierItem& item, Clock_t::time_point now, Clock_t::time_point& waitUntil)
+{
+  unparkReady(now);
+  while(!ready.empty())
+    {
+      std::pop_heap(ready.begin(), ready.end(), before);
+      const FrontierItem& key(ready.back());
+      auto found = hosts.find(key.host);
+      if (hosts.end() == found || found->second.parked || key.seq != found->second.items.front().seq)
+        {//the item is taken already or the host is parked
+          ready.pop_back();
+          continue;
+        }
+      ready.pop_back();
+      HostQueue& hq(found->second);
+      const std::string& host(found->first);
+      auto delay = hostDelays.find(host);
+      if (hostDelays.end() != delay && delay->second > now)
+        {//the host isn't ready: wait in the parking
+          park(hq, host, delay->second);
+          continue;
+        }
+      if (hostDelays.end() != delay)
+        hostDelays.erase(delay);
+      if (0 != heldHosts.count(host))
+        {//no key in (parked): releaseHost() brings the host back
+          hq.parked = hq.held = true;
+          continue;
+        }
+      bool acquired = false;
+      if (nullptr != scheduler)
+        {
+          Clock_t::time_point readyAt;
+          if (!scheduler->tryAcquire(host, readyAt))
+            {//rate limit or a backoff: parked by time
+              if (Clock_t::time_point::max() != readyAt)
+                park(hq, host, readyAt);
+              else//too many requests in flight: no key in (parked), hostSlotFreed() brings it back
+                hq.parked = hq.held = true;
+              continue;
+            }
+          acquired = true;
+        }
+      std::pop_heap(hq.items.begin(), hq.items.end(), before);
+      item = std::move(hq.items.back());
+      item.hostAcquired = acquired;
+      hq.items.pop_back();
+      --itemsCount;
+      if (hq.items.empty())
+        hosts.erase(found);
+      else
+        pushReady(hq.items.front());
+      return true;
+    }
+  waitUntil = parked.empty()? Clock_t::time_point::max() : parked.front().readyAt;
+  return false;
+}
+
+void CrawlFrontier::setHostScheduler(std::shared_ptr<HostScheduler> sched)
+{
+  std::shared_ptr<HostScheduler> prev;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    prev = scheduler;
+    scheduler = sched;
+  }
+  //out of the lock: the scheduler calls the frontier under no lock of it's own
+  if (nullptr != prev && prev != sched)
+    prev->setSlotFreedFunc(nullptr);
+  if (nullptr == sched)
+    return;
+  std::shared_ptr<SlotLink> link(slotLink);
+  sched->setSlotFreedFunc([link](const std::string& host)
+  {
+    std::lock_guard<std::recursive_mutex> lk(link->mu); (void)lk;
+    if (nullptr != link->owner)
+      link->owner->hostSlotFreed(host);
+  });
+}
+
+std::shared_ptr<HostScheduler> CrawlFrontier::hostScheduler()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  return scheduler;
+}
+
+void CrawlFrontier::delayHost(const std::string& host, Clock_t::time_point until)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  Clock_t::time_point& t(hostDelays[host]);
+  t = std::max(t, until);
+}
+
+void CrawlFrontier::holdHost(const std::string& host)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  heldHosts.insert(host);
+}
+
+bool CrawlFrontier::unholdLocked(const std::string& host)
+{
+  auto found = hosts.find(host);
+  if (hosts.end() == found || !found->second.held)
+    return false;
+  found->second.parked = found->second.held = false;
+  pushReady(found->second.items.front());
+  return true;
+}
+
+void CrawlFrontier::releaseHost(const std::string& host)
+{
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    if (0 == heldHosts.erase(host) || !unholdLocked(host))
+      return;
+  }
+  //the pumps of the held items have come back empty
+  wakeOwed();
+}
+
+void CrawlFrontier::hostSlotFreed(const std::string& host)
+{
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    if (0 != heldHosts.count(host) || !unholdLocked(host))
+      return;//< releaseHost() brings it back
+  }
+  wakeOwed();
+}
+
+void CrawlFrontier::clear()
+{
+  std::unordered_map<std::string, HostQueue> h;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    h.swap(hosts);
+    ready.clear();
+    parked.clear();
+    hostDelays.clear();
+    heldHosts.clear();
+    itemsCount = 0;
+    owedPumps.store(0);
+  }
+  //the contexts are released out of the lock
+}
+
+size_t CrawlFrontier::size()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  return itemsCount;
+}
+
+size_t CrawlFrontier::parkedCount()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  size_t cnt = 0;
+  for(const FrontierItem& key : parked)
+    {
+      auto found = hosts.find(key.host);
+      cnt += (hosts.end() == found)? 0 : found->second.items.size();
+    }
+  for(const auto& entry : hosts)
+    {
+      cnt += entry.second.held? entry.second.items.size() : 0;
+    }
+  return cnt;
+}
+
+}//WebGrep
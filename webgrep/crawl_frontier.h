@@ -0,0 +1,211 @@
+#ifndef CRAWL_FRONTIER_H
+#define CRAWL_FRONTIER_H
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include "noncopyable.hpp"
+#include "host_scheduler.h"
+
+namespace WebGrep {
+
+class LinkedTask;
+class WorkerCtx;
+
+/** Order of the pages to be downloaded.*/
+enum class FrontierPolicy
+{
+  BFS,        //< shallow levels first, then in the order of discovery
+  DFS,        //< the deepest level first, the last discovered first
+  BEST_FIRST  //< the highest URL score first, then the shallow levels
+};
+
+/** A page waiting in the frontier: the node and what to do with it.*/
+struct FrontierItem
+{
+  FrontierItem() : node(nullptr), method(nullptr), level(0), score(0.0), seq(0), hostAcquired(false) { }
+
+  LinkedTask* node;
+  bool (*method)(LinkedTask*, WorkerCtx&);
+  std::shared_ptr<const WorkerCtx> ctx;//< keeps the branch pinned (WorkerCtx::treePin)
+
+  std::string host;//< "site.com:443"
+  unsigned level;
+  double score;
+  uint64_t seq;    //< order of push()
+  std::chrono::steady_clock::time_point readyAt;//< when parked: the host's delay
+  bool hostAcquired;//< pop() has taken a slot of the HostScheduler for (host)
+};
+
+/** Priority queue of the discovered pages between the parser and the workers' pool.
+ *  The items are ordered by the policy (level, URL score, order of discovery),
+ *  the items of a host that is delayed by delayHost() or refused by the HostScheduler
+ *  are parked until it's ready.
+ *
+ *  Each host has it's own heap of items, the best item of each ready host is in the heap
+ *  of the hosts; a delayed host is parked as a whole -- by one entry, it's items stay in place.
+ *  Thread-safe: the heaps are under a mutex, push() and pop() are O(log N)
+ *  and short, the tasks are executed out of the lock.
+*/
+class CrawlFrontier : public WebGrep::noncopyable
+{
+public:
+  typedef std::chrono::steady_clock Clock_t;
+  /** @return greater value for the pages to be downloaded first by BEST_FIRST.*/
+  typedef std::function<double(const std::string& url, unsigned level)> ScoreFunc_t;
+  /** Queues a pump of the frontier to the workers' pool and returns, see popOrWait().
+   *  It must not run the pump: it's called from the frontier's timer thread and by releaseHost().*/
+  typedef void (*PumpFunc_t)(const std::shared_ptr<const WorkerCtx>& ctx);
+
+  explicit CrawlFrontier(FrontierPolicy policy = FrontierPolicy::BFS);
+  //stops the timer of the delayed pump
+  ~CrawlFrontier();
+
+  /** Change the order, the waiting items are reordered.*/
+  void setPolicy(FrontierPolicy policy);
+  FrontierPolicy policy();
+
+  /** NULL sets DefaultScore().*/
+  void setScorer(ScoreFunc_t func);
+
+  /** Prefer short paths to the site's pages: penalties for the path depth,
+   *  the query string and the length of the URL.*/
+  static double DefaultScore(const std::string& url, unsigned level);
+
+  /** Queue (node) to be run by (method) with (ctx). Possible exceptions: bad_alloc.*/
+  void push(LinkedTask* node, bool (*method)(LinkedTask*, WorkerCtx&),
+            const std::shared_ptr<const WorkerCtx>& ctx);
+
+  /** Consult (scheduler) before giving an item, NULL disables the per-host limits.
+   *  A host refused by the limit of requests in flight is parked until the scheduler
+   *  reports it's free slot, then an owed pump is scheduled as by releaseHost().*/
+  void setHostScheduler(std::shared_ptr<HostScheduler> scheduler);
+  std::shared_ptr<HostScheduler> hostScheduler();
+
+  /** Take the best item of the ready hosts.
+   *  With a HostScheduler the item's slot is taken (FrontierItem::hostAcquired)
+   *  and must be released by HostScheduler::release().
+   * @param waitUntil: when FALSE is returned -- the time the first parked item gets ready,
+   *  or Clock_t::time_point::max() if the frontier is empty or it's items wait for the slots
+   *  of the HostScheduler or releaseHost().
+   * @return FALSE if there is no ready item. */
+  bool pop(FrontierItem& item, Clock_t::time_point& waitUntil);
+
+  /** pop() for the pumps run by the workers' pool, one pump is scheduled per push().
+   *  A pump that finds no ready item leaves it's turn to the parked items and returns:
+   *  one timer of the frontier is re-armed for the first parked item, when it's ready
+   *  the timer's thread schedules a pump by (pump) with an item's context. Nothing sleeps in the pool.
+   * @return FALSE if there is no ready item. */
+  bool popOrWait(FrontierItem& item, PumpFunc_t pump);
+
+  /** After popOrWait() has given an item: TRUE if the pumps of the parked items are owed,
+   *  the caller schedules one more pump then -- the woken pumps are chained one by one.*/
+  bool takeOwedPump();
+
+  /** Don't give the items of (host) until (until). */
+  void delayHost(const std::string& host, Clock_t::time_point until);
+
+  /** Don't give the items of (host) until releaseHost(): e.g. it's robots.txt is downloading.*/
+  void holdHost(const std::string& host);
+  /** The items of the held (host) are ready again, an owed pump is scheduled for them:
+   *  it's queued to the pool, never run by the caller -- e.g. a page task that has stored robots.txt.*/
+  void releaseHost(const std::string& host);
+
+  //drop all items, e.g. on new crawl
+  void clear();
+
+  size_t size();       //< all items
+  size_t parkedCount();//< items of the delayed and the held hosts
+
+protected:
+  struct Before
+  {
+    FrontierPolicy policy;
+    //TRUE if (a) goes after (b): std heap keeps the "greatest" on the top
+    bool operator()(const FrontierItem& a, const FrontierItem& b) const;
+  };
+  struct ReadyLater
+  {
+    bool operator()(const FrontierItem& a, const FrontierItem& b) const
+    { return a.readyAt > b.readyAt; }
+  };
+
+  /** Items of a host, the best one represents the host in (ready).*/
+  struct HostQueue
+  {
+    HostQueue() : parked(false), held(false) { }
+    std::vector<FrontierItem> items;//< heap by (before)
+    bool parked;//< waits in (parked) for the host's delay or the HostScheduler
+    bool held;  //< parked by holdHost() or until a slot is free, it has no key in (parked)
+  };
+
+  /** The link of the HostScheduler's notifications to the frontier: they may come
+   *  from any thread, the destructor cuts the link.*/
+  struct SlotLink
+  {
+    SlotLink() : owner(nullptr) { }
+
+    std::recursive_mutex mu;//< the notified frontier may be released by the call
+    CrawlFrontier* owner;
+  };
+
+  /** The timer of the delayed pump. It's thread keeps it alive: the frontier
+   *  may be released by the context of the pump that the timer has fired.*/
+  struct PumpTimer
+  {
+    PumpTimer() : deadline(Clock_t::time_point::max()), stopping(false) { }
+
+    std::mutex mu;
+    std::condition_variable cond;
+    Clock_t::time_point deadline;//< max if not armed
+    bool stopping;
+    std::thread thread;
+  };
+
+  //put the key of the host's best item to (ready), the keys have no node and context
+  void pushReady(const FrontierItem& top);
+  void park(HostQueue& hq, const std::string& host, Clock_t::time_point until);
+  void unparkReady(Clock_t::time_point now);
+  bool popLocked(FrontierItem& item, Clock_t::time_point now, Clock_t::time_point& waitUntil);
+
+  void armTimer(Clock_t::time_point when);
+  static void TimerLoop(std::shared_ptr<PumpTimer> timer, CrawlFrontier* owner);
+  //schedule one owed pump by (pumpFunc), the call may release the frontier
+  void wakeOwed();
+  //the held (host) is ready again: TRUE if it's brought back to (ready)
+  bool unholdLocked(const std::string& host);
+  //HostScheduler::SlotFreedFunc_t: the host isn't held by holdHost() -- unpark it
+  void hostSlotFreed(const std::string& host);
+
+  std::mutex mu;
+  Before before;
+  ScoreFunc_t scorer;
+  uint64_t seqCounter;
+  size_t itemsCount;
+  std::unordered_map<std::string, HostQueue> hosts;
+  /** Heap by (before) of the ready hosts' best items: the host's best item is checked by (seq),
+   *  the keys left by the items that are taken or parked are skipped.*/
+  std::vector<FrontierItem> ready;
+  std::vector<FrontierItem> parked;//< heap by (readyAt), one key per parked host
+  std::unordered_map<std::string, Clock_t::time_point> hostDelays;
+  std::unordered_set<std::string> heldHosts;
+  std::shared_ptr<HostScheduler> scheduler;
+  std::shared_ptr<SlotLink> slotLink;
+
+  PumpFunc_t pumpFunc;//< set by popOrWait()
+  std::atomic<size_t> owedPumps;//< the pumps that have found no ready item
+  std::shared_ptr<PumpTimer> timer;
+};
+
+}//WebGrep
+
+#endif // CRAWL_FRONTIER_H
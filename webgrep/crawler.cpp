@@ -20,6 +20,11 @@ void Crawler::setLevelSpawnedCB(OnPageScannedCallback_t func)
   pv->onLevelSpawned = func;
 }
 
+void Crawler::setPageParsedCB(OnPageScannedCallback_t func)
+{
+  pv->onSingleNodeScanned = func;
+}
+
 Crawler::Crawler()
 {
   pv = std::make_shared<CrawlerPV>();
@@ -33,7 +38,7 @@ void Crawler::clear()
 std::shared_ptr<LinkedTask> Crawler::start
   (const std::string& url,
    const std::string& grepRegex,
-   unsigned maxLinks, unsigned threadsNum)
+   unsigned maxLinks, unsigned threadsNum, FrontierPolicy policy, bool resume)
 {
   //----------------------------------------------------------------
   // These functors are set in a way that binds them to reference-counted
@@ -46,10 +51,15 @@ std::shared_ptr<LinkedTask> Crawler::start
   //----------------------------------------------------------------
 
   std::shared_ptr<LinkedTask> mainTask;
+  //the restored nodes to be downloaded
+  std::vector<LinkedTask*> pending;
 
   try {
     setMaxLinks(maxLinks);
-    if (nullptr == pv->taskRoot || pv->taskRoot->grepVars.targetUrl != url
+    pv->frontier->setPolicy(policy);
+    //compiled once, the nodes share it
+    std::shared_ptr<const GrepEngine> engine = GrepEngine::Create(grepRegex, pv->grepEngineKind);
+    if (resume || nullptr == pv->taskRoot || pv->taskRoot->grepVars.targetUrl != url
         || pv->taskRoot->grepVars.matchURLVector.empty() )
       {
         //alloc toplevel node:
@@ -57,25 +67,61 @@ std::shared_ptr<LinkedTask> Crawler::start
         pv->currentLinksCount->store(0);
         mainTask->linksCounterPtr = (pv->currentLinksCount);
         mainTask->maxLinksCountPtr = (pv->maxLinksCount);
+        mainTask->visitedSet = std::make_shared<VisitedSet>();
+        mainTask->grepVars.grepEngine = engine;
+        if (pv->obeyRobots)
+          mainTask->robotsCache = std::make_shared<RobotsCache>(pv->hostScheduler);
+        if (resume)
+          pv->restoreCheckpoint(mainTask, url, grepRegex, pending);
+        //the budget goes on from the restored links' count
+        mainTask->linksBudget = std::make_shared<LinkBudget>(pv->currentLinksCount, pv->maxLinksCount);
+        for(LinkedTask* item : pending)
+          item->linksBudget = mainTask->linksBudget;
+        //without the first page it's a new crawl
+        resume = mainTask->grepVars.pageIsParsed;
+        pv->checkpoint.reset();
+        if (!pv->checkpointPath.empty())
+          {
+            pv->checkpoint = std::make_shared<CrawlCheckpoint>(pv->checkpointPath, pv->checkpointFlushMs);
+            pv->checkpoint->setResultsSink(pv->resultsSink);
+            bool opened = resume? pv->checkpoint->reopen() : pv->checkpoint->begin(url, grepRegex);
+            if (!opened)
+              throw std::runtime_error("Can't write the checkpoint " + pv->checkpointPath);
+          }
       }
     else
       {
         mainTask = pv->taskRoot;
+        resume = false;
       }
 
     GrepVars* g = &(mainTask->grepVars);
     g->targetUrl = url;
-    g->grepExpr = grepRegex;
+    g->grepEngine = engine;
+    if (nullptr != mainTask->visitedSet)
+      mainTask->visitedSet->insert(url);
 
     //submit a root-task:
     //get the first page and then follow it's content's links in new threads.
     //It is to be done async. to avoid GUI lags etc.
-    std::thread launcher(
-          [crawlerImpl, threadsNum, mainTask]()
-    { /*async start.*/
-        crawlerImpl->start(mainTask, threadsNum);
-    } );
-    launcher.detach();
+    //waitIdle() is not satisfied until the launcher is done
+    crawlerImpl->launching.fetch_add(1);
+    try {
+      std::thread launcher(
+            [crawlerImpl, threadsNum, mainTask, resume, pending]()
+      { /*async start.*/
+          if (resume)
+            crawlerImpl->resume(mainTask, pending, threadsNum);
+          else
+            crawlerImpl->start(mainTask, threadsNum);
+          crawlerImpl->launching.fetch_sub(1);
+      } );
+      launcher.detach();
+    } catch(...)
+    {
+      crawlerImpl->launching.fetch_sub(1);
+      throw;
+    }
   } catch(const std::exception& ex)
   {
     std::cerr << ex.what() << "\n";
@@ -91,6 +137,102 @@ void Crawler::stop()
   pv->stop();
 }
 
+bool Crawler::waitIdle(unsigned timeoutMs)
+{
+  return pv->waitIdle(timeoutMs);
+}
+
+void Crawler::setGrepEngine(GrepEngineKind kind)
+{
+  pv->grepEngineKind = kind;
+}
+
+void Crawler::setMaxPageSize(size_t maxBytes)
+{
+  pv->maxPageBytes = maxBytes;
+#ifdef WITH_CURL_MULTI
+  if (nullptr != pv->fetchEngine)
+    pv->fetchEngine->setMaxBodyBytes(maxBytes);
+#endif
+}
+
+bool Crawler::setCacheDir(const std::string& dir)
+{
+  try {
+    if (dir.empty())
+      {
+        pv->pageCache.reset();
+        return true;
+      }
+    std::shared_ptr<PageCache> cache = std::make_shared<PageCache>(dir);
+    if (!cache->valid())
+      return false;
+    pv->pageCache = cache;
+  } catch(const std::exception& ex)
+  {
+    std::cerr << ex.what() << "\n";
+    if(pv->onException) { pv->onException(ex.what()); }
+    return false;
+  }
+  return true;
+}
+
+void Crawler::setResultsSink(std::shared_ptr<ResultsSink> sink, bool releasePages)
+{
+  pv->resultsSink = sink;
+  //nothing receives the pages without a sink, the tree keeps them
+  pv->releasePages = releasePages && nullptr != sink;
+}
+
+void Crawler::setCheckpoint(const std::string& path, unsigned flushMs)
+{
+  pv->checkpointPath = path;
+  pv->checkpointFlushMs = flushMs;
+}
+
+MetricsSnapshot Crawler::stats() const
+{
+  try {
+    return pv->metricsRegistry->snapshot();
+  } catch(const std::exception& ex)
+  {
+    std::cerr << ex.what() << "\n";
+    if(pv->onException) { pv->onException(ex.what()); }
+  }
+  return MetricsSnapshot();
+}
+
+bool Crawler::setMetricsFile(const std::string& path, unsigned periodMs)
+{
+  try {
+    //the previous writer writes the file once more when it's gone
+    pv->metricsWriter.reset();
+    if (!path.empty())
+      pv->metricsWriter = std::make_shared<MetricsFileWriter>(pv->metricsRegistry, path, periodMs);
+  } catch(const std::exception& ex)
+  {
+    std::cerr << ex.what() << "\n";
+    if(pv->onException) { pv->onException(ex.what()); }
+    return false;
+  }
+  return true;
+}
+
+void Crawler::setObeyRobots(bool obey)
+{
+  pv->obeyRobots = obey;
+}
+
+void Crawler::setUrlScorer(CrawlFrontier::ScoreFunc_t func)
+{
+  pv->frontier->setScorer(func);
+}
+
+void Crawler::setHostLimits(double requestsPerSec, unsigned burst, unsigned maxInFlight)
+{
+  pv->hostScheduler->setLimits(requestsPerSec, burst, maxInFlight);
+}
+
 void Crawler::setMaxLinks(unsigned maxScanLinks)
 {
   //sync with load(acquire)
@@ -105,6 +247,10 @@ void Crawler::setThreadsNumber(unsigned nthreads)
       return;
     }
   try {
+    //the running pool is resized in place, the tasks keep going;
+    //the stopped one is resumed by start()
+    if (!pv->workersPool->paused() && pv->workersPool->resize(nthreads))
+      return;
     pv->start(pv->taskRoot, nthreads);
 
   } catch(const std::exception& ex)
@@ -2,6 +2,12 @@
 #define CRAWLER_H
 
 #include <memory>
+#include <string>
+#include <functional>
+#include "grep_engine.h"
+#include "crawl_frontier.h"
+#include "results_sink.h"
+#include "metrics.h"
 
 namespace WebGrep {
 
@@ -31,20 +37,91 @@ public:
   /** set links count any time. */
   void setMaxLinks(unsigned maxScanLinks = 4096);
 
+  /** Choose the text search engine for the next start():
+   *  AUTOMATON (default) is a lazy DFA that falls back to std::regex for the syntax it lacks,
+   *  STD_REGEX reports the subgroups of the match as well. */
+  void setGrepEngine(GrepEngineKind kind);
+
+  /** Abort the downloads of the pages bigger than (maxBytes), 0 -- no limit (default 8MB).
+   *  The downloads of the responses that are not text/html (or xhtml, text/plain)
+   *  are aborted as soon as the headers come anyway. Applied to the next start(). */
+  void setMaxPageSize(size_t maxBytes);
+
+  /** Keep the downloaded pages in (dir) with their ETag/Last-Modified,
+   *  the next crawls download them by conditional GET and take them from there on 304 Not Modified.
+   *  An empty (dir) disables the cache. Applied to the next start().
+   *  @return FALSE if the directory can't be created. */
+  bool setCacheDir(const std::string& dir);
+
+  /** Write the results of each page to (sink) as soon as it's done (JsonLinesSink, BinaryRecordSink,
+   *  CallbackSink, see webgrep/results_sink.h), NULL disables it. Applied to the next start().
+   *  @param releasePages: drop the page's content and matches from the tree after that,
+   *  so the crawl's memory doesn't grow with the pages visited (the first page is kept).
+   *  The nodes keep their URLs and response codes. Ignored when (sink) is NULL. */
+  void setResultsSink(std::shared_ptr<ResultsSink> sink, bool releasePages = true);
+
+  /** Journal the crawl to (path) to resume it after a restart by start(..., resume = TRUE):
+   *  each finished page is appended with it's results and links, the writes are buffered
+   *  for (flushMs) at most and flushed by stop(). A new crawl truncates the file.
+   *  An empty (path) disables it. Applied to the next start(). See webgrep/crawl_checkpoint.h */
+  void setCheckpoint(const std::string& path, unsigned flushMs = 1000);
+
+  /** The metrics of the crawls made by this object: the histograms of the stages
+   *  "webgrep_connect_seconds", "webgrep_ttfb_seconds", "webgrep_download_seconds",
+   *  "webgrep_fetch_seconds", "webgrep_parse_seconds", "webgrep_grep_seconds",
+   *  "webgrep_queue_wait_seconds", "webgrep_task_seconds" and the counters of the pages,
+   *  bytes, matches and tasks ("webgrep_*_total"). See webgrep/metrics.h */
+  MetricsSnapshot stats() const;
+
+  /** Write the metrics to (path) in Prometheus text format every (periodMs),
+   *  the file is replaced at once. An empty (path) stops the writes, the file is written
+   *  once more then. @return FALSE on bad_alloc or if the thread can't be started.*/
+  bool setMetricsFile(const std::string& path, unsigned periodMs = 5000);
+
+  /** Follow robots.txt of the hosts (default TRUE) in the next start() of a new crawl:
+   *  the disallowed pages are not downloaded, Crawl-delay limits the host's rate
+   *  (see setHostLimits()). Each robots.txt is downloaded once per crawl.*/
+  void setObeyRobots(bool obey);
+
   /** Start recursive scanning of the URLs from given page
    * It will continue scanning from the last stop() point if the arguments
    * are the same as before.
    *
-   * @param grepRegex: boost.regex valid expression to grep the textual content.
+   * @param grepRegex: ECMAScript regular expression to grep the textual content,
+   * it's compiled by the engine chosen with setGrepEngine().
+   * @param policy: order of the pages' downloads, BFS gets the shallow pages first
+   *  that's what matters when (maxLinks) is less than the site's size.
+   * @param resume: rebuild the crawl of (url, grepRegex) from the checkpoint's file (setCheckpoint()):
+   *  the finished pages are not downloaded again, the rest of the spawned pages are scheduled,
+   *  the links' count goes on from the restored one. The restored pages keep the matched text only.
+   *  Fails (NULL) if the file is of another crawl; without the first page there it's a new crawl.
    * @return pointer to the root node of the tasks tree,
    *  it can be read concurrently while it's being updated in the crawler's threads.
 */
   std::shared_ptr<LinkedTask> start(const std::string& url,
                                     const std::string& grepRegex,
-                                    unsigned maxLinks = 4096, unsigned threadsNum = 4);
-
-  /** Halts the html pages crawler for a while.
-   *  Use clear() to clear the search results totally.*/
+                                    unsigned maxLinks = 4096, unsigned threadsNum = 4,
+                                    FrontierPolicy policy = FrontierPolicy::BFS,
+                                    bool resume = false);
+
+  /** Set the URL's score for FrontierPolicy::BEST_FIRST, NULL restores CrawlFrontier::DefaultScore.*/
+  void setUrlScorer(CrawlFrontier::ScoreFunc_t func);
+
+  /** Politeness to each host ("site.com:443"): not more than (requestsPerSec) with bursts
+   *  of (burst) requests and (maxInFlight) requests at once; 0 disables the limit.
+   *  The hosts answering 429 or 503 are left alone for a while (Retry-After or 1..64 seconds),
+   *  the workers go on with the other hosts. Applied immediately. */
+  void setHostLimits(double requestsPerSec = 10.0, unsigned burst = 10, unsigned maxInFlight = 6);
+
+  /** Block until the crawl is over: all pages are downloaded and parsed or the links limit is reached,
+   *  or stop() is called.
+   *  @param timeoutMs: 0 -- wait as long as it takes.
+   *  @return FALSE on timeout. */
+  bool waitIdle(unsigned timeoutMs = 0);
+
+  /** Halts the html pages crawler for a while: the threads park after their current pages,
+   *  the pages waiting for download are kept, start() with the same arguments goes on from there.
+   *  The downloads in flight are finished and queued. Use clear() to clear the search results totally.*/
   void stop();
 
   /** Clear the search results.*/
@@ -63,6 +140,11 @@ public:
   void setPageScannedCB(OnPageScannedCallback_t func);
   void setLevelSpawnedCB(OnPageScannedCallback_t func);
 
+  /** Invoked on each page after it's downloaded and parsed (node->grepVars.pageIsReady is FALSE
+   *  if the download has failed), in the crawler's threads: must be thread-safe.
+   *  The node's page and matches are complete at the moment. Applied to the next start(). */
+  void setPageParsedCB(OnPageScannedCallback_t func);
+
 private:
   std::shared_ptr<CrawlerPV> pv;
 };
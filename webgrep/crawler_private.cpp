@@ -25,23 +25,32 @@ bool CrawlerPV::selfTest() const
   return true;
 }
 //--------------------------------------------------------------
+void CrawlerPV::preparePool(const std::shared_ptr<LinkedTask>& neuRootTask, unsigned threadsNumber)
+{
+  if (neuRootTask.get() != taskRoot.get())
+    {//stop ASAP with tasks termination
+      workersPool->terminateDetach();
+      frontier->clear();
+    }
+
+  //set up workersPool if needed, a running pool is resized in place.
+  if (workersPool->closed())
+    {
+      workersPool.reset(new WebGrep::ThreadsPool(threadsNumber, true/*work stealing*/,
+                                               TPoolQueue::LOCKFREE_RING, metrics->poolProbes));
+    }
+  else if (workersPool->threadsCount() != threadsNumber)
+    {
+      workersPool->resize(threadsNumber);
+    }
+  //after stop() the tasks go on from their queues
+  workersPool->resume();
+}
+//--------------------------------------------------------------
 void CrawlerPV::start(std::shared_ptr<LinkedTask> neuRootTask, unsigned threadsNumber, bool forceRebuild)
 {
   try {
-    if (neuRootTask.get() != taskRoot.get())
-      {//stop ASAP with tasks termination
-        workersPool->terminateDetach();
-      }
-    else
-      {//stop temporarly, with tasks re-scheduling
-        stop();
-      }
-
-    //set up workersPool if needed.
-    if (workersPool->closed() || workersPool->threadsCount() != threadsNumber)
-      {
-        workersPool.reset(new WebGrep::ThreadsPool(threadsNumber));
-      }
+    preparePool(neuRootTask, threadsNumber);
 
     if(taskRoot == neuRootTask)
       { //submit previously abandoned tasks due to stop()
@@ -77,13 +86,15 @@ void CrawlerPV::start(std::shared_ptr<LinkedTask> neuRootTask, unsigned threadsN
     LinkedTask* expell = nullptr;
 
     //make a child node for new sequence of pages for download/grep
-    LinkedTask* child = taskRoot->spawnChildNode(expell); DeleteList(expell);
+    //the tasks of the previous crawl may still read the expelled nodes
+    LinkedTask* child = taskRoot->spawnChildNode(expell); RetireList(expell);
     size_t spawnedCnt = child->spawnGreppedSubtasks(worker.hostPort, taskRoot->grepVars, 0);
+    FuncFinishPage(taskRoot.get(), worker);
     std::cerr << "Root task: " << spawnedCnt << " spawned;\n";
     if (0 == spawnedCnt)
       {
-        WebGrep::DeleteList(child);
         taskRoot->child.store(0u);
+        WebGrep::RetireList(child);
         return;
       }
     //notify that root node is parsed:
@@ -92,7 +103,10 @@ void CrawlerPV::start(std::shared_ptr<LinkedTask> neuRootTask, unsigned threadsN
         onNodeListScanned(taskRoot, taskRoot.get());
       }
 
-    worker.childLevelSpawned(taskRoot,child);
+    if (worker.childLevelSpawned)
+      {
+        worker.childLevelSpawned(taskRoot,child);
+      }
     //we have grepped N URLs from the first page
     //ventillate them as subtasks:
     worker.scheduleBranchExec(child, &FuncDownloadGrepRecursive, 0 );
@@ -105,40 +119,68 @@ void CrawlerPV::start(std::shared_ptr<LinkedTask> neuRootTask, unsigned threadsN
 
 }
 //--------------------------------------------------------------
-void CrawlerPV::stop()
+void CrawlerPV::resume(std::shared_ptr<LinkedTask> neuRootTask, const std::vector<LinkedTask*>& pending,
+                       unsigned threadsNumber)
 {
-  auto this_shared = shared_from_this();
+  try {
+    preparePool(neuRootTask, threadsNumber);
+    taskRoot = neuRootTask;
+    if (nullptr == taskRoot)
+      return;
+    WorkerCtx worker = makeWorkerContext();
 
-  std::function<void(WebGrep::CallableDoubleFunc*, size_t)> exportFn =
-      [this_shared](WebGrep::CallableDoubleFunc* dfuncArray, size_t len)
-  {
-      std::lock_guard<std::mutex> lk(this_shared->slockLonelyFunctors);
-      (void)lk;
-      for(size_t c = 0; c < len; ++c)
-        {
-          this_shared->lonelyFunctorsVector.push_back(dfuncArray[c]);
-        }
-  };
-  //terminate the tasks manager and export abandoned tasks here:
-  auto workersCopy = workersPool;
-  std::thread waiter([workersCopy, exportFn](){
-      if (nullptr == workersCopy)
-        { return; }
-      try {
-        workersCopy->joinExportAll(exportFn);
-      } catch(...)
-      { std::cerr << "Error! Failed to join workers thread!\n";
+    //show the restored tree
+    if (onNodeListScanned)
+      {
+        onNodeListScanned(taskRoot, taskRoot.get());
       }
-    });
-  waiter.detach();
-
+    for(LinkedTask* item : PreOrder(taskRoot.get()))
+      {
+        LinkedTask* child = ItemLoadAcquire(item->child);
+        if (nullptr != child && worker.childLevelSpawned)
+          worker.childLevelSpawned(taskRoot, child);
+      }
+    std::cerr << "Resumed: " << pending.size() << " pages to download;\n";
+    worker.scheduleNodesExec(pending, &FuncDownloadGrepRecursive);
 
+  } catch(const std::exception& ex)
+  {
+    if(onException)
+      onException(ex.what());
+  }
+}
+//--------------------------------------------------------------
+void CrawlerPV::restoreCheckpoint(const std::shared_ptr<LinkedTask>& root, const std::string& url,
+                                  const std::string& grepRegex, std::vector<LinkedTask*>& pending)
+{
+  CrawlCheckpoint::State state;
+  if (checkpointPath.empty() || !CrawlCheckpoint::Load(checkpointPath, state))
+    throw std::runtime_error("No checkpoint to resume: " + checkpointPath);
+  if (state.rootUrl != url || state.grepRegex != grepRegex)
+    throw std::runtime_error("The checkpoint is of another crawl: " + state.rootUrl);
+  size_t restored = CrawlCheckpoint::Restore(state, root.get(), pending);
+  currentLinksCount->store((unsigned)restored);
+  std::cerr << "Restored: " << state.pages.size() << " pages, " << restored << " links;\n";
+}
+//--------------------------------------------------------------
+void CrawlerPV::stop()
+{
+  //the threads park after their current tasks, the queued ones stay there for start()
+  workersPool->pause();
+  if (nullptr != checkpoint)
+    {//the pages finished so far are resumed without the downloads
+      checkpoint->flush();
+    }
 }
 //--------------------------------------------------------------
 void CrawlerPV::clear()
 {
   stop();
+  //the queued tasks of the crawl are dropped, the next start() makes a new pool
+  workersPool->terminateDetach();
+  frontier->clear();
   taskRoot.reset();
+  checkpoint.reset();
   currentLinksCount->store(0);
   {
     std::lock_guard<std::mutex> lk(slockLonely);
@@ -148,10 +190,53 @@ void CrawlerPV::clear()
   lonelyFunctorsVector.clear();
 }
 //---------------------------------------------------------------
+bool CrawlerPV::idle()
+{
+  if (0 != launching.load())
+    return false;
+  if (workersPool->closed() || workersPool->paused())
+    return true;//stopped, the tasks are put aside
+  if (0 != frontier->size())
+    return false;
+#ifdef WITH_CURL_MULTI
+  if (nullptr != fetchEngine && 0 != fetchEngine->inFlight())
+    return false;
+#endif
+  return workersPool->idle();
+}
+
+bool CrawlerPV::waitIdle(unsigned timeoutMs)
+{
+  //a task passes the work on (to the frontier, to the downloads) before it's finished,
+  //still the snapshot may miss it: trust a few snapshots in a row only
+  static const unsigned confirmations = 3;
+  const std::chrono::milliseconds period(50);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  for(unsigned seen = 0; seen < confirmations; )
+    {
+      if (0 != timeoutMs && std::chrono::steady_clock::now() >= deadline)
+        return false;
+      std::this_thread::sleep_for(period);
+      seen = idle()? seen + 1 : 0;
+    }
+  return true;
+}
+//---------------------------------------------------------------
 WorkerCtx CrawlerPV::makeWorkerContext()
 {
   WorkerCtx ctx;
   ctx.rootNode = taskRoot;
+  ctx.httpClient.setSessionPool(sessionPool);
+  ctx.frontier = frontier;
+  ctx.pageCache = pageCache;
+  ctx.maxPageBytes = maxPageBytes;
+  ctx.resultsSink = resultsSink;
+  ctx.releasePages = releasePages;
+  ctx.checkpoint = checkpoint;
+  ctx.metrics = metrics;
+#ifdef WITH_CURL_MULTI
+  ctx.fetchEngine = fetchEngine;
+#endif
 
   auto crawlerImpl = shared_from_this();
   //enable workers to spawn subtasks e.g. "start"
@@ -164,9 +249,9 @@ WorkerCtx CrawlerPV::makeWorkerContext()
       crawlerImpl->scheduleTask(*task);
   };
 
-  ctx.scheduleFunctor = [crawlerImpl](CallableDoubleFunc func)
+  ctx.scheduleFunctor = [crawlerImpl](CallableDoubleFunc&& func)
   {
-    crawlerImpl->scheduleFunctor(func);
+    crawlerImpl->scheduleFunctor(std::move(func));
   };
   ctx.getThreadHandle = [crawlerImpl]() -> TPool_ThreadDataPtr
   {
@@ -216,17 +301,17 @@ bool CrawlerPV::scheduleTask(const WebGrep::LonelyTask& task, bool resendAbandon
 
 }
 //-----------------------------------------------------------------
-bool CrawlerPV::scheduleFunctor(CallableDoubleFunc func, bool resendAbandonedTasks)
+bool CrawlerPV::scheduleFunctor(CallableDoubleFunc&& func, bool resendAbandonedTasks)
 {
   try {
     if (workersPool->closed())
       {//workers pool is unavailable, lets stack tasks in the vector
         std::lock_guard<CrawlerPV::LonelyLock_t> lk(slockLonelyFunctors); (void)lk;
-        lonelyFunctorsVector.push_back(func);
+        lonelyFunctorsVector.push_back(std::move(func));
         return true;
       }
     //submit current task:
-    workersPool->submit(func);
+    workersPool->submit(std::move(func));
 
     //submit delayed tasks from the vector:
     if (!resendAbandonedTasks)
@@ -234,9 +319,9 @@ bool CrawlerPV::scheduleFunctor(CallableDoubleFunc func, bool resendAbandonedTas
         return true;
       }
     std::lock_guard<CrawlerPV::LonelyLock_t> lk(slockLonelyFunctors); (void)lk;
-    for(CallableDoubleFunc& func : lonelyFunctorsVector)
+    for(CallableDoubleFunc& lonely : lonelyFunctorsVector)
       {
-        workersPool->submit(func);
+        workersPool->submit(std::move(lonely));
       }
     lonelyFunctorsVector.clear();
   } catch(std::exception& ex)
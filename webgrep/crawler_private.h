@@ -6,9 +6,11 @@
 #include <vector>
 #include <thread>
 #include "thread_pool.h"
+#include "session_pool.h"
 #include <stdio.h>
 #include <cstdlib>
 #include <cassert>
+#include <stdexcept>
 
 
 namespace WebGrep {
@@ -26,9 +28,29 @@ public:
 
     maxLinksCount->store(4096);
     currentLinksCount->store(0);
+    grepEngineKind = GrepEngineKind::AUTOMATON;
+    obeyRobots = true;
+    maxPageBytes = WebGrep::ResponseGate::defaultMaxBytes;
+    launching.store(0);
+    releasePages = false;
+    checkpointFlushMs = 1000;
 
     selfTest();
-    workersPool = std::make_shared<WebGrep::ThreadsPool>(1);
+    metricsRegistry = std::make_shared<WebGrep::MetricsRegistry>();
+    metrics = std::make_shared<WebGrep::CrawlMetrics>(*metricsRegistry);
+    workersPool = std::make_shared<WebGrep::ThreadsPool>(1, true/*work stealing*/, TPoolQueue::LOCKFREE_RING,
+                                                         metrics->poolProbes);
+    sessionPool = std::make_shared<WebGrep::SessionPool>();
+    frontier = std::make_shared<WebGrep::CrawlFrontier>(FrontierPolicy::BFS);
+    hostScheduler = std::make_shared<WebGrep::HostScheduler>();
+    frontier->setHostScheduler(hostScheduler);
+#ifdef WITH_CURL_MULTI
+    fetchEngine = std::make_shared<WebGrep::FetchEngine>();
+    if (!fetchEngine->valid())
+      {//fall back to the blocking downloads
+        fetchEngine.reset();
+      }
+#endif
   }
 
   virtual ~CrawlerPV()
@@ -48,12 +70,12 @@ public:
   //@return FALSE on exception (like bad alloc etc.)
   bool scheduleTask(const WebGrep::LonelyTask& task, bool resendAbandonedTasks = false);
 
-  //this method serves as scheduling method for functors
+  //this method serves as scheduling method for functors, (func) is moved to the pool
   //@return FALSE on exception (like bad alloc etc.)
-  bool scheduleFunctor(CallableDoubleFunc func, bool resendAbandonedTasks = false);
+  bool scheduleFunctor(CallableDoubleFunc&& func, bool resendAbandonedTasks = false);
 
-  /** It will suspend current tasks by hiding them into a "pocket",
-   *  from where it can be pulled out and processed later. */
+  /** Pause the pool: the threads park after their current tasks,
+   *  the queued tasks and the frontier wait for start() of the same root. */
   void stop();
 
   /** Starts the root processing task that will spawn subtasks
@@ -61,8 +83,9 @@ public:
     The tree will have structure like following:
 
     @param neuRootTask: must be constructed with
-    taskRoot.grepVars.targetUrl and optionally taskRoot.grepVars.grepRegex values set.
-    @param threadsNumber: quantity of working threads to use.
+    taskRoot.grepVars.targetUrl and optionally taskRoot.grepVars.grepEngine values set.
+    @param threadsNumber: quantity of working threads to use,
+    the running pool is resized in place when the root is the same.
     @param forceRebuild: force to parse all URLs even if it is done already.
 
     @verbatim
@@ -89,10 +112,31 @@ public:
   void start(std::shared_ptr<LinkedTask> neuRootTask,
              unsigned threadsNumber = 4, bool forceRebuild = false);
 
+  /** Continue the crawl restored from the checkpoint (see CrawlCheckpoint::Restore()):
+   *  the first page is not downloaded again, the (pending) nodes are scheduled.*/
+  void resume(std::shared_ptr<LinkedTask> neuRootTask, const std::vector<LinkedTask*>& pending,
+              unsigned threadsNumber = 4);
+
+  /** Rebuild the tree of the new (root) from the checkpoint's file, set the links' counter.
+   *  Possible exceptions: runtime_error if the file is missing or it's of another crawl, bad_alloc.
+   *  @param pending: the nodes to be downloaded.*/
+  void restoreCheckpoint(const std::shared_ptr<LinkedTask>& root, const std::string& url,
+                         const std::string& grepRegex, std::vector<LinkedTask*>& pending);
+
 
   //stop all tasks ASAP and clear otu everything
   void clear();
 
+  /** TRUE if nothing is running or waiting: no start() in progress, the pool's threads are parked,
+   *  the frontier is empty and no downloads are in flight. Also TRUE after stop().
+   *  It's a snapshot, the work may be passed between these at the moment.*/
+  bool idle();
+
+  /** Wait until idle() holds for a while (several checks in a row).
+   *  @param timeoutMs: 0 -- no limit.
+   *  @return FALSE on timeout.*/
+  bool waitIdle(unsigned timeoutMs);
+
   std::function<void(const std::string& what)> onException;
   //-----------------------------------------------------------------------------
   /** Called on each HTML page's parsing success.*/
@@ -111,9 +155,54 @@ public:
   /** Multithreaded task exec. entity.*/
   std::shared_ptr<WebGrep::ThreadsPool> workersPool;
 
+  /** Keep-alive connections of the hosts, shared by the workers' http clients.*/
+  std::shared_ptr<WebGrep::SessionPool> sessionPool;
+
+  /** Pages waiting for download, ordered by the policy given to Crawler::start().*/
+  std::shared_ptr<WebGrep::CrawlFrontier> frontier;
+
+  /** Pages of the previous crawls for the conditional GET, NULL if disabled.*/
+  std::shared_ptr<WebGrep::PageCache> pageCache;
+
+  /** Receives the pages' results, NULL if disabled.*/
+  std::shared_ptr<WebGrep::ResultsSink> resultsSink;
+  //drop the pages from the tree after they're written to the sink
+  bool releasePages;
+
+  /** Journal of the crawl for resume, NULL if disabled; it's file and the period of the writes.*/
+  std::shared_ptr<WebGrep::CrawlCheckpoint> checkpoint;
+  std::string checkpointPath;
+  unsigned checkpointFlushMs;
+
+  /** The crawls' metrics, they're accumulated by all crawls of the object.*/
+  std::shared_ptr<WebGrep::MetricsRegistry> metricsRegistry;
+  std::shared_ptr<const WebGrep::CrawlMetrics> metrics;
+  //writes the Prometheus file, NULL if disabled
+  std::shared_ptr<WebGrep::MetricsFileWriter> metricsWriter;
+
+  /** Per-host rate limits and backoffs, consulted by the frontier.*/
+  std::shared_ptr<WebGrep::HostScheduler> hostScheduler;
+
+#ifdef WITH_CURL_MULTI
+  /** Downloads the pages asynchronously, the pool threads only parse them.*/
+  std::shared_ptr<WebGrep::FetchEngine> fetchEngine;
+#endif
+
   //these shared by all tasks spawned by the object CrawlerPV:
   std::shared_ptr<std::atomic_uint> maxLinksCount, currentLinksCount;
 
+  //which engine compiles the text expression on start()
+  WebGrep::GrepEngineKind grepEngineKind;
+
+  //check the pages by robots.txt in the crawls started after it's set
+  bool obeyRobots;
+
+  //limit of a page's body, the bigger ones are aborted
+  size_t maxPageBytes;
+
+  //count of the start() calls in progress in the launcher threads
+  std::atomic_uint launching;
+
   //---- these variables track for abandoned tasks that are to be re-issued:
   // these provide sync. access to lonelyVector, lonelyFunctorsVector
   typedef std::mutex LonelyLock_t;
@@ -122,6 +211,10 @@ public:
   //these are keeping abandoned tasks that should be rescheduled
   std::vector<WebGrep::LonelyTask> lonelyVector;
   std::vector<WebGrep::CallableDoubleFunc> lonelyFunctorsVector;
+
+protected:
+  //stop the tasks of another tree, make or resize the pool
+  void preparePool(const std::shared_ptr<LinkedTask>& neuRootTask, unsigned threadsNumber);
 };
 
 }//namespace WebGrep
@@ -1,4 +1,5 @@
 #include "crawler_worker.h"
+#include "link_scanner.h"
 
 #include <iostream>
 #include <regex>
@@ -6,59 +7,163 @@
 namespace WebGrep {
 
 //---------------------------------------------------------------
-bool CheckExtension(const char* buf, unsigned len)
+//milliseconds passed since (start)
+static unsigned MsSince(std::chrono::steady_clock::time_point start)
 {
-  unsigned _pos = 0;
-  unsigned _bound = std::min((unsigned)WebGrep::MaxURLlen,len);
-  for(; _pos < _bound && buf[_pos] != '.'; ++_pos)
-  { /*find a '.' symbol*/}
+  return (unsigned)std::chrono::duration_cast<std::chrono::milliseconds>
+      (std::chrono::steady_clock::now() - start).count();
+}
 
-  if (_pos >= _bound)
-    {//has not dots, consider it to be a folder
-      return true;
+//---------------------------------------------------------------
+CrawlMetrics::CrawlMetrics(MetricsRegistry& registry)
+{
+  connect = registry.histogram("webgrep_connect_seconds", "DNS lookup and connect (TLS included) of the new connections.");
+  ttfb = registry.histogram("webgrep_ttfb_seconds", "Time to the first byte of the response after the request is sent.");
+  download = registry.histogram("webgrep_download_seconds", "Transfer of the response after the first byte.");
+  fetch = registry.histogram("webgrep_fetch_seconds", "Whole download of a page.");
+  parse = registry.histogram("webgrep_parse_seconds", "Parsing of a downloaded page: the text search and the links.");
+  grep = registry.histogram("webgrep_grep_seconds", "Search of the text expression in a page.");
+  pagesDownloaded = registry.counter("webgrep_pages_downloaded_total", "Pages downloaded.");
+  pagesFailed = registry.counter("webgrep_pages_failed_total", "Pages failed or skipped by the download.");
+  bytesDownloaded = registry.counter("webgrep_downloaded_bytes_total", "Bytes of the pages downloaded.");
+  matches = registry.counter("webgrep_matches_total", "Matches of the text expression.");
+  poolProbes = std::make_shared<TPool_Probes>();
+  poolProbes->queueWait = registry.histogram("webgrep_queue_wait_seconds", "Time a task waits in the threads pool's queues.");
+  poolProbes->taskExec = registry.histogram("webgrep_task_seconds", "Execution of a task in the threads pool.");
+  poolProbes->tasks = registry.counter("webgrep_tasks_total", "Tasks executed by the threads pool.");
+}
+
+//the page's download is over (it's content is kept or it has failed)
+static void RecordDownload(const CrawlMetrics* metrics, const GrepVars& g,
+                           std::chrono::steady_clock::time_point started)
+{
+  if (nullptr == metrics)
+    return;
+  metrics->fetch->recordSince(started);
+  if (g.pageIsReady)
+    {
+      metrics->pagesDownloaded->add();
+      metrics->bytesDownloaded->add(g.pageContent.size());
     }
-  //not interesting files (media, .css):
-  static const char* d_file_extensions[ ] = {
-      ".js",  ".jpg", "jpeg", ".mp4", "mpeg", ".avi",
-      ".mkv", "rtmp", ".mov", ".3gp", ".wav", ".mp3",
-      ".doc", ".odt", ".pdf", ".gif", ".ogv", ".ogg",
-      ".css","\0\0\0\0"
-    };
-  //interesting files:
-  static const char* d_extensions[ ]
-      = {"html",".txt", ".cgi", ".htm", ".asp", ".jsp", ".php", ".rb", ".pl", ".py", "\0"};
-  const char* last4 = buf + _pos;
-
-  //since we have only 4 bytes there, lets compare them as uint32_t
-  unsigned idx = 0;
-  const char* ext = d_extensions[idx];
-  uint32_t sz = sizeof(d_extensions)/sizeof(const char*) - 1;
-
-  {//check for good extensions:
-    for(; idx < sz && 0 == ::memcmp(last4, ext, ::strlen(ext));
-        ++idx, ext = d_extensions[idx]) {  }
-    if (idx < sz)
-      return true;//matches recommended extensions
+  else
+    metrics->pagesFailed->add();
+}
+
+#ifdef WITH_LIBCURL
+static void RecordTransfer(const CrawlMetrics* metrics, const CurlTimings& timings)
+{
+  if (nullptr == metrics)
+    return;
+  if (timings.connected)
+    metrics->connect->record(timings.connectUs);
+  metrics->ttfb->record(timings.ttfbUs);
+  metrics->download->record(timings.downloadUs);
+}
+#endif
+
+/** Records the blocking download when it's over, whatever way it returns.*/
+struct DownloadProbe
+{
+  DownloadProbe(const CrawlMetrics* m, const GrepVars& g)
+    : metrics(m), page(g), started(std::chrono::steady_clock::now())
+  { }
+  ~DownloadProbe() { RecordDownload(metrics, page, started); }
+
+  const CrawlMetrics* metrics;//< NULL to skip it
+  const GrepVars& page;
+  std::chrono::steady_clock::time_point started;
+};
+
+//give back what the task has held in the thread
+static void AfterTask()
+{
+  LinkBudget::ReleaseThreadLease();
+  EpochReclaimer::Global().collect();
+}
+
+static void PumpFrontier(const std::shared_ptr<const WorkerCtx>& shared);
+
+//queue PumpFrontier() to the pool, the frontier's timer calls it as well
+static void SchedulePump(const std::shared_ptr<const WorkerCtx>& shared)
+{
+  WebGrep::CallableDoubleFunc dfunc;
+  dfunc.functor = [shared]() { PumpFrontier(shared); };
+  shared->scheduleFunctor(std::move(dfunc));
+}
+
+/** Run the best ready item of the frontier, one call per item pushed.
+ *  When only the items of the delayed hosts are left -- return, the frontier's timer
+ *  schedules the pump again when the first of them is ready.*/
+static void PumpFrontier(const std::shared_ptr<const WorkerCtx>& shared)
+{
+  std::shared_ptr<CrawlFrontier> frontier = shared->frontier;
+  FrontierItem item;
+  if (!frontier->popOrWait(item, &SchedulePump))
+    return;
+  if (frontier->takeOwedPump())
+    {//the pumps of the parked items are passed on one by one
+      SchedulePump(shared);
+    }
+  {
+    WorkerCtx temp = *item.ctx;
+    if (item.hostAcquired)
+      {//released by the download or when (temp) is gone
+        temp.hostSlot = std::make_shared<HostSlot>(frontier->hostScheduler(), item.host);
+      }
+    item.method(item.node, temp);
   }
+  item = FrontierItem();
+  AfterTask();
+}
 
-  {//check for bad extenstions:
-    idx = 0;
-    ext = d_file_extensions[0];
-    sz = sizeof(d_file_extensions)/sizeof(const char*) - 1;
-    for(; idx < sz && 0 == ::memcmp(last4, ext, ::strlen(ext));
-        ++idx, ext = d_extensions[idx]) {  }
-    return (idx < sz)? false /*match with media extention*/ : true/*not match, return default(TRUE)*/;
+/** Queue the task's page to the frontier again, with a pump for it.
+ *  @return FALSE if there is no frontier or on bad_alloc.*/
+static bool Requeue(LinkedTask* task, const WorkerCtx& w)
+{
+  if (nullptr == w.frontier)
+    return false;
+  try {
+    WorkerCtx pinned(w);
+    pinned.hostSlot.reset();
+    std::shared_ptr<const WorkerCtx> shared = std::make_shared<const WorkerCtx>(std::move(pinned));
+    shared->frontier->push(task, &FuncDownloadGrepRecursive, shared);
+    SchedulePump(shared);
+  } catch(const std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << "\n";
+    return false;
   }
+  return true;
+}
+
+/** The host has answered 429 or 503: queue the page again, the frontier
+ *  keeps it parked while the host backs off.
+ *  @return FALSE if the page is not to be retried.*/
+static bool RetryLater(LinkedTask* task, const WorkerCtx& w)
+{
+  static const unsigned maxRetries = 3;
+  GrepVars& g(task->grepVars);
+  if ((429 != g.responseCode && 503 != g.responseCode)
+      || nullptr == w.frontier || g.retriesCount >= maxRetries)
+    return false;
+  ++g.retriesCount;
+  return Requeue(task, w);
 }
 //---------------------------------------------------------------
 size_t WorkerCtx::scheduleBranchExec(LinkedTask* node, WorkFunc_t method, uint32_t skipCount, bool spray)
 {
+  //one copy of the context is shared by all tasks of the branch,
+  //so the task's functor fits the inline storage of CallableDoubleFunc
+  //the branch's nodes stay alive until the last task of the branch is done
+  WorkerCtx pinned(*this);
+  pinned.treePin = std::make_shared<WebGrep::EpochGuard>();
+  pinned.hostSlot.reset();
+  std::shared_ptr<const WorkerCtx> shared = std::make_shared<const WorkerCtx>(std::move(pinned));
   if(spray)
     {
       return WebGrep::ForEachOnBranch(node, [&](LinkedTask* _node)
         {
 //          std::cerr << "scheduling task:: " << _node->grepVars.targetUrl << "\n";
-          WorkerCtx copy = *this;
           WebGrep::CallableDoubleFunc dfunc;
           {//text tag
             const char* _src = _node->grepVars.targetUrl.data();
@@ -68,30 +173,73 @@ size_t WorkerCtx::scheduleBranchExec(LinkedTask* node, WorkFunc_t method, uint32
             _src -= _min;
             ::memcpy(dfunc.tag.data(), _src, _min - 1);
           }
-          dfunc.functor = [copy, method, _node]()
+          if (nullptr != frontier)
+            {//the frontier decides which page goes first, the pool gets a pump for each
+              frontier->push(_node, method, shared);
+              dfunc.functor = [shared]() { PumpFrontier(shared); };
+              this->scheduleFunctor(std::move(dfunc));
+              return;
+            }
+          dfunc.functor = [shared, method, _node]()
           {
-            //ctx instance, bind the callbacks by copying shared pointers
-            WorkerCtx temp = copy;
-            method(_node, temp);
+            {//ctx instance, bind the callbacks by copying shared pointers
+              WorkerCtx temp = *shared;
+              method(_node, temp);
+            }
+            AfterTask();
           };
 
-          this->scheduleFunctor(dfunc);
+          this->scheduleFunctor(std::move(dfunc));
         },
       skipCount);
     }
   //else: make tasks consequent in one thread:
-  WorkerCtx copy = *this;
+  size_t cnt = WebGrep::ForEachOnBranch(node, [](LinkedTask*){ }, skipCount);
   WebGrep::CallableDoubleFunc dfunc;
-  dfunc.functor = [copy, skipCount, node, method]()
+  dfunc.functor = [shared, skipCount, node, method]()
   {
-      WorkerCtx temp = copy;
-      WebGrep::ForEachOnBranch(node, [&temp, method](LinkedTask* _node)
       {
-          method(_node, temp);
-      },
-      skipCount);
+        WorkerCtx temp = *shared;
+        WebGrep::ForEachOnBranch(node, [&temp, method](LinkedTask* _node)
+        {
+            method(_node, temp);
+        },
+        skipCount);
+      }
+      AfterTask();
   };
-  this->scheduleFunctor(dfunc);
+  this->scheduleFunctor(std::move(dfunc));
+  return cnt;
+}
+
+size_t WorkerCtx::scheduleNodesExec(const std::vector<LinkedTask*>& nodes, WorkFunc_t method)
+{
+  WorkerCtx pinned(*this);
+  pinned.treePin = std::make_shared<WebGrep::EpochGuard>();
+  pinned.hostSlot.reset();
+  std::shared_ptr<const WorkerCtx> shared = std::make_shared<const WorkerCtx>(std::move(pinned));
+  for(LinkedTask* _node : nodes)
+    {
+      WebGrep::CallableDoubleFunc dfunc;
+      if (nullptr != frontier)
+        {
+          frontier->push(_node, method, shared);
+          dfunc.functor = [shared]() { PumpFrontier(shared); };
+        }
+      else
+        {
+          dfunc.functor = [shared, method, _node]()
+          {
+            {
+              WorkerCtx temp = *shared;
+              method(_node, temp);
+            }
+            AfterTask();
+          };
+        }
+      this->scheduleFunctor(std::move(dfunc));
+    }
+  return nodes.size();
 }
 
 /** schedule all all nodes of the branch to be executed by given functor.*/
@@ -100,12 +248,95 @@ size_t WorkerCtx::scheduleBranchExecFunctor(LinkedTask* task, std::function<void
   return WebGrep::ForEachOnBranch(task, functor, skipCount);
 }
 
+//---------------------------------------------------------------
+/** Take the page from the (cache) on 304 Not Modified, store a fresh page with it's validators.
+ *  @return g.pageIsReady */
+static bool ApplyPageCache(const std::shared_ptr<PageCache>& cache, GrepVars& g,
+                           const HttpValidators& validators)
+{
+  if (nullptr == cache)
+    return g.pageIsReady;
+  try {
+    if (304 == g.responseCode)
+      {
+        PageCache::Entry cached;
+        g.pageIsReady = cache->lookup(g.targetUrl, cached, true);
+        g.pageContent = std::move(cached.body);
+      }
+    else if (g.pageIsReady && 200 == g.responseCode)
+      {
+        cache->store(g.targetUrl, validators, g.pageContent);
+      }
+  } catch(const std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << "\n";
+  }
+  return g.pageIsReady;
+}
+
+#ifdef WITH_LIBCURL
+/** What the blocking download takes from the response's headers.*/
+struct HeaderSink
+{
+  explicit HeaderSink(size_t maxBytes) : gate(maxBytes) { }
+
+  HttpValidators validators;
+  ResponseGate gate;
+};
+
+//collects the validators of the response, aborts the transfer when the gate says no
+static size_t SinkHeaderCallback(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+  HeaderSink* sink = (HeaderSink*)userdata;
+  try {
+    sink->validators.parseHeaderLine(ptr, size * nmemb);
+  } catch(const std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << "\n";
+    return 0;
+  }
+  return sink->gate.onHeaderLine(ptr, size * nmemb)? size * nmemb : 0;
+}
+
+//the body's limit for chunked responses (without Content-Length)
+static int SinkProgressCallback(void* userdata, curl_off_t dltotal, curl_off_t dlnow,
+                                curl_off_t ultotal, curl_off_t ulnow)
+{
+  (void)dltotal; (void)ultotal; (void)ulnow;
+  HeaderSink* sink = (HeaderSink*)userdata;
+  size_t received = sink->gate.received();
+  return (dlnow < 0 || (size_t)dlnow <= received || sink->gate.onBody((size_t)dlnow - received))? 0 : 1;
+}
+#elif defined(WITH_LIBNEON)
+//ne_hook_post_headers: check the type and the length of the response
+static void GatePostHeaders(ne_request* req, void* userdata, const ne_status* status)
+{
+  ResponseGate* gate = (ResponseGate*)userdata;
+  gate->onStatus(status->code);
+  const char* type = ne_get_response_header(req, "Content-Type");
+  if (nullptr != type)
+    gate->onContentType(type, ::strlen(type));
+  const char* length = ne_get_response_header(req, "Content-Length");
+  if (nullptr != length)
+    gate->onContentLength(::strtoull(length, nullptr, 10));
+}
+
+//a second reader of the body: a non-zero result aborts the request
+static int GateBodyReader(void* userdata, const char* buf, size_t len)
+{
+  (void)buf;
+  ResponseGate* gate = (ResponseGate*)userdata;
+  return gate->onBody(len)? 0 : -1;
+}
+#endif
 //---------------------------------------------------------------
 bool FuncDownloadOne(LinkedTask* task, WorkerCtx& w)
 {
   GrepVars& g(task->grepVars);
   std::string& url(g.targetUrl);
   std::cerr << "downloading: " << url << "\n";
+  auto started = std::chrono::steady_clock::now();
+  DownloadProbe probe(w.metrics.get(), g);
 
   //try to connect, w.hostPort will be set on success to "site.com:443"
   g.scheme.fill(0);
@@ -130,16 +361,40 @@ bool FuncDownloadOne(LinkedTask* task, WorkerCtx& w)
 #ifdef WITH_LIBNEON
   //issue GET request
   WebGrep::IssuedRequest rq = w.httpClient.issueRequest("GET", _path);
+  PageCache::Entry cached;
+  if (nullptr != w.pageCache && w.pageCache->lookup(url, cached, false))
+    {//conditional GET
+      if (!cached.validators.etag.empty())
+        ne_add_request_header(rq.req.get(), "If-None-Match", cached.validators.etag.c_str());
+      if (!cached.validators.lastModified.empty())
+        ne_add_request_header(rq.req.get(), "If-Modified-Since", cached.validators.lastModified.c_str());
+    }
+  //abort the media files and the huge pages as soon as the headers come
+  ResponseGate gate(w.maxPageBytes);
+  ne_hook_post_headers(rq.ctx->sess, &GatePostHeaders, (void*)&gate);
+  ne_add_response_body_reader(rq.req.get(), ne_accept_always, &GateBodyReader, (void*)&gate);
   ne_set_read_timeout(rq.ctx->sess, readTimeOut);
   //parse the results
   int result = ne_request_dispatch(rq.req.get());
+  g.fetchMs = MsSince(started);
+  ne_unhook_post_headers(rq.ctx->sess, &GatePostHeaders, (void*)&gate);
   std::cerr << ne_get_error(rq.ctx->sess) << std::endl;
+  if (gate.rejected())
+    {
+      std::cerr << "download skipped, " << gate.reason() << ": " << url << "\n";
+      return false;
+    }
   if (NE_OK != result)
     {
       return false;
     }
 
   g.responseCode = ne_get_status(rq.req.get())->code;
+  if (nullptr != w.hostSlot)
+    {
+      const char* retryAfter = ne_get_response_header(rq.req.get(), "Retry-After");
+      w.hostSlot->done(g.responseCode, (nullptr == retryAfter)? -1 : ::atol(retryAfter));
+    }
 
   switch (g.responseCode)
     {
@@ -152,15 +407,27 @@ bool FuncDownloadOne(LinkedTask* task, WorkerCtx& w)
         if (nullptr == location)//failed to get Location header
           { return false; }
         url = location;
+        rq.req.reset();//the session may go to another host's request after that
+        probe.metrics = nullptr;//the redirected request is recorded by itself
         return FuncDownloadOne(task, w);
       };
       break;
     case 200: break;
+    case 304: break;//not modified, taken from the cache
 
     default: {return false;};
     };
   g.pageContent = std::move(rq.ctx->response);
   g.pageIsReady = true;
+  if (nullptr != w.pageCache)
+    {
+      HttpValidators validators;
+      const char* etag = ne_get_response_header(rq.req.get(), "ETag");
+      const char* lastModified = ne_get_response_header(rq.req.get(), "Last-Modified");
+      validators.etag = (nullptr == etag)? "" : etag;
+      validators.lastModified = (nullptr == lastModified)? "" : lastModified;
+      ApplyPageCache(w.pageCache, g, validators);
+    }
 #elif defined(WITH_LIBCURL)
   WebGrep::IssuedRequest rq = w.httpClient.issueRequest("GET", _path);
   if (!rq.valid())
@@ -168,14 +435,62 @@ bool FuncDownloadOne(LinkedTask* task, WorkerCtx& w)
       return false;
     }
 
+  //conditional GET of a cached page
+  PageCache::Entry cached;
+  curl_slist* condHeaders = nullptr;
+  if (nullptr != w.pageCache && w.pageCache->lookup(url, cached, false))
+    {
+      for(const std::string& header : cached.validators.conditionalHeaders())
+        condHeaders = curl_slist_append(condHeaders, header.c_str());
+      curl_easy_setopt(rq.ctx->curl, CURLOPT_HTTPHEADER, condHeaders);
+    }
+  //abort the media files and the huge pages as soon as the headers come
+  HeaderSink sink(w.maxPageBytes);
+  curl_easy_setopt(rq.ctx->curl, CURLOPT_HEADERFUNCTION, &SinkHeaderCallback);
+  curl_easy_setopt(rq.ctx->curl, CURLOPT_HEADERDATA, (void*)&sink);
+  curl_easy_setopt(rq.ctx->curl, CURLOPT_XFERINFOFUNCTION, &SinkProgressCallback);
+  curl_easy_setopt(rq.ctx->curl, CURLOPT_XFERINFODATA, (void*)&sink);
+  curl_easy_setopt(rq.ctx->curl, CURLOPT_NOPROGRESS, 0L);
+
   curl_easy_setopt(rq.ctx->curl, CURLOPT_TIMEOUT, readTimeOut/*seconds*/);
   curl_easy_setopt(rq.ctx->curl, CURLOPT_FOLLOWLOCATION, 1);
   rq.res = curl_easy_perform(rq.ctx->curl);
   rq.ctx->status = rq.res;
+  g.fetchMs = MsSince(started);
+  {
+    CurlTimings timings;
+    timings.read(rq.ctx->curl);
+    RecordTransfer(w.metrics.get(), timings);
+  }
+  {//the handle is reused by the next requests: no pointers to the locals there
+    curl_easy_setopt(rq.ctx->curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(rq.ctx->curl, CURLOPT_HEADERFUNCTION, nullptr);
+    curl_easy_setopt(rq.ctx->curl, CURLOPT_HEADERDATA, nullptr);
+    curl_easy_setopt(rq.ctx->curl, CURLOPT_XFERINFOFUNCTION, nullptr);
+    curl_easy_setopt(rq.ctx->curl, CURLOPT_XFERINFODATA, nullptr);
+    curl_easy_setopt(rq.ctx->curl, CURLOPT_NOPROGRESS, 1L);
+    curl_slist_free_all(condHeaders);
+  }
+  if (sink.gate.rejected())
+    {
+      std::cerr << "download skipped, " << sink.gate.reason() << ": " << url << "\n";
+    }
   curl_easy_getinfo (rq.ctx->curl, CURLINFO_RESPONSE_CODE, &(g.responseCode));
+  if (nullptr != w.hostSlot)
+    {
+      long retryAfterSec = -1;
+#if LIBCURL_VERSION_NUM >= 0x074200
+      curl_off_t retryAfter = 0;
+      if (CURLE_OK == curl_easy_getinfo(rq.ctx->curl, CURLINFO_RETRY_AFTER, &retryAfter) && retryAfter > 0)
+        retryAfterSec = (long)retryAfter;
+#endif
+      w.hostSlot->done(g.responseCode, retryAfterSec);
+    }
   g.pageContent = std::move(rq.ctx->response);
   g.pageIsReady = (rq.res == CURLE_OK);
-  rq.ctx->disconnect();
+  ApplyPageCache(w.pageCache, g, sink.validators);
+  //keep the connection alive for the next request to the host
+  w.httpClient.release();
 
 
 //end of WITH_LIBCURL
@@ -193,10 +508,13 @@ bool FuncDownloadOne(LinkedTask* task, WorkerCtx& w)
       //wait for the reply, notification in Cli
       issue.ctx->cond.wait_for(lk, std::chrono::seconds(5));
     }
+  g.fetchMs = MsSince(started);
   //ok, got an reply
   g.responseCode = issue.ctx->reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
   g.pageContent = std::move(issue.ctx->response);
   g.pageIsReady = !g.pageContent.empty();
+  if (nullptr != w.hostSlot)
+    w.hostSlot->done(g.responseCode);
 //WITH_QTNETWORK
 #endif//WITH_LIBNEON
   std::cerr << "download code: " << g.responseCode << "\n";
@@ -204,35 +522,279 @@ bool FuncDownloadOne(LinkedTask* task, WorkerCtx& w)
   return g.pageIsReady;
 }
 //---------------------------------------------------------------
+/** GET the (url) with the (client), follows the redirects.
+ *  @return FALSE if there is no response.*/
+static bool FetchText(WebGrep::Client& client, const std::string& url, int readTimeOut,
+                      std::string& content, long& responseCode)
+{
+  if (client.connect(url).empty())
+    return false;
+
+  static const char* _defaultSlash = "/";
+  size_t pathBegin  = url.find_first_of('/', FindURLAddressBegin(url.data(), url.size()));
+  const char* _path = (std::string::npos == pathBegin)? _defaultSlash : url.data() + pathBegin;
+
+#ifdef WITH_LIBNEON
+  WebGrep::IssuedRequest rq = client.issueRequest("GET", _path);
+  ne_set_read_timeout(rq.ctx->sess, readTimeOut);
+  if (NE_OK != ne_request_dispatch(rq.req.get()))
+    {
+      return false;
+    }
+  responseCode = ne_get_status(rq.req.get())->code;
+  content = std::move(rq.ctx->response);
+  return true;
+#elif defined(WITH_LIBCURL)
+  bool ok = false;
+  {
+    WebGrep::IssuedRequest rq = client.issueRequest("GET", _path);
+    if (!rq.valid())
+      {
+        return false;
+      }
+    curl_easy_setopt(rq.ctx->curl, CURLOPT_TIMEOUT, readTimeOut/*seconds*/);
+    curl_easy_setopt(rq.ctx->curl, CURLOPT_FOLLOWLOCATION, 1);
+    rq.res = curl_easy_perform(rq.ctx->curl);
+    rq.ctx->status = rq.res;
+    curl_easy_getinfo (rq.ctx->curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    content = std::move(rq.ctx->response);
+    ok = (rq.res == CURLE_OK);
+  }
+  client.release();
+  return ok;
+#elif defined(WITH_QTNETWORK)
+  WebGrep::IssuedRequest issue = client.issueRequest("GET", _path);
+  std::shared_ptr<QNetworkReply> rep = issue.ctx->makeGet(issue.req);
+  std::unique_lock<std::mutex> lk(issue.ctx->mu);
+  if (!rep->isFinished())
+    {
+      issue.ctx->cond.wait_for(lk, std::chrono::seconds(readTimeOut));
+    }
+  responseCode = issue.ctx->reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  content = std::move(issue.ctx->response);
+  return 0 != responseCode;
+#endif//WITH_LIBNEON
+}
+//---------------------------------------------------------------
+bool FuncRobotsAllow(LinkedTask* task, WorkerCtx& w)
+{
+  if (nullptr == task->robotsCache)
+    return true;
+  const std::string& url(task->grepVars.targetUrl);
+  try {
+    std::shared_ptr<const RobotsRules> rules = task->robotsCache->rules(url,
+      [&w](const std::string& robotsUrl, std::string& content, long& responseCode)
+      {
+        return FetchText(w.httpClient, robotsUrl, 4, content, responseCode);
+      });
+    if (rules->allowed(url))
+      return true;
+  } catch(const std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << "\n";
+    return true;
+  }
+  std::cerr << "robots.txt disallows: " << url << "\n";
+  return false;
+}
+
+/** The response to a robots.txt request issued by FetchRobots().*/
+struct RobotsResponse
+{
+  RobotsResponse() : fetched(false), responseCode(0) { }
+
+  std::string url;//< of the page that has asked for it
+  std::shared_ptr<RobotsCache> cache;
+  bool fetched;
+  long responseCode;
+  std::string content;
+};
+
+//publish the rules and give the held items of the host back to the frontier,
+//their pump is queued to the pool: it doesn't nest in the calling task
+static void StoreRobots(const RobotsResponse& rsp, const std::shared_ptr<CrawlFrontier>& frontier)
+{
+  try {
+    rsp.cache->store(rsp.url, rsp.fetched, rsp.responseCode, rsp.content);
+  } catch(const std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << "\n";
+  }
+  frontier->releaseHost(ExtractHostPortHttp(rsp.url));
+}
+
+/** Download robots.txt of the task's host for task->robotsCache, the host is held
+ *  in the frontier until it's done. The request takes the task's slot of the HostScheduler
+ *  (w.hostSlot), it's issued by w.fetchEngine when there is, by this worker otherwise.*/
+static void FetchRobots(LinkedTask* task, WorkerCtx& w)
+{
+  std::shared_ptr<RobotsResponse> rsp = std::make_shared<RobotsResponse>();
+  rsp->url = task->grepVars.targetUrl;
+  rsp->cache = task->robotsCache;
+  std::string robotsUrl = RobotsCache::OriginOf(rsp->url) + "/robots.txt";
+  std::shared_ptr<HostSlot> slot;
+  slot.swap(w.hostSlot);
+#ifdef WITH_CURL_MULTI
+  if (nullptr != w.fetchEngine)
+    {
+      std::shared_ptr<const WorkerCtx> shared = std::make_shared<const WorkerCtx>(w);
+      bool issued = w.fetchEngine->fetch(robotsUrl, 4, [shared, rsp, slot](FetchResult& result)
+      {
+        if (nullptr != slot)
+          slot->done(result.responseCode, result.retryAfterSec);
+        rsp->fetched = (CURLE_OK == result.res);
+        rsp->responseCode = result.responseCode;
+        rsp->content = std::move(result.content);
+        //parsed in the pool, not in the I/O thread
+        WebGrep::CallableDoubleFunc dfunc;
+        dfunc.functor = [shared, rsp]() { StoreRobots(*rsp, shared->frontier); };
+        shared->scheduleFunctor(std::move(dfunc));
+      });
+      if (!issued)
+        StoreRobots(*rsp, w.frontier);
+      return;
+    }
+#endif
+  rsp->fetched = FetchText(w.httpClient, robotsUrl, 4, rsp->content, rsp->responseCode);
+  if (nullptr != slot)
+    slot->done(rsp->responseCode);
+  StoreRobots(*rsp, w.frontier);
+}
+
+enum class RobotsVerdict { ALLOWED, DISALLOWED, DEFERRED };
+
+/** FuncRobotsAllow() that doesn't wait for the rules of the task's host when there is a frontier:
+ *  the host's items are held there while it's robots.txt is downloading by FetchRobots(),
+ *  the task is queued again (DEFERRED).*/
+static RobotsVerdict RobotsCheck(LinkedTask* task, WorkerCtx& w)
+{
+  if (nullptr == task->robotsCache || nullptr == w.frontier)
+    return FuncRobotsAllow(task, w)? RobotsVerdict::ALLOWED : RobotsVerdict::DISALLOWED;
+  const std::string& url(task->grepVars.targetUrl);
+  try {
+    std::shared_ptr<const RobotsRules> rules = task->robotsCache->peek(url);
+    if (nullptr == rules)
+      {
+        std::string host = ExtractHostPortHttp(url);
+        w.frontier->holdHost(host);
+        //the rules may be stored before the host was held: nobody would release it then
+        rules = task->robotsCache->peek(url);
+        if (nullptr != rules)
+          {
+            w.frontier->releaseHost(host);
+          }
+        else if (Requeue(task, w))
+          {
+            if (task->robotsCache->claimFetch(url))
+              FetchRobots(task, w);
+            return RobotsVerdict::DEFERRED;
+          }
+        else
+          {//the page goes on without the rules
+            w.frontier->releaseHost(host);
+            return RobotsVerdict::ALLOWED;
+          }
+      }
+    if (rules->allowed(url))
+      return RobotsVerdict::ALLOWED;
+  } catch(const std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << "\n";
+    return RobotsVerdict::ALLOWED;
+  }
+  std::cerr << "robots.txt disallows: " << url << "\n";
+  return RobotsVerdict::DISALLOWED;
+}
+//---------------------------------------------------------------
 bool FuncGrepOne(LinkedTask* task, WorkerCtx& w)
 {
   GrepVars& g(task->grepVars);
   g.pageIsParsed = false;
   g.pageIsReady = false;
 
+  if (!FuncRobotsAllow(task, w))
+    return false;
   FuncDownloadOne(task, w);
   if (!g.pageIsReady || g.pageContent.empty())
     return false;
+  return FuncParseOne(task, w);
+}
+//---------------------------------------------------------------
+/** Filter the full path URL (key) found on the task's page:
+ *  skips the links to the main page, media files and the pages visited already.
+ *  @param markVisited: FALSE to leave the crawl-wide visited set to the caller,
+ *  the link is inserted there when it's spawned then.
+ *  @return TRUE if the link must be spawned as a subtask.*/
+static bool AcceptLink(LinkedTask* task, const std::string& key, bool markVisited = true)
+{
+  GrepVars& g(task->grepVars);
+  LinkedTask* _root = WebGrep::ItemLoadAcquire(task->root);
+  if (nullptr == _root)
+    _root = task;
+
+  const std::string& rootTarget (_root->grepVars.targetUrl);
+  static std::regex matchRoot("(:[0-9]*)/");
+  if (std::string::npos != key.find_first_of(rootTarget)
+      && key.size() >= rootTarget.size()
+      && std::regex_match(key, matchRoot))
+    {
+      return false;//skip link to main page
+    }
+  //filter which content we allow to be scanned:
+  bool extFilter = WebGrep::CheckExtension(key.data(), key.size()) && key != g.targetUrl;
+  if (!extFilter)
+    return false;
 
-  /**TODO: figure out how much memory allocations std::regex or std::regex can
-   * make while parsing the regular expressions.
-   *  Maybe I should use PCRE or similar with C POD containers
-   *  and non-singleton pool allocators
-   *  (std::pool_allocator is a singleton, not good).
-   *
- **/
+  //the host's robots.txt is checked here if it's known already, by the download otherwise
+  if (nullptr != task->robotsCache && !task->robotsCache->allowed(key))
+    return false;
+
+  bool traversalFilter = !(rootTarget == key);
+  if (nullptr != task->visitedSet)
+    {//crawl-wide check: the URL could be spawned by any other branch
+      traversalFilter = traversalFilter && (markVisited ? task->visitedSet->insert(key)
+                                                        : !task->visitedSet->contains(key));
+    }
+  else
+    {
+      //traverse the tree up to the root and exclude current match
+      //if it coincides with one of the parent nodes:
+      LinkedTask* _node = WebGrep::ItemLoadAcquire(task->parent);
+      for( ;
+          nullptr != _node && _root != _node && traversalFilter;
+          _node = WebGrep::ItemLoadAcquire(_node->parent))
+        {
+          traversalFilter = traversalFilter && !(_node->grepVars.targetUrl == key);
+        }
+    }
+  return traversalFilter;
+}
+//---------------------------------------------------------------
+bool FuncParseOne(LinkedTask* task, WorkerCtx& w)
+{
+  GrepVars& g(task->grepVars);
+  g.pageIsParsed = false;
+  if (!g.pageIsReady || g.pageContent.empty())
+    return false;
+  const CrawlMetrics* metrics = w.metrics.get();
+  auto started = std::chrono::steady_clock::now();
 
   //used internally for sorting & duplicates removal
   std::map<std::string, GrepVars::CIteratorPair> matches;
 
   try
   {
-    g.matchURLVector.clear();
+    if (!g.linksStreamed)
+      g.matchURLVector.clear();//else they are filled while downloading
     g.matchTextVector.clear();
 
-    //grep the grepExpr within pageContent:
-    std::smatch matchedText;
-    bool gotText = std::regex_search(g.pageContent, matchedText, g.grepExpr);
+    //grep the text expression within pageContent:
+    std::vector<GrepMatch> matchedText;
+    auto grepStarted = std::chrono::steady_clock::now();
+    bool gotText = (nullptr != g.grepEngine)
+        && g.grepEngine->search(g.pageContent.data(), g.pageContent.size(), matchedText);
+    if (nullptr != metrics && nullptr != g.grepEngine)
+      metrics->grep->recordSince(grepStarted);
 
     //grep the http:// URLs and spawn new nodes:
 #if CRAWLER_WORKER_USE_REGEXP
@@ -245,53 +807,18 @@ bool FuncGrepOne(LinkedTask* task, WorkerCtx& w)
           }
       }
 #else
+    if (!g.linksStreamed)
     {
-      const char hrefCSTR[] = "href";
-      const char httpCSTR[] = "http";
-      const uint32_t hrefSz = sizeof(hrefCSTR) - 1;
-      const uint32_t httpSz = sizeof(httpCSTR) - 1;
+      //candidates and closing quotes are found by the SIMD kernels, see link_scanner.h
       const std::string& _page(g.pageContent);
+      std::vector<LinkSpan> spans;
+      ScanLinks(_page.data(), _page.size(), spans);
 
-      for(size_t pos = 0; (pos + 1 + std::max(hrefSz,httpSz)) < _page.size(); ++pos)
+      for(const LinkSpan& span : spans)
         {
-          size_t linkPos = pos;
-          bool isHref = false;
-          const char* ptr = _page.data() + pos;
-          if (0 == ::memcmp(ptr, hrefCSTR, hrefSz))
-            {
-              //case href = "/resource/res2/page.html"
-              linkPos = _page.find_first_of('=',4 + pos);
-              isHref = true;
-            }
-          else if (0 == ::memcmp(ptr, httpCSTR, httpSz)
-                   && (ptr[4] == ':' || (ptr[4] == 's')))
-            {
-              isHref = false;
-            }
-          else
-            {
-              continue;
-            }
-
-          //find opening quote:
-          linkPos = _page.find_first_of('"', linkPos);
-          linkPos++;
           //make new iterators that point to g.pageContent
-          auto begin = _page.begin();
-          begin += isHref? linkPos : pos;
-          auto end = begin;
-
-          //find closing quote \" or other character like '>'
-          end += FindClosingQuote((const char*)&(*begin), _page.data()
-                                    + std::min((size_t)WebGrep::MaxURLlen, _page.size()));
-
-          if (end == _page.end() || end >= begin + WebGrep::MaxURLlen
-              || (end - begin) <= 1
-              || (!isHref && (begin + 10) > end )
-              )
-            {
-              continue;
-            }
+          auto begin = _page.begin() + span.begin;
+          auto end = _page.begin() + span.end;
           /**Make full path URL and pass to the matches map:
            * possible pairs:
            * (key: http://site.com/some/path/file.txt, value: "some/path/file.txt")
@@ -299,9 +826,7 @@ bool FuncGrepOne(LinkedTask* task, WorkerCtx& w)
            * in the page's text point to a path that has been scanned already. **/
           auto fullpath = MakeFullPath(&(*begin), end - begin, w.hostPort, g);
           matches[fullpath] = GrepVars::CIteratorPair(begin, end);
-          pos += (end - begin);
         }
-
     }
 
 #endif
@@ -313,44 +838,14 @@ bool FuncGrepOne(LinkedTask* task, WorkerCtx& w)
       //push text match results into the vector
       for(size_t matchIdx = 0; gotText && matchIdx < matchedText.size(); ++matchIdx)
         {
-          auto subitem = &(matchedText[matchIdx]);
-          auto diff = subitem->second - subitem->first;
-          auto begin = g.pageContent.begin() + matchedText.position(matchIdx);
-          g.matchTextVector.push_back(GrepVars::CIteratorPair(begin, begin + diff));
+          const GrepMatch& subitem(matchedText[matchIdx]);
+          auto begin = g.pageContent.begin() + subitem.begin;
+          g.matchTextVector.push_back(GrepVars::CIteratorPair(begin, begin + (subitem.end - subitem.begin)));
         }
-      auto rootNode = ItemLoadAcquire(task->root);
-      if (nullptr == rootNode)
-        rootNode = task;
-
-      const std::string& rootTarget (rootNode->grepVars.targetUrl);
-      static std::regex matchRoot("(:[0-9]*)/");
       //push matched URLS
-      for(auto iter = matches.begin(); iter != matches.end(); ++iter)
+      for(auto iter = matches.begin(); !g.linksStreamed && iter != matches.end(); ++iter)
         {
-          const std::string& key((*iter).first);
-          if (std::string::npos != key.find_first_of(rootTarget)
-              && key.size() >= rootTarget.size()
-              && std::regex_match(key, matchRoot))
-            {
-              continue;//skip link to main page
-            }
-          //filter which content we allow to be scanned:
-          bool extFilter = WebGrep::CheckExtension(key.data(), key.size()) && key != g.targetUrl;
-          LinkedTask* _root = WebGrep::ItemLoadAcquire(task->root);
-
-          bool traversalFilter = !(_root->grepVars.targetUrl == key);
-
-          //traverse the tree up to the root and exclude current match
-          //if it coincides with one of the parent nodes:
-          LinkedTask* _node = WebGrep::ItemLoadAcquire(task->parent);
-          for( ;
-              nullptr != _node && _root != _node && traversalFilter;
-              _node = WebGrep::ItemLoadAcquire(_node->parent))
-            {
-              traversalFilter = traversalFilter && !(_node->grepVars.targetUrl == key);
-            }
-
-          if (extFilter && traversalFilter) //avoid scanning self again
+          if (AcceptLink(task, (*iter).first, false)) //avoid scanning self again
             {
               g.matchURLVector.push_back((*iter).second);
             }
@@ -369,9 +864,13 @@ bool FuncGrepOne(LinkedTask* task, WorkerCtx& w)
       }
   }
 
-  task->linksCounterPtr->fetch_add(g.matchURLVector.size());
-
+  //the links are counted when they're spawned (LinkBudget)
   g.pageIsParsed = true;
+  if (nullptr != metrics)
+    {
+      metrics->parse->recordSince(started);
+      metrics->matches->add(g.matchTextVector.size());
+    }
   if (w.pageMatchFinishedCb)
     {
       w.pageMatchFinishedCb(w.rootNode, task);
@@ -379,38 +878,117 @@ bool FuncGrepOne(LinkedTask* task, WorkerCtx& w)
   return g.pageIsReady && g.pageIsParsed;
 }
 //---------------------------------------------------------------
+/** Spawn the child level from the grepped URLs and schedule
+ *  FuncDownloadGrepRecursive for each of them.*/
+static bool FuncSpawnLevel(LinkedTask* task, WorkerCtx& w);
+
+/** FuncParseOne() then FuncSpawnLevel(), the page is downloaded already.*/
+static bool FuncParseSpawnLevel(LinkedTask* task, WorkerCtx& w)
+{
+  bool ok = FuncParseOne(task, w) && FuncSpawnLevel(task, w);
+  FuncFinishPage(task, w);
+  return ok;
+}
+//---------------------------------------------------------------
+void FuncFinishPage(LinkedTask* task, WorkerCtx& w)
+{
+  if (nullptr == w.resultsSink && nullptr == w.checkpoint)
+    return;
+  GrepVars& g(task->grepVars);
+  try {
+    PageRecord rec;
+    rec.assign(g, task->level, nullptr != w.resultsSink && w.resultsSink->withBody());
+    if (nullptr != w.resultsSink)
+      w.resultsSink->write(rec);
+    if (nullptr != w.checkpoint)
+      w.checkpoint->writePage(rec, task);
+  } catch(const std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << "\n";
+  }
+  if (!w.releasePages || nullptr == w.resultsSink || nullptr == ItemLoadAcquire(task->parent))
+    return;
+  //the iterators point to the content
+  std::vector<GrepVars::CIteratorPair>().swap(g.matchURLVector);
+  std::vector<GrepVars::CIteratorPair>().swap(g.matchTextVector);
+  std::string().swap(g.pageContent);
+}
+//---------------------------------------------------------------
 bool FuncDownloadGrepRecursive(LinkedTask* task, WorkerCtx& w)
 {
   //case stopped by force:
   if (nullptr == task || nullptr == task->linksCounterPtr)
     { return false; }
 
+  //with the budget the node has taken a token when it was spawned, it's downloaded anyway
   size_t link_cnt = task->linksCounterPtr->load(std::memory_order_acquire);
-  if (link_cnt >= task->maxLinksCountPtr->load(std::memory_order_acquire))
+  if (nullptr == task->linksBudget
+      && link_cnt >= task->maxLinksCountPtr->load(std::memory_order_acquire))
     {//max. links reached, lets stop the parsing
       if (w.onMaximumLinksCount) {
           w.onMaximumLinksCount(w.rootNode, task);
         }
       return true;
     }
-  //download one page:
-  GrepVars& g(task->grepVars);
-  //download and grep page for (text and URLs):
-  if (!FuncGrepOne(task, w))
-  {
+  RobotsVerdict robots = RobotsCheck(task, w);
+  if (RobotsVerdict::DEFERRED == robots)
+    return true;//the page is queued again
+  if (RobotsVerdict::DISALLOWED == robots)
     return false;
-  }
-
+#ifdef WITH_CURL_MULTI
+  if (nullptr != w.fetchEngine)
+    {//the page is parsed in the pool when it's downloaded
+      return FuncFetchAsync(task, w, &FuncParseSpawnLevel, true);
+    }
+#endif
+  //download and grep page for (text and URLs):
+  task->grepVars.pageIsParsed = false;
+  task->grepVars.pageIsReady = false;
+  FuncDownloadOne(task, w);
+  if (RetryLater(task, w))
+    return true;
+  bool ok = FuncParseOne(task, w) && FuncSpawnLevel(task, w);
+  FuncFinishPage(task, w);
+  return ok;
+}
+//---------------------------------------------------------------
+static bool FuncSpawnLevel(LinkedTask* task, WorkerCtx& w)
+{
+  GrepVars& g(task->grepVars);
   if (g.matchURLVector.empty())
     {
       //no URLS then no subtree items. but we're okay.
       return true;
     }
+  if (g.linksStreamed)
+    {//the subtasks are spawned and scheduled while the page was downloading
+      LinkedTask* child = ItemLoadAcquire(task->child);
+      if (nullptr != child && nullptr != w.childLevelSpawned)
+        {
+          w.childLevelSpawned(w.rootNode, child);
+        }
+      return true;
+    }
+  if (nullptr != task->linksBudget && task->linksBudget->exhausted())
+    {
+      if (w.onMaximumLinksCount) {
+          w.onMaximumLinksCount(w.rootNode, task);
+        }
+      return true;
+    }
   LinkedTask* old = nullptr;
-  LinkedTask* child = task->spawnChildNode(old); DeleteList(old);
+  LinkedTask* child = task->spawnChildNode(old); RetireList(old);
+  if (nullptr == child)
+    return false;
 
   //create next level linked list from grepped URLS:
   size_t n_subtasks = child->spawnGreppedSubtasks(w.hostPort, g, 0);
+  if (0 == n_subtasks)
+    {//the budget is gone meanwhile
+      StoreRelease(task->child, nullptr);
+      RetireList(child);
+      return true;
+    }
 
   //emit signal that we've spawned a new level:
   if (nullptr != w.childLevelSpawned)
@@ -425,6 +1003,224 @@ bool FuncDownloadGrepRecursive(LinkedTask* task, WorkerCtx& w)
   return true;
 }
 
+#ifdef WITH_CURL_MULTI
+//---------------------------------------------------------------
+/** Links of a page that is still downloading, they're spawned as subtasks
+ *  as soon as they're found. Accessed by the FetchEngine's I/O thread only,
+ *  the pool gets the page after the download is done.*/
+struct LinkStream
+{
+  LinkStream(const WorkerCtx& ctx) : child(nullptr), exhausted(false), w(ctx) { }
+
+  LinkTokenizer tokenizer;
+  std::vector<LinkSpan> accepted;//< the spawned links, become task->grepVars.matchURLVector
+  LinkedTask* child;//< head of the spawned level
+  bool exhausted;   //< the budget or the nodes are gone, the rest of the page isn't scanned
+  WorkerCtx w;
+};
+
+/** Gives back the I/O thread's leased tokens when the download's callback returns:
+ *  the I/O thread serves other crawls as well, the tokens must not stay with it.*/
+struct StreamLeaseRelease
+{
+  explicit StreamLeaseRelease(bool active) : on(active) { }
+  ~StreamLeaseRelease()
+  {
+    if (on)
+      LinkBudget::ReleaseThreadLease();
+  }
+  bool on;
+};
+
+/** Scan the new bytes of (content), spawn the accepted links on the task's child level
+ *  and schedule FuncDownloadGrepRecursive for them.*/
+static void StreamLinks(LinkedTask* task, LinkStream& ls, const std::string& content, bool final)
+{
+  try {
+    std::vector<LinkSpan> spans;
+    if (!ls.exhausted)
+      ls.tokenizer.feed(content.data(), content.size(), final, spans);
+
+    size_t fresh = 0;
+    LinkedTask* firstFresh = nullptr;
+    const std::shared_ptr<LinkBudget>& budget(task->linksBudget);
+    for(const LinkSpan& span : spans)
+      {
+        std::string key = MakeFullPath(content.data() + span.begin, span.end - span.begin,
+                                       ls.w.hostPort, task->grepVars);
+        if (!AcceptLink(task, key, false))
+          continue;
+        //the token first: the link refused by the budget is not marked as visited
+        if (nullptr != budget && 0 == budget->acquire(1))
+          {//max. links reached
+            ls.exhausted = true;
+            if (ls.w.onMaximumLinksCount) {
+                ls.w.onMaximumLinksCount(ls.w.rootNode, task);
+              }
+            break;
+          }
+        if (!task->visitedSet->insert(key))
+          {
+            if (nullptr != budget)
+              budget->giveBack(1);
+            continue;
+          }
+        LinkedTask* node = nullptr;
+        if (nullptr == ls.child)
+          {
+            LinkedTask* old = nullptr;
+            ls.child = node = task->spawnChildNode(old); RetireList(old);
+          }
+        else if (1 == ls.child->spawnNextNodes(1))
+          {
+            node = ls.child->getLastOnLevel();
+          }
+        if (nullptr == node)
+          {//maximum nodes count reached: the link may be spawned later by another page
+            task->visitedSet->erase(key);
+            if (nullptr != budget)
+              budget->giveBack(1);
+            ls.exhausted = true;
+            break;
+          }
+        ls.accepted.push_back(span);
+        node->grepVars.targetUrl = key;
+        if (nullptr == budget)
+          task->linksCounterPtr->fetch_add(1);
+        std::cerr << "spawn: " << key << "\n";
+        firstFresh = (nullptr == firstFresh)? node : firstFresh;
+        ++fresh;
+      }
+    if (fresh > 0)
+      {//the level is appended by this stream only: schedule from the first new node
+        ls.w.scheduleBranchExec(firstFresh, &FuncDownloadGrepRecursive, 0, true);
+      }
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << std::endl;
+  }
+}
+
+bool FuncFetchAsync(LinkedTask* task, WorkerCtx& w, WorkerCtx::WorkFunc_t onReady, bool streamLinks)
+{
+  GrepVars& g(task->grepVars);
+  g.pageIsParsed = false;
+  g.pageIsReady = false;
+  g.linksStreamed = false;
+  std::cerr << "downloading: " << g.targetUrl << "\n";
+
+  //w.hostPort is used to make full paths of the grepped links
+  g.scheme.fill(0);
+  w.scheme.fill(0);
+  w.hostPort = w.httpClient.connect(g.targetUrl);
+  if (w.hostPort.empty())
+    return false;
+  w.scheme.copyFrom(w.httpClient.scheme());
+  w.scheme.writeTo(g.scheme.data());
+
+  long readTimeOut = 2;//seconds
+  if (nullptr == ItemLoadAcquire(task->parent))
+    { //in case of root task -- we can increase the timeout
+      readTimeOut = 8;
+    }
+
+  //without the crawl-wide visited set the links are filtered by the parser,
+  //the duplicates are not detected otherwise.
+  //The body is streamed when it's 2xx: an error page may be retried (RetryLater)
+  std::shared_ptr<LinkStream> stream;
+  FetchDataCallback_t onData;
+  if (streamLinks && nullptr != task->visitedSet)
+    {
+      stream = std::make_shared<LinkStream>(w);
+      onData = [stream, task](const std::string& content)
+      {
+        StreamLinks(task, *stream, content, false);
+      };
+    }
+
+  //conditional GET of a cached page
+  std::vector<std::string> condHeaders;
+  if (nullptr != w.pageCache)
+    {
+      PageCache::Entry cached;
+      if (w.pageCache->lookup(g.targetUrl, cached, false))
+        condHeaders = cached.validators.conditionalHeaders();
+    }
+
+  std::shared_ptr<const WorkerCtx> shared = std::make_shared<const WorkerCtx>(w);
+  auto started = std::chrono::steady_clock::now();
+  return w.fetchEngine->fetch(g.targetUrl, readTimeOut,
+                              [shared, task, onReady, stream, started](FetchResult& result)
+  {
+    //called from the I/O thread, do not block it by parsing.
+    //The streamed links have leased tokens whichever way the download ended:
+    StreamLeaseRelease lease(nullptr != stream);
+    GrepVars& g(task->grepVars);
+    g.fetchMs = MsSince(started);
+    g.responseCode = result.responseCode;
+    g.pageContent = std::move(result.content);
+    g.pageIsReady = (CURLE_OK == result.res);
+    RecordDownload(shared->metrics.get(), g, started);
+    RecordTransfer(shared->metrics.get(), result.timings);
+    std::cerr << "download code: " << g.responseCode << "\n";
+    if (nullptr != result.rejected)
+      {
+        std::cerr << "download skipped, " << result.rejected << ": " << g.targetUrl << "\n";
+      }
+    if (nullptr != shared->hostSlot)
+      {
+        shared->hostSlot->done(result.responseCode, result.retryAfterSec);
+      }
+    if (RetryLater(task, *shared))
+      return;
+    //not modified: the cached page is read and parsed in the pool
+    bool notModified = (304 == g.responseCode && g.pageIsReady && nullptr != shared->pageCache);
+    if (!notModified && (!g.pageIsReady || g.pageContent.empty()))
+      {//the failed page is reported from the pool as well
+        if (nullptr != shared->resultsSink || nullptr != shared->checkpoint)
+          {
+            WebGrep::CallableDoubleFunc dfunc;
+            dfunc.functor = [shared, task]()
+            {
+              WorkerCtx temp = *shared;
+              FuncFinishPage(task, temp);
+            };
+            shared->scheduleFunctor(std::move(dfunc));
+          }
+        return;
+      }
+
+    if (nullptr != stream && !notModified)
+      {//the tail of the page, then the links for the parser's results
+        StreamLinks(task, *stream, g.pageContent, true);
+        g.matchURLVector.clear();
+        for(const LinkSpan& span : stream->accepted)
+          {
+            g.matchURLVector.push_back(GrepVars::CIteratorPair(g.pageContent.begin() + span.begin,
+                                                               g.pageContent.begin() + span.end));
+          }
+        g.linksStreamed = true;
+      }
+
+    std::shared_ptr<HttpValidators> validators;
+    if (nullptr != shared->pageCache && (notModified || !result.validators.empty()))
+      validators = std::make_shared<HttpValidators>(std::move(result.validators));
+
+    WebGrep::CallableDoubleFunc dfunc;
+    dfunc.functor = [shared, task, onReady, validators]()
+    {
+      if (nullptr != validators)
+        {//the disk is not touched in the I/O thread
+          ApplyPageCache(shared->pageCache, task->grepVars, *validators);
+        }
+      WorkerCtx temp = *shared;
+      onReady(task, temp);
+    };
+    shared->scheduleFunctor(std::move(dfunc));
+  }, std::move(onData), condHeaders);
+}
+#endif//WITH_CURL_MULTI
+
 //---------------------------------------------------------------
 LonelyTask::LonelyTask() : target(nullptr), action(nullptr), additional(nullptr)
 {
@@ -6,10 +6,20 @@
 #include <thread>
 #include <condition_variable>
 #include "client_http.hpp"
+#ifdef WITH_CURL_MULTI
+#include "http_impl/ch_multi_curl.h"
+#endif
 #include <atomic>
 #include <array>
 #include "noncopyable.hpp"
 #include "linked_task.h"
+#include "epoch_reclaimer.h"
+#include "crawl_frontier.h"
+#include "page_cache.h"
+#include "response_gate.h"
+#include "results_sink.h"
+#include "crawl_checkpoint.h"
+#include "metrics.h"
 
 #define CRAWLER_WORKER_USE_REGEXP 0
 
@@ -21,6 +31,24 @@ struct LonelyTask;
 typedef std::function<void()> CallableFunc_t;
 typedef std::function<void(std::shared_ptr<LinkedTask> rootNode, LinkedTask* node)> NodeScanCallback_t;
 
+//---------------------------------------------------------------
+/** The crawl's stages measured by the workers and the pool, taken from the registry once.
+ *  The histograms are named "webgrep_<stage>_seconds", see the constructor.*/
+struct CrawlMetrics
+{
+  /** Possible exceptions: bad_alloc.*/
+  explicit CrawlMetrics(MetricsRegistry& registry);
+
+  //DNS and connect of the new connections, the wait for the first byte, the body
+  std::shared_ptr<LatencyHistogram> connect, ttfb, download;
+  //the whole request with the redirects, FuncParseOne(), the text expression's search in it
+  std::shared_ptr<LatencyHistogram> fetch, parse, grep;
+  std::shared_ptr<MetricCounter> pagesDownloaded, pagesFailed, bytesDownloaded, matches;
+
+  //given to the ThreadsPool: the queue wait and the execution of the tasks
+  std::shared_ptr<TPool_Probes> poolProbes;
+};
+
 //---------------------------------------------------------------
 /** The structure must be copyable in such manner that
  * the original and copied resources can be used concurrently in different threads.
@@ -38,6 +66,8 @@ struct WorkerCtx
 #endif
     scheme.fill(0);
     data_ = nullptr;
+    maxPageBytes = WebGrep::ResponseGate::defaultMaxBytes;
+    releasePages = false;
   }
 
   //--------------------------------------------------------
@@ -47,6 +77,42 @@ struct WorkerCtx
 
   std::shared_ptr<LinkedTask> rootNode;
 
+  /** Keeps the scheduled nodes from being released by RetireList() until the tasks are done,
+   *  set by scheduleBranchExec(), the copies of the context share it.*/
+  std::shared_ptr<WebGrep::EpochGuard> treePin;
+
+  /** When not NULL scheduleBranchExec() queues the nodes here, the pool takes
+   *  the best of them by the frontier's policy.*/
+  std::shared_ptr<WebGrep::CrawlFrontier> frontier;
+
+  /** The host's request slot taken by the frontier for this page,
+   *  the download releases it with the response's code. Not inherited by the scheduled children.*/
+  std::shared_ptr<WebGrep::HostSlot> hostSlot;
+
+  /** The page's body limit for the blocking downloads (see ResponseGate), 0 -- no limit.*/
+  size_t maxPageBytes;
+
+  /** When not NULL the cached pages are downloaded by conditional GET,
+   *  304 Not Modified takes the page from the cache, the fresh pages are stored there.*/
+  std::shared_ptr<WebGrep::PageCache> pageCache;
+
+  /** When not NULL each page's results are written here by FuncFinishPage(),
+   *  with (releasePages) the page's content and matches are dropped from the node then.*/
+  std::shared_ptr<WebGrep::ResultsSink> resultsSink;
+  bool releasePages;
+
+  /** When not NULL FuncFinishPage() records each page and it's links to resume the crawl.*/
+  std::shared_ptr<WebGrep::CrawlCheckpoint> checkpoint;
+
+  /** When not NULL the downloads and the parsing are measured there.*/
+  std::shared_ptr<const WebGrep::CrawlMetrics> metrics;
+
+#ifdef WITH_CURL_MULTI
+  /** When not NULL FuncDownloadGrepRecursive() downloads the pages with it,
+   *  the parsing is scheduled by scheduleFunctor() when a page is ready.*/
+  std::shared_ptr<WebGrep::FetchEngine> fetchEngine;
+#endif
+
   /** An array of expression to grep URLs from the web pages.*/
 #if CRAWLER_WORKER_USE_REGEXP
   std::vector<std::regex> urlGrepExpressions; //sometimes we do it without regexp.
@@ -61,8 +127,8 @@ struct WorkerCtx
    * The pointer is not used, it's object is copied */
   std::function<void(const LonelyTask*)> scheduleTask;
 
-  /** Call this one to schedule any task:*/
-  std::function<void(CallableDoubleFunc)> scheduleFunctor;
+  /** Call this one to schedule any task, the task is moved to the pool:*/
+  std::function<void(CallableDoubleFunc&&)> scheduleFunctor;
 
   /** This is a hack to work with a thread handle to serialize sequential
    *  functors to one thread. Be careful with the data.*/
@@ -89,6 +155,11 @@ struct WorkerCtx
    * @return number of items scheduled. */
   size_t scheduleBranchExec(LinkedTask* node, WorkFunc_t method, uint32_t skipCount = 0, bool spray = true);
 
+  /** schedule the (nodes) of any levels to be executed by given method, each by itself:
+   *  e.g. the pending pages of a resumed crawl (see CrawlCheckpoint::Restore()).
+   * @return number of items scheduled. */
+  size_t scheduleNodesExec(const std::vector<LinkedTask*>& nodes, WorkFunc_t method);
+
   /** schedule all all nodes of the branch(by .next item) to be executed by given functor.
    * @return number of items scheduled. */
   size_t scheduleBranchExecFunctor(LinkedTask* task, std::function<void(LinkedTask*)> functor,
@@ -114,15 +185,31 @@ struct LonelyTask
 */
 bool FuncDownloadOne(LinkedTask* task, WorkerCtx& w);
 
-/** Calls FuncDownloadOne(task, w) if FALSE == (volatile bool)task->grepVars.pageIsReady,
- *  then if the download is successfull it'll grep the http:// and href= links from the page,
+/** Greps the text and the http:// and href= links from the downloaded page (task->grepVars.pageContent),
  *  the results are stored in a container of type (vector<pair<string::const_iterator,string::const_iterator>>)
  *  at variable (task->grepVars.matchURLVector and task->grepVars.matchTextVector)
  *  where each pair of const iterators points to the begin and the end of matched strings
  *  in task->grepVars.pageContent, the iterators are valid until grepVars.pageContent exists.
 */
+bool FuncParseOne(LinkedTask* task, WorkerCtx& w);
+
+/** Calls FuncDownloadOne(task, w), then FuncParseOne(task, w) if the download is successfull.
+ *  The pages disallowed by robots.txt are not downloaded (see FuncRobotsAllow()).*/
 bool FuncGrepOne(LinkedTask* task, WorkerCtx& w);
 
+/** Check the task's URL by robots.txt of it's host, the robots.txt is downloaded
+ *  by w.httpClient once per crawl and kept in task->robotsCache, the call waits for it.
+ *  FuncDownloadGrepRecursive() doesn't wait when there is w.frontier: the host's pages are held
+ *  there while it's robots.txt is downloading (by w.fetchEngine if there is), the page is queued again.
+ *  @return TRUE if the page is allowed or there is no robotsCache.*/
+bool FuncRobotsAllow(LinkedTask* task, WorkerCtx& w);
+
+/** The page is done (downloaded, parsed and it's level is spawned, or failed):
+ *  write it's results to w.resultsSink and w.checkpoint, then release task->grepVars.pageContent
+ *  and the matches if w.releasePages. The first page of the crawl (the root) is kept,
+ *  the crawl continues by it's links after stop(). Does nothing if there is no sink or checkpoint.*/
+void FuncFinishPage(LinkedTask* task, WorkerCtx& w);
+
 /** Call FuncDownloadOne(task,w) multiple times: once for each new http:// URL
  *  in a page's content. It won't use recursion, but will utilize appropriate
  *  callbacks to put new tasks as functors in a multithreaded work queue.
@@ -134,6 +221,17 @@ bool FuncGrepOne(LinkedTask* task, WorkerCtx& w);
  *  until counter's limit is reached.
 */
 bool FuncDownloadGrepRecursive(LinkedTask* task, WorkerCtx& w);
+
+#ifdef WITH_CURL_MULTI
+/** Issue download of the task's page by w.fetchEngine and return immediately.
+ *  When the page is ready (onReady)(task, w_copy) is scheduled by w.scheduleFunctor().
+ *  @param streamLinks: TRUE to scan the links while the page is downloading,
+ *  each accepted link is spawned on the task's child level and FuncDownloadGrepRecursive
+ *  is scheduled for it right away; task->grepVars.linksStreamed is set then.
+ *  Works if task->visitedSet is set, the page is parsed after the download otherwise.
+ *  @return FALSE if the request has not been issued.*/
+bool FuncFetchAsync(LinkedTask* task, WorkerCtx& w, WorkerCtx::WorkFunc_t onReady, bool streamLinks = false);
+#endif
 //---------------------------------------------------------------
 
 
@@ -0,0 +1,147 @@
+#include "epoch_reclaimer.h"
+#include <iostream>
+
+namespace WebGrep {
+
+EpochReclaimer::EpochReclaimer()
+{
+  d_epoch.store(2);
+  d_readers[0].store(0);
+  d_readers[1].store(0);
+  d_pending.store(0);
+}
+
+EpochReclaimer::~EpochReclaimer()
+{
+  std::vector<Retired> items;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    items.swap(retired);
+  }
+  Invoke(items);
+}
+
+EpochReclaimer& EpochReclaimer::Global()
+{
+  static EpochReclaimer instance;
+  return instance;
+}
+
+uint64_t EpochReclaimer::pin()
+{
+  for(;;)
+    {
+      uint64_t e = d_epoch.load();
+      d_readers[e & 1].fetch_add(1);
+      //the epoch could have moved on before the counter's increment,
+      //the reader must be counted in the current epoch's slot:
+      if (e == d_epoch.load())
+        return e;
+      d_readers[e & 1].fetch_sub(1);
+    }
+}
+
+void EpochReclaimer::unpin(uint64_t epoch)
+{
+  d_readers[epoch & 1].fetch_sub(1);
+}
+
+void EpochReclaimer::tryAdvance()
+{
+  //the slot of (e + 1) is the slot of (e - 1): it must be empty
+  uint64_t e = d_epoch.load();
+  if (0 == d_readers[(e + 1) & 1].load())
+    d_epoch.compare_exchange_strong(e, e + 1);
+}
+
+void EpochReclaimer::retire(const void* tag, Deleter_t&& deleter)
+{
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    retired.push_back(Retired{d_epoch.load(), tag, std::move(deleter)});
+    d_pending.fetch_add(1);
+  }
+  collect();
+}
+
+size_t EpochReclaimer::collect()
+{
+  if (0 == d_pending.load())
+    return 0;
+
+  std::vector<Retired> ready;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    tryAdvance();
+    tryAdvance();
+    uint64_t e = d_epoch.load();
+    size_t keep = 0;
+    for(size_t idx = 0; idx < retired.size(); ++idx)
+      {
+        if (retired[idx].epoch + 2 <= e)
+          {
+            ++inflight[retired[idx].tag];
+            ready.push_back(std::move(retired[idx]));
+          }
+        else if (keep++ != idx)
+          retired[keep - 1] = std::move(retired[idx]);
+      }
+    retired.resize(keep);
+    d_pending.fetch_sub(ready.size());
+  }
+  //the deleters may take other locks, call them unlocked:
+  return Invoke(ready);
+}
+
+size_t EpochReclaimer::drain(const void* tag)
+{
+  std::vector<Retired> ready;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    size_t keep = 0;
+    for(size_t idx = 0; idx < retired.size(); ++idx)
+      {
+        if (tag == retired[idx].tag)
+          {
+            ++inflight[tag];
+            ready.push_back(std::move(retired[idx]));
+          }
+        else if (keep++ != idx)
+          retired[keep - 1] = std::move(retired[idx]);
+      }
+    retired.resize(keep);
+    d_pending.fetch_sub(ready.size());
+  }
+  size_t cnt = Invoke(ready);
+  //collect() in another thread may be running the deleters of (tag) taken before:
+  std::unique_lock<std::mutex> lk(mu);
+  inflightCv.wait(lk, [this, tag]() { return 0 == inflight.count(tag); });
+  return cnt;
+}
+
+size_t EpochReclaimer::Invoke(std::vector<Retired>& items)
+{
+  size_t cnt = 0;
+  for(Retired& item : items)
+    {
+      try {
+        item.deleter();
+        ++cnt;
+      } catch(std::exception& ex)
+      {
+        std::cerr << __FUNCTION__ << " " << ex.what() << std::endl;
+      }
+      item.deleter = nullptr;
+      std::lock_guard<std::mutex> lk(mu); (void)lk;
+      auto iter = inflight.find(item.tag);
+      if (inflight.end() != iter && 0 == --(iter->second))
+        {
+          inflight.erase(iter);
+          inflightCv.notify_all();
+        }
+    }
+  items.clear();
+  return cnt;
+}
+
+}//WebGrep
@@ -0,0 +1,113 @@
+#ifndef EPOCH_RECLAIMER_H
+#define EPOCH_RECLAIMER_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+/** Deferred release of the tree's items that may be read concurrently.
+ *  A reader pins the current epoch (EpochGuard) while it holds the pointers to the items,
+ *  a writer unlinks a subtree and retire()s it: the subtree is deleted
+ *  when all readers that have pinned before the unlinking are gone.
+ *
+ *  There are 2 readers' counters indexed by the epoch's parity,
+ *  the epoch is advanced when the counter of the previous epoch is zero,
+ *  the items retired at epoch R are released when the epoch is R + 2 or later.
+ *  pin() and unpin() are atomic increments/decrements -- lock-free, no registration of threads,
+ *  a pin may be released by another thread (a task carries it through the pool's queue).
+ *  retire(), collect() use a mutex, they're rare.
+*/
+class EpochReclaimer : public WebGrep::noncopyable
+{
+public:
+  typedef std::function<void()> Deleter_t;
+
+  EpochReclaimer();
+  //calls the deleters of all items that are left
+  ~EpochReclaimer();
+
+  //the instance for LinkedTask trees
+  static EpochReclaimer& Global();
+
+  /** Enter a read section.
+   * @return pinned epoch to be passed to unpin(). */
+  uint64_t pin();
+  void unpin(uint64_t epoch);
+
+  /** Queue (deleter) to be called when there are no readers that may see the item, then collect().
+   * @param tag: owner of the item, see drain(). */
+  void retire(const void* tag, Deleter_t&& deleter);
+
+  /** Advance the epoch if possible and call the deleters of the released items.
+   *  Cheap when there is nothing retired.
+   * @return count of deleters called. */
+  size_t collect();
+
+  /** Call the deleters of the items retired with (tag) right away,
+   *  when the caller knows there are no readers: e.g. the tree is being destroyed.
+   *  Returns when the deleters of (tag) that collect() runs in other threads are done too.*/
+  size_t drain(const void* tag);
+
+  size_t pending() const { return d_pending.load(); }
+  uint64_t epoch() const { return d_epoch.load(); }
+
+protected:
+  struct Retired
+  {
+    uint64_t epoch;
+    const void* tag;
+    Deleter_t deleter;
+  };
+
+  void tryAdvance();
+  //calls the deleters, (inflight) of their tags is decremented after each one
+  size_t Invoke(std::vector<Retired>& items);
+
+  std::atomic<uint64_t> d_epoch;
+  std::atomic<size_t> d_readers[2];
+  std::atomic<size_t> d_pending;
+  std::mutex mu;//< guards (retired), (inflight)
+  std::condition_variable inflightCv;
+  std::vector<Retired> retired;
+  //count of the deleters taken out of (retired) and not finished yet, by the tag
+  std::unordered_map<const void*, size_t> inflight;
+};
+
+//---------------------------------------------------------------
+/** Keeps the epoch pinned while it lives, movable.
+ *  Share it by a shared_ptr to keep the items alive along with the tasks that reference them.*/
+class EpochGuard
+{
+public:
+  explicit EpochGuard(EpochReclaimer& reclaimer = EpochReclaimer::Global())
+    : r(&reclaimer), e(reclaimer.pin())
+  { }
+
+  EpochGuard(EpochGuard&& other) : r(other.r), e(other.e)
+  { other.r = nullptr; }
+
+  EpochGuard(const EpochGuard&) = delete;
+  EpochGuard& operator = (const EpochGuard&) = delete;
+  EpochGuard& operator = (EpochGuard&&) = delete;
+
+  ~EpochGuard()
+  {
+    if (nullptr != r)
+      r->unpin(e);
+  }
+
+protected:
+  EpochReclaimer* r;
+  uint64_t e;
+};
+
+}//WebGrep
+
+#endif // EPOCH_RECLAIMER_H
@@ -0,0 +1,764 @@
+#include "grep_engine.h"
+#include <map>
+#include <bitset>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+namespace WebGrep {
+
+typedef std::bitset<256> ByteSet;
+
+//limits for the patterns AutomatonGrep accepts, StdRegexGrep is used above them
+static const int maxRepeatCount = 1000;
+static const size_t maxNfaStates = 50000;
+//the DFA cache is flushed when it grows above that
+static const size_t maxDfaStates = 1024;
+
+//---------------------------------------------------------------
+std::shared_ptr<const GrepEngine> GrepEngine::Create(const std::string& pattern, GrepEngineKind kind)
+{
+  if (GrepEngineKind::AUTOMATON == kind)
+    {
+      std::shared_ptr<AutomatonGrep> engine = AutomatonGrep::Compile(pattern);
+      if (nullptr != engine)
+        return engine;
+    }
+  return std::make_shared<StdRegexGrep>(pattern);
+}
+
+//---------------------------------------------------------------
+StdRegexGrep::StdRegexGrep(const std::string& pattern) : expr(pattern)
+{
+  d_pattern = pattern;
+}
+
+bool StdRegexGrep::search(const char* text, size_t len, std::vector<GrepMatch>& groups) const
+{
+  groups.clear();
+  std::cmatch matched;
+  if (!std::regex_search(text, text + len, matched, expr))
+    return false;
+  for(size_t idx = 0; idx < matched.size(); ++idx)
+    {
+      GrepMatch m;
+      m.begin = matched.position(idx);
+      m.end = m.begin + matched.length(idx);
+      groups.push_back(m);
+    }
+  return true;
+}
+
+//---------------------------------------------------------------
+// Syntax tree of the pattern, the nodes refer to each other by index.
+struct AstNode
+{
+  enum Kind { EMPTY, BYTES, CAT, ALT, REPEAT };
+  Kind kind;
+  int cls;        //< BYTES: index of the byte set
+  int left, right;//< CAT, ALT: operands, REPEAT: (left) only
+  int min, max;   //< REPEAT: (max < 0) is infinity
+};
+
+class PatternParser
+{
+public:
+  explicit PatternParser(const std::string& pattern) : p(pattern), pos(0), ok(true) { }
+
+  //@return root node index or -1 on unsupported or invalid syntax
+  int parse()
+  {
+    int root = parseAlt();
+    if (!ok || pos != p.size())
+      return -1;
+    return root;
+  }
+
+  std::vector<AstNode> nodes;
+  std::vector<ByteSet> classes;
+
+protected:
+  bool more() const { return pos < p.size(); }
+  char peek() const { return p[pos]; }
+  int fail() { ok = false; return -1; }
+
+  int add(AstNode::Kind kind, int left = -1, int right = -1)
+  {
+    AstNode n;
+    n.kind = kind;
+    n.cls = -1;
+    n.left = left;
+    n.right = right;
+    n.min = n.max = 0;
+    nodes.push_back(n);
+    return (int)nodes.size() - 1;
+  }
+
+  int addBytes(const ByteSet& set)
+  {
+    classes.push_back(set);
+    int idx = add(AstNode::BYTES);
+    nodes[idx].cls = (int)classes.size() - 1;
+    return idx;
+  }
+
+  int parseAlt()
+  {
+    int left = parseCat();
+    while(ok && more() && '|' == peek())
+      {
+        ++pos;
+        int right = parseCat();
+        left = add(AstNode::ALT, left, right);
+      }
+    return left;
+  }
+
+  int parseCat()
+  {
+    int node = -1;
+    while(ok && more() && '|' != peek() && ')' != peek())
+      {
+        int atom = parseRepeat();
+        node = (node < 0)? atom : add(AstNode::CAT, node, atom);
+      }
+    return (node < 0)? add(AstNode::EMPTY) : node;
+  }
+
+  static bool isQuantifier(char c) { return '*' == c || '+' == c || '?' == c || '{' == c; }
+
+  int parseRepeat()
+  {
+    int atom = parseAtom();
+    if (!ok || !more() || !isQuantifier(peek()))
+      return atom;
+
+    int min = 0, max = -1;
+    char c = p[pos++];
+    if ('+' == c)
+      min = 1;
+    else if ('?' == c)
+      max = 1;
+    else if ('{' == c && !parseCount(min, max))
+      return fail();
+
+    if (more() && isQuantifier(peek()))
+      return fail();//lazy quantifier or a syntax error
+    int rep = add(AstNode::REPEAT, atom);
+    nodes[rep].min = min;
+    nodes[rep].max = max;
+    return rep;
+  }
+
+  //{n} {n,} {n,m}, the position is after '{'
+  bool parseCount(int& min, int& max)
+  {
+    if (!readNumber(min))
+      return false;
+    max = min;
+    if (more() && ',' == peek())
+      {
+        ++pos;
+        max = -1;
+        if (more() && '}' != peek() && !readNumber(max))
+          return false;
+      }
+    if (!more() || '}' != peek())
+      return false;
+    ++pos;
+    return min <= maxRepeatCount && max <= maxRepeatCount && (max < 0 || max >= min);
+  }
+
+  bool readNumber(int& value)
+  {
+    size_t begin = pos;
+    value = 0;
+    for(; more() && peek() >= '0' && peek() <= '9' && value <= maxRepeatCount; ++pos)
+      value = value * 10 + (peek() - '0');
+    return pos != begin;
+  }
+
+  int parseAtom()
+  {
+    char c = p[pos++];
+    ByteSet set;
+    switch(c)
+      {
+      case '(':
+        {
+          if (more() && '?' == peek())
+            {//only (?: ) is supported, not the lookahead
+              if (pos + 1 >= p.size() || ':' != p[pos + 1])
+                return fail();
+              pos += 2;
+            }
+          int inner = parseAlt();
+          if (!ok || !more() || ')' != peek())
+            return fail();
+          ++pos;
+          return inner;
+        }
+      case '[':
+        return parseClass();
+      case '.':
+        set.set();
+        set.reset('\n');
+        set.reset('\r');
+        return addBytes(set);
+      case '\\':
+        if (!parseEscape(set, false))
+          return fail();
+        return addBytes(set);
+      case '^': case '$': case ')': case ']': case '}':
+      case '*': case '+': case '?': case '{':
+        return fail();
+      default:
+        set.set((unsigned char)c);
+        return addBytes(set);
+      }
+  }
+
+  static void setRange(ByteSet& set, int lo, int hi)
+  {
+    for(int b = lo; b <= hi; ++b)
+      set.set(b);
+  }
+
+  static int hexValue(char c)
+  {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  //the position is after '\\'
+  bool parseEscape(ByteSet& set, bool inClass)
+  {
+    if (!more())
+      return false;
+    char c = p[pos++];
+    switch(c)
+      {
+      case 'd': case 'D':
+        setRange(set, '0', '9');
+        break;
+      case 'w': case 'W':
+        setRange(set, 'a', 'z');
+        setRange(set, 'A', 'Z');
+        setRange(set, '0', '9');
+        set.set('_');
+        break;
+      case 's': case 'S':
+        for(char sp : std::string(" \t\n\v\f\r"))
+          set.set((unsigned char)sp);
+        break;
+      case 't': set.set('\t'); return true;
+      case 'n': set.set('\n'); return true;
+      case 'r': set.set('\r'); return true;
+      case 'f': set.set('\f'); return true;
+      case 'v': set.set('\v'); return true;
+      case '0':
+        if (more() && peek() >= '0' && peek() <= '9')
+          return false;
+        set.set(0);
+        return true;
+      case 'x':
+        {
+          if (pos + 2 > p.size() || hexValue(p[pos]) < 0 || hexValue(p[pos + 1]) < 0)
+            return false;
+          set.set(hexValue(p[pos]) * 16 + hexValue(p[pos + 1]));
+          pos += 2;
+          return true;
+        }
+      case 'b':
+        if (!inClass)
+          return false;//word boundary
+        set.set('\b');
+        return true;
+      default:
+        //backreferences, \B, \c, \u and the rest
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+          return false;
+        set.set((unsigned char)c);
+        return true;
+      }
+    if ('D' == c || 'W' == c || 'S' == c)
+      set.flip();
+    return true;
+  }
+
+  static int singleByte(const ByteSet& set)
+  {
+    if (1 != set.count())
+      return -1;
+    int b = 0;
+    for(; !set[b]; ++b) { }
+    return b;
+  }
+
+  //the position is after '['
+  int parseClass()
+  {
+    bool negate = false;
+    if (more() && '^' == peek())
+      {
+        negate = true;
+        ++pos;
+      }
+    ByteSet set;
+    for(;;)
+      {
+        if (!more())
+          return fail();
+        char c = p[pos++];
+        if (']' == c)
+          break;
+
+        ByteSet item;
+        if ('\\' == c)
+          {
+            if (!parseEscape(item, true))
+              return fail();
+          }
+        else
+          {
+            item.set((unsigned char)c);
+          }
+        int lo = singleByte(item);
+        //a range like a-z, the '-' before ']' is a literal
+        if (lo >= 0 && pos + 1 < p.size() && '-' == p[pos] && ']' != p[pos + 1])
+          {
+            ++pos;
+            ByteSet upper;
+            char h = p[pos++];
+            if ('\\' == h)
+              {
+                if (!parseEscape(upper, true))
+                  return fail();
+              }
+            else
+              {
+                upper.set((unsigned char)h);
+              }
+            int hi = singleByte(upper);
+            if (hi < lo)
+              return fail();
+            setRange(item, lo, hi);
+          }
+        set |= item;
+      }
+    if (negate)
+      set.flip();
+    return addBytes(set);
+  }
+
+  const std::string& p;
+  size_t pos;
+  bool ok;
+};
+
+//---------------------------------------------------------------
+struct NfaState
+{
+  enum Type { BYTES, SPLIT, MATCH };
+  Type type;
+  int out, out1;
+  int cls;//< BYTES: index in Program::classes
+};
+
+struct AutomatonGrep::Program
+{
+  std::vector<NfaState> states;
+  std::vector<ByteSet> classes;
+  int start;
+};
+
+/** Thompson's construction: each node is emitted in front of it's continuation (next),
+ *  the reversed program matches the reversed text.*/
+class NfaBuilder
+{
+public:
+  NfaBuilder(const PatternParser& parser, bool reversed, AutomatonGrep::Program& program)
+    : ast(parser), rev(reversed), prog(program), ok(true)
+  {
+    prog.classes = ast.classes;
+  }
+
+  bool build(int root)
+  {
+    int match = add(NfaState::MATCH, -1, -1);
+    prog.start = emit(root, match);
+    return ok;
+  }
+
+protected:
+  int add(NfaState::Type type, int out, int out1, int cls = -1)
+  {
+    NfaState st;
+    st.type = type;
+    st.out = out;
+    st.out1 = out1;
+    st.cls = cls;
+    prog.states.push_back(st);
+    return (int)prog.states.size() - 1;
+  }
+
+  int emit(int node, int next)
+  {
+    if (!ok || prog.states.size() > maxNfaStates)
+      {
+        ok = false;
+        return next;
+      }
+    const AstNode n = ast.nodes[node];
+    switch(n.kind)
+      {
+      case AstNode::EMPTY:
+        return next;
+      case AstNode::BYTES:
+        return add(NfaState::BYTES, next, -1, n.cls);
+      case AstNode::CAT:
+        return rev? emit(n.right, emit(n.left, next)) : emit(n.left, emit(n.right, next));
+      case AstNode::ALT:
+        {
+          int left = emit(n.left, next);
+          int right = emit(n.right, next);
+          return add(NfaState::SPLIT, left, right);
+        }
+      case AstNode::REPEAT:
+        {
+          int cur = next;
+          if (n.max < 0)
+            {//the x* tail
+              int loop = add(NfaState::SPLIT, -1, next);
+              int body = emit(n.left, loop);
+              prog.states[loop].out = body;
+              cur = loop;
+            }
+          else
+            {//optional tail (x(x)?)? of (max - min) items
+              for(int cnt = n.min; cnt < n.max; ++cnt)
+                {
+                  int body = emit(n.left, cur);
+                  cur = add(NfaState::SPLIT, body, next);
+                }
+            }
+          for(int cnt = 0; cnt < n.min; ++cnt)
+            cur = emit(n.left, cur);
+          return cur;
+        }
+      }
+    return next;
+  }
+
+  const PatternParser& ast;
+  bool rev;
+  AutomatonGrep::Program& prog;
+  bool ok;
+};
+
+//---------------------------------------------------------------
+struct DfaState
+{
+  std::vector<int> nfa;//< sorted NFA states: BYTES and MATCH only
+  bool match;
+  int next[256];       //< -2: not computed yet, -1: dead
+};
+
+struct Dfa
+{
+  Dfa() : start(-1), gen(0) { }
+
+  void flush()
+  {
+    states.clear();
+    index.clear();
+    start = -1;
+  }
+
+  std::vector<std::unique_ptr<DfaState>> states;
+  std::map<std::vector<int>, int> index;
+  int start;
+
+  //marks of the visited NFA states for the closures
+  std::vector<uint32_t> marks;
+  uint32_t gen;
+  std::vector<int> stack;
+};
+
+struct AutomatonGrep::DfaCache
+{
+  Dfa forward;//< anchored, finds the match's end
+  Dfa reverse;//< unanchored, finds the leftmost start
+};
+
+static void AddClosure(const AutomatonGrep::Program& prog, Dfa& dfa, int first, std::vector<int>& out)
+{
+  dfa.stack.clear();
+  dfa.stack.push_back(first);
+  while(!dfa.stack.empty())
+    {
+      int s = dfa.stack.back();
+      dfa.stack.pop_back();
+      if (dfa.marks[s] == dfa.gen)
+        continue;
+      dfa.marks[s] = dfa.gen;
+      const NfaState& st = prog.states[s];
+      if (NfaState::SPLIT == st.type)
+        {
+          dfa.stack.push_back(st.out1);
+          dfa.stack.push_back(st.out);
+        }
+      else
+        {
+          out.push_back(s);
+        }
+    }
+}
+
+static void NextGeneration(const AutomatonGrep::Program& prog, Dfa& dfa)
+{
+  if (dfa.marks.size() != prog.states.size() || 0 == ++dfa.gen)
+    {
+      dfa.marks.assign(prog.states.size(), 0);
+      dfa.gen = 1;
+    }
+}
+
+static int InternState(const AutomatonGrep::Program& prog, Dfa& dfa, std::vector<int>& set)
+{
+  std::sort(set.begin(), set.end());
+  auto iter = dfa.index.find(set);
+  if (iter != dfa.index.end())
+    return iter->second;
+  if (dfa.states.size() >= maxDfaStates)
+    dfa.flush();
+
+  std::unique_ptr<DfaState> st(new DfaState);
+  st->match = false;
+  for(int s : set)
+    st->match = st->match || (NfaState::MATCH == prog.states[s].type);
+  std::fill(st->next, st->next + 256, -2);
+  st->nfa = set;
+  int idx = (int)dfa.states.size();
+  dfa.states.push_back(std::move(st));
+  dfa.index[set] = idx;
+  return idx;
+}
+
+static int StartState(const AutomatonGrep::Program& prog, Dfa& dfa)
+{
+  if (dfa.start >= 0)
+    return dfa.start;
+  std::vector<int> set;
+  NextGeneration(prog, dfa);
+  AddClosure(prog, dfa, prog.start, set);
+  dfa.start = InternState(prog, dfa, set);
+  return dfa.start;
+}
+
+//@return next DFA state, -1 if it's dead
+static int Step(const AutomatonGrep::Program& prog, Dfa& dfa, int cur, unsigned char byte, bool unanchored)
+{
+  int next = dfa.states[cur]->next[byte];
+  if (next > -2)
+    return next;
+
+  std::vector<int> set;
+  NextGeneration(prog, dfa);
+  for(int s : dfa.states[cur]->nfa)
+    {
+      const NfaState& st = prog.states[s];
+      if (NfaState::BYTES == st.type && prog.classes[st.cls][byte])
+        AddClosure(prog, dfa, st.out, set);
+    }
+  if (unanchored)
+    {//a match may start at any position
+      AddClosure(prog, dfa, prog.start, set);
+    }
+  if (set.empty())
+    {
+      dfa.states[cur]->next[byte] = -1;
+      return -1;
+    }
+  size_t count = dfa.states.size();
+  next = InternState(prog, dfa, set);
+  if (dfa.states.size() >= count)
+    {//the cache is not flushed, (cur) is valid
+      dfa.states[cur]->next[byte] = next;
+    }
+  return next;
+}
+
+//---------------------------------------------------------------
+//the top level sequence of the pattern
+static void FlattenCat(const PatternParser& parser, int node, std::vector<int>& items)
+{
+  const AstNode& n = parser.nodes[node];
+  if (AstNode::CAT == n.kind)
+    {
+      FlattenCat(parser, n.left, items);
+      FlattenCat(parser, n.right, items);
+      return;
+    }
+  items.push_back(node);
+}
+
+AutomatonGrep::AutomatonGrep() : pureLiteral(false), literalPrefix(false)
+{
+
+}
+
+AutomatonGrep::~AutomatonGrep()
+{
+
+}
+
+std::shared_ptr<AutomatonGrep> AutomatonGrep::Compile(const std::string& pattern)
+{
+  PatternParser parser(pattern);
+  int root = parser.parse();
+  if (root < 0)
+    return nullptr;
+
+  std::shared_ptr<AutomatonGrep> engine(new AutomatonGrep);
+  engine->d_pattern = pattern;
+  engine->forward.reset(new Program);
+  engine->reverse.reset(new Program);
+  if (!NfaBuilder(parser, false, *engine->forward).build(root)
+      || !NfaBuilder(parser, true, *engine->reverse).build(root))
+    {
+      return nullptr;
+    }
+
+  //the longest run of single bytes in the top level sequence must be in each match
+  std::vector<int> items;
+  FlattenCat(parser, root, items);
+  std::string run;
+  bool pure = true;
+  size_t prefixLen = 0;//< count of single bytes the sequence starts with
+  for(int node : items)
+    {
+      const AstNode& n = parser.nodes[node];
+      const ByteSet& set = (AstNode::BYTES == n.kind)? parser.classes[n.cls] : ByteSet();
+      if (AstNode::BYTES == n.kind && 1 == set.count())
+        {
+          int b = 0;
+          for(; !set[b]; ++b) { }
+          run += (char)b;
+          prefixLen += pure? 1 : 0;
+          continue;
+        }
+      pure = false;
+      if (run.size() > engine->literal.size())
+        engine->literal = run;
+      run.clear();
+    }
+  if (run.size() > engine->literal.size())
+    engine->literal = run;
+  engine->pureLiteral = pure && !engine->literal.empty();
+  engine->literalPrefix = !engine->literal.empty() && prefixLen == engine->literal.size();
+  return engine;
+}
+
+static size_t FindLiteral(const char* text, size_t len, const std::string& literal)
+{
+  const size_t n = literal.size();
+  const char first = literal[0];
+  for(const char* ptr = text; len >= n && ptr <= text + len - n; ++ptr)
+    {
+      ptr = (const char*)::memchr(ptr, first, (text + len - n + 1) - ptr);
+      if (nullptr == ptr)
+        break;
+      if (0 == ::memcmp(ptr + 1, literal.data() + 1, n - 1))
+        return ptr - text;
+    }
+  return std::string::npos;
+}
+
+size_t AutomatonGrep::findLeftmost(DfaCache& cache, const char* text, size_t len) const
+{
+  Dfa& dfa = cache.reverse;
+  int cur = StartState(*reverse, dfa);
+  size_t leftmost = dfa.states[cur]->match? len : std::string::npos;
+  //a match may start at each position where the reversed automaton has matched
+  for(size_t pos = len; pos > 0; --pos)
+    {
+      cur = Step(*reverse, dfa, cur, (unsigned char)text[pos - 1], true);
+      if (cur < 0)
+        cur = StartState(*reverse, dfa);
+      else if (dfa.states[cur]->match)
+        leftmost = pos - 1;
+    }
+  return leftmost;
+}
+
+size_t AutomatonGrep::matchLongest(DfaCache& cache, const char* text, size_t len, size_t begin) const
+{
+  Dfa& dfa = cache.forward;
+  int cur = StartState(*forward, dfa);
+  size_t end = dfa.states[cur]->match? begin : std::string::npos;
+  for(size_t pos = begin; pos < len; ++pos)
+    {
+      cur = Step(*forward, dfa, cur, (unsigned char)text[pos], false);
+      if (cur < 0)
+        break;
+      if (dfa.states[cur]->match)
+        end = pos + 1;
+    }
+  return end;
+}
+
+bool AutomatonGrep::search(const char* text, size_t len, std::vector<GrepMatch>& groups) const
+{
+  groups.clear();
+  GrepMatch m;
+  size_t from = 0;//< no match starts before it
+  if (!literal.empty())
+    {//prefilter
+      size_t at = FindLiteral(text, len, literal);
+      if (std::string::npos == at)
+        return false;
+      if (literalPrefix)
+        from = at;
+      if (pureLiteral)
+        {
+          m.begin = at;
+          m.end = at + literal.size();
+          groups.push_back(m);
+          return true;
+        }
+    }
+
+  std::unique_ptr<DfaCache> cache;
+  {
+    std::lock_guard<std::mutex> lk(cacheMu); (void)lk;
+    if (!spareCaches.empty())
+      {
+        cache = std::move(spareCaches.back());
+        spareCaches.pop_back();
+      }
+  }
+  if (nullptr == cache)
+    cache.reset(new DfaCache);
+
+  //the text is scanned once backward and once forward from the match's start
+  m.begin = findLeftmost(*cache, text + from, len - from);
+  m.end = std::string::npos;
+  if (std::string::npos != m.begin)
+    {
+      m.begin += from;
+      m.end = matchLongest(*cache, text, len, m.begin);
+    }
+  {
+    std::lock_guard<std::mutex> lk(cacheMu); (void)lk;
+    spareCaches.push_back(std::move(cache));
+  }
+  if (std::string::npos == m.end)
+    return false;
+  groups.push_back(m);
+  return true;
+}
+
+}//WebGrep
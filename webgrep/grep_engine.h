@@ -0,0 +1,117 @@
+#ifndef GREP_ENGINE_H
+#define GREP_ENGINE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+/** Position of a match: [begin, end) offsets in the text.*/
+struct GrepMatch
+{
+  size_t begin, end;
+};
+
+enum class GrepEngineKind
+{
+  AUTOMATON, //< AutomatonGrep, falls back to STD_REGEX for unsupported syntax
+  STD_REGEX  //< StdRegexGrep
+};
+
+/** Text search interface for the pages' content.
+ *  An engine is compiled once per crawl and shared by all nodes of the tree
+ *  (GrepVars::grepEngine), search() is thread-safe.
+*/
+class GrepEngine : public WebGrep::noncopyable
+{
+public:
+  virtual ~GrepEngine() { }
+
+  /** Find the first match in the text.
+   * @param groups: receives the whole match at [0] and the subgroups if the engine reports them.
+   * @return FALSE if there is no match. */
+  virtual bool search(const char* text, size_t len, std::vector<GrepMatch>& groups) const = 0;
+
+  virtual const char* name() const = 0;
+  const std::string& pattern() const { return d_pattern; }
+
+  /** Compile (pattern) with the engine of given kind.
+   *  Possible exceptions: std::regex_error for invalid pattern, bad_alloc.*/
+  static std::shared_ptr<const GrepEngine> Create(const std::string& pattern,
+                                                  GrepEngineKind kind = GrepEngineKind::AUTOMATON);
+
+protected:
+  std::string d_pattern;
+};
+
+//---------------------------------------------------------------
+/** std::regex (ECMAScript) backend: backtracking, reports all subgroups of the first match.
+ *  Kept for compatibility with the patterns that AutomatonGrep doesn't support.*/
+class StdRegexGrep : public GrepEngine
+{
+public:
+  explicit StdRegexGrep(const std::string& pattern);
+
+  bool search(const char* text, size_t len, std::vector<GrepMatch>& groups) const override;
+  const char* name() const override { return "std::regex"; }
+
+protected:
+  std::regex expr;
+};
+
+//---------------------------------------------------------------
+/** Thompson NFA run as a lazy DFA: the DFA states are made of NFA state sets on demand
+ *  and cached between the searches, so each byte of the text costs a table lookup
+ *  and there is no backtracking (no stack overflows on big pages).
+ *
+ *  A literal that each match must contain is looked up first,
+ *  the pages without it are rejected without running the automaton.
+ *  The leftmost match start is found by the reversed automaton scanning the text backward
+ *  (down to the literal's first occurrence if each match starts with it),
+ *  the end -- by the forward one from that start.
+ *
+ *  Supported syntax (ECMAScript subset): literals, escapes, '.', [classes], \d \w \s \D \W \S,
+ *  ( ) (?: ) groups, '|', '*' '+' '?' {n} {n,} {n,m}.
+ *  Not supported: anchors, \b, backreferences, lookahead, lazy quantifiers.
+ *  The match is leftmost-longest (POSIX), only the whole match is reported.
+*/
+class AutomatonGrep : public GrepEngine
+{
+public:
+  /** @return NULL if the pattern has unsupported or invalid syntax.
+   *  Possible exceptions: bad_alloc.*/
+  static std::shared_ptr<AutomatonGrep> Compile(const std::string& pattern);
+
+  virtual ~AutomatonGrep();
+
+  bool search(const char* text, size_t len, std::vector<GrepMatch>& groups) const override;
+  const char* name() const override { return "automaton"; }
+
+  struct Program;
+  struct DfaCache;
+
+protected:
+  AutomatonGrep();
+
+  //the longest end of a match that starts at (begin), npos if none
+  size_t matchLongest(DfaCache& cache, const char* text, size_t len, size_t begin) const;
+  //the leftmost start of a match, npos if none
+  size_t findLeftmost(DfaCache& cache, const char* text, size_t len) const;
+
+  std::unique_ptr<Program> forward, reverse;
+  std::string literal;//< each match contains it, can be empty
+  bool pureLiteral;   //< the pattern is (literal) itself
+  bool literalPrefix; //< each match starts with (literal)
+
+  //the DFA caches are taken by the searching threads and given back
+  mutable std::mutex cacheMu;
+  mutable std::vector<std::unique_ptr<DfaCache>> spareCaches;
+};
+
+}//WebGrep
+
+#endif // GREP_ENGINE_H
@@ -0,0 +1,165 @@
+#include "host_scheduler.h"
+#include <algorithm>
+#include <vector>
+
+namespace WebGrep {
+
+HostScheduler::HostScheduler(double requestsPerSec, unsigned burst, unsigned maxInFlight)
+  : requestsPerSec(requestsPerSec), burst(std::max(1u, burst)), maxInFlight(maxInFlight)
+{
+
+}
+
+void HostScheduler::setLimits(double rps, unsigned nburst, unsigned inFlightMax)
+{
+  std::vector<std::string> freed;
+  SlotFreedFunc_t func;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    requestsPerSec = rps;
+    burst = std::max(1u, nburst);
+    maxInFlight = inFlightMax;
+    for(auto& entry : hosts)
+      {//the raised limit frees the slots
+        HostState& h(entry.second);
+        if (h.slotWaited && (0 == maxInFlight || h.inFlight < maxInFlight))
+          {
+            h.slotWaited = false;
+            freed.push_back(entry.first);
+          }
+      }
+    func = slotFreed;
+  }
+  for(const std::string& host : freed)
+    {
+      if (nullptr != func)
+        func(host);
+    }
+}
+
+void HostScheduler::setSlotFreedFunc(SlotFreedFunc_t func)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  slotFreed = func;
+}
+
+void HostScheduler::setHostRate(const std::string& host, double rps)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  HostState& h(state(host, Clock_t::now()));
+  h.rate = rps;
+}
+
+HostScheduler::HostState& HostScheduler::state(const std::string& host, Clock_t::time_point now)
+{
+  auto iter = hosts.find(host);
+  if (hosts.end() != iter)
+    return iter->second;
+  HostState& h(hosts[host]);
+  h.tokens = (double)burst;
+  h.refilled = now;
+  return h;
+}
+
+bool HostScheduler::tryAcquire(const std::string& host, Clock_t::time_point& readyAt)
+{
+  Clock_t::time_point now = Clock_t::now();
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  HostState& h(state(host, now));
+  if (h.backoffUntil > now)
+    {
+      readyAt = h.backoffUntil;
+      return false;
+    }
+  if (0 != maxInFlight && h.inFlight >= maxInFlight)
+    {//release() reports the free slot
+      h.slotWaited = true;
+      readyAt = Clock_t::time_point::max();
+      return false;
+    }
+  double rate = requestsPerSec;
+  if (h.rate >= 0.0 && (rate <= 0.0 || h.rate < rate))
+    rate = h.rate;
+  if (rate > 0.0)
+    {
+      double elapsed = std::chrono::duration<double>(now - h.refilled).count();
+      h.tokens = std::min((double)burst, h.tokens + elapsed * rate);
+      h.refilled = now;
+      if (h.tokens < 1.0)
+        {
+          auto wait = std::chrono::duration<double>((1.0 - h.tokens) / rate);
+          readyAt = now + std::chrono::duration_cast<Clock_t::duration>(wait);
+          return false;
+        }
+      h.tokens -= 1.0;
+    }
+  ++h.inFlight;
+  return true;
+}
+
+void HostScheduler::release(const std::string& host, long responseCode, long retryAfterSec)
+{
+  Clock_t::time_point now = Clock_t::now();
+  SlotFreedFunc_t func;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    HostState& h(state(host, now));
+    if (h.inFlight > 0)
+      --h.inFlight;
+    if (429 == responseCode || 503 == responseCode)
+      {
+        ++h.failures;
+        auto delay = std::chrono::seconds(1) * (1 << std::min(6u, h.failures - 1));
+        if (retryAfterSec >= 0)
+          delay = std::chrono::seconds(retryAfterSec);
+        h.backoffUntil = std::max(h.backoffUntil, now + delay);
+      }
+    else if (responseCode > 0)
+      {
+        h.failures = 0;
+      }
+    if (h.slotWaited && (0 == maxInFlight || h.inFlight < maxInFlight))
+      {
+        h.slotWaited = false;
+        func = slotFreed;
+      }
+  }
+  if (nullptr != func)
+    func(host);
+}
+
+void HostScheduler::backoff(const std::string& host, Clock_t::duration delay)
+{
+  Clock_t::time_point now = Clock_t::now();
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  HostState& h(state(host, now));
+  h.backoffUntil = std::max(h.backoffUntil, now + delay);
+}
+
+unsigned HostScheduler::inFlight(const std::string& host)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  auto iter = hosts.find(host);
+  return (hosts.end() == iter)? 0 : iter->second.inFlight;
+}
+
+//---------------------------------------------------------------
+HostSlot::HostSlot(std::shared_ptr<HostScheduler> scheduler, const std::string& host)
+  : scheduler(scheduler), d_host(host)
+{
+  released.store(false);
+}
+
+HostSlot::~HostSlot()
+{
+  done(0);
+}
+
+void HostSlot::done(long responseCode, long retryAfterSec)
+{
+  if (nullptr == scheduler || released.exchange(true))
+    return;
+  scheduler->release(d_host, responseCode, retryAfterSec);
+}
+
+}//WebGrep
@@ -0,0 +1,108 @@
+#ifndef HOST_SCHEDULER_H
+#define HOST_SCHEDULER_H
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+/** Politeness of the crawler: limits the requests to each host ("site.com:443").
+ *  Each host has a token bucket (requests per second with a burst),
+ *  a limit of requests in flight and a backoff after 429 and 503 responses:
+ *  the delay from Retry-After header or 1, 2, 4 ... 64 seconds for the consequent failures.
+ *
+ *  CrawlFrontier consults it before it gives a page to a worker,
+ *  the pages of a host that isn't ready are parked, the workers go on with other hosts.
+ *  A host that has too many requests in flight is parked until release() frees a slot.
+ *  Thread-safe.
+*/
+class HostScheduler : public WebGrep::noncopyable
+{
+public:
+  typedef std::chrono::steady_clock Clock_t;
+  /** Called out of the lock when a slot of the (host) that has been refused
+   *  by the limit of requests in flight is free, e.g. to unpark the host's pages.*/
+  typedef std::function<void(const std::string& host)> SlotFreedFunc_t;
+
+  /** @param requestsPerSec: 0 disables the rate limit,
+   *  @param maxInFlight: 0 disables the limit of requests in flight. */
+  explicit HostScheduler(double requestsPerSec = 10.0, unsigned burst = 10, unsigned maxInFlight = 6);
+
+  //the limits of all hosts, except the rates set by setHostRate()
+  void setLimits(double requestsPerSec, unsigned burst, unsigned maxInFlight);
+
+  /** Slow down one host, e.g. by robots.txt Crawl-delay.
+   *  The rate is not raised above the common limit. */
+  void setHostRate(const std::string& host, double requestsPerSec);
+
+  /** Take a request slot of the host: a token of the bucket and an in-flight place.
+   * @param readyAt: when FALSE is returned -- the time to try again,
+   *  or Clock_t::time_point::max() if the requests in flight are too many: the slot freed
+   *  by release() is reported by SlotFreedFunc_t then.
+   * @return TRUE if the request may be issued, release() must follow. */
+  bool tryAcquire(const std::string& host, Clock_t::time_point& readyAt);
+
+  /** The request is done.
+   * @param responseCode: 429, 503 make the host back off, 0 if there was no response.
+   * @param retryAfterSec: Retry-After header's value or -1. */
+  void release(const std::string& host, long responseCode, long retryAfterSec = -1);
+
+  //NULL disables the notifications
+  void setSlotFreedFunc(SlotFreedFunc_t func);
+
+  //don't give the slots of the host for (delay)
+  void backoff(const std::string& host, Clock_t::duration delay);
+
+  unsigned inFlight(const std::string& host);
+
+protected:
+  struct HostState
+  {
+    HostState() : tokens(0.0), rate(-1.0), inFlight(0), failures(0), slotWaited(false) { }
+
+    double tokens;
+    double rate;//< the host's own rate, negative if the common one is used
+    Clock_t::time_point refilled;
+    Clock_t::time_point backoffUntil;
+    unsigned inFlight;
+    unsigned failures;//< 429/503 responses in a row
+    bool slotWaited;  //< refused by (maxInFlight), release() reports the free slot
+  };
+  HostState& state(const std::string& host, Clock_t::time_point now);
+
+  std::mutex mu;
+  double requestsPerSec;
+  unsigned burst, maxInFlight;
+  std::unordered_map<std::string, HostState> hosts;
+  SlotFreedFunc_t slotFreed;
+};
+
+//---------------------------------------------------------------
+/** A slot of HostScheduler taken for one download, released by done()
+ *  with the response's code or by the destructor if the download hasn't happened.*/
+class HostSlot : public WebGrep::noncopyable
+{
+public:
+  HostSlot(std::shared_ptr<HostScheduler> scheduler, const std::string& host);
+  ~HostSlot();
+
+  //release the slot, the next calls are ignored
+  void done(long responseCode, long retryAfterSec = -1);
+
+  const std::string& host() const { return d_host; }
+
+protected:
+  std::shared_ptr<HostScheduler> scheduler;
+  std::string d_host;
+  std::atomic_bool released;
+};
+
+}//WebGrep
+
+#endif // HOST_SCHEDULER_H
@@ -1,24 +1,52 @@
 #include "ch_ctx_curl.h"
 #include <cstring>
 #include <functional>
+#include <algorithm>
 
 
 namespace WebGrep {
 typedef std::function<void()> Ftor_t;
 static std::shared_ptr<Ftor_t> CurlGlobalCleaner;
 
-ClientCtx::ClientCtx()
-  : curl(nullptr), port(0)
+void CurlGlobalInit()
 {
-  scheme.fill(0x00);
-  status = CURL_LAST;
-
   static std::once_flag curl_once;
   std::call_once(curl_once, []() {
       curl_global_init(CURL_GLOBAL_ALL);
       CurlGlobalCleaner = std::make_shared<Ftor_t>
           ([](){curl_global_cleanup(); });
     });
+}
+
+//the phase between two marks of the transfer, seconds to microseconds
+static uint64_t PhaseUs(double from, double to)
+{
+  return (to > from)? (uint64_t)((to - from) * 1e6) : 0;
+}
+
+void CurlTimings::read(CURL* curl)
+{
+  double connectSec = 0, tlsSec = 0, pretransferSec = 0, firstByteSec = 0, totalSec = 0;
+  long connects = 0;
+  curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connectSec);
+  curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &tlsSec);
+  curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME, &pretransferSec);
+  curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &firstByteSec);
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &totalSec);
+  curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+  connected = connects > 0;
+  connectUs = connected? PhaseUs(0, std::max(connectSec, tlsSec)) : 0;
+  ttfbUs = PhaseUs(pretransferSec, firstByteSec);
+  downloadUs = PhaseUs(firstByteSec, totalSec);
+}
+
+ClientCtx::ClientCtx()
+  : curl(nullptr), port(0)
+{
+  scheme.fill(0x00);
+  status = CURL_LAST;
+
+  CurlGlobalInit();
 
   curl = nullptr;
   url.reserve(256);
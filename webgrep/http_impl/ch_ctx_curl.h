@@ -6,6 +6,7 @@
 #include <mutex>
 #include <memory>
 #include <cstring>
+#include <cstdint>
 #include <cassert>
 #include "../noncopyable.hpp"
 
@@ -27,6 +28,22 @@ public:
   void writeTo(char* dest) {::memcpy(dest, data(), size());}
 };
 
+//calls curl_global_init() once per process, it's thread-safe
+void CurlGlobalInit();
+
+/** Phases of a finished transfer, microseconds: DNS and connect (with TLS handshake)
+ *  when a new connection is made, the wait for the first byte of the response, the rest of it.*/
+struct CurlTimings
+{
+  CurlTimings() : connectUs(0), ttfbUs(0), downloadUs(0), connected(false) { }
+
+  //read them from the (curl) handle of the finished transfer
+  void read(CURL* curl);
+
+  uint64_t connectUs, ttfbUs, downloadUs;
+  bool connected;//< FALSE if the connection is reused, (connectUs) is 0 then
+};
+
 /** libneon ne_session holder*/
 class ClientCtx : public WebGrep::noncopyable
 {
@@ -1,5 +1,6 @@
 #include "ch_ctx_win32.h"
 #include <cassert>
+#include "../user_agent.h"
 
 namespace WebGrep {
 
@@ -57,7 +58,7 @@ void ClientCtx::onRedirected(const QUrl &url)
 {
   QNetworkRequest req;
   req.setUrl(url);
-  req.setRawHeader("User-Agent", "Qt5GET 1.0");
+  req.setRawHeader("User-Agent", UserAgentHeader);
   makeGet(req);
 }
 
@@ -0,0 +1,327 @@
+#include "ch_multi_curl.h"
+#include "ch_ctx_curl.h"
+#include "../user_agent.h"
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace WebGrep {
+
+//how much finished easy handles are kept for reuse
+static const size_t maxSpareHandles = 64;
+
+FetchEngine::FetchEngine(long maxConnections, long maxHostConnections)
+  : multi(nullptr), epollFd(-1), eventFd(-1), stopFlag(false), timerArmed(false)
+{
+  d_inFlight.store(0);
+  d_maxBodyBytes.store(ResponseGate::defaultMaxBytes);
+  CurlGlobalInit();
+
+  epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+  eventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  multi = curl_multi_init();
+  if (!valid())
+    {
+      std::cerr << __FUNCTION__ << " failed to initialize epoll or curl multi handle.\n";
+      return;
+    }
+  epoll_event ev;
+  ::memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = eventFd;
+  ::epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &ev);
+
+  curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, &FetchEngine::SocketCallback);
+  curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, (void*)this);
+  curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, &FetchEngine::TimerCallback);
+  curl_multi_setopt(multi, CURLMOPT_TIMERDATA, (void*)this);
+  curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, maxConnections);
+  curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, maxHostConnections);
+
+  ioThread = std::thread([this](){ loop(); });
+}
+
+FetchEngine::~FetchEngine()
+{
+  stopFlag = true;
+  if (eventFd >= 0)
+    {
+      uint64_t one = 1;
+      ssize_t n = ::write(eventFd, &one, sizeof(one)); (void)n;
+    }
+  if (ioThread.joinable())
+    ioThread.join();
+
+  for(auto& item : active)
+    {
+      curl_multi_remove_handle(multi, item.first);
+      curl_easy_cleanup(item.first);
+    }
+  active.clear();
+  for(CURL* easy : spareHandles)
+    curl_easy_cleanup(easy);
+  spareHandles.clear();
+  if (nullptr != multi)
+    curl_multi_cleanup(multi);
+  if (epollFd >= 0)
+    ::close(epollFd);
+  if (eventFd >= 0)
+    ::close(eventFd);
+}
+
+bool FetchEngine::fetch(const std::string& url, long timeoutSec, FetchCallback_t&& onDone,
+                        FetchDataCallback_t&& onData, const std::vector<std::string>& headers)
+{
+  if (!valid() || stopFlag)
+    return false;
+  try {
+    std::unique_ptr<Request> rq(new Request);
+    rq->url = url;
+    rq->timeoutSec = timeoutSec;
+    rq->onDone = std::move(onDone);
+    rq->onData = std::move(onData);
+    rq->gate.maxBytes = d_maxBodyBytes.load();
+    for(const std::string& header : headers)
+      {
+        curl_slist* appended = curl_slist_append(rq->headerList, header.c_str());
+        if (nullptr == appended)
+          throw std::bad_alloc();
+        rq->headerList = appended;
+      }
+    {
+      std::lock_guard<std::mutex> lk(mu); (void)lk;
+      pending.push_back(std::move(rq));
+    }
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << std::endl;
+    return false;
+  }
+  d_inFlight.fetch_add(1);
+  uint64_t one = 1;
+  ssize_t n = ::write(eventFd, &one, sizeof(one)); (void)n;
+  return true;
+}
+
+void FetchEngine::loop()
+{
+  static const int maxEvents = 64;
+  epoll_event events[maxEvents];
+  int running = 0;
+
+  while(!stopFlag)
+    {
+      int waitMs = 1000;
+      if (timerArmed)
+        {
+          auto left = std::chrono::duration_cast<std::chrono::milliseconds>
+              (timerDeadline - std::chrono::steady_clock::now()).count();
+          waitMs = (left < 0)? 0 : (int)std::min<long long>(left, waitMs);
+        }
+      int n = ::epoll_wait(epollFd, events, maxEvents, waitMs);
+
+      for(int idx = 0; idx < n; ++idx)
+        {
+          if (events[idx].data.fd == eventFd)
+            {
+              uint64_t cnt = 0;
+              ssize_t rd = ::read(eventFd, &cnt, sizeof(cnt)); (void)rd;
+              addPending();
+              continue;
+            }
+          int flags = 0;
+          if (events[idx].events & EPOLLIN)
+            flags |= CURL_CSELECT_IN;
+          if (events[idx].events & EPOLLOUT)
+            flags |= CURL_CSELECT_OUT;
+          if (events[idx].events & (EPOLLERR | EPOLLHUP))
+            flags |= CURL_CSELECT_ERR;
+          curl_multi_socket_action(multi, events[idx].data.fd, flags, &running);
+        }
+
+      if (timerArmed && std::chrono::steady_clock::now() >= timerDeadline)
+        {
+          timerArmed = false;
+          curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+        }
+      readDone();
+    }//while
+}
+
+void FetchEngine::addPending()
+{
+  std::vector<std::unique_ptr<Request>> fresh;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    fresh.swap(pending);
+  }
+  for(std::unique_ptr<Request>& rq : fresh)
+    {
+      CURL* easy = nullptr;
+      if (!spareHandles.empty())
+        {
+          easy = spareHandles.back();
+          spareHandles.pop_back();
+          curl_easy_reset(easy);
+        }
+      else
+        {
+          easy = curl_easy_init();
+        }
+      if (nullptr == easy)
+        {//report the failure like curl would do
+          rq->result.res = CURLE_FAILED_INIT;
+          if (rq->onDone)
+            rq->onDone(rq->result);
+          d_inFlight.fetch_sub(1);
+          continue;
+        }
+      curl_easy_setopt(easy, CURLOPT_USERAGENT, UserAgentHeader);
+      curl_easy_setopt(easy, CURLOPT_URL, rq->url.data());
+      curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+      curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+      curl_easy_setopt(easy, CURLOPT_TIMEOUT, rq->timeoutSec);
+      curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &FetchEngine::WriteCallback);
+      curl_easy_setopt(easy, CURLOPT_WRITEDATA, (void*)rq.get());
+      curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &FetchEngine::HeaderCallback);
+      curl_easy_setopt(easy, CURLOPT_HEADERDATA, (void*)rq.get());
+      if (nullptr != rq->headerList)
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, rq->headerList);
+      active[easy] = std::move(rq);
+      curl_multi_add_handle(multi, easy);
+    }
+}
+
+void FetchEngine::readDone()
+{
+  CURLMsg* msg = nullptr;
+  int left = 0;
+  while(nullptr != (msg = curl_multi_info_read(multi, &left)))
+    {
+      if (CURLMSG_DONE != msg->msg)
+        continue;
+      CURL* easy = msg->easy_handle;
+      CURLcode res = msg->data.result;
+      auto iter = active.find(easy);
+      std::unique_ptr<Request> rq;
+      if (iter != active.end())
+        {
+          rq = std::move(iter->second);
+          active.erase(iter);
+        }
+      if (nullptr != rq)
+        {
+          rq->result.res = res;
+          curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &(rq->result.responseCode));
+          rq->result.timings.read(easy);
+#if LIBCURL_VERSION_NUM >= 0x074200
+          curl_off_t retryAfter = 0;
+          if (CURLE_OK == curl_easy_getinfo(easy, CURLINFO_RETRY_AFTER, &retryAfter) && retryAfter > 0)
+            rq->result.retryAfterSec = (long)retryAfter;
+#endif
+        }
+      curl_multi_remove_handle(multi, easy);
+      if (spareHandles.size() < maxSpareHandles)
+        spareHandles.push_back(easy);
+      else
+        curl_easy_cleanup(easy);
+      if (nullptr == rq)
+        continue;
+
+      try {
+        if (rq->onDone)
+          rq->onDone(rq->result);
+      } catch(std::exception& ex)
+      {
+        std::cerr << __FUNCTION__ << " " << ex.what() << std::endl;
+      }
+      d_inFlight.fetch_sub(1);
+    }
+}
+
+int FetchEngine::SocketCallback(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp)
+{
+  (void)easy;
+  FetchEngine* self = (FetchEngine*)userp;
+  if (CURL_POLL_REMOVE == what)
+    {
+      ::epoll_ctl(self->epollFd, EPOLL_CTL_DEL, s, nullptr);
+      return 0;
+    }
+  epoll_event ev;
+  ::memset(&ev, 0, sizeof(ev));
+  ev.data.fd = s;
+  if (what & CURL_POLL_IN)
+    ev.events |= EPOLLIN;
+  if (what & CURL_POLL_OUT)
+    ev.events |= EPOLLOUT;
+
+  //(socketp) is set to non-NULL once the socket is registered
+  if (nullptr == socketp)
+    {
+      if (0 != ::epoll_ctl(self->epollFd, EPOLL_CTL_ADD, s, &ev))
+        ::epoll_ctl(self->epollFd, EPOLL_CTL_MOD, s, &ev);
+      curl_multi_assign(self->multi, s, (void*)self);
+    }
+  else
+    {
+      ::epoll_ctl(self->epollFd, EPOLL_CTL_MOD, s, &ev);
+    }
+  return 0;
+}
+
+int FetchEngine::TimerCallback(CURLM* multi, long timeoutMs, void* userp)
+{
+  (void)multi;
+  FetchEngine* self = (FetchEngine*)userp;
+  if (timeoutMs < 0)
+    {//delete the timer
+      self->timerArmed = false;
+      return 0;
+    }
+  self->timerArmed = true;
+  self->timerDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  return 0;
+}
+
+size_t FetchEngine::WriteCallback(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+  Request* rq = (Request*)userdata;
+  if (!rq->gate.onBody(size * nmemb))
+    {//too big: abort the transfer
+      rq->result.rejected = rq->gate.reason();
+      return 0L;
+    }
+  try {
+    rq->result.content.append(ptr, size * nmemb);
+    if (rq->onData && rq->gate.successful())
+      rq->onData(rq->result.content);
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << std::endl;
+    return 0L;
+  }
+  return size * nmemb;
+}
+
+size_t FetchEngine::HeaderCallback(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+  Request* rq = (Request*)userdata;
+  try {
+    rq->result.validators.parseHeaderLine(ptr, size * nmemb);
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << std::endl;
+    return 0L;
+  }
+  if (!rq->gate.onHeaderLine(ptr, size * nmemb))
+    {//not a page or too big: abort the transfer
+      rq->result.rejected = rq->gate.reason();
+      return 0L;
+    }
+  return size * nmemb;
+}
+
+}//WebGrep
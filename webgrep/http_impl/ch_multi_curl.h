@@ -0,0 +1,131 @@
+#ifndef CH_MULTI_CURL_H
+#define CH_MULTI_CURL_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include "../noncopyable.hpp"
+#include "../inline_function.h"
+#include "../page_cache.h"
+#include "../response_gate.h"
+#include "ch_ctx_curl.h"
+
+extern "C" {
+        #include "curl/curl.h"
+        #include "curl/multi.h"
+}
+
+namespace WebGrep {
+
+/** Outcome of one GET request issued by FetchEngine.*/
+struct FetchResult
+{
+  FetchResult() : res(CURL_LAST), responseCode(0), retryAfterSec(-1), rejected(nullptr) { }
+
+  CURLcode res;
+  long responseCode;
+  long retryAfterSec;//< Retry-After header of 429/503 responses, -1 if none
+  HttpValidators validators;//< ETag, Last-Modified of the last response
+  const char* rejected;//< why ResponseGate has aborted the transfer or NULL
+  CurlTimings timings;
+  std::string content;
+};
+
+/** Called from the engine's I/O thread when the request is done,
+ *  the callback may move the content from the result.
+ *  It must be short: schedule heavy work somewhere else.*/
+typedef WebGrep::InlineFunction<void(FetchResult&), 64> FetchCallback_t;
+
+/** Called from the engine's I/O thread each time a chunk of the body is appended
+ *  to (content), lets the caller look at the page while it's still downloading.
+ *  Only the successful (2xx) responses are streamed: the bodies of 429/503 pages
+ *  that are retried later don't reach it. Must be short as well and must not modify the content.*/
+typedef WebGrep::InlineFunction<void(const std::string& content), 64> FetchDataCallback_t;
+
+/** Event-driven downloader: one I/O thread runs curl_multi_socket_action()
+ *  on epoll events, so thousands of requests may be in flight at once
+ *  without blocking a thread for each one.
+ *
+ *  fetch() is thread-safe, it hands the request to the I/O thread and returns.
+ *  The destructor stops the thread, the callbacks of unfinished requests are not called.
+*/
+class FetchEngine : public WebGrep::noncopyable
+{
+public:
+  /** @param maxConnections: total limit of connections (CURLMOPT_MAX_TOTAL_CONNECTIONS),
+   *  @param maxHostConnections: limit of connections to one host,
+   *  curl keeps the requests above the limits pending.
+   *  The connections are kept alive in the multi handle's cache and reused by the next requests.*/
+  explicit FetchEngine(long maxConnections = 512, long maxHostConnections = 8);
+  virtual ~FetchEngine();
+
+  //FALSE if epoll or curl multi handle has failed to initialize
+  bool valid() const { return nullptr != multi && epollFd >= 0 && eventFd >= 0; }
+
+  /** Issue GET request for (url), (onDone) will be invoked from the I/O thread.
+   *  @param timeoutSec: whole request's timeout.
+   *  @param onData: optional, invoked on each received chunk before (onDone).
+   *  @param headers: additional request headers like "If-None-Match: \"1f-5a\"".
+   *  @return FALSE if the engine is not valid() or on bad_alloc. */
+  bool fetch(const std::string& url, long timeoutSec, FetchCallback_t&& onDone,
+             FetchDataCallback_t&& onData = FetchDataCallback_t(),
+             const std::vector<std::string>& headers = std::vector<std::string>());
+
+  /** Limit of a page's body (see ResponseGate), 0 -- no limit.
+   *  The responses that are not text pages are aborted anyway.*/
+  void setMaxBodyBytes(size_t maxBytes) { d_maxBodyBytes.store(maxBytes); }
+
+  //count of requests that are issued and not finished yet
+  size_t inFlight() const { return d_inFlight.load(); }
+
+protected:
+  struct Request
+  {
+    Request() : timeoutSec(0), headerList(nullptr) { }
+    ~Request() { if (nullptr != headerList) curl_slist_free_all(headerList); }
+
+    std::string url;
+    long timeoutSec;
+    curl_slist* headerList;//< must outlive the transfer
+    ResponseGate gate;
+    FetchResult result;
+    FetchCallback_t onDone;
+    FetchDataCallback_t onData;
+  };
+
+  void loop();
+  void addPending();  //< move submitted requests to the multi handle
+  void readDone();    //< invoke callbacks of the finished requests
+
+  static int SocketCallback(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp);
+  static int TimerCallback(CURLM* multi, long timeoutMs, void* userp);
+  static size_t WriteCallback(char* ptr, size_t size, size_t nmemb, void* userdata);
+  static size_t HeaderCallback(char* ptr, size_t size, size_t nmemb, void* userdata);
+
+  CURLM* multi;
+  int epollFd;
+  int eventFd;//< wakes up the loop on fetch() and on stop
+  volatile bool stopFlag;
+
+  //when to call curl_multi_socket_action(CURL_SOCKET_TIMEOUT), set by curl via TimerCallback
+  bool timerArmed;
+  std::chrono::steady_clock::time_point timerDeadline;
+
+  std::mutex mu;//< guards (pending)
+  std::vector<std::unique_ptr<Request>> pending;
+  std::map<CURL*, std::unique_ptr<Request>> active;//< accessed by the I/O thread only
+  std::vector<CURL*> spareHandles;//< finished handles to be reset and reused, the I/O thread only
+  std::atomic<size_t> d_inFlight;
+  std::atomic<size_t> d_maxBodyBytes;
+
+  std::thread ioThread;
+};
+
+}//WebGrep
+
+#endif // CH_MULTI_CURL_H
@@ -0,0 +1,199 @@
+#ifndef INLINE_FUNCTION_H
+#define INLINE_FUNCTION_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+namespace WebGrep {
+
+template<typename Signature, size_t Capacity = 96>
+class InlineFunction;
+
+/** Move-only replacement of std::function<R(Args...)> with inline storage.
+ *  A callable up to (Capacity) bytes is constructed right in the object,
+ *  only larger ones (or those that can throw on move) are allocated on the heap.
+ *  Moving the InlineFunction moves the callable, it's never copied.
+ *
+ *  Calling an empty object throws std::bad_function_call like std::function does.
+*/
+template<typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity>
+{
+public:
+  static const size_t capacity = Capacity;
+
+  InlineFunction() : vt(nullptr) { }
+  InlineFunction(std::nullptr_t) : vt(nullptr) { }
+
+  template<typename F,
+           typename = typename std::enable_if<
+             !std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+  InlineFunction(F&& f) : vt(nullptr)
+  {
+    assign(std::forward<F>(f));
+  }
+
+  InlineFunction(InlineFunction&& other) : vt(nullptr)
+  {
+    moveFrom(other);
+  }
+
+  InlineFunction& operator = (InlineFunction&& other)
+  {
+    if (this != &other)
+      {
+        reset();
+        moveFrom(other);
+      }
+    return *this;
+  }
+
+  InlineFunction& operator = (std::nullptr_t)
+  {
+    reset();
+    return *this;
+  }
+
+  template<typename F,
+           typename = typename std::enable_if<
+             !std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+  InlineFunction& operator = (F&& f)
+  {
+    reset();
+    assign(std::forward<F>(f));
+    return *this;
+  }
+
+  InlineFunction(const InlineFunction&) = delete;
+  InlineFunction& operator = (const InlineFunction&) = delete;
+
+  ~InlineFunction() { reset(); }
+
+  explicit operator bool() const { return nullptr != vt; }
+
+  R operator()(Args... args) const
+  {
+    if (nullptr == vt)
+      throw std::bad_function_call();
+    return vt->invoke(const_cast<void*>((const void*)&storage), std::forward<Args>(args)...);
+  }
+
+  //TRUE if the callable is placed in the inline storage
+  bool isInline() const { return nullptr != vt && vt->isInline; }
+
+  void reset()
+  {
+    if (nullptr != vt)
+      {
+        vt->destroy(&storage);
+        vt = nullptr;
+      }
+  }
+
+protected:
+  struct VTable
+  {
+    R (*invoke)(void* storage, Args&&... args);
+    void (*move)(void* dst, void* src);//move-construct (dst) from (src), destroys (src)
+    void (*destroy)(void* storage);
+    bool isInline;
+  };
+
+  template<typename F>
+  struct InlineOps
+  {
+    static R invoke(void* s, Args&&... args)
+    { return (*static_cast<F*>(s))(std::forward<Args>(args)...); }
+    static void move(void* dst, void* src)
+    {
+      F* f = static_cast<F*>(src);
+      new (dst) F(std::move(*f));
+      f->~F();
+    }
+    static void destroy(void* s) { static_cast<F*>(s)->~F(); }
+  };
+
+  template<typename F>
+  struct HeapOps
+  {
+    static R invoke(void* s, Args&&... args)
+    { return (**static_cast<F**>(s))(std::forward<Args>(args)...); }
+    static void move(void* dst, void* src)
+    {
+      *static_cast<F**>(dst) = *static_cast<F**>(src);
+      *static_cast<F**>(src) = nullptr;
+    }
+    static void destroy(void* s) { delete *static_cast<F**>(s); }
+  };
+
+  //function pointers and std::function can be NULL, they make an empty object then
+  template<typename T> struct Nullable : std::integral_constant<bool,
+      std::is_pointer<T>::value || std::is_member_pointer<T>::value> { };
+  template<typename S> struct Nullable<std::function<S>> : std::true_type { };
+
+  template<typename F>
+  static bool isNull(const F&, std::false_type) { return false; }
+  template<typename F>
+  static bool isNull(const F& f, std::true_type) { return !f; }
+
+  template<typename F>
+  void assign(F&& f)
+  {
+    typedef typename std::decay<F>::type Functor_t;
+    if (isNull(f, Nullable<Functor_t>()))
+      return;
+    constructFunctor<Functor_t>(std::forward<F>(f),
+                                std::integral_constant<bool,
+                                  sizeof(Functor_t) <= sizeof(Storage_t)
+                                  && alignof(Functor_t) <= alignof(Storage_t)
+                                  && std::is_nothrow_move_constructible<Functor_t>::value>());
+  }
+
+  template<typename Functor_t, typename F>
+  void constructFunctor(F&& f, std::true_type/*fits inline*/)
+  {
+    static const VTable table = { &InlineOps<Functor_t>::invoke, &InlineOps<Functor_t>::move,
+                                  &InlineOps<Functor_t>::destroy, true };
+    new (&storage) Functor_t(std::forward<F>(f));
+    vt = &table;
+  }
+
+  template<typename Functor_t, typename F>
+  void constructFunctor(F&& f, std::false_type/*too big*/)
+  {
+    static const VTable table = { &HeapOps<Functor_t>::invoke, &HeapOps<Functor_t>::move,
+                                  &HeapOps<Functor_t>::destroy, false };
+    *reinterpret_cast<Functor_t**>(&storage) = new Functor_t(std::forward<F>(f));
+    vt = &table;
+  }
+
+  void moveFrom(InlineFunction& other)
+  {
+    if (nullptr == other.vt)
+      return;
+    other.vt->move(&storage, &other.storage);
+    vt = other.vt;
+    other.vt = nullptr;
+  }
+
+  typedef typename std::aligned_storage<(Capacity < sizeof(void*)? sizeof(void*) : Capacity),
+                                        alignof(std::max_align_t)>::type Storage_t;
+  Storage_t storage;
+  const VTable* vt;
+};
+
+template<typename Sig, size_t C>
+bool operator == (const InlineFunction<Sig, C>& f, std::nullptr_t) { return !f; }
+template<typename Sig, size_t C>
+bool operator == (std::nullptr_t, const InlineFunction<Sig, C>& f) { return !f; }
+template<typename Sig, size_t C>
+bool operator != (const InlineFunction<Sig, C>& f, std::nullptr_t) { return (bool)f; }
+template<typename Sig, size_t C>
+bool operator != (std::nullptr_t, const InlineFunction<Sig, C>& f) { return (bool)f; }
+
+}//WebGrep
+
+#endif // INLINE_FUNCTION_H
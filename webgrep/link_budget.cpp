@@ -0,0 +1,110 @@
+#include "link_budget.h"
+#include <algorithm>
+
+namespace WebGrep {
+
+/** Tokens of one budget held by a thread.*/
+struct ThreadLease
+{
+  ThreadLease() : ownerId(0), tokens(0), spent(0) { }
+  ~ThreadLease() { LinkBudget::ReleaseThreadLease(); }
+
+  std::weak_ptr<LinkBudget> owner;
+  uint64_t ownerId;//< LinkBudget::d_id of the (owner), 0 if none
+  unsigned tokens;
+  unsigned spent;  //< granted tokens not added to the owner's (used) yet
+};
+
+static thread_local ThreadLease t_lease;
+static std::atomic<uint64_t> budgetsCounter(0);
+
+LinkBudget::LinkBudget(std::shared_ptr<std::atomic_uint> used,
+                       std::shared_ptr<std::atomic_uint> limit,
+                       unsigned blockSize)
+  : d_used(used), d_limit(limit), blockSize(std::max(1u, blockSize)), d_id(1 + budgetsCounter.fetch_add(1))
+{
+  if (nullptr == d_used)
+    d_used = std::make_shared<std::atomic_uint>(0);
+  if (nullptr == d_limit)
+    d_limit = std::make_shared<std::atomic_uint>(0);
+  //the links counted already (a resumed crawl) are not in the pool
+  d_committed.store(d_used->load());
+}
+
+unsigned LinkBudget::lease(unsigned need)
+{
+  unsigned committed = d_committed.load();
+  for(;;)
+    {
+      unsigned lim = d_limit->load();
+      if (committed >= lim)
+        return 0;
+      unsigned left = lim - committed;
+      //the lease is smaller close to the limit, less tokens are held by the idle threads
+      unsigned extra = std::min(blockSize, left / 8);
+      unsigned take = std::min(left, need + extra);
+      if (d_committed.compare_exchange_weak(committed, committed + take))
+        return take;
+    }
+}
+
+unsigned LinkBudget::acquire(unsigned count)
+{
+  if (0 == count)
+    return 0;
+  ThreadLease& l(t_lease);
+  if (l.ownerId != d_id)
+    {//the lease of another budget
+      ReleaseThreadLease();
+      l.owner = shared_from_this();
+      l.ownerId = d_id;
+    }
+  unsigned granted = std::min(count, l.tokens);
+  l.tokens -= granted;
+  l.spent += granted;
+  if (granted < count)
+    {//a new lease, the spent tokens are published meanwhile
+      unsigned taken = lease(count - granted);
+      unsigned given = std::min(taken, count - granted);
+      granted += given;
+      l.tokens += taken - given;
+      d_used->fetch_add(l.spent + given);
+      l.spent = 0;
+    }
+  return granted;
+}
+
+void LinkBudget::giveBack(unsigned count)
+{
+  if (0 == count)
+    return;
+  ThreadLease& l(t_lease);
+  if (l.ownerId == d_id)
+    {
+      unsigned local = std::min(count, l.spent);
+      l.spent -= local;
+      if (count > local)
+        d_used->fetch_sub(count - local);//< published by a lease already
+      l.tokens += count;
+      return;
+    }
+  d_used->fetch_sub(count);
+  d_committed.fetch_sub(count);
+}
+
+void LinkBudget::ReleaseThreadLease()
+{
+  ThreadLease& l(t_lease);
+  if (0 == l.tokens && 0 == l.spent)
+    return;
+  std::shared_ptr<LinkBudget> owner = l.owner.lock();
+  if (nullptr != owner)
+    {
+      owner->d_used->fetch_add(l.spent);
+      owner->d_committed.fetch_sub(l.tokens);
+    }
+  l.tokens = 0;
+  l.spent = 0;
+}
+
+}//WebGrep
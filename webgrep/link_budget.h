@@ -0,0 +1,60 @@
+#ifndef LINK_BUDGET_H
+#define LINK_BUDGET_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+/** Exact limit of the links spawned by a crawl.
+ *  Each spawned link takes a token, the tokens are leased from the shared pool
+ *  by blocks to the calling thread, so the most of acquire() calls don't touch shared memory:
+ *  the thread knows it's lease by the budget's id, the spent tokens are counted locally.
+ *  The pool never gives more than (limit) tokens in total, the unused tokens of a lease
+ *  are given back by ReleaseThreadLease() -- the workers call it after each task.
+ *
+ *  The counters are shared pointers to be displayed (LinkedTask::linksCounterPtr, maxLinksCountPtr),
+ *  (used) is the count of links spawned, (limit) may be changed while crawling.
+ *  The threads add their spent tokens to (used) when they take a new lease or release it,
+ *  so it's behind by the leases that are held at the moment.
+*/
+class LinkBudget : public std::enable_shared_from_this<LinkBudget>,
+                   public WebGrep::noncopyable
+{
+public:
+  LinkBudget(std::shared_ptr<std::atomic_uint> used,
+             std::shared_ptr<std::atomic_uint> limit,
+             unsigned blockSize = 32);
+
+  /** Take up to (count) tokens: from the thread's lease first, then from the pool.
+   * @return count of granted tokens, less than (count) when the limit is reached. */
+  unsigned acquire(unsigned count);
+
+  /** Give back the granted tokens that weren't used (e.g. the node's allocation has failed),
+   *  must be called by the thread that has acquired them.*/
+  void giveBack(unsigned count);
+
+  /** Return the calling thread's leased tokens to their pool, whatever budget it is.*/
+  static void ReleaseThreadLease();
+
+  unsigned used() const { return d_used->load(); }
+  unsigned limit() const { return d_limit->load(); }
+
+  //all tokens are given: spawned or leased by the threads
+  bool exhausted() const { return d_committed.load() >= d_limit->load(); }
+
+protected:
+  //take tokens from the pool: at least (need) if possible, maybe more for the lease.
+  unsigned lease(unsigned need);
+
+  std::shared_ptr<std::atomic_uint> d_used, d_limit;
+  std::atomic_uint d_committed;//< tokens taken from the pool: used + leased
+  unsigned blockSize;
+  const uint64_t d_id;//< unique for the process' budgets, unlike the address
+};
+
+}//WebGrep
+
+#endif // LINK_BUDGET_H
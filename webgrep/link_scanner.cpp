@@ -0,0 +1,264 @@
+#include "link_scanner.h"
+#include "linked_task.h"
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #define WEBGREP_SIMD_X86 1
+  #include <immintrin.h>
+#endif
+
+namespace WebGrep {
+
+//the bytes that end a link:
+static const char d_stopChars[] = "\"'\n> <";//and '\0'
+
+/** The kernels find the next candidate "hr"/"ht" at [from, limit) and the stop characters.
+ *  (limit) must be less than (len - 1), so the next byte is always there. */
+struct ScanKernels
+{
+  const char* name;
+  size_t (*findCandidate)(const char* p, size_t len, size_t from, size_t limit);
+  size_t (*findStop)(const char* str, const char* end);
+};
+
+//---------------------------------------------------------------
+static size_t FindCandidateScalar(const char* p, size_t len, size_t from, size_t limit)
+{
+  (void)len;
+  for(size_t i = from; i < limit; ++i)
+    {
+      if ('h' == p[i] && ('r' == p[i + 1] || 't' == p[i + 1]))
+        return i;
+    }
+  return limit;
+}
+
+static size_t FindStopScalar(const char* str, const char* end)
+{
+  const char* ptr = str;
+  for(; ptr < end; ++ptr)
+    {
+      if ('\0' == *ptr || nullptr != ::memchr(d_stopChars, *ptr, sizeof(d_stopChars) - 1))
+        break;
+    }
+  return ptr - str;
+}
+
+#ifdef WEBGREP_SIMD_X86
+//---------------------------------------------------------------
+__attribute__((target("sse2")))
+static size_t FindCandidateSSE2(const char* p, size_t len, size_t from, size_t limit)
+{
+  const __m128i h = _mm_set1_epi8('h'), r = _mm_set1_epi8('r'), t = _mm_set1_epi8('t');
+  size_t i = from;
+  //(i + 1) is loaded as well, so 17 bytes must be there
+  for(; i < limit && i + 17 <= len; i += 16)
+    {
+      __m128i v0 = _mm_loadu_si128((const __m128i*)(p + i));
+      __m128i v1 = _mm_loadu_si128((const __m128i*)(p + i + 1));
+      __m128i m = _mm_and_si128(_mm_cmpeq_epi8(v0, h),
+                                _mm_or_si128(_mm_cmpeq_epi8(v1, r), _mm_cmpeq_epi8(v1, t)));
+      unsigned mask = (unsigned)_mm_movemask_epi8(m);
+      if (0 != mask)
+        return std::min(limit, i + __builtin_ctz(mask));
+    }
+  return FindCandidateScalar(p, len, std::min(i, limit), limit);
+}
+
+__attribute__((target("sse2")))
+static size_t FindStopSSE2(const char* str, const char* end)
+{
+  const __m128i c0 = _mm_set1_epi8('"'), c1 = _mm_set1_epi8('\''), c2 = _mm_set1_epi8('\n'),
+      c3 = _mm_set1_epi8('>'), c4 = _mm_set1_epi8(' '), c5 = _mm_set1_epi8('<'), c6 = _mm_setzero_si128();
+  const char* ptr = str;
+  for(; ptr + 16 <= end; ptr += 16)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)ptr);
+      __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, c0), _mm_cmpeq_epi8(v, c1)),
+                               _mm_or_si128(_mm_cmpeq_epi8(v, c2), _mm_cmpeq_epi8(v, c3)));
+      m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, c4),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v, c5), _mm_cmpeq_epi8(v, c6))));
+      unsigned mask = (unsigned)_mm_movemask_epi8(m);
+      if (0 != mask)
+        return (ptr - str) + __builtin_ctz(mask);
+    }
+  return (ptr - str) + FindStopScalar(ptr, end);
+}
+
+//---------------------------------------------------------------
+__attribute__((target("avx2")))
+static size_t FindCandidateAVX2(const char* p, size_t len, size_t from, size_t limit)
+{
+  const __m256i h = _mm256_set1_epi8('h'), r = _mm256_set1_epi8('r'), t = _mm256_set1_epi8('t');
+  size_t i = from;
+  for(; i < limit && i + 33 <= len; i += 32)
+    {
+      __m256i v0 = _mm256_loadu_si256((const __m256i*)(p + i));
+      __m256i v1 = _mm256_loadu_si256((const __m256i*)(p + i + 1));
+      __m256i m = _mm256_and_si256(_mm256_cmpeq_epi8(v0, h),
+                                   _mm256_or_si256(_mm256_cmpeq_epi8(v1, r), _mm256_cmpeq_epi8(v1, t)));
+      unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+      if (0 != mask)
+        return std::min(limit, i + __builtin_ctz(mask));
+    }
+  return FindCandidateSSE2(p, len, std::min(i, limit), limit);
+}
+
+__attribute__((target("avx2")))
+static size_t FindStopAVX2(const char* str, const char* end)
+{
+  const __m256i c0 = _mm256_set1_epi8('"'), c1 = _mm256_set1_epi8('\''), c2 = _mm256_set1_epi8('\n'),
+      c3 = _mm256_set1_epi8('>'), c4 = _mm256_set1_epi8(' '), c5 = _mm256_set1_epi8('<'),
+      c6 = _mm256_setzero_si256();
+  const char* ptr = str;
+  for(; ptr + 32 <= end; ptr += 32)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i*)ptr);
+      __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, c0), _mm256_cmpeq_epi8(v, c1)),
+                                  _mm256_or_si256(_mm256_cmpeq_epi8(v, c2), _mm256_cmpeq_epi8(v, c3)));
+      m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(v, c4),
+                                             _mm256_or_si256(_mm256_cmpeq_epi8(v, c5),
+                                                             _mm256_cmpeq_epi8(v, c6))));
+      unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+      if (0 != mask)
+        return (ptr - str) + __builtin_ctz(mask);
+    }
+  return (ptr - str) + FindStopSSE2(ptr, end);
+}
+#endif//WEBGREP_SIMD_X86
+
+//---------------------------------------------------------------
+static const ScanKernels d_scalarKernels = { "scalar", &FindCandidateScalar, &FindStopScalar };
+#ifdef WEBGREP_SIMD_X86
+static const ScanKernels d_sse2Kernels = { "sse2", &FindCandidateSSE2, &FindStopSSE2 };
+static const ScanKernels d_avx2Kernels = { "avx2", &FindCandidateAVX2, &FindStopAVX2 };
+#endif
+
+static const ScanKernels* FindKernels(const char* name)
+{
+#ifdef WEBGREP_SIMD_X86
+  __builtin_cpu_init();
+  bool any = (nullptr == name);
+  if ((any || 0 == ::strcmp(name, "avx2")) && __builtin_cpu_supports("avx2"))
+    return &d_avx2Kernels;
+  if ((any || 0 == ::strcmp(name, "sse2")) && __builtin_cpu_supports("sse2"))
+    return &d_sse2Kernels;
+#endif
+  if (nullptr == name || 0 == ::strcmp(name, "scalar"))
+    return &d_scalarKernels;
+  return nullptr;
+}
+
+//chosen once by the CPU's features, can be replaced by SetLinkScannerKernel()
+static std::atomic<const ScanKernels*>& ActiveKernels()
+{
+  static std::atomic<const ScanKernels*> kernels(FindKernels(nullptr));
+  return kernels;
+}
+
+const char* LinkScannerKernel()
+{
+  return ActiveKernels().load(std::memory_order_relaxed)->name;
+}
+
+bool SetLinkScannerKernel(const char* name)
+{
+  const ScanKernels* k = (nullptr == name)? nullptr : FindKernels(name);
+  if (nullptr == k)
+    return false;
+  ActiveKernels().store(k);
+  return true;
+}
+
+size_t FindStopChar(const char* str, const char* end)
+{
+  if (str >= end)
+    return 0;
+  return ActiveKernels().load(std::memory_order_relaxed)->findStop(str, end);
+}
+
+//---------------------------------------------------------------
+/** Scan [from, len) of the page.
+ *  When (final) is FALSE the page is expected to grow: the scan stops at the first link that
+ *  may change with the next bytes and (resume) is set to it's position.*/
+static size_t ScanFrom(const ScanKernels* k, const char* page, size_t len, size_t from, bool final,
+                       std::vector<LinkSpan>& out, size_t& resume)
+{
+  const char hrefCSTR[] = "href";
+  const char httpCSTR[] = "http";
+  //the bytes after the candidate "href"/"http" are looked at, leave room for them
+  const size_t limit = (len > 5)? len - 5 : 0;
+  size_t cnt = 0;
+  size_t searchFrom = from;
+
+  for(size_t pos = k->findCandidate(page, len, std::min(from, limit), limit); pos < limit;
+      pos = k->findCandidate(page, len, searchFrom, limit))
+    {
+      searchFrom = pos + 1;
+      const char* ptr = page + pos;
+      size_t begin = pos;
+      bool isHref = false;
+      if (0 == ::memcmp(ptr, hrefCSTR, 4))
+        {//case href = "/resource/res2/page.html"
+          const char* eq = (const char*)::memchr(ptr + 4, '=', len - pos - 4);
+          //find opening quote:
+          const char* quote = (nullptr == eq)? nullptr : (const char*)::memchr(eq, '"', (page + len) - eq);
+          if (nullptr == quote)
+            {
+              if (!final)
+                {//the quote may come with the next bytes
+                  resume = pos;
+                  return cnt;
+                }
+              continue;
+            }
+          begin = (quote - page) + 1;
+          isHref = true;
+        }
+      else if (!(0 == ::memcmp(ptr, httpCSTR, 4) && (ptr[4] == ':' || ptr[4] == 's')))
+        {
+          continue;
+        }
+
+      //find closing quote \" or other character like '>'
+      size_t bound = std::min(len, begin + WebGrep::MaxURLlen);
+      size_t end = begin + FindStopChar(page + begin, page + bound);
+      if (!final && end >= len && begin + WebGrep::MaxURLlen > len)
+        {//the link is cut by the end of the received bytes
+          resume = pos;
+          return cnt;
+        }
+      if (end >= len || end >= begin + WebGrep::MaxURLlen
+          || (end - begin) <= 1
+          || (!isHref && (begin + 10) > end))
+        {
+          continue;
+        }
+      out.push_back(LinkSpan());
+      out.back().begin = begin;
+      out.back().end = end;
+      out.back().isHref = isHref;
+      ++cnt;
+      searchFrom = pos + (end - begin) + 1;
+    }
+  resume = std::max(searchFrom, limit);
+  return cnt;
+}
+
+size_t ScanLinks(const char* page, size_t len, std::vector<LinkSpan>& out)
+{
+  size_t resume = 0;
+  return ScanFrom(ActiveKernels().load(std::memory_order_relaxed), page, len, 0, true, out, resume);
+}
+
+size_t LinkTokenizer::feed(const char* page, size_t len, bool final, std::vector<LinkSpan>& out)
+{
+  if (resumeAt >= len && !final)
+    return 0;
+  return ScanFrom(ActiveKernels().load(std::memory_order_relaxed), page, len,
+                  resumeAt, final, out, resumeAt);
+}
+
+}//WebGrep
@@ -0,0 +1,61 @@
+#ifndef LINK_SCANNER_H
+#define LINK_SCANNER_H
+
+#include <vector>
+#include <cstddef>
+
+namespace WebGrep {
+
+/** Position of a link in the page: [begin, end) offsets.*/
+struct LinkSpan
+{
+  size_t begin, end;
+  bool isHref;//< TRUE for href="...", FALSE for a bare http(s):// link
+};
+
+/** Find href="..." and http:// (https://) links in the page.
+ *  The candidate 'h' bytes and the closing quotes are looked up 16 or 32 bytes at a time
+ *  (SSE2 or AVX2, chosen at runtime by the CPU's features) with a scalar fallback,
+ *  all of them give the same results.
+ *  @return count of spans appended to (out).
+ *  Possible exceptions: bad_alloc. */
+size_t ScanLinks(const char* page, size_t len, std::vector<LinkSpan>& out);
+
+/** Resumable ScanLinks() for a page that is still being downloaded.
+ *  feed() is called each time new bytes are appended to the page buffer,
+ *  the links that are cut by the end of the received bytes are scanned again on the next call,
+ *  so all calls together give the same spans as one ScanLinks() for the whole page.
+ *  Not thread-safe: one tokenizer per page.*/
+class LinkTokenizer
+{
+public:
+  LinkTokenizer() : resumeAt(0) { }
+
+  /** Scan the bytes received since the previous call.
+   *  @param page: whole page received so far (the bytes fed before must be unchanged).
+   *  @param final: TRUE when the page is complete, the rest of it is scanned then.
+   *  @return count of spans appended to (out). Possible exceptions: bad_alloc.*/
+  size_t feed(const char* page, size_t len, bool final, std::vector<LinkSpan>& out);
+
+  //position where the next feed() starts
+  size_t position() const { return resumeAt; }
+  void reset() { resumeAt = 0; }
+
+protected:
+  size_t resumeAt;
+};
+
+/** Offset of the first stop character (one of: " ' \n > space < \0) in [str, end),
+ *  (end - str) if there's none. */
+size_t FindStopChar(const char* str, const char* end);
+
+/** Name of the kernels in use: "avx2", "sse2" or "scalar".*/
+const char* LinkScannerKernel();
+
+/** Force the kernels by name (tests and benchmarks).
+ *  @return FALSE if they're not supported by the CPU or the build.*/
+bool SetLinkScannerKernel(const char* name);
+
+}//WebGrep
+
+#endif // LINK_SCANNER_H
@@ -1,30 +1,27 @@
 #include "linked_task.h"
+#include "link_scanner.h"
+#include "node_arena.h"
+#include "epoch_reclaimer.h"
 #include <cassert>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 
 namespace WebGrep {
 
 void TraverseFunc(LinkedTask* head, void* additional,
                   void(*func)(LinkedTask*, void*))
 {
-  if (nullptr == head || nullptr == func) return;
-  LinkedTask* next = ItemLoadAcquire(head->next);
-  LinkedTask* child = ItemLoadAcquire(head->child);
-  TraverseFunc(next, additional, func);
-  TraverseFunc(child, additional, func);
-  func(head, additional);
+  if (nullptr == func) return;
+  TraverseTree(head, [additional, func](LinkedTask* item) { func(item, additional); });
 }
 
-// Recursively traverse the list and call functor on each item
+// Traverse the list and call functor on each item
 void TraverseFunctor(LinkedTask* head, void* additional,
                      std::function<void(LinkedTask*, void* additional/*nullptr*/)> func)
 {
-  if (nullptr == head || nullptr == func) return;
-  LinkedTask* next = ItemLoadAcquire(head->next);
-  LinkedTask* child = ItemLoadAcquire(head->child);
-  TraverseFunctor(next, additional, func);
-  TraverseFunctor(child, additional, func);
-  func(head, additional);
+  if (nullptr == func) return;
+  TraverseTree(head, [additional, &func](LinkedTask* item) { func(item, additional); });
 }
 
 static void DeleteCall(LinkedTask* item, void* data)
@@ -39,26 +36,137 @@ static void DeleteCall(LinkedTask* item, void* data)
   root->deleteNode(root, item);
 }
 
-// Free memory recursively.
+// Free memory, no recursion: a level of any length is fine.
 void DeleteList(LinkedTask* head)
 {
-  TraverseFunc(head, nullptr, &DeleteCall);
+  TraverseTree(head, [](LinkedTask* item) { DeleteCall(item, nullptr); });
+}
+
+void RetireList(LinkedTask* head)
+{
+  if (nullptr == head)
+    return;
+  //tagged by the root: the root's deleter releases the subtree if it's still pending
+  LinkedTask* root = ItemLoadAcquire(head->root);
+  EpochReclaimer::Global().retire(root, [head]() { DeleteList(head); });
+}
+
+//---------------------------------------------------------------
+PreOrderIterator::PreOrderIterator(LinkedTask* head) : cur(nullptr)
+{
+  visit(head);
+}
+
+void PreOrderIterator::visit(LinkedTask* item)
+{
+  cur = item;
+  if (nullptr == item)
+    return;
+  LinkedTask* next = ItemLoadAcquire(item->next);
+  LinkedTask* child = ItemLoadAcquire(item->child);
+  if (nullptr != next)
+    pending.push_back(next);
+  if (nullptr != child)
+    pending.push_back(child);
+}
+
+PreOrderIterator& PreOrderIterator::operator++()
+{
+  LinkedTask* item = nullptr;
+  if (!pending.empty())
+    {
+      item = pending.back();
+      pending.pop_back();
+    }
+  visit(item);
+  return *this;
+}
+
+PostOrderIterator::PostOrderIterator(LinkedTask* head) : cur(nullptr)
+{
+  if (nullptr != head)
+    {
+      pending.push_back(Frame{head, false});
+      ++(*this);
+    }
+}
+
+PostOrderIterator& PostOrderIterator::operator++()
+{
+  cur = nullptr;
+  while(!pending.empty())
+    {
+      Frame& top = pending.back();
+      if (top.expanded)
+        {
+          cur = top.item;
+          pending.pop_back();
+          break;
+        }
+      top.expanded = true;
+      LinkedTask* next = ItemLoadAcquire(top.item->next);
+      LinkedTask* child = ItemLoadAcquire(top.item->child);
+      //(top) is invalidated by push_back()
+      if (nullptr != child)
+        pending.push_back(Frame{child, false});
+      if (nullptr != next)
+        pending.push_back(Frame{next, false});
+    }
+  return *this;
+}
+
+LevelOrderIterator::LevelOrderIterator(LinkedTask* head) : cur(nullptr), nextOnLevel(nullptr)
+{
+  visit(head);
+}
+
+void LevelOrderIterator::visit(LinkedTask* item)
+{
+  cur = item;
+  if (nullptr == item)
+    {
+      nextOnLevel = nullptr;
+      return;
+    }
+  nextOnLevel = ItemLoadAcquire(item->next);
+  LinkedTask* child = ItemLoadAcquire(item->child);
+  if (nullptr != child)
+    levels.push_back(child);
+}
+
+LevelOrderIterator& LevelOrderIterator::operator++()
+{
+  LinkedTask* item = nextOnLevel;
+  if (nullptr == item && !levels.empty())
+    {
+      item = levels.front();
+      levels.pop_front();
+    }
+  visit(item);
+  return *this;
+}
+
+static bool NodesLimitReached(LinkedTask* RootNodePtr)
+{
+  auto cntMax = RootNodePtr->maxPossbleNodesQuantity.load();
+  auto cntCur = RootNodePtr->nodeAllocationsCount.load();
+  if (cntMax <= cntCur)
+    {
+      std::cerr << "Maximum nodes count reach: " << cntCur << std::endl;
+      if(RootNodePtr->linksCounterPtr) {
+          std::cerr << " for task No" << (1 + RootNodePtr->linksCounterPtr->load()) << std::endl;
+        }
+      return true;
+    }
+  return false;
 }
 
 LinkedTask* FuncNeu(LinkedTask* RootNodePtr)
 {
   LinkedTask* p = nullptr;
   try {
-    auto cntMax = RootNodePtr->maxPossbleNodesQuantity.load();
-    auto cntCur = RootNodePtr->nodeAllocationsCount.load();
-    if (cntMax <= cntCur)
-      {
-        std::cerr << "Maximum nodes count reach: " << cntCur << std::endl;
-        if(RootNodePtr->linksCounterPtr) {
-            std::cerr << " for task No" << (1 + RootNodePtr->linksCounterPtr->load()) << std::endl;
-          }
-        return nullptr;
-      }
+    if (NodesLimitReached(RootNodePtr))
+      return nullptr;
     p = new LinkedTask(RootNodePtr);
     RootNodePtr->nodeAllocationsCount.fetch_add(1);
   }catch(std::bad_alloc& ba)
@@ -72,21 +180,13 @@ LinkedTask::LinkedTask() : level(0)
 {
   order = 0;
   next.store(0);
+  tail.store(0);
   child.store(0);
   root.store(0);
   parent.store(0);
   childNodesCount.store(0);
   maxPossbleNodesQuantity.store(8192);
   nodeAllocationsCount.store(0);
-
-  makeNewNode = &FuncNeu;
-
-  deleteNode = [](LinkedTask* RootNodePtr, LinkedTask* node_ptr)
-  {
-    delete node_ptr;
-    RootNodePtr->nodeAllocationsCount.fetch_sub(1);
-  };
-
 }
 
 LinkedTask::LinkedTask(LinkedTask* rootNode) : LinkedTask()
@@ -98,9 +198,39 @@ LinkedTask::LinkedTask(LinkedTask* rootNode) : LinkedTask()
 std::shared_ptr<LinkedTask> LinkedTask::createRootNode()
 {
   std::shared_ptr<LinkedTask> rootNode;
+  auto arena = std::make_shared<NodeArena>();
   auto ptr = new LinkedTask;
-  rootNode.reset(ptr,
-             [](LinkedTask* ptr){WebGrep::DeleteList(ptr);});
+  ptr->arena = arena;
+  //the nodes are made in the root's arena, the child nodes keep the hooks empty
+  ptr->makeNewNode = [arena](LinkedTask* RootNodePtr) -> LinkedTask*
+  {
+    if (NodesLimitReached(RootNodePtr))
+      return nullptr;
+    LinkedTask* p = arena->make(RootNodePtr);
+    if (nullptr != p)
+      RootNodePtr->nodeAllocationsCount.fetch_add(1);
+    return p;
+  };
+  ptr->deleteNode = [arena](LinkedTask* RootNodePtr, LinkedTask* node_ptr)
+  {
+    arena->destroy(node_ptr);
+    RootNodePtr->nodeAllocationsCount.fetch_sub(1);
+  };
+  rootNode.reset(ptr, [](LinkedTask* ptr)
+  {
+    //nobody reads the tree when it's root is released
+    EpochReclaimer::Global().drain(ptr);
+    if (nullptr == ptr->arena)
+      {
+        WebGrep::DeleteList(ptr);
+        return;
+      }
+    //bulk release: no traversal, the slabs are freed at once
+    std::shared_ptr<NodeArena> arena;
+    arena.swap(ptr->arena);
+    arena->clear();
+    delete ptr;
+  });
   rootNode->root.store((std::uintptr_t)ptr);
   return rootNode;
 }
@@ -111,30 +241,48 @@ void LinkedTask::shallowCopy(const LinkedTask& other)
   level = other.level;
   root.store(other.root.load());
   parent.store(other.parent.load());
-  {
-    grepVars.grepExpr = other.grepVars.grepExpr;
-  }
+  grepVars.grepEngine = other.grepVars.grepEngine;
 
   maxLinksCountPtr = other.maxLinksCountPtr;
   linksCounterPtr = other.linksCounterPtr;
+  linksBudget = other.linksBudget;
+  visitedSet = other.visitedSet;
+  robotsCache = other.robotsCache;
   maxPossbleNodesQuantity.store(other.maxPossbleNodesQuantity.load());
 }
 
 LinkedTask* LinkedTask::getLastOnLevel()
 {
-  std::atomic_uintptr_t* freeslot = &next;
-  LinkedTask* item = ItemLoadAcquire(*freeslot);
-  LinkedTask* last_item = item;
-  for(; nullptr != item; item = ItemLoadAcquire(*freeslot))
+  //start from the last known item, it's behind the real one if other nodes have appended
+  LinkedTask* last_item = ItemLoadAcquire(tail);
+  if (nullptr == last_item)
+    last_item = this;
+  for(LinkedTask* item = ItemLoadAcquire(last_item->next); nullptr != item;
+      item = ItemLoadAcquire(item->next))
     {
-      freeslot = &(item->next);
       last_item = item;
     }
-  if (nullptr == last_item)
-    last_item = this;
+  if (this != last_item)
+    StoreRelease(tail, last_item);
   return last_item;
 }
 
+void LinkedTask::appendNext(LinkedTask* item)
+{
+  LinkedTask* last_item = getLastOnLevel();
+  std::uintptr_t expected = 0;
+  //other appender may take the slot first: move to it's item and retry
+  while(!last_item->next.compare_exchange_weak(expected, (std::uintptr_t)item,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_acquire))
+    {
+      if (0 != expected)
+        last_item = (LinkedTask*)expected;
+      expected = 0;
+    }
+  StoreRelease(tail, item);
+}
+
 size_t LinkedTask::spawnNextNodes(size_t nodesCount)
 {
   if (0 == nodesCount)
@@ -142,25 +290,19 @@ size_t LinkedTask::spawnNextNodes(size_t nodesCount)
 
   LinkedTask* root = ItemLoadAcquire(this->root);
 
-  //go to the end elemet:
-  LinkedTask* last_item = getLastOnLevel();
-
   //spawn items on same level (access by .next)
   size_t c = 0;
   try {
-
-    //put 1 item into last zero holder:
-    LinkedTask* item = nullptr;
-    for(; c < nodesCount; ++c, last_item = item)
+    for(; c < nodesCount; ++c)
       {
-        item = root->makeNewNode(root);
-        StoreAcquire(last_item->next, item);
+        LinkedTask* item = root->makeNewNode(root);
         if (nullptr == item)
           break;
+        //configure the item before it's visible to the readers:
         item->shallowCopy(*this);
-        StoreAcquire(item->parent, ItemLoadAcquire(this->parent));
-        item->order = childNodesCount.load(std::memory_order_acquire);
-        this->childNodesCount.fetch_add(1);
+        StoreRelease(item->parent, ItemLoadAcquire(this->parent));
+        item->order = this->childNodesCount.fetch_add(1);
+        appendNext(item);
       };
   }catch(std::exception& ex)
   {
@@ -178,12 +320,12 @@ LinkedTask* LinkedTask::spawnChildNode(LinkedTask*& expelledChild)
     auto item = rootNode->makeNewNode(rootNode);
     if(nullptr == item)
       return nullptr;
-    StoreAcquire(child, item);
+    //configure the item before it's visible to the readers:
     item->shallowCopy(*this);
     item->parent.store((std::uintptr_t)this);
     item->level = 1u + this->level;
-    item->order = childNodesCount.load(std::memory_order_acquire);
-    this->childNodesCount.fetch_add(1);
+    item->order = this->childNodesCount.fetch_add(1);
+    StoreRelease(child, item);
     return item;
   } catch(std::exception& ex)
   {
@@ -224,22 +366,56 @@ size_t LinkedTask::spawnGreppedSubtasks(const std::string& host_and_port, const
       return 0;
     }
 
+  size_t wanted = targetVariables.matchURLVector.size();
+  if (nullptr != linksBudget)
+    {
+      wanted = linksBudget->acquire((unsigned)wanted);
+      if (0 == wanted)
+        return 0;
+    }
+  //the token first: a URL is marked as visited crawl-wide only when it's spawned,
+  //the ones visited by other branches meanwhile are skipped
+  std::vector<std::string> urls;
+  urls.reserve(wanted);
+  for(size_t idx = 0; idx < targetVariables.matchURLVector.size() && urls.size() < wanted; ++idx)
+    {
+      const GrepVars::CIteratorPair& link(targetVariables.matchURLVector[idx]);
+      std::string turl(link.first, link.second);
+      turl = MakeFullPath(turl.data(), turl.size(), host_and_port, targetVariables);
+      if (nullptr == visitedSet || visitedSet->insert(turl))
+        urls.push_back(std::move(turl));
+    }
+  if (urls.empty())
+    {
+      if (nullptr != linksBudget)
+        linksBudget->giveBack((unsigned)wanted);
+      return 0;
+    }
+
   size_t cposition = 0;
-  auto func = [this, &cposition, &host_and_port, &targetVariables](LinkedTask* _node)
+  auto func = [&cposition, &urls](LinkedTask* _node)
   {
-    std::string& turl(_node->grepVars.targetUrl);
-    turl.assign(targetVariables.matchURLVector[cposition].first,
-                targetVariables.matchURLVector[cposition].second);
-    turl = MakeFullPath(turl.data(), turl.size(), host_and_port, targetVariables);
-    std::cerr << "spawn: " << turl << "\n";
-    ++cposition;
+    if (cposition >= urls.size())
+      return;
+    _node->grepVars.targetUrl = std::move(urls[cposition++]);
+    std::cerr << "spawn: " << _node->grepVars.targetUrl << "\n";
   };
 
   //spawn N items (leafs) on current branch
-  size_t spawnedListSize = spawnNextNodes(targetVariables.matchURLVector.size()-1/*exclude this*/);
+  spawnNextNodes(urls.size() - 1/*exclude this*/);
   //for each leaf: configure it with target URL:
   size_t cnt = ForEachOnBranch(this, func, skipCount);
-  linksCounterPtr->fetch_add(cnt);
+  //the URLs of the nodes that have failed to allocate are not visited
+  for(size_t idx = cposition; nullptr != visitedSet && idx < urls.size(); ++idx)
+    visitedSet->erase(urls[idx]);
+  if (nullptr != linksBudget)
+    {//neither the skipped URLs nor the failed nodes take the tokens
+      linksBudget->giveBack((unsigned)(wanted - cposition));
+    }
+  else
+    {
+      linksCounterPtr->fetch_add(cnt);
+    }
   return cnt;
 }
 
@@ -296,18 +472,7 @@ size_t FindURLPathBegin(const char* str, size_t nmax)
 
 size_t FindClosingQuote(const char* strPtr, const char* end)
 {
-  //inc pointer until we get on of stop charactres
-  auto old = strPtr;
-  static const char stopChars[] = "\"'\n> <\0";
-  for(char c = strPtr[0]; strPtr < end; c = *(++strPtr))
-    {
-      for(uint32_t z = 0; z < sizeof(stopChars) - 1; ++z)
-        {
-          if (c == stopChars[z])
-            return strPtr - old;
-        }
-    }
-  return strPtr - old;
+  return WebGrep::FindStopChar(strPtr, end);
 }
 
 std::string MakeFullPath(const char* url, size_t len, const std::string& host_and_port, const WebGrep::GrepVars& targetVars)
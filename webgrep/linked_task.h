@@ -1,13 +1,19 @@
 #ifndef LINKEDTASK_H
 #define LINKEDTASK_H
 #include <string>
-#include <regex>
 #include "noncopyable.hpp"
 #include <atomic>
 
 #include <functional>
+#include <vector>
+#include <deque>
+#include <iterator>
 #include <iostream>
 #include "thread_pool.h"
+#include "visited_set.h"
+#include "grep_engine.h"
+#include "link_budget.h"
+#include "robots_rules.h"
 
 namespace WebGrep {
 
@@ -18,7 +24,7 @@ class WorkerCtx;
 /** Contains match results -- an iterators pointing to .pageContent.*/
 struct GrepVars
 {
-  GrepVars() : responseCode(0), pageIsReady(false), pageIsParsed(false)
+  GrepVars() : responseCode(0), retriesCount(0), fetchMs(0), pageIsReady(false), pageIsParsed(false), linksStreamed(false)
   {
     scheme.fill(0);
   }
@@ -26,8 +32,11 @@ struct GrepVars
   std::array<char, 6> scheme;// must be set to "http\0\0" or "https\0"
   std::string targetUrl;
 
-  std::regex grepExpr;  //< regexp to be matched
+  //< expression to be matched, compiled once per crawl and shared by the nodes
+  std::shared_ptr<const WebGrep::GrepEngine> grepEngine;
   long responseCode;       //< last HTTP GET response code
+  unsigned retriesCount;   //< downloads repeated after 429/503 responses
+  unsigned fetchMs;        //< duration of the last download, milliseconds
 
   std::string pageContent;//< html content
 
@@ -45,21 +54,31 @@ struct GrepVars
   //must be set to true when it's safe to access .pageContent from other threads:
   volatile bool pageIsReady;
   volatile bool pageIsParsed;
+
+  /** TRUE when the links were found and spawned while the page was downloading,
+   *  matchURLVector is filled then and the parser greps the text only.*/
+  bool linksStreamed;
 };
 //---------------------------------------------------------------
 class LinkedTask;
+class NodeArena;
 
-// Recursively traverse the list and call a function each item
+// Traverse the list in post-order (see PostOrder()) and call a function each item
 void TraverseFunc(LinkedTask* head, void* additional,
                   void(*func)(LinkedTask*, void*));
 
-// Recursively traverse the list and call functor on each item
+// Traverse the list in post-order (see PostOrder()) and call functor on each item
 void TraverseFunctor(LinkedTask* head, void* additional,
                      std::function<void(LinkedTask*, void* additional)>);
 
-// Free memory recursively. NOT THREAD SAFE! Must be syncronized.
+// Free memory of the items in post-order. NOT THREAD SAFE! Must be syncronized.
 void DeleteList(LinkedTask* head);
 
+/** DeleteList(head) when the readers that may see the items are gone (EpochReclaimer::Global()).
+ *  The subtree must be unlinked from the tree already: e.g. (expelledChild) of spawnChildNode().
+ *  The readers must hold an EpochGuard while they access the nodes.*/
+void RetireList(LinkedTask* head);
+
 /** Apply functor for each item on same branch accessed by(head->next).
  * Any exceptions from the functor will be catched and printed to std::cerr.
  * @return how much times functor has been invoked.
@@ -102,15 +121,24 @@ public:
  */
   LinkedTask* spawnChildNode(LinkedTask*& expelledChild);
 
-  /** traverse to the last item on current tree level
+  /** Go to the last item on current tree level, starts from the (.tail) hint,
+   *  so it's O(1) when the items are appended by this node.
    * @return last item if exists, (this) otherwise. */
   LinkedTask* getLastOnLevel();
 
+  /** Link (item) at the end of current tree level, lock-free:
+   *  concurrent appenders compete by CAS on the last item's (.next).
+   *  The item must be configured already, it's visible to the readers right away.*/
+  void appendNext(LinkedTask* item);
+
   /** Append items to (.next) node (on the same tree level)*/
   size_t spawnNextNodes(size_t nodesCount);
 
-  /** Scan targetVariables.matchURLVector[] and create linked list of subtasks on CURRENT LEVEL.
-   * @return quantity of subtasks spawned. */
+  /** Scan targetVariables.matchURLVector[] and create linked list of subtasks on CURRENT LEVEL,
+   *  (this) takes the first URL. Each subtask takes a token of (linksBudget) if it's set,
+   *  the URLs above the budget are dropped. A URL is inserted into (visitedSet) only
+   *  when it's node got a token, the ones visited crawl-wide already are skipped.
+   * @return quantity of subtasks spawned, 0 if the budget is exhausted. */
   size_t spawnGreppedSubtasks(const std::string& host_and_port, const GrepVars& targetVariables, size_t skipCount = 0);
 
   //level of this node
@@ -124,11 +152,23 @@ public:
    * store: memory_order_release */
   std::atomic_uintptr_t next, child, root, parent;
 
+  //hint: last known item on the level after this node, or NULL; see getLastOnLevel()
+  std::atomic_uintptr_t tail;
+
   GrepVars grepVars;
 
   // you must have guaranteed that these are set & will live longer than any LinkedTask object
   std::shared_ptr<std::atomic_uint> linksCounterPtr, maxLinksCountPtr;
 
+  //tokens for the spawned links, counts them by (linksCounterPtr) up to (maxLinksCountPtr), can be NULL
+  std::shared_ptr<WebGrep::LinkBudget> linksBudget;
+
+  //URLs that are spawned already in the whole tree, shared by all nodes, can be NULL
+  std::shared_ptr<WebGrep::VisitedSet> visitedSet;
+
+  //robots.txt of the hosts met in the tree, shared by all nodes, can be NULL
+  std::shared_ptr<WebGrep::RobotsCache> robotsCache;
+
   std::atomic_uint nodeAllocationsCount;
 
   /** ctor() sets the limit 8192 that sis computed for estimation of 2GB memory for 200kb .html pages in average.
@@ -141,6 +181,11 @@ public:
   std::function<LinkedTask*(LinkedTask*/*RootNodePtr*/)> makeNewNode;
   std::function<void(LinkedTask*/*RootNodePtr*/, LinkedTask* /*node_ptr*/)> deleteNode;
 
+  /** Root node only: slab allocator used by the hooks of createRootNode(),
+   *  the root's deleter releases all nodes of the tree by it at once.
+   *  Reset it to NULL if you replace the hooks with your own allocation. */
+  std::shared_ptr<WebGrep::NodeArena> arena;
+
 };
 //---------------------------------------------------------------
 typedef std::shared_ptr<LinkedTask> RootNodePtr;
@@ -164,6 +209,116 @@ static inline std::atomic_uintptr_t& StoreRelease(std::atomic_uintptr_t& atom, L
   atom.store((std::uintptr_t)ptr, std::memory_order_release);
   return atom;
 }
+//---------------------------------------------------------------
+/** Iterators over the tree of (head): the head, it's (.next) items and their (.child) subtrees.
+ *  They keep an explicit stack (queue), so neither the tree's depth nor the length
+ *  of a level is limited by the thread's stack.
+ *  The pointers (.next, .child) of an item are read before the item is dereferenced by the caller,
+ *  so the caller may delete the item PostOrderIterator points to before the increment.
+ *  NOT THREAD SAFE for the items being deleted concurrently.
+*/
+class PreOrderIterator
+{
+public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef LinkedTask* value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef LinkedTask* const* pointer;
+  typedef LinkedTask* const& reference;
+
+  PreOrderIterator() : cur(nullptr) { }
+  explicit PreOrderIterator(LinkedTask* head);
+
+  //item, then it's child subtree, then the next items of the level
+  PreOrderIterator& operator++();
+  reference operator*() const { return cur; }
+  bool operator==(const PreOrderIterator& other) const { return cur == other.cur; }
+  bool operator!=(const PreOrderIterator& other) const { return cur != other.cur; }
+
+protected:
+  void visit(LinkedTask* item);
+  LinkedTask* cur;
+  std::vector<LinkedTask*> pending;
+};
+
+class PostOrderIterator
+{
+public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef LinkedTask* value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef LinkedTask* const* pointer;
+  typedef LinkedTask* const& reference;
+
+  PostOrderIterator() : cur(nullptr) { }
+  explicit PostOrderIterator(LinkedTask* head);
+
+  //the next items of the level, then the child subtree, then the item (as DeleteList() needs)
+  PostOrderIterator& operator++();
+  reference operator*() const { return cur; }
+  bool operator==(const PostOrderIterator& other) const { return cur == other.cur; }
+  bool operator!=(const PostOrderIterator& other) const { return cur != other.cur; }
+
+protected:
+  struct Frame { LinkedTask* item; bool expanded; };
+  LinkedTask* cur;
+  std::vector<Frame> pending;
+};
+
+class LevelOrderIterator
+{
+public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef LinkedTask* value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef LinkedTask* const* pointer;
+  typedef LinkedTask* const& reference;
+
+  LevelOrderIterator() : cur(nullptr), nextOnLevel(nullptr) { }
+  explicit LevelOrderIterator(LinkedTask* head);
+
+  //all items of the tree level (LinkedTask::level), then the items of the level + 1
+  LevelOrderIterator& operator++();
+  reference operator*() const { return cur; }
+  bool operator==(const LevelOrderIterator& other) const { return cur == other.cur; }
+  bool operator!=(const LevelOrderIterator& other) const { return cur != other.cur; }
+
+protected:
+  void visit(LinkedTask* item);
+  LinkedTask* cur;
+  LinkedTask* nextOnLevel;
+  std::deque<LinkedTask*> levels;//< heads of the child levels to be visited
+};
+
+template<class Iterator>
+struct TreeRange
+{
+  Iterator first, last;
+  Iterator begin() const { return first; }
+  Iterator end() const { return last; }
+};
+
+/** for(LinkedTask* item : PreOrder(head)) { ... } */
+static inline TreeRange<PreOrderIterator> PreOrder(LinkedTask* head)
+{ return TreeRange<PreOrderIterator>{PreOrderIterator(head), PreOrderIterator()}; }
+
+static inline TreeRange<PostOrderIterator> PostOrder(LinkedTask* head)
+{ return TreeRange<PostOrderIterator>{PostOrderIterator(head), PostOrderIterator()}; }
+
+static inline TreeRange<LevelOrderIterator> LevelOrder(LinkedTask* head)
+{ return TreeRange<LevelOrderIterator>{LevelOrderIterator(head), LevelOrderIterator()}; }
+
+/** Call func(LinkedTask*) on each item in post-order,
+ *  a template for any callable, so there is no std::function's indirect call.
+ *  The item may be deleted by func.*/
+template<typename Func>
+void TraverseTree(LinkedTask* head, Func&& func)
+{
+  for(PostOrderIterator it(head), end; it != end; ++it)
+    func(*it);
+}
+
+//---------------------------------------------------------------
 /** Extracts "site.com:443" from https://site.com:443/some/path */
 std::string ExtractHostPortHttp(const std::string& targetUrl);
 
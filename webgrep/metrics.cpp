@@ -0,0 +1,289 @@
+#include "metrics.h"
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+
+namespace WebGrep {
+
+static std::atomic_uint nextShard(0);
+
+unsigned MetricShardIndex()
+{
+  static thread_local unsigned t_shard = nextShard.fetch_add(1, std::memory_order_relaxed);
+  return t_shard;
+}
+//---------------------------------------------------------------
+const unsigned MetricCounter::shardsCount;
+
+MetricCounter::MetricCounter()
+{
+  for(Shard& shard : d_shards)
+    shard.value.store(0);
+}
+
+uint64_t MetricCounter::value() const
+{
+  uint64_t sum = 0;
+  for(const Shard& shard : d_shards)
+    sum += shard.value.load(std::memory_order_relaxed);
+  return sum;
+}
+//---------------------------------------------------------------
+const unsigned LatencyHistogram::subBucketBits;
+const unsigned LatencyHistogram::maxValueBits;
+const unsigned LatencyHistogram::bucketsCount;
+const unsigned LatencyHistogram::shardsCount;
+
+//index of the highest bit set, (value) is not 0
+static unsigned HighestBit(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return 63 - (unsigned)__builtin_clzll(value);
+#else
+  unsigned bit = 0;
+  for(; value > 1; value >>= 1)
+    ++bit;
+  return bit;
+#endif
+}
+
+unsigned LatencyHistogram::BucketIndex(uint64_t us)
+{
+  static const uint64_t subBuckets = 1u << subBucketBits;
+  //the buckets hold (previous limit, limit], like Prometheus' "le"
+  us = (0 == us)? 0 : us - 1;
+  if (us < subBuckets)
+    return (unsigned)us;
+  unsigned msb = HighestBit(us);
+  if (msb >= maxValueBits)
+    return bucketsCount - 1;
+  unsigned sub = (unsigned)((us >> (msb - subBucketBits)) & (subBuckets - 1));
+  return ((msb - subBucketBits + 1) << subBucketBits) + sub;
+}
+
+uint64_t LatencyHistogram::BucketLimit(unsigned idx)
+{
+  static const unsigned subBuckets = 1u << subBucketBits;
+  if (idx < subBuckets)
+    return idx + 1;
+  unsigned group = idx >> subBucketBits;
+  uint64_t sub = idx & (subBuckets - 1);
+  return (subBuckets + sub + 1) << (group - 1);
+}
+
+LatencyHistogram::Shard::Shard()
+{
+  for(std::atomic<uint64_t>& bucket : buckets)
+    bucket.store(0);
+  sumUs.store(0);
+}
+
+LatencyHistogram::LatencyHistogram() : d_shards(shardsCount)
+{
+
+}
+
+void LatencyHistogram::record(uint64_t us)
+{
+  Shard& shard(d_shards[MetricShardIndex() % shardsCount]);
+  shard.buckets[BucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+  shard.sumUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+  HistogramSnapshot snap;
+  snap.buckets.assign(bucketsCount, 0);
+  for(const Shard& shard : d_shards)
+    {
+      for(unsigned idx = 0; idx < bucketsCount; ++idx)
+        snap.buckets[idx] += shard.buckets[idx].load(std::memory_order_relaxed);
+      snap.sumUs += shard.sumUs.load(std::memory_order_relaxed);
+    }
+  for(uint64_t n : snap.buckets)
+    snap.count += n;
+  return snap;
+}
+//---------------------------------------------------------------
+uint64_t HistogramSnapshot::quantileUs(double q) const
+{
+  if (0 == count)
+    return 0;
+  q = (q < 0.0)? 0.0 : (q > 1.0)? 1.0 : q;
+  uint64_t rank = (uint64_t)(q * (double)count + 0.5);
+  rank = (0 == rank)? 1 : rank;
+  uint64_t seen = 0;
+  for(unsigned idx = 0; idx < buckets.size(); ++idx)
+    {
+      seen += buckets[idx];
+      if (seen >= rank)
+        return LatencyHistogram::BucketLimit(idx);
+    }
+  return LatencyHistogram::BucketLimit((unsigned)buckets.size() - 1);
+}
+
+uint64_t HistogramSnapshot::countAtMost(uint64_t us) const
+{
+  uint64_t cnt = 0;
+  for(unsigned idx = 0; idx < buckets.size() && LatencyHistogram::BucketLimit(idx) <= us; ++idx)
+    cnt += buckets[idx];
+  return cnt;
+}
+
+uint64_t MetricsSnapshot::counter(const std::string& name) const
+{
+  auto found = counters.find(name);
+  return (counters.end() == found)? 0 : found->second;
+}
+
+HistogramSnapshot MetricsSnapshot::histogram(const std::string& name) const
+{
+  auto found = histograms.find(name);
+  return (histograms.end() == found)? HistogramSnapshot() : found->second;
+}
+//---------------------------------------------------------------
+std::shared_ptr<MetricCounter> MetricsRegistry::counter(const std::string& name, const std::string& help)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  Entry<MetricCounter>& entry(d_counters[name]);
+  if (nullptr == entry.metric)
+    {
+      entry.help = help;
+      entry.metric = std::make_shared<MetricCounter>();
+    }
+  return entry.metric;
+}
+
+std::shared_ptr<LatencyHistogram> MetricsRegistry::histogram(const std::string& name, const std::string& help)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  Entry<LatencyHistogram>& entry(d_histograms[name]);
+  if (nullptr == entry.metric)
+    {
+      entry.help = help;
+      entry.metric = std::make_shared<LatencyHistogram>();
+    }
+  return entry.metric;
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() const
+{
+  MetricsSnapshot snap;
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  for(const auto& item : d_counters)
+    snap.counters[item.first] = item.second.metric->value();
+  for(const auto& item : d_histograms)
+    snap.histograms[item.first] = item.second.metric->snapshot();
+  return snap;
+}
+
+//"# HELP" line, the backslashes and the line breaks are escaped
+static void WriteHelp(std::ostream& os, const std::string& name, const std::string& help)
+{
+  os << "# HELP " << name << ' ';
+  for(char c : help)
+    {
+      if ('\\' == c)
+        os << "\\\\";
+      else if ('\n' == c)
+        os << "\\n";
+      else
+        os << c;
+    }
+  os << '\n';
+}
+
+void MetricsRegistry::writePrometheus(std::ostream& os) const
+{
+  //the powers of 2 are the buckets' bounds, so the counts are exact
+  static const unsigned firstBoundBit = 3, lastBoundBit = 27;
+  char buf[64];
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  for(const auto& item : d_counters)
+    {
+      WriteHelp(os, item.first, item.second.help);
+      os << "# TYPE " << item.first << " counter\n";
+      os << item.first << ' ' << item.second.metric->value() << '\n';
+    }
+  for(const auto& item : d_histograms)
+    {
+      const std::string& name(item.first);
+      HistogramSnapshot snap = item.second.metric->snapshot();
+      WriteHelp(os, name, item.second.help);
+      os << "# TYPE " << name << " histogram\n";
+      for(unsigned bit = firstBoundBit; bit <= lastBoundBit; ++bit)
+        {
+          uint64_t bound = (uint64_t)1 << bit;
+          std::snprintf(buf, sizeof(buf), "%.6f", (double)bound / 1e6);
+          os << name << "_bucket{le=\"" << buf << "\"} " << snap.countAtMost(bound) << '\n';
+        }
+      os << name << "_bucket{le=\"+Inf\"} " << snap.count << '\n';
+      std::snprintf(buf, sizeof(buf), "%.6f", (double)snap.sumUs / 1e6);
+      os << name << "_sum " << buf << '\n';
+      os << name << "_count " << snap.count << '\n';
+    }
+}
+
+bool MetricsRegistry::writePrometheusFile(const std::string& path) const
+{
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::out | std::ios::trunc);
+    writePrometheus(file);
+    file.flush();
+    if (!file)
+      {
+        std::cerr << __FUNCTION__ << " can't write " << tmpPath << "\n";
+        return false;
+      }
+  }
+  if (0 != std::rename(tmpPath.c_str(), path.c_str()))
+    {//Windows does not replace the file
+      std::remove(path.c_str());
+      if (0 != std::rename(tmpPath.c_str(), path.c_str()))
+        {
+          std::cerr << __FUNCTION__ << " can't rename " << tmpPath << "\n";
+          return false;
+        }
+    }
+  return true;
+}
+//---------------------------------------------------------------
+MetricsFileWriter::MetricsFileWriter(std::shared_ptr<const MetricsRegistry> registry,
+                                     const std::string& path, unsigned periodMs)
+  : d_registry(registry), d_path(path), d_period(periodMs), d_stop(false)
+{
+  d_thread = std::thread(&MetricsFileWriter::loop, this);
+}
+
+MetricsFileWriter::~MetricsFileWriter()
+{
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    d_stop = true;
+  }
+  cond.notify_all();
+  if (d_thread.joinable())
+    d_thread.join();
+}
+
+void MetricsFileWriter::loop()
+{
+  std::unique_lock<std::mutex> lk(mu);
+  bool stopped = false;
+  while(!stopped)
+    {
+      stopped = cond.wait_for(lk, d_period, [this]() { return d_stop; });
+      //the last values are written on stop as well
+      lk.unlock();
+      try {
+        d_registry->writePrometheusFile(d_path);
+      } catch(const std::exception& ex)
+      {
+        std::cerr << __FUNCTION__ << " " << ex.what() << "\n";
+      }
+      lk.lock();
+    }
+}
+
+}//WebGrep
@@ -0,0 +1,182 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+/** The shard of the calling thread: the threads are given the shards round-robin
+ *  at their first call, so the hot paths of the different threads touch different cache lines.*/
+unsigned MetricShardIndex();
+
+//microseconds passed since (start)
+inline uint64_t MicrosSince(std::chrono::steady_clock::time_point start)
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>
+      (std::chrono::steady_clock::now() - start).count();
+}
+
+//---------------------------------------------------------------
+/** A counter split into per-thread shards, add() is one relaxed atomic increment
+ *  of the thread's own cache line, value() sums the shards.*/
+class MetricCounter : public WebGrep::noncopyable
+{
+public:
+  static const unsigned shardsCount = 16;
+
+  MetricCounter();
+
+  void add(uint64_t n = 1)
+  { d_shards[MetricShardIndex() % shardsCount].value.fetch_add(n, std::memory_order_relaxed); }
+
+  uint64_t value() const;
+
+protected:
+  struct Shard
+  {
+    std::atomic<uint64_t> value;
+    char pad[64 - sizeof(std::atomic<uint64_t>)];
+  };
+  Shard d_shards[shardsCount];
+};
+
+//---------------------------------------------------------------
+/** Counts of a histogram's buckets summed over the shards, see LatencyHistogram.*/
+struct HistogramSnapshot
+{
+  HistogramSnapshot() : count(0), sumUs(0) { }
+
+  /** The value at (q) 0..1 -- the highest value of it's bucket, microseconds; 0 if it's empty.*/
+  uint64_t quantileUs(double q) const;
+
+  /** Count of the values not greater than (us), exact for the buckets' limits
+   *  (the powers of 2 are among them).*/
+  uint64_t countAtMost(uint64_t us) const;
+
+  uint64_t count;//< sum of the buckets
+  uint64_t sumUs;
+  std::vector<uint64_t> buckets;
+};
+
+/** HDR-style latency histogram of microseconds: the values up to 8 have a bucket each,
+ *  then each power of 2 is split into 8 buckets, so a bucket is 12.5% of the value at most.
+ *  A bucket holds the values greater than the previous limit and not greater than it's own.
+ *  The values from 2^35 us (about 9.5 hours) fall into the last bucket.
+ *  The buckets are sharded per thread like MetricCounter, record() is lock-free.*/
+class LatencyHistogram : public WebGrep::noncopyable
+{
+public:
+  static const unsigned subBucketBits = 3;
+  static const unsigned maxValueBits = 35;
+  static const unsigned bucketsCount = (maxValueBits - subBucketBits + 1) << subBucketBits;
+  static const unsigned shardsCount = 8;
+
+  LatencyHistogram();
+
+  void record(uint64_t us);
+
+  /** record() the time passed since (start).*/
+  void recordSince(std::chrono::steady_clock::time_point start) { record(MicrosSince(start)); }
+
+  HistogramSnapshot snapshot() const;
+
+  static unsigned BucketIndex(uint64_t us);
+
+  /** The highest value of the bucket.*/
+  static uint64_t BucketLimit(unsigned idx);
+
+protected:
+  struct Shard
+  {
+    Shard();
+    std::atomic<uint64_t> buckets[bucketsCount];
+    std::atomic<uint64_t> sumUs;
+  };
+  std::vector<Shard> d_shards;
+};
+
+//---------------------------------------------------------------
+/** Values of the registry's metrics at the moment, by their names.*/
+struct MetricsSnapshot
+{
+  /** 0 or empty if there is no such metric.*/
+  uint64_t counter(const std::string& name) const;
+  HistogramSnapshot histogram(const std::string& name) const;
+
+  std::map<std::string, uint64_t> counters;
+  std::map<std::string, HistogramSnapshot> histograms;
+};
+
+/** Named counters and latency histograms, the names follow Prometheus:
+ *  "webgrep_pages_total", the histograms are exported in seconds ("webgrep_fetch_seconds").
+ *  The metrics are taken once by name and updated by the pointers: the registry is not
+ *  on the hot path, it's locked by the lookups and snapshot() only. Thread-safe.*/
+class MetricsRegistry : public WebGrep::noncopyable
+{
+public:
+  /** Get the metric of (name) or make a new one. Possible exceptions: bad_alloc.*/
+  std::shared_ptr<MetricCounter> counter(const std::string& name, const std::string& help);
+  std::shared_ptr<LatencyHistogram> histogram(const std::string& name, const std::string& help);
+
+  MetricsSnapshot snapshot() const;
+
+  /** Write the metrics in Prometheus text format (version 0.0.4),
+   *  the histograms have the buckets of the powers of 2 from 8us to 2^27us (134s).*/
+  void writePrometheus(std::ostream& os) const;
+
+  /** writePrometheus() to "(path).tmp", then rename it to (path):
+   *  the readers never see a half-written file. @return FALSE on I/O errors.*/
+  bool writePrometheusFile(const std::string& path) const;
+
+protected:
+  template<typename T>
+  struct Entry
+  {
+    std::string help;
+    std::shared_ptr<T> metric;
+  };
+
+  mutable std::mutex mu;
+  std::map<std::string, Entry<MetricCounter>> d_counters;
+  std::map<std::string, Entry<LatencyHistogram>> d_histograms;
+};
+
+//---------------------------------------------------------------
+/** Writes the registry to the Prometheus text file every (periodMs) from it's own thread,
+ *  e.g. for node_exporter's textfile collector. The destructor stops the thread
+ *  and writes the file once more.*/
+class MetricsFileWriter : public WebGrep::noncopyable
+{
+public:
+  MetricsFileWriter(std::shared_ptr<const MetricsRegistry> registry,
+                    const std::string& path, unsigned periodMs = 5000);
+  ~MetricsFileWriter();
+
+  const std::string& path() const { return d_path; }
+
+protected:
+  void loop();
+
+  std::shared_ptr<const MetricsRegistry> d_registry;
+  std::string d_path;
+  std::chrono::milliseconds d_period;
+  std::mutex mu;
+  std::condition_variable cond;
+  bool d_stop;
+  std::thread d_thread;
+};
+
+}//WebGrep
+
+#endif // METRICS_H
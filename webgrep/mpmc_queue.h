@@ -0,0 +1,140 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+/** Bounded lock-free multi-producer/multi-consumer queue (D.Vyukov's ring buffer).
+ *  Each cell has a sequence number that tells whether the cell is free for
+ *  the producer at position (pos) or holds a value for the consumer at (pos),
+ *  so push() and pop() cost one CAS on the position counter each.
+ *
+ *  The values are moved in and out, the queue never copies them.
+ *  T must be default constructible and move assignable.
+ *  Capacity is rounded up to power of 2.
+*/
+template<typename T>
+class MPMCBoundedQueue : public WebGrep::noncopyable
+{
+public:
+  explicit MPMCBoundedQueue(size_t capacity = 1024)
+  {
+    size_t cap = 2;
+    for(; cap < capacity; cap <<= 1) { }
+    mask = cap - 1;
+    cells = std::vector<Cell>(cap);
+    for(size_t c = 0; c < cap; ++c)
+      {
+        cells[c].seq.store(c, std::memory_order_relaxed);
+      }
+    enqueuePos.store(0, std::memory_order_relaxed);
+    dequeuePos.store(0, std::memory_order_relaxed);
+  }
+
+  size_t capacity() const { return mask + 1; }
+
+  /** @return FALSE when the queue is full, (value) is left untouched then.*/
+  bool push(T&& value)
+  {
+    Cell* cell = nullptr;
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for(;;)
+      {
+        cell = &cells[pos & mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (0 == diff)
+          {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+              break;
+          }
+        else if (diff < 0)
+          {
+            return false;//full
+          }
+        else
+          {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+          }
+      }
+    cell->data = std::move(value);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** @return FALSE when the queue is empty.*/
+  bool pop(T& out)
+  {
+    Cell* cell = nullptr;
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    for(;;)
+      {
+        cell = &cells[pos & mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (0 == diff)
+          {
+            if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+              break;
+          }
+        else if (diff < 0)
+          {
+            return false;//empty
+          }
+        else
+          {
+            pos = dequeuePos.load(std::memory_order_relaxed);
+          }
+      }
+    out = std::move(cell->data);
+    cell->data = T();//release the resources held by the moved-from value
+    cell->seq.store(pos + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Approximate count of items, exact only when there is no concurrent access.*/
+  size_t sizeApprox() const
+  {
+    size_t tail = enqueuePos.load(std::memory_order_acquire);
+    size_t head = dequeuePos.load(std::memory_order_acquire);
+    return (tail > head)? tail - head : 0;
+  }
+
+  bool emptyApprox() const { return 0 == sizeApprox(); }
+
+protected:
+  struct Cell
+  {
+    Cell() { seq.store(0, std::memory_order_relaxed); }
+    Cell(Cell&& other) : data(std::move(other.data))
+    { seq.store(other.seq.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+    Cell& operator = (Cell&& other)
+    {
+      data = std::move(other.data);
+      seq.store(other.seq.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+    }
+    std::atomic<size_t> seq;
+    T data;
+  };
+  typedef char CacheLinePad_t[64];
+
+  CacheLinePad_t pad0;
+  std::vector<Cell> cells;
+  size_t mask;
+  CacheLinePad_t pad1;
+  std::atomic<size_t> enqueuePos;
+  CacheLinePad_t pad2;
+  std::atomic<size_t> dequeuePos;
+  CacheLinePad_t pad3;
+};
+
+}//WebGrep
+
+#endif // MPMC_QUEUE_H
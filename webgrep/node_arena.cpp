@@ -0,0 +1,112 @@
+#include "node_arena.h"
+#include <new>
+#include <iostream>
+#include <type_traits>
+
+namespace WebGrep {
+
+struct NodeArena::Slot
+{
+  //must be the first member: the node's address is the slot's address
+  typename std::aligned_storage<sizeof(LinkedTask), alignof(LinkedTask)>::type storage;
+  bool isAlive;
+  Slot* nextFree;
+};
+
+NodeArena::NodeArena(size_t nodesPerSlab)
+  : slabSize(std::max<size_t>(1, nodesPerSlab)), used(0), freeList(nullptr), alive(0)
+{
+
+}
+
+NodeArena::~NodeArena()
+{
+  clear();
+}
+
+LinkedTask* NodeArena::make(LinkedTask* rootNode)
+{
+  Slot* slot = nullptr;
+  try {
+    {
+      std::lock_guard<std::mutex> lk(mu); (void)lk;
+      if (nullptr != freeList)
+        {
+          slot = freeList;
+          freeList = slot->nextFree;
+        }
+      else
+        {
+          if (slabs.empty() || used == slabSize)
+            {
+              slabs.push_back(std::unique_ptr<Slot[]>(new Slot[slabSize]));
+              used = 0;
+            }
+          slot = &(slabs.back()[used++]);
+        }
+      slot->isAlive = true;
+      ++alive;
+    }
+    return new (&slot->storage) LinkedTask(rootNode);
+
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << std::endl;
+  }
+  if (nullptr != slot)
+    {//the node's constructor has thrown
+      std::lock_guard<std::mutex> lk(mu); (void)lk;
+      slot->isAlive = false;
+      slot->nextFree = freeList;
+      freeList = slot;
+      --alive;
+    }
+  return nullptr;
+}
+
+void NodeArena::destroy(LinkedTask* node)
+{
+  if (nullptr == node)
+    return;
+  Slot* slot = reinterpret_cast<Slot*>(node);
+  node->~LinkedTask();
+
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  slot->isAlive = false;
+  slot->nextFree = freeList;
+  freeList = slot;
+  --alive;
+}
+
+void NodeArena::clear()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  for(size_t idx = 0; idx < slabs.size(); ++idx)
+    {
+      Slot* slab = slabs[idx].get();
+      size_t count = (idx + 1 == slabs.size())? used : slabSize;
+      for(size_t cnt = 0; cnt < count; ++cnt)
+        {
+          if (slab[cnt].isAlive)
+            reinterpret_cast<LinkedTask*>(&slab[cnt].storage)->~LinkedTask();
+        }
+    }
+  slabs.clear();
+  freeList = nullptr;
+  used = 0;
+  alive = 0;
+}
+
+size_t NodeArena::aliveCount()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  return alive;
+}
+
+size_t NodeArena::slabsCount()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  return slabs.size();
+}
+
+}//WebGrep
@@ -0,0 +1,55 @@
+#ifndef NODE_ARENA_H
+#define NODE_ARENA_H
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include "noncopyable.hpp"
+#include "linked_task.h"
+
+namespace WebGrep {
+
+/** Slab allocator of the LinkedTask nodes of one tree.
+ *  The nodes are constructed in blocks of memory for (nodesPerSlab) items,
+ *  the destroyed ones go to a free list and their memory is reused by the next make().
+ *  clear() destroys all nodes that are still alive and frees the slabs at once,
+ *  so the tree is released without traversal and a free() call for each node.
+ *
+ *  Thread-safe: make() and destroy() are called by the workers concurrently,
+ *  clear() must not run concurrently with them.
+ *  The root node of a tree owns it's arena by LinkedTask::arena,
+ *  see LinkedTask::createRootNode().
+*/
+class NodeArena : public WebGrep::noncopyable
+{
+public:
+  explicit NodeArena(size_t nodesPerSlab = 256);
+  ~NodeArena();
+
+  /** Construct a node for the tree of (rootNode).
+   * @return NULL on bad_alloc.*/
+  LinkedTask* make(LinkedTask* rootNode);
+
+  /** Destroy the node made by make(), it's memory is kept for the next make().*/
+  void destroy(LinkedTask* node);
+
+  /** Destroy all alive nodes and free the slabs.*/
+  void clear();
+
+  size_t aliveCount();
+  size_t slabsCount();
+
+protected:
+  struct Slot;
+
+  std::mutex mu;
+  size_t slabSize;
+  size_t used;//< slots taken from the last slab
+  std::vector<std::unique_ptr<Slot[]>> slabs;
+  Slot* freeList;
+  size_t alive;
+};
+
+}//WebGrep
+
+#endif // NODE_ARENA_H
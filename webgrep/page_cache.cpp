@@ -0,0 +1,156 @@
+#include "page_cache.h"
+#include "visited_set.h"
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace WebGrep {
+
+static const char cacheMagic[] = "WebGrep page cache 1";
+
+//TRUE if (line) starts with the header's (name) and ':', case insensitive
+static bool IsHeader(const char* line, size_t len, const char* name)
+{
+  size_t nameLen = ::strlen(name);
+  if (len <= nameLen || ':' != line[nameLen])
+    return false;
+  for(size_t pos = 0; pos < nameLen; ++pos)
+    {
+      if (std::tolower((unsigned char)line[pos]) != std::tolower((unsigned char)name[pos]))
+        return false;
+    }
+  return true;
+}
+
+//the value after "Name:" without the spaces and "\r\n"
+static std::string HeaderValue(const char* line, size_t len, size_t nameLen)
+{
+  size_t begin = nameLen + 1, end = len;
+  while(begin < end && std::isspace((unsigned char)line[begin]))
+    ++begin;
+  while(end > begin && std::isspace((unsigned char)line[end - 1]))
+    --end;
+  return std::string(line + begin, end - begin);
+}
+
+void HttpValidators::parseHeaderLine(const char* line, size_t len)
+{
+  if (len >= 5 && 0 == ::memcmp(line, "HTTP/", 5))
+    {
+      clear();
+      return;
+    }
+  if (IsHeader(line, len, "ETag"))
+    etag = HeaderValue(line, len, 4);
+  else if (IsHeader(line, len, "Last-Modified"))
+    lastModified = HeaderValue(line, len, 13);
+}
+
+std::vector<std::string> HttpValidators::conditionalHeaders() const
+{
+  std::vector<std::string> headers;
+  if (!etag.empty())
+    headers.push_back("If-None-Match: " + etag);
+  if (!lastModified.empty())
+    headers.push_back("If-Modified-Since: " + lastModified);
+  return headers;
+}
+
+//---------------------------------------------------------------
+PageCache::PageCache(const std::string& dir) : d_dir(dir), d_valid(false)
+{
+  tmpCounter.store(0);
+  while(d_dir.size() > 1 && ('/' == d_dir.back() || '\\' == d_dir.back()))
+    d_dir.pop_back();
+  if (d_dir.empty())
+    return;
+  struct stat st;
+  if (0 == ::stat(d_dir.c_str(), &st))
+    {
+      d_valid = (0 != (st.st_mode & S_IFDIR));
+      return;
+    }
+#ifdef _WIN32
+  d_valid = (0 == ::_mkdir(d_dir.c_str()));
+#else
+  d_valid = (0 == ::mkdir(d_dir.c_str(), 0755));
+#endif
+  if (!d_valid)
+    std::cerr << __FUNCTION__ << " can't create " << d_dir << "\n";
+}
+
+std::string PageCache::pathOf(const std::string& url) const
+{
+  char name[32];
+  ::snprintf(name, sizeof(name), "/%016llx.wgc", (unsigned long long)VisitedSet::HashURL(url));
+  return d_dir + name;
+}
+
+bool PageCache::lookup(const std::string& url, Entry& entry, bool withBody) const
+{
+  if (!d_valid)
+    return false;
+  std::ifstream in(pathOf(url), std::ios::binary);
+  if (!in)
+    return false;
+  std::string magic, size;
+  std::getline(in, magic);
+  std::getline(in, entry.url);
+  std::getline(in, entry.validators.etag);
+  std::getline(in, entry.validators.lastModified);
+  std::getline(in, size);
+  if (!in || magic != cacheMagic || entry.url != VisitedSet::NormalizeURL(url.data(), url.size()))
+    return false;//damaged or the hash of another URL
+  entry.body.clear();
+  if (!withBody)
+    return true;
+  size_t len = (size_t)::strtoull(size.c_str(), nullptr, 10);
+  entry.body.resize(len);
+  in.read(&entry.body[0], (std::streamsize)len);
+  return (size_t)in.gcount() == len;
+}
+
+bool PageCache::store(const std::string& url, const HttpValidators& validators, const std::string& body)
+{
+  if (!d_valid || validators.empty())
+    return false;
+  std::string path = pathOf(url);
+  std::string tmpPath = path + ".tmp" + std::to_string(tmpCounter.fetch_add(1));
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out << cacheMagic << "\n"
+        << VisitedSet::NormalizeURL(url.data(), url.size()) << "\n"
+        << validators.etag << "\n"
+        << validators.lastModified << "\n"
+        << body.size() << "\n";
+    out.write(body.data(), (std::streamsize)body.size());
+    if (!out)
+      {
+        out.close();
+        ::remove(tmpPath.c_str());
+        return false;
+      }
+  }
+#ifdef _WIN32
+  ::remove(path.c_str());//rename() doesn't replace on Windows
+#endif
+  if (0 != ::rename(tmpPath.c_str(), path.c_str()))
+    {
+      ::remove(tmpPath.c_str());
+      return false;
+    }
+  return true;
+}
+
+bool PageCache::remove(const std::string& url)
+{
+  return d_valid && 0 == ::remove(pathOf(url).c_str());
+}
+
+}//WebGrep
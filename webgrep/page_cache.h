@@ -0,0 +1,73 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+/** Validators of a response: ETag and Last-Modified headers' values.*/
+struct HttpValidators
+{
+  std::string etag, lastModified;
+
+  bool empty() const { return etag.empty() && lastModified.empty(); }
+  void clear() { etag.clear(); lastModified.clear(); }
+
+  /** Take a validator from a raw header line like "ETag: \"1f-5a\"\r\n",
+   *  a status line "HTTP/1.1 301 ..." clears them: the redirect's headers don't count.*/
+  void parseHeaderLine(const char* line, size_t len);
+
+  /** "If-None-Match: ..." and "If-Modified-Since: ..." for a conditional GET.*/
+  std::vector<std::string> conditionalHeaders() const;
+};
+
+//---------------------------------------------------------------
+/** On-disk cache of the pages for the conditional GET: the page is stored with it's validators,
+ *  the next crawl sends them and takes the body from here if the server answers 304 Not Modified.
+ *
+ *  One file per page named by the hash of the normalized URL (VisitedSet::NormalizeURL()),
+ *  a file is written to a temporary one and renamed, so the readers never see it half-written.
+ *  Thread-safe, methods return FALSE on I/O errors and don't throw except bad_alloc.
+*/
+class PageCache : public WebGrep::noncopyable
+{
+public:
+  struct Entry
+  {
+    std::string url;//< normalized
+    HttpValidators validators;
+    std::string body;
+  };
+
+  /** @param dir: the directory of the files, it's created if it's parent exists.*/
+  explicit PageCache(const std::string& dir);
+
+  //FALSE if the directory is missing and can't be created
+  bool valid() const { return d_valid; }
+  const std::string& dir() const { return d_dir; }
+
+  /** Read the page's entry.
+   * @param withBody: FALSE to read the validators only.
+   * @return FALSE if the page is not cached.*/
+  bool lookup(const std::string& url, Entry& entry, bool withBody = true) const;
+
+  /** Store (replace) the page, the pages without validators are not stored.*/
+  bool store(const std::string& url, const HttpValidators& validators, const std::string& body);
+
+  bool remove(const std::string& url);
+
+  //the file of the URL's entry
+  std::string pathOf(const std::string& url) const;
+
+protected:
+  std::string d_dir;
+  bool d_valid;
+  std::atomic_uint tmpCounter;
+};
+
+}//WebGrep
+
+#endif // PAGE_CACHE_H
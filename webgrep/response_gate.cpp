@@ -0,0 +1,162 @@
+#include "response_gate.h"
+#include "linked_task.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <array>
+#include <algorithm>
+
+namespace WebGrep {
+
+const size_t ResponseGate::defaultMaxBytes;
+
+ResponseGate::ResponseGate(size_t maxBytes)
+  : maxBytes(maxBytes), d_status(0), d_received(0), d_reason(nullptr)
+{
+
+}
+
+//TRUE if (line) starts with (name), case insensitive
+static bool StartsWith(const char* line, size_t len, const char* name)
+{
+  size_t nameLen = ::strlen(name);
+  if (len < nameLen)
+    return false;
+  for(size_t pos = 0; pos < nameLen; ++pos)
+    {
+      if (std::tolower((unsigned char)line[pos]) != std::tolower((unsigned char)name[pos]))
+        return false;
+    }
+  return true;
+}
+
+bool ResponseGate::onHeaderLine(const char* line, size_t len)
+{
+  if (StartsWith(line, len, "HTTP/"))
+    {//"HTTP/1.1 200 OK"
+      const char* space = (const char*)::memchr(line, ' ', len);
+      onStatus((nullptr == space)? 0 : ::strtol(space + 1, nullptr, 10));
+    }
+  else if (StartsWith(line, len, "Content-Type:"))
+    {
+      onContentType(line + 13, len - 13);
+    }
+  else if (StartsWith(line, len, "Content-Length:"))
+    {
+      std::string value(line + 15, len - 15);
+      onContentLength(::strtoull(value.c_str(), nullptr, 10));
+    }
+  return !rejected();
+}
+
+void ResponseGate::onStatus(long code)
+{//a new response: the previous one was a redirect
+  d_status = code;
+  d_received = 0;
+  d_reason = nullptr;
+}
+
+void ResponseGate::onContentType(const char* value, size_t len)
+{
+  if (checked() && !IsPageType(value, len))
+    d_reason = "not a text page";
+}
+
+void ResponseGate::onContentLength(uint64_t length)
+{
+  if (checked() && 0 != maxBytes && length > maxBytes)
+    d_reason = "too big page";
+}
+
+bool ResponseGate::onBody(size_t len)
+{
+  d_received += len;
+  if (checked() && 0 != maxBytes && d_received > maxBytes)
+    d_reason = "too big page";
+  return !rejected();
+}
+
+bool ResponseGate::IsPageType(const char* value, size_t len)
+{
+  while(len > 0 && std::isspace((unsigned char)*value))
+    {
+      ++value; --len;
+    }
+  static const char* pageTypes[] = { "text/html", "application/xhtml+xml", "text/plain" };
+  for(const char* type : pageTypes)
+    {
+      size_t typeLen = ::strlen(type);
+      //the type is followed by the end, ';' or a space
+      if (StartsWith(value, len, type)
+          && (len == typeLen || ';' == value[typeLen] || std::isspace((unsigned char)value[typeLen])))
+        return true;
+    }
+  return 0 == len;//an empty type is not known
+}
+
+//---------------------------------------------------------------
+bool CheckExtension(const char* buf, unsigned len)
+{
+  len = std::min((unsigned)WebGrep::MaxURLlen, len);
+  //the path's last segment without "?query" and "#fragment"
+  unsigned _begin = 0, _end = len;
+  for(unsigned pos = 0; pos + 2 < len; ++pos)
+    {
+      if (0 == ::memcmp(buf + pos, "://", 3))
+        {//skip the host, it has dots
+          _begin = pos + 3;
+          break;
+        }
+    }
+  for(unsigned pos = _begin; pos < _end; ++pos)
+    {
+      if ('?' == buf[pos] || '#' == buf[pos])
+        _end = pos;
+    }
+  unsigned _dot = _end;
+  for(unsigned pos = _end; pos > _begin && '/' != buf[pos - 1]; --pos)
+    {
+      if ('.' == buf[pos - 1])
+        {
+          _dot = pos - 1;
+          break;
+        }
+    }
+  if (_dot >= _end || (_begin > 0 && nullptr == ::memchr(buf + _begin, '/', _dot - _begin)))
+    {//has not dots (or it's the host's), consider it to be a folder
+      return true;
+    }
+  std::array<char, 8> ext;
+  unsigned extLen = _end - _dot - 1;
+  if (extLen >= ext.size())
+    return true;
+  for(unsigned pos = 0; pos < extLen; ++pos)
+    ext[pos] = (char)std::tolower((unsigned char)buf[_dot + 1 + pos]);
+  ext[extLen] = '\0';
+
+  //interesting files:
+  static const char* d_extensions[ ]
+      = {"html", "txt", "cgi", "htm", "asp", "aspx", "jsp", "php", "rb", "pl", "py", "shtml"};
+  for(const char* good : d_extensions)
+    {
+      if (0 == ::strcmp(ext.data(), good))
+        return true;//matches recommended extensions
+    }
+  //not interesting files (media, .css):
+  static const char* d_file_extensions[ ] = {
+      "js",  "jpg", "jpeg", "mp4", "mpeg", "avi",
+      "mkv", "rtmp", "mov", "3gp", "wav", "mp3",
+      "doc", "odt", "pdf", "gif", "ogv", "ogg",
+      "css", "png", "svg", "ico", "zip", "gz",
+      "tar", "exe", "webm", "webp", "woff", "woff2"
+    };
+  for(const char* bad : d_file_extensions)
+    {
+      if (0 == ::strcmp(ext.data(), bad))
+        return false;//match with media extention
+    }
+  return true;//not match, return default(TRUE)
+}
+
+}//WebGrep
@@ -0,0 +1,64 @@
+#ifndef RESPONSE_GATE_H
+#define RESPONSE_GATE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace WebGrep {
+
+/** Decides by the response's headers and size whether the page is worth downloading,
+ *  the transfer is aborted as soon as it says no:
+ *  the successfull (2xx) responses must be text/html (application/xhtml+xml, text/plain),
+ *  Content-Length and the received body must not exceed (maxBytes).
+ *  A response without Content-Type is accepted. The redirects' responses are not checked.
+ *
+ *  It's fed by the HTTP backend's callbacks of one request, not thread-safe.
+*/
+class ResponseGate
+{
+public:
+  static const size_t defaultMaxBytes = 8u << 20;
+
+  /** @param maxBytes: limit of the body, 0 -- no limit.*/
+  explicit ResponseGate(size_t maxBytes = defaultMaxBytes);
+
+  /** A raw header line like curl gives them: "HTTP/1.1 200 OK\r\n", "Content-Type: text/html\r\n".
+   *  @return FALSE if the transfer must be aborted.*/
+  bool onHeaderLine(const char* line, size_t len);
+
+  //these are for the backends that parse the headers themselves
+  void onStatus(long code);
+  void onContentType(const char* value, size_t len);
+  void onContentLength(uint64_t length);
+
+  /** Count (len) received bytes of the body. @return FALSE if the transfer must be aborted.*/
+  bool onBody(size_t len);
+
+  /** TRUE if the last status line is 2xx: the body is the page, not an error or a redirect.*/
+  bool successful() const { return checked(); }
+
+  bool rejected() const { return nullptr != d_reason; }
+  //why it's rejected or NULL
+  const char* reason() const { return d_reason; }
+  size_t received() const { return d_received; }
+
+  /** TRUE for "text/html; charset=utf-8" and the other types that may be grepped.*/
+  static bool IsPageType(const char* value, size_t len);
+
+  size_t maxBytes;
+
+protected:
+  bool checked() const { return d_status >= 200 && d_status < 300; }
+
+  long d_status;
+  size_t d_received;
+  const char* d_reason;
+};
+
+/** Guess by the extension of the URL's path whether it's a page worth downloading:
+ *  FALSE for the media files, scripts and styles, TRUE for the pages, folders and unknown types.*/
+bool CheckExtension(const char* buf, unsigned len);
+
+}//WebGrep
+
+#endif // RESPONSE_GATE_H
@@ -0,0 +1,350 @@
+#include "results_sink.h"
+#include "linked_task.h"
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+namespace WebGrep {
+
+void PageRecord::assign(const GrepVars& g, unsigned nodeLevel, bool withBody)
+{
+  url = g.targetUrl;
+  responseCode = g.responseCode;
+  downloaded = g.pageIsReady;
+  level = nodeLevel;
+  fetchMs = g.fetchMs;
+  pageBytes = g.pageContent.size();
+  matches.clear();
+  for(const GrepVars::CIteratorPair& match : g.matchTextVector)
+    matches.emplace_back(match.first, match.second);
+  body = withBody? g.pageContent.data() : nullptr;
+  bodyLen = withBody? g.pageContent.size() : 0;
+}
+//---------------------------------------------------------------
+ResultsSink::ResultsSink(bool withBody) : d_closed(false), d_withBody(withBody)
+{
+
+}
+
+ResultsSink::~ResultsSink()
+{
+
+}
+
+bool ResultsSink::write(const PageRecord& rec)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  if (d_closed)
+    return false;
+  try {
+    return doWrite(rec);
+  } catch(const std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << "\n";
+  }
+  return false;
+}
+
+void ResultsSink::close()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  if (!d_closed)
+    doFlush();
+  d_closed = true;
+}
+
+bool ResultsSink::closed()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  return d_closed;
+}
+
+bool ResultsSink::flush()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  //the output may be gone after close()
+  return !d_closed && doFlush();
+}
+//---------------------------------------------------------------
+StreamSink::StreamSink(const std::string& path, bool binary, bool withBody)
+  : ResultsSink(withBody), d_os(nullptr)
+{
+  d_file.open(path, std::ios::out | std::ios::trunc | (binary? std::ios::binary : std::ios::out));
+  if (d_file)
+    d_os = &d_file;
+}
+
+StreamSink::StreamSink(std::ostream* os, bool withBody)
+  : ResultsSink(withBody), d_os(os)
+{
+
+}
+
+bool StreamSink::doFlush()
+{
+  if (nullptr == d_os)
+    return false;
+  d_os->flush();
+  return !d_os->fail();
+}
+//---------------------------------------------------------------
+//length of the valid UTF-8 sequence at (text), 0 if it's not valid
+static size_t Utf8SequenceLen(const unsigned char* text, size_t len)
+{
+  unsigned char c = text[0];
+  size_t n = 0;
+  uint32_t cp = 0;
+  if (c < 0x80)
+    return 1;
+  else if (0xC0 == (c & 0xE0))
+    { n = 2; cp = c & 0x1F; }
+  else if (0xE0 == (c & 0xF0))
+    { n = 3; cp = c & 0x0F; }
+  else if (0xF0 == (c & 0xF8))
+    { n = 4; cp = c & 0x07; }
+  else
+    return 0;
+  if (n > len)
+    return 0;
+  for(size_t pos = 1; pos < n; ++pos)
+    {
+      if (0x80 != (text[pos] & 0xC0))
+        return 0;
+      cp = (cp << 6) | (text[pos] & 0x3F);
+    }
+  //overlong forms, surrogates and out of range
+  static const uint32_t minCodePoint[] = { 0, 0, 0x80, 0x800, 0x10000 };
+  if (cp < minCodePoint[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    return 0;
+  return n;
+}
+
+void JsonLinesSink::AppendJsonString(std::string& out, const char* text, size_t len)
+{
+  const unsigned char* u = (const unsigned char*)text;
+  out.push_back('"');
+  for(size_t pos = 0; pos < len; )
+    {
+      unsigned char c = u[pos];
+      switch(c)
+        {
+        case '"':  out += "\\\""; ++pos; continue;
+        case '\\': out += "\\\\"; ++pos; continue;
+        case '\n': out += "\\n"; ++pos; continue;
+        case '\r': out += "\\r"; ++pos; continue;
+        case '\t': out += "\\t"; ++pos; continue;
+        default: break;
+        }
+      if (c < 0x20)
+        {
+          char esc[8];
+          std::snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)c);
+          out += esc;
+          ++pos;
+          continue;
+        }
+      size_t n = Utf8SequenceLen(u + pos, len - pos);
+      if (0 == n)
+        {//replacement character
+          out += "\xEF\xBF\xBD";
+          ++pos;
+          continue;
+        }
+      out.append(text + pos, n);
+      pos += n;
+    }
+  out.push_back('"');
+}
+
+bool JsonLinesSink::doWrite(const PageRecord& rec)
+{
+  if (nullptr == d_os)
+    return false;
+  char buf[160];
+  std::string& line(d_line);
+  line.clear();
+  line += "{\"url\":";
+  AppendJsonString(line, rec.url.data(), rec.url.size());
+  std::snprintf(buf, sizeof(buf),
+                ",\"status\":%ld,\"downloaded\":%s,\"level\":%u,\"fetch_ms\":%u,\"bytes\":%llu,\"matches\":[",
+                rec.responseCode, rec.downloaded? "true" : "false",
+                rec.level, rec.fetchMs, (unsigned long long)rec.pageBytes);
+  line += buf;
+  for(size_t idx = 0; idx < rec.matches.size(); ++idx)
+    {
+      if (idx > 0)
+        line.push_back(',');
+      AppendJsonString(line, rec.matches[idx].data(), rec.matches[idx].size());
+    }
+  line.push_back(']');
+  if (d_withBody)
+    {
+      line += ",\"body\":";
+      AppendJsonString(line, rec.body, (nullptr == rec.body)? 0 : rec.bodyLen);
+    }
+  line += "}\n";
+  d_os->write(line.data(), line.size());
+  return !d_os->fail();
+}
+//---------------------------------------------------------------
+static const char binaryMagic[4] = { 'W', 'G', 'R', 'B' };
+static const uint32_t flagDownloaded = 1;
+//a record is read by these pieces: a broken size doesn't allocate more than the data has
+static const size_t readChunk = 64 * 1024;
+
+static void PutU32(std::string& out, uint32_t value)
+{
+  for(unsigned shift = 0; shift < 32; shift += 8)
+    out.push_back((char)((value >> shift) & 0xFF));
+}
+
+static void PutU64(std::string& out, uint64_t value)
+{
+  PutU32(out, (uint32_t)(value & 0xFFFFFFFFu));
+  PutU32(out, (uint32_t)(value >> 32));
+}
+
+static void PutString(std::string& out, const char* text, size_t len)
+{
+  PutU32(out, (uint32_t)len);
+  if (len > 0)
+    out.append(text, len);
+}
+
+//read uint32 at (pos), FALSE if out of (data)
+static bool GetU32(const std::string& data, size_t& pos, uint32_t& value)
+{
+  if (data.size() < 4 || pos > data.size() - 4)
+    return false;
+  value = 0;
+  for(unsigned idx = 0; idx < 4; ++idx)
+    value |= (uint32_t)(unsigned char)data[pos + idx] << (8 * idx);
+  pos += 4;
+  return true;
+}
+
+static bool GetString(const std::string& data, size_t& pos, std::string& text)
+{
+  uint32_t len = 0;
+  if (!GetU32(data, pos, len) || len > data.size() - pos)
+    return false;
+  text.assign(data, pos, len);
+  pos += len;
+  return true;
+}
+
+static bool WriteHeader(std::ostream* os)
+{
+  if (nullptr == os)
+    return false;
+  std::string header(binaryMagic, sizeof(binaryMagic));
+  PutU32(header, BinaryRecordSink::version);
+  os->write(header.data(), header.size());
+  return !os->fail();
+}
+
+const uint32_t BinaryRecordSink::version;
+
+BinaryRecordSink::BinaryRecordSink(const std::string& path, bool withBody)
+  : StreamSink(path, true, withBody)
+{
+  if (!WriteHeader(d_os))
+    d_os = nullptr;
+}
+
+BinaryRecordSink::BinaryRecordSink(std::ostream* os, bool withBody, bool header)
+  : StreamSink(os, withBody)
+{
+  if (header && !WriteHeader(d_os))
+    d_os = nullptr;
+}
+
+bool BinaryRecordSink::doWrite(const PageRecord& rec)
+{
+  if (nullptr == d_os)
+    return false;
+  std::string& out(d_record);
+  out.assign(4, '\0');//the size is set below
+  PutU32(out, (uint32_t)(int32_t)rec.responseCode);
+  PutU32(out, rec.downloaded? flagDownloaded : 0u);
+  PutU32(out, rec.level);
+  PutU32(out, rec.fetchMs);
+  PutU64(out, rec.pageBytes);
+  PutString(out, rec.url.data(), rec.url.size());
+  PutU32(out, (uint32_t)rec.matches.size());
+  for(const std::string& match : rec.matches)
+    PutString(out, match.data(), match.size());
+  size_t bodyLen = (d_withBody && nullptr != rec.body)? rec.bodyLen : 0;
+  PutString(out, rec.body, bodyLen);
+
+  std::string size;
+  PutU32(size, (uint32_t)(out.size() - 4));
+  out.replace(0, 4, size);
+  d_os->write(out.data(), out.size());
+  return !d_os->fail();
+}
+//---------------------------------------------------------------
+BinaryRecordReader::BinaryRecordReader(std::istream& is) : d_is(is), d_valid(false)
+{
+  char header[8];
+  if (!d_is.read(header, sizeof(header)) || 0 != ::memcmp(header, binaryMagic, sizeof(binaryMagic)))
+    return;
+  std::string data(header, sizeof(header));
+  size_t pos = sizeof(binaryMagic);
+  uint32_t ver = 0;
+  d_valid = GetU32(data, pos, ver) && BinaryRecordSink::version == ver;
+}
+
+bool BinaryRecordReader::next(PageRecord& rec)
+{
+  if (!d_valid)
+    return false;
+  char sizeBuf[4];
+  if (!d_is.read(sizeBuf, sizeof(sizeBuf)))
+    return false;
+  std::string sizeData(sizeBuf, sizeof(sizeBuf));
+  size_t pos = 0;
+  uint32_t size = 0;
+  GetU32(sizeData, pos, size);
+  d_record.clear();
+  while(d_record.size() < size)
+    {
+      size_t at = d_record.size();
+      size_t len = std::min(readChunk, (size_t)size - at);
+      d_record.resize(at + len);
+      if (!d_is.read(&d_record[at], len))
+        return false;//< short read
+    }
+
+  pos = 0;
+  uint32_t status = 0, flags = 0, low = 0, high = 0, count = 0;
+  bool ok = GetU32(d_record, pos, status) && GetU32(d_record, pos, flags) && GetU32(d_record, pos, rec.level)
+      && GetU32(d_record, pos, rec.fetchMs) && GetU32(d_record, pos, low) && GetU32(d_record, pos, high)
+      && GetString(d_record, pos, rec.url) && GetU32(d_record, pos, count);
+  if (!ok || count > size)
+    return false;
+  rec.responseCode = (long)(int32_t)status;
+  rec.downloaded = 0 != (flags & flagDownloaded);
+  rec.pageBytes = ((uint64_t)high << 32) | low;
+  rec.matches.resize(count);
+  for(std::string& match : rec.matches)
+    {
+      if (!GetString(d_record, pos, match))
+        return false;
+    }
+  if (!GetString(d_record, pos, d_body))
+    return false;
+  rec.body = d_body.data();
+  rec.bodyLen = d_body.size();
+  return true;
+}
+//---------------------------------------------------------------
+bool CallbackSink::doWrite(const PageRecord& rec)
+{
+  if (d_func)
+    d_func(rec);
+  return true;
+}
+
+}//WebGrep
@@ -0,0 +1,178 @@
+#ifndef RESULTS_SINK_H
+#define RESULTS_SINK_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+struct GrepVars;
+
+/** Results of one crawled page as they're given to a ResultsSink.*/
+struct PageRecord
+{
+  PageRecord() : responseCode(0), downloaded(false), level(0), fetchMs(0), pageBytes(0), body(nullptr), bodyLen(0)
+  { }
+
+  /** Copy the URL, status and the matched text of (g), the body is pointed at if (withBody).*/
+  void assign(const GrepVars& g, unsigned nodeLevel, bool withBody);
+
+  std::string url;
+  long responseCode;
+  bool downloaded;    //< the page's content is complete (GrepVars::pageIsReady)
+  unsigned level;     //< the depth of the page in the crawl, the first page is 0
+  unsigned fetchMs;   //< the download's duration
+  uint64_t pageBytes; //< size of the page's content
+  std::vector<std::string> matches;//< the matched text
+
+  //the page's content, NULL if not requested; valid during ResultsSink::write() only
+  const char* body;
+  size_t bodyLen;
+};
+
+//---------------------------------------------------------------
+/** Receives the results of each page as soon as it's parsed,
+ *  so the pages need not stay in the LinkedTask tree (see Crawler::setResultsSink()).
+ *  write() is called from the crawler's threads concurrently, the implementations are thread-safe.
+ *  After close() the records are dropped: the crawler's tasks that are still running
+ *  won't write after the results are collected.
+*/
+class ResultsSink : public WebGrep::noncopyable
+{
+public:
+  /** @param withBody: TRUE to get the pages' content as well.*/
+  explicit ResultsSink(bool withBody = false);
+  virtual ~ResultsSink();
+
+  bool withBody() const { return d_withBody; }
+
+  /** Write a record unless it's closed. @return FALSE on output errors or if closed.*/
+  bool write(const PageRecord& rec);
+
+  /** Flush the output and drop the next records.*/
+  void close();
+  bool closed();
+
+  /** Flush the output. @return FALSE on output errors or if closed.*/
+  bool flush();
+
+protected:
+  //called with (mu) locked
+  virtual bool doWrite(const PageRecord& rec) = 0;
+  virtual bool doFlush() { return true; }
+
+  std::mutex mu;
+  bool d_closed;
+  const bool d_withBody;
+};
+
+//---------------------------------------------------------------
+/** A sink that writes to a file it owns or to an external stream (like std::cout).*/
+class StreamSink : public ResultsSink
+{
+public:
+  /** The file is truncated.*/
+  StreamSink(const std::string& path, bool binary, bool withBody);
+
+  /** The stream is not owned, it must outlive the sink.*/
+  StreamSink(std::ostream* os, bool withBody);
+
+  //FALSE if the file can't be opened
+  bool valid() const { return nullptr != d_os; }
+
+protected:
+  bool doFlush() override;
+
+  std::ofstream d_file;
+  std::ostream* d_os;
+};
+
+//---------------------------------------------------------------
+/** JSON Lines: one object per page,
+ *  {"url":"...","status":200,"downloaded":true,"level":1,"fetch_ms":12,"bytes":5120,"matches":["..."],"body":"..."}
+ *  "body" is written by the sinks created (withBody). The text is escaped as JSON strings,
+ *  the bytes that are not valid UTF-8 become U+FFFD.*/
+class JsonLinesSink : public StreamSink
+{
+public:
+  explicit JsonLinesSink(const std::string& path, bool withBody = false)
+    : StreamSink(path, false, withBody) { }
+  explicit JsonLinesSink(std::ostream* os, bool withBody = false)
+    : StreamSink(os, withBody) { }
+
+  /** Append (text) to (out) as a quoted JSON string.*/
+  static void AppendJsonString(std::string& out, const char* text, size_t len);
+
+protected:
+  bool doWrite(const PageRecord& rec) override;
+
+  std::string d_line;
+};
+
+//---------------------------------------------------------------
+/** Compact binary records, all integers are little-endian:
+ *  the file starts with "WGRB" and uint32 version (1), then the records follow:
+ *  uint32 size of the record after this field, int32 status, uint32 flags (1 -- downloaded),
+ *  uint32 level, uint32 fetchMs,
+ *  uint64 pageBytes, the url, uint32 count of matches and the matches, the body;
+ *  each string is written as uint32 length and the bytes, the body is empty when it's not requested.
+ *  Read them by BinaryRecordReader.*/
+class BinaryRecordSink : public StreamSink
+{
+public:
+  static const uint32_t version = 1;
+
+  explicit BinaryRecordSink(const std::string& path, bool withBody = false);
+  /** @param header: FALSE when the records are appended to the stream that has the header already.*/
+  explicit BinaryRecordSink(std::ostream* os, bool withBody = false, bool header = true);
+
+protected:
+  bool doWrite(const PageRecord& rec) override;
+
+  std::string d_record;
+};
+
+/** Reads the records written by BinaryRecordSink.*/
+class BinaryRecordReader : public WebGrep::noncopyable
+{
+public:
+  /** Reads the file's header, check valid() then.*/
+  explicit BinaryRecordReader(std::istream& is);
+
+  bool valid() const { return d_valid; }
+
+  /** Read the next record, (rec.body) points to the reader's buffer until the next call.
+   *  @return FALSE at the end or if the data is broken.*/
+  bool next(PageRecord& rec);
+
+protected:
+  std::istream& d_is;
+  bool d_valid;
+  std::string d_record, d_body;
+};
+
+//---------------------------------------------------------------
+/** Hands the records to a functor, it's called under the sink's mutex: one at a time.*/
+class CallbackSink : public ResultsSink
+{
+public:
+  typedef std::function<void(const PageRecord&)> Callback_t;
+
+  explicit CallbackSink(Callback_t func, bool withBody = false)
+    : ResultsSink(withBody), d_func(func) { }
+
+protected:
+  bool doWrite(const PageRecord& rec) override;
+
+  Callback_t d_func;
+};
+
+}//WebGrep
+
+#endif // RESULTS_SINK_H
@@ -0,0 +1,363 @@
+#include "robots_rules.h"
+#include "host_scheduler.h"
+#include "linked_task.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+
+namespace WebGrep {
+
+static std::string Trim(const std::string& str, size_t begin, size_t end)
+{
+  while(begin < end && std::isspace((unsigned char)str[begin]))
+    ++begin;
+  while(end > begin && std::isspace((unsigned char)str[end - 1]))
+    --end;
+  return str.substr(begin, end - begin);
+}
+
+static std::string ToLower(std::string str)
+{
+  for(char& ch : str)
+    ch = (char)std::tolower((unsigned char)ch);
+  return str;
+}
+
+RobotsRules::RobotsRules() : d_crawlDelay(-1.0), d_rulesCount(0)
+{
+  TrieNode root;
+  root.ch = 0;
+  root.rule = NO_RULE;
+  root.firstChild = root.nextSibling = 0;
+  trie.push_back(root);
+}
+
+std::shared_ptr<const RobotsRules> RobotsRules::AllowAll()
+{
+  static std::shared_ptr<const RobotsRules> empty = std::make_shared<RobotsRules>();
+  return empty;
+}
+
+std::shared_ptr<const RobotsRules> RobotsRules::Parse(const std::string& text, const std::string& userAgent)
+{
+  //the rules of the groups for (userAgent) and for "*"
+  struct Collected
+  {
+    Collected() : found(false), delay(-1.0) { }
+    bool found;
+    double delay;
+    std::vector<std::pair<std::string, bool>> rules;
+  } mine, star;
+
+  std::string agent = ToLower(userAgent);
+  bool groupMine = false, groupStar = false, lastWasAgent = false;
+  size_t lineBegin = 0;
+  while(lineBegin < text.size())
+    {
+      size_t lineEnd = text.find('\n', lineBegin);
+      lineEnd = (std::string::npos == lineEnd)? text.size() : lineEnd;
+      size_t end = std::min(lineEnd, text.find('#', lineBegin));
+      size_t colon = text.find(':', lineBegin);
+      size_t begin = lineBegin;
+      lineBegin = lineEnd + 1;
+      if (colon >= end)
+        continue;
+
+      std::string key = ToLower(Trim(text, begin, colon));
+      std::string value = Trim(text, colon + 1, end);
+      if ("user-agent" == key)
+        {//the consequent User-agent lines make one group
+          if (!lastWasAgent)
+            groupMine = groupStar = false;
+          lastWasAgent = true;
+          std::string token = ToLower(value.substr(0, value.find_first_of("/ \t")));
+          if ("*" == token)
+            {
+              groupStar = star.found = true;
+            }
+          else if (!token.empty() && token == agent)
+            {
+              groupMine = mine.found = true;
+            }
+          continue;
+        }
+      lastWasAgent = false;
+      if ("allow" == key || "disallow" == key)
+        {//"Disallow:" with empty path allows everything
+          if (value.empty() || ('/' != value[0] && '*' != value[0]))
+            continue;
+          if (groupMine)
+            mine.rules.push_back(std::make_pair(value, "allow" == key));
+          if (groupStar)
+            star.rules.push_back(std::make_pair(value, "allow" == key));
+        }
+      else if ("crawl-delay" == key)
+        {
+          char* parsed = nullptr;
+          double delay = ::strtod(value.c_str(), &parsed);
+          if (parsed == value.c_str() || delay < 0.0)
+            continue;
+          if (groupMine)
+            mine.delay = delay;
+          if (groupStar)
+            star.delay = delay;
+        }
+    }
+
+  std::shared_ptr<RobotsRules> result = std::make_shared<RobotsRules>();
+  const Collected& taken(mine.found? mine : star);
+  for(const auto& rule : taken.rules)
+    {
+      result->addRule(rule.first, rule.second);
+    }
+  result->d_crawlDelay = taken.delay;
+  return result;
+}
+
+void RobotsRules::addRule(const std::string& path, bool allow)
+{
+  ++d_rulesCount;
+  if (std::string::npos != path.find('*') || '$' == path.back())
+    {
+      Pattern p;
+      p.expr = path;
+      p.allow = allow;
+      patterns.push_back(std::move(p));
+      return;
+    }
+  uint32_t idx = 0;
+  for(char ch : path)
+    {
+      uint32_t child = trie[idx].firstChild;
+      for(; 0 != child && ch != trie[child].ch; child = trie[child].nextSibling)
+        { }
+      if (0 == child)
+        {//a new node in front of the siblings
+          TrieNode node;
+          node.ch = ch;
+          node.rule = NO_RULE;
+          node.firstChild = 0;
+          node.nextSibling = trie[idx].firstChild;
+          child = (uint32_t)trie.size();
+          trie.push_back(node);
+          trie[idx].firstChild = child;
+        }
+      idx = child;
+    }
+  trie[idx].rule |= allow? ALLOW : DISALLOW;
+}
+
+bool RobotsRules::MatchPattern(const std::string& expr, const char* path, size_t len)
+{
+  bool anchored = !expr.empty() && '$' == expr.back();
+  size_t exprLen = anchored? expr.size() - 1 : expr.size();
+  size_t e = 0, t = 0;
+  size_t starE = std::string::npos, starT = 0;
+  while(t < len)
+    {
+      if (e < exprLen && '*' == expr[e])
+        {
+          starE = e++;
+          starT = t;
+          continue;
+        }
+      if (e < exprLen && expr[e] == path[t])
+        {
+          ++e; ++t;
+          continue;
+        }
+      if (e == exprLen && !anchored)
+        return true;//the path has (expr) as a prefix
+      if (std::string::npos == starE)
+        return false;
+      //let the last '*' take one char more
+      e = starE + 1;
+      t = ++starT;
+    }
+  while(e < exprLen && '*' == expr[e])
+    ++e;
+  return e == exprLen;
+}
+
+bool RobotsRules::allowed(const std::string& pathOrUrl) const
+{
+  const char* path = pathOrUrl.data();
+  size_t len = pathOrUrl.size();
+  if (0 == len || '/' != path[0])
+    {//the path of a full URL
+      size_t hostPos = pathOrUrl.find("://");
+      hostPos = (std::string::npos == hostPos)? 0 : hostPos + 3;
+      size_t pathPos = pathOrUrl.find('/', hostPos);
+      if (std::string::npos == pathPos)
+        {
+          static const char slash[] = "/";
+          path = slash;
+          len = 1;
+        }
+      else
+        {
+          path += pathPos;
+          len -= pathPos;
+        }
+    }
+  len = std::min(len, (size_t)(std::find(path, path + len, '#') - path));
+  if (11 == len && 0 == ::memcmp(path, "/robots.txt", 11))
+    return true;
+
+  size_t bestLen = 0;
+  uint8_t bestRule = NO_RULE;
+  uint32_t idx = 0;
+  for(size_t pos = 0; pos < len; ++pos)
+    {
+      uint32_t child = trie[idx].firstChild;
+      for(; 0 != child && path[pos] != trie[child].ch; child = trie[child].nextSibling)
+        { }
+      if (0 == child)
+        break;
+      idx = child;
+      if (NO_RULE != trie[idx].rule)
+        {
+          bestLen = pos + 1;
+          bestRule = trie[idx].rule;
+        }
+    }
+  for(const Pattern& p : patterns)
+    {
+      size_t plen = p.expr.size();
+      if (plen < bestLen || (plen == bestLen && !p.allow) || !MatchPattern(p.expr, path, len))
+        continue;
+      bestRule = (plen == bestLen)? (bestRule | ALLOW) : (p.allow? ALLOW : DISALLOW);
+      bestLen = plen;
+    }
+  return NO_RULE == bestRule || 0 != (bestRule & ALLOW);
+}
+
+//---------------------------------------------------------------
+RobotsCache::RobotsCache(std::shared_ptr<HostScheduler> scheduler, const std::string& userAgent)
+  : scheduler(scheduler), userAgent(userAgent)
+{
+
+}
+
+std::string RobotsCache::OriginOf(const std::string& url)
+{
+  size_t hostPos = url.find("://");
+  std::string origin;
+  if (std::string::npos == hostPos)
+    {
+      hostPos = 0;
+      origin = "http://";
+    }
+  else
+    {
+      hostPos += 3;
+    }
+  size_t pathPos = url.find_first_of("/?#", hostPos);
+  origin += url.substr(0, pathPos);
+  return ToLower(origin);
+}
+
+std::shared_ptr<RobotsCache::Entry> RobotsCache::entryOf(const std::string& origin, bool create)
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  auto iter = entries.find(origin);
+  if (entries.end() != iter)
+    return iter->second;
+  if (!create)
+    return nullptr;
+  std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+  entries[origin] = entry;
+  return entry;
+}
+
+std::shared_ptr<const RobotsRules> RobotsCache::rules(const std::string& url, const FetchFunc_t& fetch)
+{
+  std::string origin = OriginOf(url);
+  std::shared_ptr<Entry> entry = entryOf(origin, true);
+  std::shared_ptr<const RobotsRules> result = std::atomic_load(&entry->rules);
+  if (nullptr != result)
+    return result;
+  {
+    std::unique_lock<std::mutex> lk(mu);
+    fetchedCond.wait(lk, [&entry]() { return !entry->fetching; });
+    result = std::atomic_load(&entry->rules);
+    if (nullptr != result)
+      return result;//fetched by another thread meanwhile
+    entry->fetching = true;
+  }
+
+  std::string content;
+  long responseCode = 0;
+  bool fetched = false;
+  try {
+    fetched = (nullptr != fetch) && fetch(origin + "/robots.txt", content, responseCode);
+  } catch(...)
+  {//the waiting threads go on without the rules
+    store(url, false, 0, content);
+    throw;
+  }
+  return store(url, fetched, responseCode, content);
+}
+
+bool RobotsCache::claimFetch(const std::string& url)
+{
+  std::shared_ptr<Entry> entry = entryOf(OriginOf(url), true);
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  if (entry->fetching || nullptr != std::atomic_load(&entry->rules))
+    return false;
+  entry->fetching = true;
+  return true;
+}
+
+std::shared_ptr<const RobotsRules> RobotsCache::store(const std::string& url, bool fetched,
+                                                      long responseCode, const std::string& content)
+{
+  std::shared_ptr<Entry> entry = entryOf(OriginOf(url), true);
+  std::shared_ptr<const RobotsRules> result;
+  if (fetched && 200 == responseCode)
+    {
+      result = RobotsRules::Parse(content, userAgent);
+    }
+  else
+    {//4xx: there are no rules, 5xx or no response: not worth to wait for them
+      result = RobotsRules::AllowAll();
+    }
+  if (nullptr != scheduler && result->crawlDelay() > 0.0)
+    {
+      scheduler->setHostRate(ExtractHostPortHttp(url), 1.0 / result->crawlDelay());
+    }
+  std::atomic_store(&entry->rules, result);
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    entry->fetching = false;
+  }
+  fetchedCond.notify_all();
+  return result;
+}
+
+std::shared_ptr<const RobotsRules> RobotsCache::peek(const std::string& url)
+{
+  std::shared_ptr<Entry> entry = entryOf(OriginOf(url), false);
+  return (nullptr == entry)? nullptr : std::atomic_load(&entry->rules);
+}
+
+bool RobotsCache::allowed(const std::string& url)
+{
+  std::shared_ptr<const RobotsRules> cached = peek(url);
+  return nullptr == cached || cached->allowed(url);
+}
+
+size_t RobotsCache::size()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  return entries.size();
+}
+
+void RobotsCache::clear()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  entries.clear();
+}
+
+}//WebGrep
@@ -0,0 +1,138 @@
+#ifndef ROBOTS_RULES_H
+#define ROBOTS_RULES_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include "noncopyable.hpp"
+#include "user_agent.h"
+
+namespace WebGrep {
+
+class HostScheduler;
+
+/** Allow/Disallow rules of one host's robots.txt for our user-agent (RFC 9309):
+ *  the longest matching rule wins, Allow wins the tie, no rule -- allowed.
+ *
+ *  The plain path prefixes are kept in a prefix trie (one small node per byte),
+ *  so a path is checked by one walk down the trie;
+ *  the rules with '*' or '$' are few and checked one by one after that.
+ *  Immutable after Parse(), may be read concurrently.
+*/
+class RobotsRules : public WebGrep::noncopyable
+{
+public:
+  RobotsRules();
+
+  /** Parse the robots.txt text, take the groups of (userAgent)
+   *  or the "*" groups if there is none for it. Possible exceptions: bad_alloc.*/
+  static std::shared_ptr<const RobotsRules> Parse(const std::string& text,
+                                                  const std::string& userAgent = UserAgentToken);
+
+  //no rules: everything is allowed
+  static std::shared_ptr<const RobotsRules> AllowAll();
+
+  /** Check the path (and query) of a URL like "/dir/page.php?x=1",
+   *  a full URL is accepted as well: the part after the host is taken.*/
+  bool allowed(const std::string& pathOrUrl) const;
+
+  //Crawl-delay in seconds or a negative value if not set
+  double crawlDelay() const { return d_crawlDelay; }
+
+  size_t rulesCount() const { return d_rulesCount; }
+
+protected:
+  enum : uint8_t { NO_RULE = 0, ALLOW = 1, DISALLOW = 2 };
+
+  struct TrieNode
+  {
+    char ch;
+    uint8_t rule;
+    uint32_t firstChild, nextSibling;//< indices in (trie), 0 if none
+  };
+
+  struct Pattern
+  {
+    std::string expr;//< with '*' and may be '$' at the end
+    bool allow;
+  };
+
+  void addRule(const std::string& path, bool allow);
+  static bool MatchPattern(const std::string& expr, const char* path, size_t len);
+
+  std::vector<TrieNode> trie;//< [0] is the root: the empty prefix
+  std::vector<Pattern> patterns;
+  double d_crawlDelay;
+  size_t d_rulesCount;
+};
+
+//---------------------------------------------------------------
+/** robots.txt of the hosts met in a crawl, fetched once per "scheme://host:port".
+ *  A host without robots.txt (or that failed to give it) is allowed entirely.
+ *  Crawl-delay is passed to the HostScheduler as the host's rate.
+ *  The rules are fetched by rules() that waits for them, or by the caller
+ *  that has won claimFetch() and gives the response to store() -- nobody waits then.
+ *  Thread-safe, shared by all nodes of a tree via LinkedTask::robotsCache.
+*/
+class RobotsCache : public WebGrep::noncopyable
+{
+public:
+  /** Download the (robotsUrl), @return FALSE if there is no response.*/
+  typedef std::function<bool(const std::string& robotsUrl, std::string& content, long& responseCode)> FetchFunc_t;
+
+  explicit RobotsCache(std::shared_ptr<HostScheduler> scheduler = nullptr,
+                       const std::string& userAgent = UserAgentToken);
+
+  /** The rules of the URL's host, they're fetched by (fetch) if not cached yet,
+   *  the other threads asking for the same host wait for it. Never NULL.
+   *  Possible exceptions: bad_alloc.*/
+  std::shared_ptr<const RobotsRules> rules(const std::string& url, const FetchFunc_t& fetch);
+
+  /** Take the download of the URL's host's robots.txt, doesn't wait.
+   *  @return TRUE if the rules are not known and nobody fetches them:
+   *  the caller downloads origin + "/robots.txt" then and must call store(). */
+  bool claimFetch(const std::string& url);
+
+  /** The robots.txt of the URL's host is downloaded: parse and publish the rules,
+   *  wake up rules() waiting for them. Never NULL.
+   *  @param fetched: FALSE if there was no response, everything is allowed then.
+   *  Possible exceptions: bad_alloc.*/
+  std::shared_ptr<const RobotsRules> store(const std::string& url, bool fetched,
+                                           long responseCode, const std::string& content);
+
+  /** The cached rules of the URL's host or NULL, doesn't wait.*/
+  std::shared_ptr<const RobotsRules> peek(const std::string& url);
+
+  /** Check the URL by the cached rules, TRUE if the host's rules are not known yet.*/
+  bool allowed(const std::string& url);
+
+  //"http://site.com:8080" of "http://site.com:8080/a/b.html"
+  static std::string OriginOf(const std::string& url);
+
+  size_t size();
+  void clear();
+
+protected:
+  struct Entry
+  {
+    Entry() : fetching(false) { }
+    bool fetching;//< the robots.txt is downloading, guarded by (mu)
+    std::shared_ptr<const RobotsRules> rules;//< std::atomic_load/store
+  };
+  std::shared_ptr<Entry> entryOf(const std::string& origin, bool create);
+
+  std::mutex mu;
+  std::condition_variable fetchedCond;//< an entry's fetch is over
+  std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+  std::shared_ptr<HostScheduler> scheduler;
+  std::string userAgent;
+};
+
+}//WebGrep
+
+#endif // ROBOTS_RULES_H
@@ -0,0 +1,115 @@
+#include "session_pool.h"
+#include <iostream>
+#include <algorithm>
+
+namespace WebGrep {
+
+SessionPool::SessionPool(size_t maxPerHost, size_t maxIdlePerHost, unsigned idleSeconds)
+  : d_maxPerHost(std::max((size_t)1, maxPerHost)), d_maxIdlePerHost(maxIdlePerHost),
+    d_idleTime(idleSeconds), lastEviction(Clock_t::now())
+{
+
+}
+
+void SessionPool::takeExpired(std::deque<IdleItem_t>& expired, bool force)
+{
+  auto now = Clock_t::now();
+  if (!force && now - lastEviction < std::chrono::seconds(1))
+    return;
+  lastEviction = now;
+  for(auto iter = hosts.begin(); iter != hosts.end(); )
+    {
+      std::deque<IdleItem_t>& idle(iter->second.idle);
+      //the oldest are at the front
+      while(!idle.empty() && now - idle.front().first >= d_idleTime)
+        {
+          expired.push_back(std::move(idle.front()));
+          idle.pop_front();
+        }
+      if (idle.empty() && 0 == iter->second.inUse)
+        iter = hosts.erase(iter);
+      else
+        ++iter;
+    }
+}
+
+std::shared_ptr<ClientCtx> SessionPool::acquire(const std::string& key)
+{
+  std::deque<IdleItem_t> expired;//closed when the mutex is unlocked
+  std::shared_ptr<ClientCtx> out;
+  try {
+    std::unique_lock<std::mutex> lk(mu);
+    takeExpired(expired, false);
+    Host* host = &hosts[key];
+    if (host->inUse >= d_maxPerHost)
+      {
+        bool freed = cond.wait_for(lk, std::chrono::seconds(10), [this, &key]()
+        {
+          return hosts[key].inUse < d_maxPerHost;
+        });
+        if (!freed)
+          return nullptr;
+        host = &hosts[key];
+      }
+    if (!host->idle.empty())
+      {
+        out = std::move(host->idle.back().second);
+        host->idle.pop_back();
+      }
+    else
+      {
+        out = std::make_shared<ClientCtx>();
+      }
+    host->inUse++;
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << std::endl;
+    return nullptr;
+  }
+  return out;
+}
+
+void SessionPool::release(const std::string& key, std::shared_ptr<ClientCtx>&& ctx)
+{
+  if (nullptr == ctx)
+    return;
+  std::deque<IdleItem_t> expired;
+  std::shared_ptr<ClientCtx> dropped;
+  try {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    Host& host(hosts[key]);
+    if (host.inUse > 0)
+      host.inUse--;
+    ctx->response.clear();
+    if (host.idle.size() < d_maxIdlePerHost && !ctx->host_and_port.empty())
+      host.idle.push_back(IdleItem_t(Clock_t::now(), std::move(ctx)));
+    else
+      dropped = std::move(ctx);
+    takeExpired(expired, false);
+  } catch(std::exception& ex)
+  {
+    std::cerr << __FUNCTION__ << " " << ex.what() << std::endl;
+  }
+  cond.notify_all();
+}
+
+size_t SessionPool::evictIdle()
+{
+  std::deque<IdleItem_t> expired;
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    takeExpired(expired, true);
+  }
+  return expired.size();
+}
+
+size_t SessionPool::idleCount()
+{
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  size_t cnt = 0;
+  for(auto& item : hosts)
+    cnt += item.second.idle.size();
+  return cnt;
+}
+
+}//WebGrep
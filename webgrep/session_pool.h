@@ -0,0 +1,72 @@
+#ifndef SESSION_POOL_H
+#define SESSION_POOL_H
+
+#include <map>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <condition_variable>
+#include "client_http.hpp"
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+/** Keeps connected ClientCtx (CURL* handle or ne_session) of each host
+ *  between the requests, so the requests to the same host reuse the
+ *  keep-alive connection instead of a new TCP and TLS handshake.
+ *
+ *  The key is "scheme://host:port", a context is used by one Client at a time.
+ *  Thread-safe, shared by the Client copies of all workers.
+*/
+class SessionPool : public WebGrep::noncopyable
+{
+public:
+  /** @param maxPerHost: how much contexts of a host can be used at once,
+   *  acquire() waits for one to be released above that.
+   *  @param maxIdlePerHost: how much released contexts of a host are kept.
+   *  @param idleSeconds: idle contexts older than that are closed.*/
+  explicit SessionPool(size_t maxPerHost = 16, size_t maxIdlePerHost = 8, unsigned idleSeconds = 30);
+  virtual ~SessionPool() { }
+
+  /** Take an idle context of the host (the last released one) or make a new
+   *  empty context, it's host_and_port is empty then and the caller must connect it.
+   *  @return NULL if the host's limit has not been freed for a while or on bad_alloc.*/
+  std::shared_ptr<ClientCtx> acquire(const std::string& key);
+
+  /** Give back the context taken by acquire(key), it's kept for reuse or closed.*/
+  void release(const std::string& key, std::shared_ptr<ClientCtx>&& ctx);
+
+  /** Close the contexts that are idle longer than idleSeconds.
+   *  Called by acquire() and release() once a second anyway.
+   *  @return count of closed contexts. */
+  size_t evictIdle();
+
+  size_t idleCount();
+
+protected:
+  typedef std::chrono::steady_clock Clock_t;
+  typedef std::pair<Clock_t::time_point, std::shared_ptr<ClientCtx>> IdleItem_t;
+
+  struct Host
+  {
+    Host() : inUse(0) { }
+    size_t inUse;
+    std::deque<IdleItem_t> idle;//< the last released one is at the back
+  };
+  //must be called when the mutex is locked, moves the contexts to (expired)
+  void takeExpired(std::deque<IdleItem_t>& expired, bool force);
+
+  const size_t d_maxPerHost, d_maxIdlePerHost;
+  const std::chrono::seconds d_idleTime;
+
+  std::mutex mu;
+  std::condition_variable cond;
+  std::map<std::string, Host> hosts;
+  Clock_t::time_point lastEviction;
+};
+
+}//WebGrep
+
+#endif // SESSION_POOL_H
@@ -14,14 +14,29 @@ struct Maker
   {
     //
     try {
+      //case the thread is retired by resize(): give the tasks to the peers
+      if (dataPtr->retired.load())
+        {
+          if (pos < localArray.size())
+            dataPtr->handOver(&localArray[pos], localArray.size() - pos);
+          else
+            dataPtr->handOver();
+          localArray.clear();
+          pos = 0;
+        }
       //case we have to export abandoned tasks:
-      if (nullptr != dataPtr->exportTaskFn)
+      else if (nullptr != dataPtr->exportTaskFn)
         {
           //move and export tasks that are left there:
           std::unique_lock<std::mutex> lk(dataPtr->mu);
-          dataPtr->exportTaskFn(&localArray[pos], localArray.size() - pos);
+          if (pos < localArray.size())
+            dataPtr->exportTaskFn(&localArray[pos], localArray.size() - pos);
+          localArray.clear();
+          //the queue is not continuous, move it to the array first:
+          pull(dataPtr);
+          if (!localArray.empty())
+            dataPtr->exportTaskFn(&localArray[0], localArray.size());
           localArray.clear();
-          dataPtr->exportTaskFn(&(dataPtr->workQ[0]), dataPtr->workQ.size());
 
         } else if (!dataPtr->terminateFlag)
         {//finish the jobs left there:
@@ -34,24 +49,57 @@ struct Maker
     {
       std::cerr << ex.what() << std::endl;
     }
-
+    dataPtr->exited.store(true);
   }
+  //must be called when td->mu is locked
   void pull(const TPool_ThreadDataPtr& td)
   {
     //move task queue to local array
+    if (nullptr != td->ringQ)
+      {
+        CallableDoubleFunc f;
+        while(td->ringQ->pop(f))
+          localArray.push_back(std::move(f));
+      }
     for(CallableDoubleFunc& f : td->workQ)
       {
 //        if(f.tag[0] != '\0')
 //          std::cerr << "pulled for making: " << f.tag.data() << "\n";
-        localArray.push_back(f);
+        localArray.push_back(std::move(f));
       }
     td->workQ.clear();
+    td->dequeSize.store(0);
+  }
+  /** Take just 1 task from the front, leave the rest for the thieves.
+   *  Must be called when td->mu is unlocked.*/
+  bool pullOne(const TPool_ThreadDataPtr& td)
+  {
+    CallableDoubleFunc f;
+    if (!td->pop(f))
+      return false;
+    localArray.push_back(std::move(f));
+    return true;
+  }
+  //TRUE while the pool is paused, the rest of the array is executed on resume
+  bool paused() const
+  {
+    return nullptr != dataPtr->gate && dataPtr->gate->closed.load(std::memory_order_relaxed);
   }
   void exec(volatile bool& term_flag)
   {
-    for(; pos < localArray.size() && !term_flag; ++pos)
+    for(; pos < localArray.size() && !term_flag
+        && !dataPtr->retired.load(std::memory_order_relaxed) && !paused(); ++pos)
       {
         CallableDoubleFunc& pair(localArray[pos]);
+        const TPool_Probes* probes = dataPtr->probes.get();
+        std::chrono::steady_clock::time_point started;
+        if (nullptr != probes)
+          {
+            started = std::chrono::steady_clock::now();
+            if (nullptr != probes->queueWait && 0 != pair.queuedAt.time_since_epoch().count())
+              probes->queueWait->record((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>
+                                        (started - pair.queuedAt).count());
+          }
         try {
           if (nullptr != pair.functor)
             pair.functor();
@@ -61,6 +109,13 @@ struct Maker
           if (pair.cbOnException)
             pair.cbOnException(ex);
         }
+        if (nullptr != probes)
+          {
+            if (nullptr != probes->taskExec)
+              probes->taskExec->recordSince(started);
+            if (nullptr != probes->tasks)
+              probes->tasks->add();
+          }
       }//for
     //clear if was not interrupted:
     if (pos == localArray.size())
@@ -68,12 +123,112 @@ struct Maker
         localArray.clear();
         pos = 0;
       }
+    dataPtr->held.store(localArray.size() - pos, std::memory_order_relaxed);
   }
+  bool pending() const { return pos < localArray.size(); }
   TPool_ThreadDataPtr dataPtr;
   size_t pos;//position
   std::vector<CallableDoubleFunc> localArray;
 
 };
+//-------------------------------------------------------------------------
+TPool_ThreadData::TPool_ThreadData(TPoolQueue backend)
+  : stopFlag(false), terminateFlag(false), spinCount(0)
+{
+  idle.store(false);
+  retired.store(false);
+  exited.store(false);
+  held.store(0);
+  dequeSize.store(0);
+  if (TPoolQueue::LOCKFREE_RING == backend)
+    {
+      ringQ.reset(new MPMCBoundedQueue<CallableDoubleFunc>(TPool_RingCapacity));
+      spinCount = 64;
+    }
+}
+
+void TPool_ThreadData::push(CallableDoubleFunc&& task)
+{
+  stamp(task);
+  if (nullptr != ringQ && ringQ->push(std::move(task)))
+    {
+      //pairs with the fence in ThreadsPool_pullingLoop() before parking:
+      //either we see (idle) or the thread sees the task.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (idle.load(std::memory_order_relaxed))
+        wake();
+      if (retired.load(std::memory_order_relaxed))
+        handOver();
+      return;
+    }
+  {//the deque is used by default and when the ring is full
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    workQ.push_back(std::move(task));
+    dequeSize.store(workQ.size());
+  }
+  notify();
+}
+
+void TPool_ThreadData::notify()
+{
+  cond.notify_all();
+  //a producer could take this thread from the old roster:
+  //either we see (retired) or the thread sees the task when it quits.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (retired.load(std::memory_order_relaxed))
+    handOver();
+}
+
+size_t TPool_ThreadData::handOver(CallableDoubleFunc* array, size_t len)
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::shared_ptr<TPool_Roster> rosterPtr = roster.lock();
+  TPool_PeersPtr peers = (nullptr != rosterPtr)? rosterPtr->snapshot() : TPool_PeersPtr();
+
+  std::vector<TPool_ThreadData*> heirs;
+  if (nullptr != peers)
+    {
+      for(const TPool_ThreadDataPtr& peer : *peers)
+        {
+          if (peer.get() != this && !peer->retired.load())
+            heirs.push_back(peer.get());
+        }
+    }
+  if (heirs.empty())
+    {//nobody to take them, keep the tasks in the queue
+      std::lock_guard<std::mutex> lk(mu); (void)lk;
+      for(size_t c = 0; c < len; ++c)
+        workQ.push_back(std::move(array[c]));
+      dequeSize.store(workQ.size());
+      return 0;
+    }
+
+  size_t cnt = 0;
+  for(; cnt < len; ++cnt)
+    heirs[cnt % heirs.size()]->push(std::move(array[cnt]));
+
+  CallableDoubleFunc f;
+  for(; pop(f); ++cnt)
+    heirs[cnt % heirs.size()]->push(std::move(f));
+  return cnt;
+}
+
+bool TPool_ThreadData::pop(CallableDoubleFunc& task)
+{
+  if (nullptr != ringQ && ringQ->pop(task))
+    return true;
+  if (0 == dequeSize.load())
+    return false;
+
+  std::lock_guard<std::mutex> lk(mu); (void)lk;
+  if (workQ.empty())
+    return false;
+  task = std::move(workQ.front());
+  workQ.pop_front();
+  dequeSize.store(workQ.size());
+  return true;
+}
+
 size_t TPool_ThreadData::enqueue(std::unique_lock<std::mutex>& lk,
                                  WebGrep::CallableFunc_t* array, size_t len, IteratorFunc_t iterFn)
 {
@@ -81,13 +236,15 @@ size_t TPool_ThreadData::enqueue(std::unique_lock<std::mutex>& lk,
   WebGrep::CallableFunc_t* ptr = array;
 
   size_t cnt = 0;
-  WebGrep::CallableDoubleFunc dfunc;
   bool ok = true;
   for(; ok; ok = iterFn(&ptr, &cnt, len))
     {
+      WebGrep::CallableDoubleFunc dfunc;
       dfunc.functor = *ptr;
-      workQ.push_back(dfunc);
+      stamp(dfunc);
+      workQ.push_back(std::move(dfunc));
     }
+  dequeSize.store(workQ.size());
   return cnt;
 }
 
@@ -101,21 +258,49 @@ size_t TPool_ThreadData::enqueue(std::unique_lock<std::mutex>& lk,
   size_t cnt = 0;
   for(; ok; ok = iterFn(&ptr, &cnt, len))
     {
-      workQ.push_back(*ptr);
+      stamp(*ptr);
+      workQ.push_back(std::move(*ptr));
     }
+  dequeSize.store(workQ.size());
   return cnt;
 }
 
+void TPool_Gate::pass(TPool_ThreadData& td)
+{
+  if (!closed.load())
+    return;
+  std::unique_lock<std::mutex> lk(mu);
+  parked.fetch_add(1);
+  while(closed.load() && !td.stopFlag && !td.retired.load())
+    {
+      cond.wait(lk);
+    }
+  parked.fetch_sub(1);
+}
+
+void TPool_Gate::open()
+{
+  {
+    std::lock_guard<std::mutex> lk(mu); (void)lk;
+    closed.store(false);
+  }
+  cond.notify_all();
+}
+
 void ThreadsPool_processingLoop(const TPool_ThreadDataPtr& td)
 {
   Maker taskM(td);
 
-  while(!td->stopFlag)
+  while(!td->stopFlag && !td->retired.load())
     {
+      td->gate->pass(*td);
       std::unique_lock<std::mutex> lk(td->mu);
-      if (taskM.pos >= taskM.localArray.size() && td->workQ.empty())
+      if (taskM.pos >= taskM.localArray.size() && td->workQ.empty()
+          && !td->retired.load())
         {
+          td->idle.store(true);
           td->cond.wait(lk);
+          td->idle.store(false);
         }
       taskM.pull(td);
       lk.unlock();
@@ -126,6 +311,106 @@ void ThreadsPool_processingLoop(const TPool_ThreadDataPtr& td)
   //the dtor() will either execute or export unfinished jobs
 }
 
+/** Move a half of the tasks from a busy peer's queue to (thief)'s queue.
+ *  The deque is stolen from the back and the peers are never waited for:
+ *  a locked queue is skipped. The ring is shared by design (MPMC).
+ * @return count of stolen tasks.*/
+static size_t StealTasks(const TPool_ThreadDataPtr& thief, const std::vector<TPool_ThreadDataPtr>& peers)
+{
+  std::deque<CallableDoubleFunc> loot;
+  //start from the thief's neighbour to spread the thefts among the peers
+  size_t start = 0;
+  for(; start < peers.size() && peers[start] != thief; ++start) { }
+
+  for(size_t c = 1; c < peers.size() && loot.empty(); ++c)
+    {
+      TPool_ThreadData* victim = peers[(start + c) % peers.size()].get();
+      if (victim->terminateFlag || victim->emptyApprox())
+        continue;
+      if (nullptr != victim->ringQ)
+        {
+          CallableDoubleFunc f;
+          size_t n = (1 + victim->ringQ->sizeApprox()) / 2;
+          for(; n > 0 && victim->ringQ->pop(f); --n)
+            loot.push_back(std::move(f));
+        }
+      std::unique_lock<std::mutex> lk(victim->mu, std::try_to_lock);
+      if (!lk.owns_lock() || victim->workQ.empty())
+        continue;
+      size_t n = (1 + victim->workQ.size()) / 2;
+      for(; n > 0; --n)
+        {
+          loot.push_front(std::move(victim->workQ.back()));
+          victim->workQ.pop_back();
+        }
+      victim->dequeSize.store(victim->workQ.size());
+    }
+  if (loot.empty())
+    return 0;
+
+  std::lock_guard<std::mutex> lk(thief->mu); (void)lk;
+  size_t cnt = loot.size();
+  for(CallableDoubleFunc& f : thief->workQ)
+    loot.push_back(std::move(f));
+  thief->workQ.swap(loot);
+  thief->dequeSize.store(thief->workQ.size());
+  return cnt;
+}
+
+/** The loop takes tasks one by one, it is used for the lock-free queue
+ *  and in work stealing mode (roster != NULL).
+ *  When there are no tasks it spins (td->spinCount) times, then it parks on the condition.*/
+void ThreadsPool_pullingLoop(const TPool_ThreadDataPtr& td, const TPool_RosterPtr& roster)
+{
+  Maker taskM(td);
+  //how long an idle thread sleeps before it looks for the peers' tasks again
+  const std::chrono::milliseconds parkPeriod(nullptr != roster? 20 : 500);
+
+  //on stop() without termination keep helping the peers until all queues are empty
+  while(!td->terminateFlag && !td->retired.load())
+    {
+      td->gate->pass(*td);
+      if (taskM.pending())
+        {//the task taken right before pause()
+          taskM.exec(td->terminateFlag);
+          continue;
+        }
+      if (taskM.pullOne(td))
+        {
+          taskM.exec(td->terminateFlag);
+          continue;
+        }
+      if (nullptr != roster && 0 != StealTasks(td, *roster->snapshot()))
+        continue;
+
+      bool gotTask = false;
+      for(unsigned spin = 0; spin < td->spinCount && !gotTask; ++spin)
+        {
+          std::this_thread::yield();
+          gotTask = !td->emptyApprox();
+        }
+      if (gotTask)
+        continue;
+
+      std::unique_lock<std::mutex> lk(td->mu);
+      td->idle.store(true, std::memory_order_relaxed);
+      //pairs with the fence in TPool_ThreadData::push()
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (td->emptyApprox() && !td->retired.load())
+        {
+          if (td->stopFlag)
+            {
+              td->idle.store(false);
+              break;
+            }
+          td->cond.wait_for(lk, parkPeriod);
+        }
+      td->idle.store(false);
+    }//while
+
+  //the dtor() will either execute or export unfinished jobs
+}
+
 bool PtrForwardIterationDbl(WebGrep::CallableDoubleFunc** arrayPPtr, size_t* counter, size_t maxValue)
 {
   ++(*arrayPPtr);
@@ -138,32 +423,156 @@ bool PtrForwardIteration(WebGrep::CallableFunc_t** arrayPPtr, size_t* counter, s
 }
 
 
-ThreadsPool::ThreadsPool(uint32_t nthreads)
-  : d_closed(false)
+ThreadsPool::ThreadsPool(uint32_t nthreads, bool workStealing, TPoolQueue queueBackend,
+                         std::shared_ptr<TPool_Probes> probes)
+  : d_probes(probes), d_closed(false), d_stealing(workStealing), d_backend(queueBackend)
 {
+  d_current.store(0);
+  d_roster = std::make_shared<TPool_Roster>();
+  d_gate = std::make_shared<TPool_Gate>();
   threadsVec.resize(nthreads);
   mcVec.resize(nthreads);
 
-  size_t idx = 0;
+  for(size_t idx = 0; idx < mcVec.size(); ++idx)
+    {
+      mcVec[idx] = std::make_shared<TPool_ThreadData>(d_backend);
+    }
+  d_roster->publish(std::make_shared<std::vector<TPool_ThreadDataPtr>>(mcVec));
 
+  size_t idx = 0;
   for(std::thread& t : threadsVec)
     {
-      mcVec[idx] = std::make_shared<TPool_ThreadData>();
-      t = std::thread(ThreadsPool_processingLoop, mcVec[idx]);
+      t = spawn(mcVec[idx]);
       idx++;
     }
 }
 
+std::thread ThreadsPool::spawn(const TPool_ThreadDataPtr& td)
+{
+  td->roster = d_roster;
+  td->gate = d_gate;
+  td->probes = d_probes;
+  if (d_stealing)
+    return std::thread(ThreadsPool_pullingLoop, td, d_roster);
+  else if (TPoolQueue::LOCKFREE_RING == d_backend)
+    return std::thread(ThreadsPool_pullingLoop, td, TPool_RosterPtr());
+  return std::thread(ThreadsPool_processingLoop, td);
+}
+
+bool ThreadsPool::resize(uint32_t nthreads)
+{
+  if (0 == nthreads)
+    return false;
+  std::lock_guard<std::mutex> lk(joinMutex);
+  if (closed() || threadsVec.empty())
+    return false;
+  joinRetired(true);
+
+  bool ok = true;
+  try {
+    while(mcVec.size() < nthreads)
+      {
+        TPool_ThreadDataPtr td = std::make_shared<TPool_ThreadData>(d_backend);
+        threadsVec.push_back(spawn(td));
+        mcVec.push_back(td);
+      }
+    std::vector<TPool_ThreadDataPtr> leaving;
+    while(mcVec.size() > nthreads)
+      {
+        leaving.push_back(mcVec.back());
+        retiredVec.push_back(std::make_pair(std::move(threadsVec.back()), mcVec.back()));
+        threadsVec.pop_back();
+        mcVec.pop_back();
+      }
+    //publish first, so the retired threads see whom to give the tasks
+    d_roster->publish(std::make_shared<std::vector<TPool_ThreadDataPtr>>(mcVec));
+    for(TPool_ThreadDataPtr& td : leaving)
+      {
+        td->retired.store(true);
+        td->wake();
+      }
+    if (!leaving.empty())
+      {//the paused ones are parked at the gate
+        d_gate->wake();
+      }
+  } catch(...)
+  {//on bad_alloc or failed thread start: keep what we've got
+    ok = false;
+    d_roster->publish(std::make_shared<std::vector<TPool_ThreadDataPtr>>(mcVec));
+  }
+  return ok;
+}
+
+void ThreadsPool::joinRetired(bool exitedOnly)
+{
+  for(size_t idx = 0; idx < retiredVec.size(); )
+    {
+      if (exitedOnly && !retiredVec[idx].second->exited.load())
+        {
+          ++idx;
+          continue;
+        }
+      retiredVec[idx].first.join();
+      retiredVec.erase(retiredVec.begin() + idx);
+    }
+}
+
+void ThreadsPool::wakeThief(TPool_ThreadData* td, const std::vector<TPool_ThreadDataPtr>& peers)
+{
+  if (!d_stealing || td->idle.load())
+    return;
+  //the owner is busy, let an idle peer to take the tasks
+  for(const TPool_ThreadDataPtr& peer : peers)
+    {
+      if (peer.get() != td && peer->idle.load())
+        {
+          peer->wake();
+          return;
+        }
+    }
+}
+
 size_t ThreadsPool::threadsCount() const
 {
-    return threadsVec.size();
+    return d_roster->snapshot()->size();
 }
 
 bool ThreadsPool::closed() const
 {
     return d_closed;
 }
-bool ThreadsPool::submit(CallableDoubleFunc& ftor)
+
+void ThreadsPool::pause()
+{
+  d_gate->closed.store(true);
+}
+
+void ThreadsPool::resume()
+{
+  d_gate->open();
+}
+
+bool ThreadsPool::paused() const
+{
+  return d_gate->closed.load();
+}
+
+size_t ThreadsPool::parkedCount() const
+{
+  return d_gate->parked.load();
+}
+
+bool ThreadsPool::idle() const
+{
+  TPool_PeersPtr peers = d_roster->snapshot();
+  for(const TPool_ThreadDataPtr& td : *peers)
+    {
+      if (!td->idle.load() || !td->emptyApprox() || 0 != td->held.load())
+        return false;
+    }
+  return true;
+}
+bool ThreadsPool::submit(CallableDoubleFunc&& ftor)
 {
   if (closed())
     return false;
@@ -188,19 +597,23 @@ bool ThreadsPool::submit(CallableDoubleFunc* ftorArray, size_t len,
   if (closed())
     return false;
 
+  TPool_PeersPtr peers = d_roster->snapshot();
+  if (peers->empty())
+    return false;
   size_t inc = std::max((size_t)1, len);
   d_current.fetch_add(inc, std::memory_order_acquire);
-  unsigned idx = d_current.load(std::memory_order_relaxed) % threadsVec.size();
+  unsigned idx = d_current.load(std::memory_order_relaxed) % peers->size();
 
   try {
     if (!spray)
       {//case we serialize tasks just to 1 thread
-        TPool_ThreadData* td = mcVec[idx].get();
+        TPool_ThreadData* td = (*peers)[idx].get();
         {
           std::unique_lock<std::mutex>lk(td->mu); (void)lk;
           td->enqueue(lk, ftorArray, len, iterFn);
         }
         td->notify();
+        wakeThief(td, *peers);
         return true;
       }
 
@@ -209,16 +622,12 @@ bool ThreadsPool::submit(CallableDoubleFunc* ftorArray, size_t len,
     bool ok = true;
     for(size_t cnt = 0; ok; ok = iterFn(&ptr, &cnt, len))
       {
-        TPool_ThreadData* td = mcVec[idx].get();
-        {
-          std::unique_lock<std::mutex>lk(td->mu);
-          (void)lk;
-          td->workQ.push_back(*ptr);
-        }
-        td->notify();
+        TPool_ThreadData* td = (*peers)[idx].get();
+        td->push(std::move(*ptr));
+        wakeThief(td, *peers);
 
         d_current.fetch_add(inc, std::memory_order_acquire);
-        idx = d_current.load(std::memory_order_relaxed) % threadsVec.size();
+        idx = d_current.load(std::memory_order_relaxed) % peers->size();
       }
   } catch(...)
   {
@@ -234,39 +643,41 @@ bool ThreadsPool::submit(WebGrep::CallableFunc_t* ftorArray, size_t len,
   if (closed())
     return false;
 
+  TPool_PeersPtr peers = d_roster->snapshot();
+  if (peers->empty())
+    return false;
   size_t inc = std::max((size_t)1, len);
   d_current.fetch_add(inc, std::memory_order_acquire);
-  unsigned idx = d_current.load(std::memory_order_relaxed) % threadsVec.size();
+  unsigned idx = d_current.load(std::memory_order_relaxed) % peers->size();
 
   try {
     if (!spray)
       {//case we serialize tasks just to 1 thread
-        TPool_ThreadData* td = mcVec[idx].get();
+        TPool_ThreadData* td = (*peers)[idx].get();
         size_t n = 0;
         {
           std::unique_lock<std::mutex>lk(td->mu);
           n = td->enqueue(lk, ftorArray, len, iterFn);
         }
         td->notify();
+        wakeThief(td, *peers);
         return n == len;
       }
 
     //case we serialize tasks to all threads (spraying them):
     CallableFunc_t* ptr = ftorArray;
-    WebGrep::CallableDoubleFunc dfunc;
 
     bool ok = true;
     for(size_t cnt = 0; ok; ok = iterFn(&ptr, &cnt, len))
       {
-        TPool_ThreadData* td = mcVec[idx].get();
-        {
-          std::unique_lock<std::mutex>lk(td->mu);
-          td->enqueue(lk, &dfunc, 1);
-        }
-        td->notify();
+        TPool_ThreadData* td = (*peers)[idx].get();
+        WebGrep::CallableDoubleFunc dfunc;
+        dfunc.functor = *ptr;
+        td->push(std::move(dfunc));
+        wakeThief(td, *peers);
 
         d_current.fetch_add(inc, std::memory_order_acquire);
-        idx = d_current.load(std::memory_order_relaxed) % threadsVec.size();
+        idx = d_current.load(std::memory_order_relaxed) % peers->size();
       }
   } catch(...)
   {
@@ -281,10 +692,13 @@ TPool_ThreadDataPtr ThreadsPool::getDataHandle()
   if (closed())
     return nullptr;
 
+  TPool_PeersPtr peers = d_roster->snapshot();
+  if (peers->empty())
+    return nullptr;
   d_current.fetch_add(1, std::memory_order_acquire);
-  unsigned idx = d_current.load(std::memory_order_relaxed) % threadsVec.size();
+  unsigned idx = d_current.load(std::memory_order_relaxed) % peers->size();
 
-  return mcVec[idx];
+  return (*peers)[idx];
 }
 
 void ThreadsPool::close()
@@ -303,12 +717,15 @@ void ThreadsPool::joinAll(bool terminateCurrentTasks)
   std::lock_guard<std::mutex> lk(joinMutex);
 
   close();
+  //the retired threads are giving their tasks to the rest, let them finish
+  joinRetired(false);
   for(TPool_ThreadDataPtr& dt : mcVec)
     {
       dt->terminateFlag = terminateCurrentTasks;
       dt->stopFlag = true;
       dt->cond.notify_all();
     }
+  d_gate->open();
 
   for(std::thread& t : threadsVec)
     {
@@ -316,6 +733,7 @@ void ThreadsPool::joinAll(bool terminateCurrentTasks)
     }
   threadsVec.clear();
   mcVec.clear();
+  d_roster->publish(std::make_shared<std::vector<TPool_ThreadDataPtr>>());
 }
 
 void ThreadsPool::terminateDetach()
@@ -324,6 +742,9 @@ void ThreadsPool::terminateDetach()
   close();
   for(std::thread& t : threadsVec)
     { t.detach(); }
+  for(auto& retiree : retiredVec)
+    { retiree.first.detach(); }
+  retiredVec.clear();
 
   for(TPool_ThreadDataPtr& dt : mcVec)
     {
@@ -331,8 +752,10 @@ void ThreadsPool::terminateDetach()
       dt->stopFlag = true;
       dt->cond.notify_all();
     }
+  d_gate->open();
   threadsVec.clear();
   mcVec.clear();
+  d_roster->publish(std::make_shared<std::vector<TPool_ThreadDataPtr>>());
 }
 
 void ThreadsPool::joinExportAll(const std::function<void(CallableDoubleFunc*, size_t)>& exportFunctor)
@@ -343,6 +766,8 @@ void ThreadsPool::joinExportAll(const std::function<void(CallableDoubleFunc*, si
       return;
 
     close();
+    //the retired threads must give away their tasks before the export
+    joinRetired(false);
     for(TPool_ThreadDataPtr& dt : mcVec)
       {
         dt->exportTaskFn = exportFunctor;
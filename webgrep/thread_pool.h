@@ -7,19 +7,37 @@
 #include <condition_variable>
 #include <atomic>
 #include <vector>
+#include <deque>
+#include <array>
+#include <functional>
 #include "noncopyable.hpp"
+#include "mpmc_queue.h"
+#include "inline_function.h"
+#include "metrics.h"
 
 namespace WebGrep {
 
 typedef std::function<void()> CallableFunc_t;
 
-/** encapsulates a callable and an exception callback.*/
+/** Move-only functors of the tasks, a lambda that captures up to 96 bytes
+ *  (or 32 bytes for the exception callback) does not allocate memory.*/
+typedef WebGrep::InlineFunction<void(), 96> TaskFunc_t;
+typedef WebGrep::InlineFunction<void(const std::exception&), 32> TaskExceptionFunc_t;
+
+/** encapsulates a callable and an exception callback.
+ *  The object is move-only: the pool moves it from the submission
+ *  to the execution (or to the export of abandoned tasks) without copying.*/
 struct CallableDoubleFunc
 {
   CallableDoubleFunc() { tag.fill(0x00); }
+  CallableDoubleFunc(CallableDoubleFunc&&) = default;
+  CallableDoubleFunc& operator = (CallableDoubleFunc&&) = default;
+
   std::array<char, 16> tag;
-  WebGrep::CallableFunc_t functor;
-  std::function<void(const std::exception&)> cbOnException;
+  WebGrep::TaskFunc_t functor;
+  WebGrep::TaskExceptionFunc_t cbOnException;
+  //when the task is queued, set by the pools that have TPool_Probes
+  std::chrono::steady_clock::time_point queuedAt;
 };
 
 //iterator function type to iterate over array of functors for submission
@@ -34,14 +52,58 @@ bool PtrForwardIteration(WebGrep::CallableFunc_t** arrayPPtr, size_t* counter, s
 
 
 //-------------------------------------------------------------------------
+/** Backend of a thread's task queue:
+ *  LOCKED_DEQUE -- std::deque guarded by the mutex, the thread always waits on the condition;
+ *  LOCKFREE_RING -- bounded lock-free MPMC ring (the deque takes the overflow),
+ *  the thread spins a while before it parks on the condition,
+ *  producers lock and notify only when the thread is parked.*/
+enum class TPoolQueue
+{
+  LOCKED_DEQUE = 0, LOCKFREE_RING
+};
+
+//capacity of a thread's ring (TPoolQueue::LOCKFREE_RING)
+const size_t TPool_RingCapacity = 1024;
+
+struct TPool_Roster;
+struct TPool_Gate;
+
+/** Optional metrics of a pool, the NULL ones are not recorded:
+ *  how long the tasks wait in the queues, how long they're executed, count of the tasks.*/
+struct TPool_Probes
+{
+  std::shared_ptr<LatencyHistogram> queueWait, taskExec;
+  std::shared_ptr<MetricCounter> tasks;
+};
+
 /** A structure that can be used directly to enqueue tasks to a threads pool.*/
 struct TPool_ThreadData
 {
-  TPool_ThreadData() : stopFlag(false), terminateFlag(false)
+  explicit TPool_ThreadData(TPoolQueue backend = TPoolQueue::LOCKED_DEQUE);
+
+  /** Put one task to the queue and wake up the thread if it's parked.
+   * Thread-safe, must be called when the mutex is unlocked.
+   * Possible exceptions: bad_alloc. */
+  void push(CallableDoubleFunc&& task);
+
+  /** Take one task from the front of the queue: the ring first, then the deque.
+   * Thread-safe, must be called when the mutex is unlocked.
+   * @return FALSE if there were no tasks.*/
+  bool pop(CallableDoubleFunc& task);
+
+  /** Mark the time the task is queued if the pool has probes, the task moved between
+   *  the queues (stolen, handed over) keeps the first mark.*/
+  void stamp(CallableDoubleFunc& task) const
   {
-    workQ.reserve(32);
+    if (nullptr != probes && nullptr != probes->queueWait
+        && 0 == task.queuedAt.time_since_epoch().count())
+      task.queuedAt = std::chrono::steady_clock::now();
   }
 
+  /** Approximate check that is used for spinning.*/
+  bool emptyApprox() const
+  { return (nullptr == ringQ || ringQ->emptyApprox()) && 0 == dequeSize.load(); }
+
   /** Serialize functors to this thread. Call notify() later to take effect.
    * Possible exceptions: bad_alloc.
    * @return count of items serialized */
@@ -49,27 +111,96 @@ struct TPool_ThreadData
                  WebGrep::CallableFunc_t* ftorArray, size_t len,
                  IteratorFunc_t iterFn = PtrForwardIteration);
 
-  /** Serialize functors to this thread. Call notify() later to take effect.
+  /** Serialize functors to this thread, the items are moved from the (array).
+   * Call notify() later to take effect.
    * Possible exceptions: bad_alloc.
    * @return count of items serialized*/
   size_t enqueue(std::unique_lock<std::mutex>& lk,
                  CallableDoubleFunc* array, size_t len,
                  IteratorFunc2_t iterFn = PtrForwardIterationDbl);
 
-  /** Must be called when the mutex is unlocked.*/
-  void notify() { cond.notify_all();}
+  /** Must be called when the mutex is unlocked.
+   *  If the thread is retired the enqueued tasks are handed over to the peers.*/
+  void notify();
+
+  /** Same as notify(), but synchronizes with the thread that is going to be parked.
+   *  Must be called when the mutex is unlocked.*/
+  void wake() { { std::lock_guard<std::mutex> lk(mu); (void)lk; } cond.notify_all(); }
+
+  /** Move the (array) items and the queued tasks to the peers that are not retired.
+   *  Used by the retired thread and by the producers that came late.
+   *  Must be called when the mutex is unlocked.
+   *  @return count of tasks handed over.*/
+  size_t handOver(CallableDoubleFunc* array = nullptr, size_t len = 0);
 
   std::mutex mu;
   std::condition_variable cond;
   volatile bool stopFlag;     //< tells to stop after finishing current tasks
   volatile bool terminateFlag;//< tells to quite the loop ASAP
-  std::vector<CallableDoubleFunc> workQ;
-
-  //used to export abandoned tasks
+  std::atomic_bool idle;      //< TRUE while the thread waits for tasks (parked)
+  std::atomic_bool retired;   //< set by ThreadsPool::resize(), the thread gives it's tasks away and quits
+  std::atomic_bool exited;    //< the thread has left the loop, it can be joined without waiting
+  std::atomic<size_t> held;   //< count of the tasks taken from the queue, left unexecuted by pause()
+  unsigned spinCount;         //< how much times to check the queue before parking
+
+  /** Owner thread pops from the front, thieves take from the back
+   *  when work stealing is enabled in the pool.
+   *  Access only when the mutex is locked, update dequeSize as well.*/
+  std::deque<CallableDoubleFunc> workQ;
+  std::atomic<size_t> dequeSize;
+
+  //lock-free queue, NULL for TPoolQueue::LOCKED_DEQUE
+  std::unique_ptr<MPMCBoundedQueue<CallableDoubleFunc>> ringQ;
+
+  //used to export abandoned tasks, the functor must move them from the array
   std::function<void(CallableDoubleFunc*, size_t/*n_items*/)> exportTaskFn;
+
+  //the pool's threads list, the retired thread gives the tasks to them
+  std::weak_ptr<TPool_Roster> roster;
+
+  //the pool's pause gate, the thread passes it before taking the tasks
+  std::shared_ptr<TPool_Gate> gate;
+
+  //the pool's metrics, NULL if disabled
+  std::shared_ptr<TPool_Probes> probes;
 };
 typedef std::shared_ptr<std::thread> ThreadPtr;
 typedef std::shared_ptr<TPool_ThreadData> TPool_ThreadDataPtr;
+typedef std::shared_ptr<std::vector<TPool_ThreadDataPtr>> TPool_PeersPtr;
+
+/** The pool's threads that are shared with the threads and submit().
+ *  The vector is never modified: resize() publishes a new one,
+ *  the readers take a snapshot.*/
+struct TPool_Roster
+{
+  TPool_PeersPtr snapshot() const { return std::atomic_load(&peers); }
+  void publish(const TPool_PeersPtr& neu) { std::atomic_store(&peers, neu); }
+
+  TPool_PeersPtr peers;
+};
+typedef std::shared_ptr<TPool_Roster> TPool_RosterPtr;
+
+/** The pause gate shared by the pool's threads (see ThreadsPool::pause()):
+ *  while it's closed the threads park here between the tasks, their queues are kept.*/
+struct TPool_Gate
+{
+  TPool_Gate() { closed.store(false); parked.store(0); }
+
+  /** Park the thread of (td) while the gate is closed,
+   *  it goes on after open() or when it's told to stop or it's retired.*/
+  void pass(TPool_ThreadData& td);
+
+  /** Let all parked threads go by one notification.*/
+  void open();
+
+  /** Wake up the parked threads to check their flags, the gate stays closed.*/
+  void wake() { { std::lock_guard<std::mutex> lk(mu); (void)lk; } cond.notify_all(); }
+
+  std::mutex mu;
+  std::condition_variable cond;
+  std::atomic_bool closed;
+  std::atomic_uint parked;//< count of the threads waiting at the gate
+};
 //-------------------------------------------------------------------------
 
 
@@ -87,25 +218,77 @@ typedef std::shared_ptr<TPool_ThreadData> TPool_ThreadDataPtr;
  *  To control exceptions raised from execution of the functor
  *  the user must set CallableDoubleFunc.cbOnException callbacks for each task during submission
  *  via the submit(const CallableDoublefunc* array ...) method.
+ *
+ *  Work stealing mode (constructor's argument): each thread takes tasks
+ *  one by one from the front of it's own queue, when the queue is empty
+ *  the thread steals a half of the tasks from the back of a busy peer's queue.
+ *  So a task that blocks one thread (like a slow download) does not stall
+ *  the tasks queued behind it.
+ *
+ *  Queue backend (constructor's argument, see TPoolQueue): the lock-free ring
+ *  lets submit() to skip the mutex and the futex call while the thread is busy,
+ *  the threads take tasks one by one from the ring in that case.
+ *
+ *  The count of threads can be changed by resize() while the pool is running:
+ *  new threads are started, or the last ones are retired -- a retired thread
+ *  finishes it's current task and moves the rest of it's queue to the other threads.
+ *  The tasks are never exported or dropped on resize().
+ *
+ *  pause() parks the threads between the tasks without joining them: the queues
+ *  stay where they are and submit() keeps queueing, resume() lets them go on.
+ *
+ *  With TPool_Probes (constructor's argument) the threads record the time each task
+ *  has waited in the queues and it's execution time.
 */
 class ThreadsPool : public WebGrep::noncopyable
 {
 public:
 
   //can throw std::bad_alloc on when system has got no bytes for spare
-  explicit ThreadsPool(uint32_t nthreads = 1);
+  explicit ThreadsPool(uint32_t nthreads = 1, bool workStealing = false,
+                       TPoolQueue queueBackend = TPoolQueue::LOCKED_DEQUE,
+                       std::shared_ptr<TPool_Probes> probes = nullptr);
   virtual ~ThreadsPool() { close(); joinAll(); }
   size_t threadsCount() const;
 
+  /** Start new threads or retire some of them, without stopping the pool.
+   *  Method is thread-safe, synchronized by this->joinMutex.
+   *  @return FALSE if (nthreads) is 0 or the pool is closed or on bad_alloc.*/
+  bool resize(uint32_t nthreads);
+
+  bool workStealing() const { return d_stealing; }
+  TPoolQueue queueBackend() const { return d_backend; }
+
   bool closed() const;
 
+  /** Close the pause gate: each thread finishes it's current task and parks,
+   *  the queued tasks are kept and submit() goes on queueing. It's O(1):
+   *  the threads are not joined, the tasks are not moved. See parkedCount().
+   *  Joining the paused pool lets the threads go.*/
+  void pause();
+
+  /** Open the pause gate, the parked threads go on with their queues.*/
+  void resume();
+
+  bool paused() const;
+
+  /** Count of the threads parked by pause(),
+   *  it reaches threadsCount() when the current tasks are done.*/
+  size_t parkedCount() const;
+
+  /** TRUE if all threads are parked, their queues are empty and they keep no tasks.
+   *  It's approximate: a task may be submitted right after the check,
+   *  the threads retired by resize() are not counted.*/
+  bool idle() const;
+
   //submit 1 task that has no cbOnException callback.
   bool submit(const WebGrep::CallableFunc_t& ftor);
 
   //submit 1 task with cbOnException callback
-  bool submit(CallableDoubleFunc& ftor);
+  bool submit(CallableDoubleFunc&& ftor);
 
-  /** Submit(len) tasks from array of data. A generalized interface
+  /** Submit(len) tasks from array of data, the tasks are moved from there.
+   *  A generalized interface
    *  to work with raw pointers or containers by providing iteration functor.
    *  The iteration functor is called after each element access by pointer dereference.
    *  Example for the linked list:
@@ -141,6 +324,8 @@ public:
 
   /** Get a one thread handle to serialize things in your own manner,
    *  be careful with the locks! I hope you known what you're doing.
+   *  Do not keep the handle: the thread may be retired by resize(),
+   *  the tasks enqueued there later are handed over on notify() though.
    *  @return thread data pointer or NULL if closed(). */
   TPool_ThreadDataPtr getDataHandle();
 
@@ -155,7 +340,8 @@ public:
   /** Notify all threads to stop, but do not join(), detach() instead.*/
   void terminateDetach();
 
-  /** Terminates execution of tasks ASAP, exports abandoned task functors by given functor.
+  /** Terminates execution of tasks ASAP, exports abandoned task functors by given functor,
+   * the functor must move the tasks from the given array.
    * Method is thread-safe.*/
   void joinExportAll(const std::function<void(CallableDoubleFunc*, size_t)>& exportFunctor);
 
@@ -163,11 +349,25 @@ public:
 
 protected:
 
+  //wake up an idle thread to steal the tasks from busy (td)
+  void wakeThief(TPool_ThreadData* td, const std::vector<TPool_ThreadDataPtr>& peers);
+
+  //start a thread for (td), must be called when joinMutex is locked
+  std::thread spawn(const TPool_ThreadDataPtr& td);
+
+  //join retired threads, must be called when joinMutex is locked
+  void joinRetired(bool exitedOnly);
 
   std::vector<std::thread> threadsVec;
   std::vector<TPool_ThreadDataPtr> mcVec;
+  TPool_RosterPtr d_roster;//< same as mcVec, shared with the threads
+  std::shared_ptr<TPool_Gate> d_gate;
+  std::shared_ptr<TPool_Probes> d_probes;
+  std::vector<std::pair<std::thread, TPool_ThreadDataPtr>> retiredVec;
   std::atomic_uint d_current;
   volatile bool d_closed;
+  const bool d_stealing;
+  const TPoolQueue d_backend;
 
   std::mutex joinMutex;
 };
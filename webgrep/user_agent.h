@@ -0,0 +1,13 @@
+#ifndef USER_AGENT_H
+#define USER_AGENT_H
+
+namespace WebGrep {
+
+/** The crawler's product token: robots.txt groups are matched by it (RobotsRules::Parse()),
+ *  the User-Agent header of all requests starts with it, whatever HTTP library sends them.*/
+static const char* const UserAgentToken = "webgrep";
+static const char* const UserAgentHeader = "webgrep/1.0";
+
+}//WebGrep
+
+#endif // USER_AGENT_H
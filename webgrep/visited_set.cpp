@@ -0,0 +1,112 @@
+#include "visited_set.h"
+#include <cstring>
+#include <cctype>
+
+namespace WebGrep {
+
+bool VisitedSet::insertHash(uint64_t hash)
+{
+  Shard& sh(shardOf(hash));
+  std::lock_guard<std::mutex> lk(sh.mu); (void)lk;
+  return sh.hashes.insert(hash).second;
+}
+
+void VisitedSet::erase(const std::string& url)
+{
+  uint64_t hash = HashURL(url);
+  Shard& sh(shardOf(hash));
+  std::lock_guard<std::mutex> lk(sh.mu); (void)lk;
+  sh.hashes.erase(hash);
+}
+
+bool VisitedSet::contains(const std::string& url)
+{
+  uint64_t hash = HashURL(url);
+  Shard& sh(shardOf(hash));
+  std::lock_guard<std::mutex> lk(sh.mu); (void)lk;
+  return 0 != sh.hashes.count(hash);
+}
+
+size_t VisitedSet::size()
+{
+  size_t cnt = 0;
+  for(Shard& sh : shards)
+    {
+      std::lock_guard<std::mutex> lk(sh.mu); (void)lk;
+      cnt += sh.hashes.size();
+    }
+  return cnt;
+}
+
+void VisitedSet::clear()
+{
+  for(Shard& sh : shards)
+    {
+      std::lock_guard<std::mutex> lk(sh.mu); (void)lk;
+      sh.hashes.clear();
+    }
+}
+
+std::string VisitedSet::NormalizeURL(const char* url, size_t len)
+{
+  std::string out;
+  out.reserve(len);
+  //cut the fragment
+  const char* hash = (const char*)::memchr(url, '#', len);
+  if (nullptr != hash)
+    len = hash - url;
+
+  size_t pos = 0;
+  size_t schemeEnd = 0;
+  {//scheme and host are case-insensitive
+    const char* sep = nullptr;
+    for(size_t c = 0; c + 2 < len && c < 8; ++c)
+      {
+        if (0 == ::memcmp(url + c, "://", 3))
+          {
+            sep = url + c;
+            break;
+          }
+      }
+    if (nullptr != sep)
+      {
+        schemeEnd = sep - url;
+        for(; pos < schemeEnd; ++pos)
+          out += (char)std::tolower((unsigned char)url[pos]);
+        out += "://";
+        pos += 3;
+      }
+    size_t hostBegin = out.size();
+    for(; pos < len && url[pos] != '/' && url[pos] != '?'; ++pos)
+      out += (char)std::tolower((unsigned char)url[pos]);
+
+    //drop the default port
+    size_t colon = out.find_last_of(':');
+    if (std::string::npos != colon && colon >= hostBegin)
+      {
+        bool https = (5 == schemeEnd && 0 == out.compare(0, 5, "https"));
+        const char* defPort = https? ":443" : ":80";
+        if (0 == out.compare(colon, std::string::npos, defPort))
+          out.resize(colon);
+      }
+  }
+  out.append(url + pos, len - pos);
+  //"site.com/a/" and "site.com/a" are the same page mostly
+  while(!out.empty() && out.back() == '/')
+    out.pop_back();
+  return out;
+}
+
+uint64_t VisitedSet::HashURL(const std::string& url)
+{
+  std::string norm = NormalizeURL(url.data(), url.size());
+  uint64_t hash = 14695981039346656037ULL;
+  for(unsigned char c : norm)
+    {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+  return hash;
+}
+
+}//WebGrep
@@ -0,0 +1,58 @@
+#ifndef VISITED_SET_H
+#define VISITED_SET_H
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <unordered_set>
+#include "noncopyable.hpp"
+
+namespace WebGrep {
+
+/** Crawl-wide set of the URLs that are scheduled for download already.
+ *  Keeps 64-bit hashes of normalized URLs in shards, each shard has it's own mutex,
+ *  so the workers that check different URLs rarely wait for each other.
+ *  Thread-safe, shared by all nodes of a tree via LinkedTask::visitedSet.
+*/
+class VisitedSet : public WebGrep::noncopyable
+{
+public:
+  VisitedSet() { }
+
+  /** Mark the URL as visited.
+   * @return TRUE if it was not visited before. Possible exceptions: bad_alloc.*/
+  bool insert(const std::string& url) { return insertHash(HashURL(url)); }
+  bool insertHash(uint64_t hash);
+
+  /** Forget the URL inserted by the caller, e.g. it's subtask has failed to spawn.*/
+  void erase(const std::string& url);
+
+  bool contains(const std::string& url);
+  size_t size();
+  void clear();
+
+  /** Lowercase the scheme and the host, drop the default port (:80, :443),
+   *  the "#fragment" and "/" at the end of the path.
+   *  "HTTP://Site.com:80/a/#top" becomes "http://site.com/a" */
+  static std::string NormalizeURL(const char* url, size_t len);
+
+  //FNV-1a hash of NormalizeURL()
+  static uint64_t HashURL(const std::string& url);
+
+protected:
+  static const size_t shardsCount = 64;
+  struct Shard
+  {
+    std::mutex mu;
+    std::unordered_set<uint64_t> hashes;
+    char pad[64];//< keep the mutexes on different cache lines
+  };
+  Shard& shardOf(uint64_t hash) { return shards[(hash >> 58) % shardsCount]; }
+
+  std::array<Shard, shardsCount> shards;
+};
+
+}//WebGrep
+
+#endif // VISITED_SET_H
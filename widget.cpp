@@ -184,6 +184,8 @@ void Widget::makeRootWidget(WebGrep::RootNodePtr rootNode, WebGrep::LinkedTask*
 {
   taskWidgetsMap.clear();
   widgetsTaskMap.clear();
+  //the nodes of previous tree may be released now
+  treePin = std::make_shared<WebGrep::EpochGuard>();
 
   for(QTreeWidgetItem* item = ui->treeWidget->takeTopLevelItem(0);
       item != nullptr; item = ui->treeWidget->takeTopLevelItem(0))
@@ -199,8 +201,10 @@ void Widget::makeRootWidget(WebGrep::RootNodePtr rootNode, WebGrep::LinkedTask*
 //-----------------------------------------------------------------------------
 void Widget::onSinglePageScanned(WebGrep::RootNodePtr rootNode, WebGrep::LinkedTask* node)
 {
+  //keep the node alive until the functor is called in GUI thread
+  auto pin = std::make_shared<WebGrep::EpochGuard>();
   auto ftor = std::function<void()>
-  ([this, rootNode, node]()
+  ([this, rootNode, node, pin]()
   {
       auto iter = taskWidgetsMap.find(node);
       if(taskWidgetsMap.end() == iter && 0 == node->level)
@@ -295,7 +299,8 @@ void Widget::onPagesListScanned(std::shared_ptr<WebGrep::LinkedTask> rootNode, W
 
   //Make a functor that updates GUI with new algorithm's data.
   //Then dispatch it via queued Qt connection.
-  auto ftor = std::function<void()>( [this, rootNode, node]()
+  auto pin = std::make_shared<WebGrep::EpochGuard>();
+  auto ftor = std::function<void()>( [this, rootNode, node, pin]()
     { this->updateRenderNodes(rootNode, node); });
 
   //dispatch ftor() to be executed in Qt main loop, it'll rearrange the tree's widgets
@@ -8,6 +8,7 @@
 #include <memory>
 
 #include "webgrep/linked_task.h"
+#include "webgrep/epoch_reclaimer.h"
 
 class QTimer;
 
@@ -102,6 +103,8 @@ private:
 
   std::map<WebGrep::LinkedTask*, WidgetConn> taskWidgetsMap;
   std::map<QTreeWidgetItem*, WebGrep::LinkedTask*> widgetsTaskMap;
+  //the nodes in the maps are not released by the crawler while it's held
+  std::shared_ptr<WebGrep::EpochGuard> treePin;
 
 };
 